@@ -0,0 +1,861 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "analyzer.h"
+#include "disassembler.h"
+
+#define JUMP_TABLE_STORES 4
+
+// Indexed loads seen on the way to a JMP (indirect) or an RTS, to find the tables they come from
+typedef struct
+{
+    int loaded; // table read by the previous instruction, -1 when it was not an indexed load
+    int store_pointers[JUMP_TABLE_STORES];
+    int store_tables[JUMP_TABLE_STORES];
+    unsigned int store_count;
+    int pushes[2]; // tables pushed by the last two PHA, oldest first
+} TABLE_TRACKER;
+
+// 16 and 32 KB ROMs are one piece of address space, bigger ones are made of independent banks
+static unsigned int analysis_segment_start(const ANALYSIS *analysis, unsigned int offset)
+{
+    return analysis->bank_count <= 2 ? 0 : offset / PRG_BANK_SIZE * PRG_BANK_SIZE;
+}
+
+static unsigned int analysis_segment_end(const ANALYSIS *analysis, unsigned int offset)
+{
+    return analysis->bank_count <= 2 ? analysis->prg_size : (offset / PRG_BANK_SIZE + 1) * PRG_BANK_SIZE;
+}
+
+// Returns the PRG offset of an address seen from the bank, -1 when it is not in ROM or depends on the switched bank
+int analysis_offset(const ANALYSIS *analysis, unsigned int bank, unsigned short address)
+{
+    if (address < 0x8000)
+    {
+        return -1;
+    }
+
+    if (analysis->bank_count == 1)
+    {
+        return address & (PRG_BANK_SIZE - 1);
+    }
+
+    if (analysis->bank_count == 2)
+    {
+        return address - 0x8000;
+    }
+
+    if (address >= 0xc000)
+    {
+        return (analysis->bank_count - 1) * PRG_BANK_SIZE + address - 0xc000;
+    }
+
+    if (bank == analysis->bank_count - 1)
+    {
+        return -1;
+    }
+
+    return bank * PRG_BANK_SIZE + address - 0x8000;
+}
+
+unsigned short analysis_address(const ANALYSIS *analysis, unsigned int offset)
+{
+    if (analysis->bank_count == 1)
+    {
+        return analysis->base + offset;
+    }
+
+    if (analysis->bank_count == 2)
+    {
+        return 0x8000 + offset;
+    }
+
+    unsigned short base = offset / PRG_BANK_SIZE == analysis->bank_count - 1 ? 0xc000 : 0x8000;
+
+    return base + offset % PRG_BANK_SIZE;
+}
+
+void analysis_label_name(const ANALYSIS *analysis, unsigned int offset, char *name)
+{
+    static const char *prefixes[] = {"byte", "data", "loc", "jt", "sub", "irq", "nmi", "reset"};
+    enum LABEL_KIND kind = analysis->labels[offset];
+
+    if (kind >= LABEL_IRQ)
+    {
+        strcpy(name, prefixes[kind]);
+    }
+    else if (analysis->bank_count <= 2)
+    {
+        sprintf(name, "%s_%04X", prefixes[kind], analysis_address(analysis, offset));
+    }
+    else
+    {
+        sprintf(name, "%s_%02X_%04X", prefixes[kind], offset / PRG_BANK_SIZE, analysis_address(analysis, offset));
+    }
+}
+
+static void analysis_set_label(ANALYSIS *analysis, unsigned int offset, enum LABEL_KIND kind)
+{
+    if (analysis->labels[offset] < kind)
+    {
+        analysis->labels[offset] = kind;
+    }
+}
+
+static void analysis_add_edge(ANALYSIS *analysis, unsigned int from, unsigned int to, enum EDGE_KIND kind)
+{
+    if (analysis->edge_count == analysis->edge_capacity)
+    {
+        analysis->edge_capacity *= 2;
+        analysis->edges = realloc(analysis->edges, analysis->edge_capacity * sizeof(CFG_EDGE));
+    }
+
+    CFG_EDGE *edge = &analysis->edges[analysis->edge_count++];
+    edge->from = from;
+    edge->to = to;
+    edge->kind = kind;
+}
+
+static void analysis_push(ANALYSIS *analysis, unsigned int offset, enum LABEL_KIND label)
+{
+    analysis_set_label(analysis, offset, label);
+
+    if (analysis->marks[offset] & BYTE_OPCODE)
+    {
+        return;
+    }
+
+    if (analysis->worklist_count == analysis->worklist_capacity)
+    {
+        analysis->worklist_capacity *= 2;
+        analysis->worklist = realloc(analysis->worklist, analysis->worklist_capacity * sizeof(unsigned int));
+    }
+
+    analysis->worklist[analysis->worklist_count++] = offset;
+}
+
+// Follows a target of the instruction at from, in every bank when the fixed bank goes to the switched one
+static void analysis_push_target(ANALYSIS *analysis, unsigned int from, unsigned short address,
+                                 enum LABEL_KIND label, enum EDGE_KIND kind)
+{
+    int to = analysis_offset(analysis, from / PRG_BANK_SIZE, address);
+
+    if (to >= 0)
+    {
+        analysis_add_edge(analysis, from, to, kind);
+        analysis_push(analysis, to, label);
+        return;
+    }
+
+    if (address < 0x8000)
+    {
+        return;
+    }
+
+    for (unsigned int bank = 0; bank < analysis->bank_count - 1; bank++)
+    {
+        to = bank * PRG_BANK_SIZE + address - 0x8000;
+
+        analysis_add_edge(analysis, from, to, kind);
+        analysis_push(analysis, to, label);
+    }
+}
+
+static int analysis_is_opcode(const ANALYSIS *analysis, unsigned int offset)
+{
+    INSTRUCTION instruction;
+
+    dis_parse_instruction(analysis->prg[offset], 0, 0, &instruction);
+
+    return instruction.mnemonic != 0;
+}
+
+/*
+ * Reads the entries of a jump table, split in a low and a high byte table or interleaved when
+ * the high bytes follow the low ones. The table ends at the first entry that does not look like
+ * a code address or runs into known code.
+ */
+static void analysis_jump_table(ANALYSIS *analysis, unsigned int from, unsigned short low_table,
+                                unsigned short high_table, int rts)
+{
+    unsigned int bank = from / PRG_BANK_SIZE;
+    unsigned int stride = high_table == low_table + 1 ? 2 : 1;
+    unsigned int limit = 256 / stride;
+
+    if (stride == 1 && low_table != high_table)
+    {
+        unsigned int gap = low_table < high_table ? high_table - low_table : low_table - high_table;
+        limit = gap < limit ? gap : limit;
+    }
+
+    for (unsigned int i = 0; i < limit; i++)
+    {
+        int low = analysis_offset(analysis, bank, low_table + i * stride);
+        int high = analysis_offset(analysis, bank, high_table + i * stride);
+
+        if (low < 0 || high < 0 || ((analysis->marks[low] | analysis->marks[high]) & (BYTE_OPCODE | BYTE_OPERAND)))
+        {
+            return;
+        }
+
+        unsigned short target = (analysis->prg[low] | analysis->prg[high] << 8) + rts;
+        int to = analysis_offset(analysis, bank, target);
+
+        if (target < 0x8000 ||
+            (to >= 0 && ((analysis->marks[to] & (BYTE_OPERAND | BYTE_DATA)) || !analysis_is_opcode(analysis, to))))
+        {
+            return;
+        }
+
+        if (i == 0)
+        {
+            analysis_set_label(analysis, low, LABEL_JUMP_TABLE);
+            analysis_set_label(analysis, high, stride == 1 ? LABEL_JUMP_TABLE : LABEL_NONE);
+        }
+
+        analysis->marks[low] |= BYTE_DATA;
+        analysis->marks[high] |= BYTE_DATA;
+
+        analysis_push_target(analysis, from, target, LABEL_LOCATION, EDGE_TABLE);
+    }
+}
+
+static int table_tracker_find(TABLE_TRACKER *tracker, int pointer)
+{
+    for (unsigned int i = 0; i < tracker->store_count; i++)
+    {
+        if (tracker->store_pointers[i] == pointer)
+        {
+            return tracker->store_tables[i];
+        }
+    }
+
+    return -1;
+}
+
+static void table_tracker_store(TABLE_TRACKER *tracker, int pointer)
+{
+    for (unsigned int i = 0; i < tracker->store_count; i++)
+    {
+        if (tracker->store_pointers[i] == pointer)
+        {
+            tracker->store_tables[i] = tracker->loaded;
+            return;
+        }
+    }
+
+    if (tracker->store_count == JUMP_TABLE_STORES)
+    {
+        memmove(tracker->store_pointers, tracker->store_pointers + 1, (JUMP_TABLE_STORES - 1) * sizeof(int));
+        memmove(tracker->store_tables, tracker->store_tables + 1, (JUMP_TABLE_STORES - 1) * sizeof(int));
+        tracker->store_count--;
+    }
+
+    tracker->store_pointers[tracker->store_count] = pointer;
+    tracker->store_tables[tracker->store_count++] = tracker->loaded;
+}
+
+// Decodes from the offset until the path leaves, returns or runs into something that is not code
+static void analysis_trace(ANALYSIS *analysis, unsigned int offset)
+{
+    unsigned int end = analysis_segment_end(analysis, offset);
+    unsigned char *prg = analysis->prg;
+    TABLE_TRACKER tracker = {-1, {0}, {0}, 0, {-1, -1}};
+
+    while (offset < end && !(analysis->marks[offset] & BYTE_OPCODE))
+    {
+        INSTRUCTION instruction;
+
+        dis_parse_instruction(prg[offset], offset + 1 < end ? prg[offset + 1] : 0,
+                              offset + 2 < end ? prg[offset + 2] : 0, &instruction);
+
+        if (!instruction.mnemonic || offset + instruction.length > end)
+        {
+            return;
+        }
+
+        for (unsigned int i = 0; i < instruction.length; i++)
+        {
+            if (analysis->marks[offset + i] & (BYTE_OPERAND | BYTE_DATA | (i ? BYTE_OPCODE : 0)))
+            {
+                return;
+            }
+        }
+
+        analysis->marks[offset] |= BYTE_OPCODE;
+        for (unsigned int i = 1; i < instruction.length; i++)
+        {
+            analysis->marks[offset + i] |= BYTE_OPERAND;
+        }
+
+        unsigned short next = analysis_address(analysis, offset) + instruction.length;
+        int loaded = -1;
+
+        switch (instruction.opcode)
+        {
+        case 0x00: // BRK
+        case 0x40: // RTI
+            return;
+        case 0x20: // JSR
+            analysis_push_target(analysis, offset, instruction.address, LABEL_SUBROUTINE, EDGE_CALL);
+            break;
+        case 0x4c: // JMP absolute
+            analysis_push_target(analysis, offset, instruction.address, LABEL_LOCATION, EDGE_JUMP);
+            return;
+        case 0x6c: // JMP indirect
+        {
+            int low_table = table_tracker_find(&tracker, instruction.address);
+            int high_table = table_tracker_find(&tracker, instruction.address + 1);
+
+            if (low_table >= 0 && high_table >= 0)
+            {
+                analysis_jump_table(analysis, offset, low_table, high_table, 0);
+            }
+            return;
+        }
+        case 0x60: // RTS, jumps to the pushed address + 1 when the code pushed table entries
+            if (tracker.pushes[0] >= 0 && tracker.pushes[1] >= 0)
+            {
+                analysis_jump_table(analysis, offset, tracker.pushes[1], tracker.pushes[0], 1);
+            }
+            return;
+        case 0x48: // PHA
+            tracker.pushes[0] = tracker.pushes[1];
+            tracker.pushes[1] = tracker.loaded;
+            break;
+        case 0x85: // STA zero page
+        case 0x8d: // STA absolute
+            table_tracker_store(&tracker, instruction.address);
+            break;
+        case 0xb9: // LDA absolute,Y
+        case 0xbd: // LDA absolute,X
+            loaded = instruction.address;
+            break;
+        }
+
+        switch (instruction.addressing_mode)
+        {
+        case RELATIVE:
+            analysis_push_target(analysis, offset, next + instruction.displacement, LABEL_LOCATION, EDGE_BRANCH);
+            break;
+        case ABSOLUTE:
+        case ABSOLUTE_X:
+        case ABSOLUTE_Y:
+            if (instruction.opcode != 0x20)
+            {
+                int data = analysis_offset(analysis, offset / PRG_BANK_SIZE, instruction.address);
+
+                if (data >= 0)
+                {
+                    analysis_set_label(analysis, data, LABEL_DATA);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+
+        tracker.loaded = loaded;
+        offset += instruction.length;
+    }
+}
+
+static int edge_compare(const void *a, const void *b)
+{
+    const CFG_EDGE *edge_a = a;
+    const CFG_EDGE *edge_b = b;
+
+    if (edge_a->from != edge_b->from)
+    {
+        return edge_a->from < edge_b->from ? -1 : 1;
+    }
+
+    return edge_a->to < edge_b->to ? -1 : edge_a->to > edge_b->to;
+}
+
+static int instruction_stops(const INSTRUCTION *instruction)
+{
+    switch (instruction->opcode)
+    {
+    case 0x00: // BRK
+    case 0x40: // RTI
+    case 0x4c: // JMP absolute
+    case 0x60: // RTS
+    case 0x6c: // JMP indirect
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Blocks start at targets and after anything that does not go on to the next instruction
+static void analysis_build_blocks(ANALYSIS *analysis)
+{
+    unsigned int capacity = 256;
+    BASIC_BLOCK *block = NULL;
+    int ends_block = 1;
+    int stops = 1;
+    unsigned int edge = 0;
+
+    qsort(analysis->edges, analysis->edge_count, sizeof(CFG_EDGE), edge_compare);
+
+    analysis->block_count = 0;
+    analysis->blocks = malloc(capacity * sizeof(BASIC_BLOCK));
+
+    for (unsigned int offset = 0; offset < analysis->prg_size;)
+    {
+        if (!(analysis->marks[offset] & BYTE_OPCODE))
+        {
+            block = NULL;
+            offset++;
+            continue;
+        }
+
+        int segment_start = offset == analysis_segment_start(analysis, offset);
+
+        if (!block || ends_block || segment_start || analysis->labels[offset] >= LABEL_LOCATION)
+        {
+            if (block)
+            {
+                block->falls_through = !stops && !segment_start;
+            }
+
+            if (analysis->block_count == capacity)
+            {
+                capacity *= 2;
+                analysis->blocks = realloc(analysis->blocks, capacity * sizeof(BASIC_BLOCK));
+            }
+
+            block = &analysis->blocks[analysis->block_count++];
+            block->start = offset;
+            block->falls_through = 0;
+        }
+
+        INSTRUCTION instruction;
+        dis_parse_instruction(analysis->prg[offset], 0, 0, &instruction);
+
+        stops = instruction_stops(&instruction);
+        ends_block = stops || instruction.addressing_mode == RELATIVE;
+        block->end = offset + instruction.length;
+
+        offset += instruction.length;
+    }
+
+    for (unsigned int i = 0; i < analysis->block_count; i++)
+    {
+        block = &analysis->blocks[i];
+
+        while (edge < analysis->edge_count && analysis->edges[edge].from < block->start)
+        {
+            edge++;
+        }
+
+        block->first_edge = edge;
+        while (edge < analysis->edge_count && analysis->edges[edge].from < block->end)
+        {
+            edge++;
+        }
+
+        block->edge_count = edge - block->first_edge;
+    }
+}
+
+static void analysis_run(ANALYSIS *analysis)
+{
+    static const struct
+    {
+        unsigned short address;
+        enum LABEL_KIND label;
+    } vectors[] = {{0xfffc, LABEL_RESET}, {0xfffa, LABEL_NMI}, {0xfffe, LABEL_IRQ}};
+    unsigned int fixed_bank = analysis->bank_count - 1;
+
+    for (unsigned int i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+    {
+        unsigned int vector = analysis_offset(analysis, fixed_bank, vectors[i].address);
+        unsigned short address = analysis->prg[vector] | analysis->prg[vector + 1] << 8;
+        int entry = analysis_offset(analysis, fixed_bank, address);
+
+        if (entry >= 0)
+        {
+            analysis_push(analysis, entry, vectors[i].label);
+        }
+    }
+
+    while (analysis->worklist_count)
+    {
+        analysis_trace(analysis, analysis->worklist[--analysis->worklist_count]);
+    }
+
+    analysis_build_blocks(analysis);
+}
+
+// Takes a whole iNES image, returns NULL when it is not one
+ANALYSIS *create_analysis(const unsigned char *rom, unsigned long size)
+{
+    if (size < INES_HEADER_SIZE || memcmp(rom, "NES\x1a", 4) != 0 || rom[4] == 0)
+    {
+        return NULL;
+    }
+
+    unsigned long prg_start = INES_HEADER_SIZE + (rom[6] & 0x04 ? INES_TRAINER_SIZE : 0);
+    unsigned long prg_size = rom[4] * PRG_BANK_SIZE;
+    unsigned long chr_size = rom[5] * CHR_BANK_SIZE;
+
+    if (prg_start + prg_size + chr_size > size)
+    {
+        return NULL;
+    }
+
+    ANALYSIS *analysis = malloc(sizeof(ANALYSIS));
+
+    memcpy(analysis->header, rom, INES_HEADER_SIZE);
+    analysis->trainer = prg_start > INES_HEADER_SIZE ? malloc(INES_TRAINER_SIZE) : NULL;
+
+    if (analysis->trainer)
+    {
+        memcpy(analysis->trainer, rom + INES_HEADER_SIZE, INES_TRAINER_SIZE);
+    }
+
+    analysis->prg_size = prg_size;
+    analysis->bank_count = rom[4];
+    analysis->prg = malloc(prg_size);
+    memcpy(analysis->prg, rom + prg_start, prg_size);
+    // The reset vector tells which of the mirrors the program was written for
+    analysis->base = analysis->prg[prg_size - 3] < 0xc0 ? 0x8000 : 0xc000;
+    analysis->chr_size = chr_size;
+    analysis->chr = malloc(chr_size ? chr_size : 1);
+    memcpy(analysis->chr, rom + prg_start + prg_size, chr_size);
+
+    analysis->marks = calloc(prg_size, 1);
+    analysis->labels = calloc(prg_size, 1);
+    analysis->edge_capacity = 256;
+    analysis->edge_count = 0;
+    analysis->edges = malloc(analysis->edge_capacity * sizeof(CFG_EDGE));
+    analysis->blocks = NULL;
+    analysis->block_count = 0;
+    analysis->worklist_capacity = 256;
+    analysis->worklist_count = 0;
+    analysis->worklist = malloc(analysis->worklist_capacity * sizeof(unsigned int));
+
+    analysis_run(analysis);
+
+    return analysis;
+}
+
+ANALYSIS *analyze_rom_file(const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+
+    if (!file)
+    {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char *rom = malloc(size > 0 ? size : 1);
+    ANALYSIS *analysis = NULL;
+
+    if (size > 0 && fread(rom, 1, size, file) == (size_t)size)
+    {
+        analysis = create_analysis(rom, size);
+    }
+
+    free(rom);
+    fclose(file);
+
+    return analysis;
+}
+
+void free_analysis(ANALYSIS *analysis)
+{
+    free(analysis->trainer);
+    free(analysis->prg);
+    free(analysis->chr);
+    free(analysis->marks);
+    free(analysis->labels);
+    free(analysis->edges);
+    free(analysis->blocks);
+    free(analysis->worklist);
+    free(analysis);
+}
+
+unsigned int analysis_code_bytes(const ANALYSIS *analysis)
+{
+    unsigned int count = 0;
+
+    for (unsigned int offset = 0; offset < analysis->prg_size; offset++)
+    {
+        count += (analysis->marks[offset] & (BYTE_OPCODE | BYTE_OPERAND)) != 0;
+    }
+
+    return count;
+}
+
+// Names the address when the code refers to a label that gets written, else leaves the number
+static int analysis_reference(const ANALYSIS *analysis, unsigned int from, unsigned short address, char *name)
+{
+    int to = analysis_offset(analysis, from / PRG_BANK_SIZE, address);
+
+    if (to < 0 || !analysis->labels[to] || (analysis->marks[to] & BYTE_OPERAND) ||
+        analysis_address(analysis, to) != address)
+    {
+        return 0;
+    }
+
+    analysis_label_name(analysis, to, name);
+
+    return 1;
+}
+
+static void analysis_write_instruction(const ANALYSIS *analysis, unsigned int offset, FILE *file)
+{
+    INSTRUCTION instruction;
+    char name[24];
+    unsigned short address;
+
+    // The instruction fits in its segment, the bytes after a short one may not be there
+    unsigned int end = analysis_segment_end(analysis, offset);
+    dis_parse_instruction(analysis->prg[offset], offset + 1 < end ? analysis->prg[offset + 1] : 0,
+                          offset + 2 < end ? analysis->prg[offset + 2] : 0, &instruction);
+
+    fprintf(file, "    %s", instruction.mnemonic);
+
+    switch (instruction.addressing_mode)
+    {
+    case IMPLIED:
+        break;
+    case ACCUMULATOR:
+        fprintf(file, " a");
+        break;
+    case IMMEDIATE:
+        fprintf(file, " #$%02X", instruction.value);
+        break;
+    case ZERO_PAGE:
+        fprintf(file, " $%02X", instruction.address);
+        break;
+    case ZERO_PAGE_X:
+        fprintf(file, " $%02X,x", instruction.address);
+        break;
+    case ZERO_PAGE_Y:
+        fprintf(file, " $%02X,y", instruction.address);
+        break;
+    case INDEXED_INDIRECT:
+        fprintf(file, " ($%02X,x)", instruction.address);
+        break;
+    case INDIRECT_INDEXED:
+        fprintf(file, " ($%02X),y", instruction.address);
+        break;
+    case RELATIVE:
+        address = analysis_address(analysis, offset) + 2 + instruction.displacement;
+        if (analysis_reference(analysis, offset, address, name))
+        {
+            fprintf(file, " %s", name);
+        }
+        else
+        {
+            fprintf(file, " $%04X", address);
+        }
+        break;
+    case ABSOLUTE:
+    case ABSOLUTE_X:
+    case ABSOLUTE_Y:
+    case INDIRECT:
+    {
+        const char *before = instruction.addressing_mode == INDIRECT ? "(" : "";
+        const char *after = instruction.addressing_mode == ABSOLUTE_X   ? ",x"
+                            : instruction.addressing_mode == ABSOLUTE_Y ? ",y"
+                            : instruction.addressing_mode == INDIRECT   ? ")"
+                                                                        : "";
+
+        if (analysis_reference(analysis, offset, instruction.address, name))
+        {
+            fprintf(file, " %s%s%s", before, name, after);
+        }
+        else if (instruction.address < 0x100 && instruction.addressing_mode != INDIRECT)
+        {
+            // Keeps the three byte encoding the assembler would shorten to zero page
+            fprintf(file, " a:$%04X%s", instruction.address, after);
+        }
+        else
+        {
+            fprintf(file, " %s$%04X%s", before, instruction.address, after);
+        }
+        break;
+    }
+    }
+
+    fprintf(file, "\n");
+}
+
+static void write_bytes(const unsigned char *bytes, unsigned int count, FILE *file)
+{
+    fprintf(file, "    .byte ");
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        fprintf(file, i ? ",$%02X" : "$%02X", bytes[i]);
+    }
+
+    fprintf(file, "\n");
+}
+
+// Writes the vectors as addresses, when nothing else took their bytes
+static int analysis_write_vectors(const ANALYSIS *analysis, unsigned int offset, FILE *file)
+{
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        if ((analysis->marks[offset + i] & (BYTE_OPCODE | BYTE_OPERAND)) || (i && analysis->labels[offset + i]))
+        {
+            return 0;
+        }
+    }
+
+    fprintf(file, "    .addr ");
+
+    for (unsigned int i = 0; i < 6; i += 2)
+    {
+        unsigned short address = analysis->prg[offset + i] | analysis->prg[offset + i + 1] << 8;
+        char name[24];
+
+        if (analysis_reference(analysis, offset, address, name))
+        {
+            fprintf(file, i ? ", %s" : "%s", name);
+        }
+        else
+        {
+            fprintf(file, i ? ", $%04X" : "$%04X", address);
+        }
+    }
+
+    fprintf(file, "\n");
+
+    return 1;
+}
+
+/*
+ * Writes source that ca65 assembles back to the same image, linked by ld65 with the config of
+ * analysis_export_ld65_config. The segments go in file order: HEADER, TRAINER when there is one,
+ * PRG0 to PRGn (one per bank, or one for NROM) and CHR.
+ */
+int analysis_export_ca65(const ANALYSIS *analysis, FILE *file)
+{
+    unsigned int vectors = analysis_offset(analysis, analysis->bank_count - 1, 0xfffa);
+    char name[24];
+
+    fprintf(file, "; Reset $%04X, %u KB PRG, %u KB CHR\n", analysis->prg[vectors + 2] | analysis->prg[vectors + 3] << 8,
+            analysis->prg_size / 1024, analysis->chr_size / 1024);
+    fprintf(file, "; Built back with the ld65 config written along: ca65 rom.s && ld65 -C rom.cfg -o rom.nes rom.o\n\n");
+    fprintf(file, ".setcpu \"6502\"\n\n.segment \"HEADER\"\n");
+    write_bytes(analysis->header, INES_HEADER_SIZE, file);
+
+    if (analysis->trainer)
+    {
+        fprintf(file, "\n.segment \"TRAINER\"\n");
+
+        for (unsigned int offset = 0; offset < INES_TRAINER_SIZE; offset += 16)
+        {
+            write_bytes(analysis->trainer + offset, 16, file);
+        }
+    }
+
+    for (unsigned int start = 0; start < analysis->prg_size; start = analysis_segment_end(analysis, start))
+    {
+        unsigned int end = analysis_segment_end(analysis, start);
+
+        fprintf(file, "\n.segment \"PRG%u\"\n.org $%04X\n", start / PRG_BANK_SIZE, analysis_address(analysis, start));
+
+        for (unsigned int offset = start; offset < end;)
+        {
+            if (analysis->labels[offset] && !(analysis->marks[offset] & BYTE_OPERAND))
+            {
+                analysis_label_name(analysis, offset, name);
+                fprintf(file, "%s%s:\n", analysis->labels[offset] >= LABEL_LOCATION ? "\n" : "", name);
+            }
+
+            if (analysis->marks[offset] & BYTE_OPCODE)
+            {
+                INSTRUCTION instruction;
+
+                dis_parse_instruction(analysis->prg[offset], 0, 0, &instruction);
+                analysis_write_instruction(analysis, offset, file);
+                offset += instruction.length;
+                continue;
+            }
+
+            if (offset == vectors && analysis_write_vectors(analysis, offset, file))
+            {
+                offset += 6;
+                continue;
+            }
+
+            unsigned int count = 1;
+            while (count < 16 && offset + count < end && offset + count != vectors &&
+                   !(analysis->marks[offset + count] & BYTE_OPCODE) && !analysis->labels[offset + count])
+            {
+                count++;
+            }
+
+            write_bytes(analysis->prg + offset, count, file);
+            offset += count;
+        }
+    }
+
+    if (analysis->chr_size)
+    {
+        fprintf(file, "\n.segment \"CHR\"\n");
+
+        for (unsigned int offset = 0; offset < analysis->chr_size; offset += 16)
+        {
+            write_bytes(analysis->chr + offset, 16, file);
+        }
+    }
+
+    return ferror(file) ? -1 : 0;
+}
+
+// A memory area per segment of analysis_export_ca65, at the address the segment is assembled for and filled to its size
+int analysis_export_ld65_config(const ANALYSIS *analysis, FILE *file)
+{
+    fprintf(file, "MEMORY\n{\n    HEADER: start = $0000, size = $%04X, file = %%O, fill = yes;\n", INES_HEADER_SIZE);
+
+    if (analysis->trainer)
+    {
+        fprintf(file, "    TRAINER: start = $7000, size = $%04X, file = %%O, fill = yes;\n", INES_TRAINER_SIZE);
+    }
+
+    for (unsigned int start = 0; start < analysis->prg_size; start = analysis_segment_end(analysis, start))
+    {
+        fprintf(file, "    PRG%u: start = $%04X, size = $%04X, file = %%O, fill = yes;\n", start / PRG_BANK_SIZE,
+                analysis_address(analysis, start), analysis_segment_end(analysis, start) - start);
+    }
+
+    if (analysis->chr_size)
+    {
+        fprintf(file, "    CHR: start = $0000, size = $%04X, file = %%O, fill = yes;\n", analysis->chr_size);
+    }
+
+    fprintf(file, "}\n\nSEGMENTS\n{\n    HEADER: load = HEADER, type = ro;\n");
+
+    if (analysis->trainer)
+    {
+        fprintf(file, "    TRAINER: load = TRAINER, type = ro;\n");
+    }
+
+    for (unsigned int start = 0; start < analysis->prg_size; start = analysis_segment_end(analysis, start))
+    {
+        fprintf(file, "    PRG%u: load = PRG%u, type = ro;\n", start / PRG_BANK_SIZE, start / PRG_BANK_SIZE);
+    }
+
+    if (analysis->chr_size)
+    {
+        fprintf(file, "    CHR: load = CHR, type = ro;\n");
+    }
+
+    fprintf(file, "}\n");
+
+    return ferror(file) ? -1 : 0;
+}
@@ -0,0 +1,90 @@
+#ifndef _ANALYZER_H_
+#define _ANALYZER_H_
+
+#include <stdio.h>
+
+#define INES_HEADER_SIZE 16
+#define INES_TRAINER_SIZE 512
+#define PRG_BANK_SIZE 0x4000
+#define CHR_BANK_SIZE 0x2000
+
+// What the analysis found out about each PRG byte
+#define BYTE_OPCODE 0x01
+#define BYTE_OPERAND 0x02
+#define BYTE_DATA 0x04 // jump table entries
+
+// Kinds of label, a byte targeted several ways keeps the highest kind
+enum LABEL_KIND
+{
+    LABEL_NONE,
+    LABEL_DATA,
+    LABEL_LOCATION,
+    LABEL_JUMP_TABLE,
+    LABEL_SUBROUTINE,
+    LABEL_IRQ,
+    LABEL_NMI,
+    LABEL_RESET
+};
+
+enum EDGE_KIND
+{
+    EDGE_BRANCH,
+    EDGE_JUMP,
+    EDGE_CALL,
+    EDGE_TABLE
+};
+
+typedef struct
+{
+    unsigned int from; // PRG offset of the instruction
+    unsigned int to;   // PRG offset of the target
+    enum EDGE_KIND kind;
+} CFG_EDGE;
+
+typedef struct
+{
+    unsigned int start; // PRG offset of the first instruction
+    unsigned int end;   // PRG offset after the last instruction
+    unsigned int first_edge;
+    unsigned int edge_count;
+    unsigned char falls_through; // the next block follows when the last instruction is done
+} BASIC_BLOCK;
+
+/*
+ * Recursive descent over the PRG ROM from the vectors. NROM maps its 16 or 32 KB at $8000,
+ * bigger ROMs are taken as UxROM-like: the last bank fixed at $C000, the others switched in
+ * at $8000. A target in the switched window from the fixed bank is followed in every bank.
+ */
+typedef struct
+{
+    unsigned char header[INES_HEADER_SIZE];
+    unsigned char *trainer; // INES_TRAINER_SIZE bytes between the header and the PRG, NULL without
+    unsigned char *prg;
+    unsigned int prg_size;
+    unsigned int bank_count; // 16 KB PRG banks
+    unsigned short base;     // where a single bank is assembled, it is mirrored at $8000 and $C000
+    unsigned char *chr;
+    unsigned int chr_size;
+    unsigned char *marks;  // BYTE_ flags of each PRG byte
+    unsigned char *labels; // LABEL_KIND of each PRG byte
+    CFG_EDGE *edges;       // sorted by instruction once the analysis is done
+    unsigned int edge_count;
+    unsigned int edge_capacity;
+    BASIC_BLOCK *blocks;
+    unsigned int block_count;
+    unsigned int *worklist;
+    unsigned int worklist_count;
+    unsigned int worklist_capacity;
+} ANALYSIS;
+
+ANALYSIS *create_analysis(const unsigned char *rom, unsigned long size);
+ANALYSIS *analyze_rom_file(const char *filename);
+void free_analysis(ANALYSIS *analysis);
+int analysis_offset(const ANALYSIS *analysis, unsigned int bank, unsigned short address);
+unsigned short analysis_address(const ANALYSIS *analysis, unsigned int offset);
+void analysis_label_name(const ANALYSIS *analysis, unsigned int offset, char *name);
+unsigned int analysis_code_bytes(const ANALYSIS *analysis);
+int analysis_export_ca65(const ANALYSIS *analysis, FILE *file);
+int analysis_export_ld65_config(const ANALYSIS *analysis, FILE *file);
+
+#endif
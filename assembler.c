@@ -0,0 +1,392 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "assembler.h"
+#include "disassembler.h"
+
+#define ASSEMBLER_LINE_SIZE 512
+
+typedef struct
+{
+    char name[24];
+    unsigned short value;
+    unsigned int line; // where it is defined, 0 for a free slot
+} LABEL;
+
+typedef struct
+{
+    LABEL *labels; // open addressing, at least twice as many slots as lines
+    unsigned int mask;
+    unsigned char *image;
+    unsigned long capacity;
+    unsigned long size;
+    unsigned short pc;
+    unsigned int line;
+    int pass; // 1 defines the labels, 2 writes the bytes
+} ASSEMBLER;
+
+static const char *skip_blanks(const char *text)
+{
+    while (isspace((unsigned char)*text))
+    {
+        text++;
+    }
+
+    return text;
+}
+
+static LABEL *find_label(ASSEMBLER *assembler, const char *name, size_t length)
+{
+    unsigned int hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+
+    LABEL *label = &assembler->labels[hash & assembler->mask];
+
+    while (label->line && (strlen(label->name) != length || strncmp(label->name, name, length)))
+    {
+        label = &assembler->labels[(label - assembler->labels + 1) & assembler->mask];
+    }
+
+    return label;
+}
+
+static size_t name_length(const char *text)
+{
+    size_t length = 0;
+
+    while (isalnum((unsigned char)text[length]) || text[length] == '_')
+    {
+        length++;
+    }
+
+    return isdigit((unsigned char)*text) || length >= sizeof(((LABEL *)NULL)->name) ? 0 : length;
+}
+
+/*
+ * Reads a hex number or a label, *known is 0 for a label defined further down. Returns what
+ * follows, NULL on an error. Labels not defined yet read as 0 in the first pass.
+ */
+static const char *parse_value(ASSEMBLER *assembler, const char *text, unsigned short *value, int *known)
+{
+    text = skip_blanks(text);
+
+    if (*text == '$')
+    {
+        char *end;
+        unsigned long number = isxdigit((unsigned char)text[1]) ? strtoul(text + 1, &end, 16) : 0x10000;
+
+        if (number > 0xffff)
+        {
+            return NULL;
+        }
+
+        *value = number;
+        *known = 1;
+
+        return skip_blanks(end);
+    }
+
+    size_t length = name_length(text);
+    LABEL *label = length ? find_label(assembler, text, length) : NULL;
+
+    if (!label || (!label->line && assembler->pass == 2))
+    {
+        return NULL;
+    }
+
+    *value = label->value;
+    *known = label->line && label->line < assembler->line;
+
+    return skip_blanks(text + length);
+}
+
+static int emit(ASSEMBLER *assembler, unsigned char byte)
+{
+    if (assembler->size == assembler->capacity)
+    {
+        return -1;
+    }
+
+    if (assembler->pass == 2)
+    {
+        assembler->image[assembler->size] = byte;
+    }
+
+    assembler->size++;
+    assembler->pc++;
+
+    return 0;
+}
+
+static int find_opcode(unsigned char mnemonic, enum ADDRESSING_MODE mode)
+{
+    for (int opcode = 0; opcode < 256; opcode++)
+    {
+        if (OPCODES[opcode].mnemonic == mnemonic && OPCODES[opcode].mode == mode)
+        {
+            return opcode;
+        }
+    }
+
+    return -1;
+}
+
+// Mode of the operand, the zero page forms only for a value known to fit when not forced absolute
+static int parse_operand(ASSEMBLER *assembler, unsigned char mnemonic, const char *text, unsigned short *value)
+{
+    static const enum ADDRESSING_MODE INDEXED_MODES[3][2] = {
+        {ABSOLUTE, ZERO_PAGE}, {ABSOLUTE_X, ZERO_PAGE_X}, {ABSOLUTE_Y, ZERO_PAGE_Y}};
+    int known = 1;
+
+    *value = 0;
+
+    if (!*text)
+    {
+        return find_opcode(mnemonic, IMPLIED) >= 0 ? IMPLIED : ACCUMULATOR;
+    }
+
+    if (!strcasecmp(text, "a"))
+    {
+        return ACCUMULATOR;
+    }
+
+    if (*text == '#')
+    {
+        text = parse_value(assembler, text + 1, value, &known);
+
+        return text && !*text ? IMMEDIATE : -1;
+    }
+
+    if (*text == '(')
+    {
+        if (!(text = parse_value(assembler, text + 1, value, &known)))
+        {
+            return -1;
+        }
+
+        return !strcasecmp(text, ",x)") ? INDEXED_INDIRECT : !strcasecmp(text, "),y") ? INDIRECT_INDEXED : !strcmp(text, ")") ? INDIRECT : -1;
+    }
+
+    int absolute = !strncasecmp(text, "a:", 2);
+
+    if (!(text = parse_value(assembler, text + 2 * absolute, value, &known)))
+    {
+        return -1;
+    }
+
+    int index = !*text ? 0 : !strcasecmp(text, ",x") ? 1 : !strcasecmp(text, ",y") ? 2 : -1;
+
+    if (index < 0)
+    {
+        return -1;
+    }
+
+    if (!index && find_opcode(mnemonic, RELATIVE) >= 0)
+    {
+        return RELATIVE;
+    }
+
+    if (!absolute && known && *value < 0x100 && find_opcode(mnemonic, INDEXED_MODES[index][1]) >= 0)
+    {
+        return INDEXED_MODES[index][1];
+    }
+
+    return INDEXED_MODES[index][0];
+}
+
+static int assemble_instruction(ASSEMBLER *assembler, const char *text)
+{
+    unsigned char mnemonic = NB_MNEMONICS;
+
+    for (unsigned char i = MNEMONIC_NONE + 1; i < NB_MNEMONICS; i++)
+    {
+        if (!strncasecmp(text, MNEMONIC_NAMES[i], 3) && (!text[3] || isspace((unsigned char)text[3])))
+        {
+            mnemonic = i;
+        }
+    }
+
+    unsigned short value;
+    int mode = mnemonic < NB_MNEMONICS ? parse_operand(assembler, mnemonic, skip_blanks(text + 3), &value) : -1;
+    int opcode = mode >= 0 ? find_opcode(mnemonic, mode) : -1;
+
+    if (opcode < 0 || emit(assembler, opcode) < 0)
+    {
+        return -1;
+    }
+
+    if (mode == RELATIVE)
+    {
+        int displacement = value - (assembler->pc + 1);
+
+        if (assembler->pass == 2 && (displacement < -128 || displacement > 127))
+        {
+            return -1;
+        }
+
+        return emit(assembler, displacement);
+    }
+
+    if (OPCODES[opcode].length == 2 && assembler->pass == 2 && value > 0xff)
+    {
+        return -1;
+    }
+
+    for (unsigned int i = 1; i < OPCODES[opcode].length; i++)
+    {
+        if (emit(assembler, value >> (8 * (i - 1))) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Values separated by commas, of one byte each or of two in little endian
+static int assemble_values(ASSEMBLER *assembler, const char *text, unsigned int size)
+{
+    do
+    {
+        unsigned short value;
+        int known;
+
+        if (!(text = parse_value(assembler, text, &value, &known)) || (size == 1 && assembler->pass == 2 && value > 0xff) ||
+            emit(assembler, value) < 0 || (size == 2 && emit(assembler, value >> 8) < 0))
+        {
+            return -1;
+        }
+    } while (*text++ == ',');
+
+    return text[-1] ? -1 : 0;
+}
+
+static int assemble_line(ASSEMBLER *assembler, char *line)
+{
+    char *comment = strchr(line, ';');
+    const char *text = skip_blanks(line);
+
+    if (comment)
+    {
+        *comment = 0;
+    }
+
+    for (char *end = line + strlen(line); end > text && isspace((unsigned char)end[-1]);)
+    {
+        *--end = 0;
+    }
+
+    size_t length = name_length(text);
+
+    if (length && text[length] == ':')
+    {
+        LABEL *label = find_label(assembler, text, length);
+
+        if (assembler->pass == 1)
+        {
+            if (label->line)
+            {
+                return -1;
+            }
+
+            memcpy(label->name, text, length);
+            label->name[length] = 0;
+            label->value = assembler->pc;
+            label->line = assembler->line;
+        }
+
+        text = skip_blanks(text + length + 1);
+    }
+
+    if (!*text || !strncasecmp(text, ".setcpu ", 8) || !strncasecmp(text, ".segment ", 9))
+    {
+        return 0;
+    }
+
+    if (!strncasecmp(text, ".org ", 5))
+    {
+        int known;
+
+        text = parse_value(assembler, text + 5, &assembler->pc, &known);
+
+        return text && !*text && known ? 0 : -1;
+    }
+
+    if (!strncasecmp(text, ".byte ", 6))
+    {
+        return assemble_values(assembler, text + 6, 1);
+    }
+
+    if (!strncasecmp(text, ".addr ", 6))
+    {
+        return assemble_values(assembler, text + 6, 2);
+    }
+
+    return assemble_instruction(assembler, text);
+}
+
+long assemble_listing(const char *text, unsigned char *image, unsigned long capacity, unsigned int *error_line)
+{
+    ASSEMBLER assembler;
+    unsigned int slots = 2;
+
+    for (const char *c = text; *c; c++)
+    {
+        slots += 2 * (*c == '\n');
+    }
+
+    while (slots & (slots - 1))
+    {
+        slots += slots & -slots;
+    }
+
+    assembler.labels = calloc(slots, sizeof(LABEL));
+    assembler.mask = slots - 1;
+    assembler.image = image;
+    assembler.capacity = capacity;
+
+    for (assembler.pass = 1; assembler.pass <= 2; assembler.pass++)
+    {
+        assembler.size = 0;
+        assembler.pc = 0;
+        assembler.line = 0;
+
+        for (const char *start = text; *start;)
+        {
+            const char *end = strchr(start, '\n');
+            size_t length = end ? (size_t)(end - start) : strlen(start);
+            char line[ASSEMBLER_LINE_SIZE];
+
+            assembler.line++;
+
+            if (length >= sizeof(line))
+            {
+                free(assembler.labels);
+                *error_line = assembler.line;
+                return -1;
+            }
+
+            memcpy(line, start, length);
+            line[length] = 0;
+
+            if (assemble_line(&assembler, line) < 0)
+            {
+                free(assembler.labels);
+                *error_line = assembler.line;
+                return -1;
+            }
+
+            start += length + (end != NULL);
+        }
+    }
+
+    free(assembler.labels);
+
+    return assembler.size;
+}
@@ -0,0 +1,14 @@
+#ifndef _ASSEMBLER_H_
+#define _ASSEMBLER_H_
+
+/*
+ * Assembles the subset of ca65 that analysis_export_ca65 writes back into the image ld65 would
+ * link with the config of analysis_export_ld65_config: the segments one after the other in the
+ * order they are written, .org, labels, .byte, .addr and the official instructions. Operands are
+ * hex numbers or labels. As in ca65, a value below $100 known when the instruction is read gives
+ * the zero page form unless "a:" forces the absolute one, a label defined further down gives the
+ * absolute form. Returns the size of the image, -1 on an error with its line in *error_line.
+ */
+long assemble_listing(const char *text, unsigned char *image, unsigned long capacity, unsigned int *error_line);
+
+#endif
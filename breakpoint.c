@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "breakpoint.h"
+
+BREAKPOINTS *create_breakpoints()
+{
+    BREAKPOINTS *breakpoints = calloc(1, sizeof(BREAKPOINTS));
+    breakpoints->temporary = -1;
+    breakpoints->step_out_sp = -1;
+
+    return breakpoints;
+}
+
+static void breakpoint_set(unsigned char *bitmap, unsigned short address)
+{
+    bitmap[address >> 3] |= 1 << (address & 0x07);
+}
+
+static void breakpoints_set_bits(BREAKPOINTS *breakpoints, unsigned int index)
+{
+    BREAKPOINT *breakpoint = &breakpoints->list[index];
+
+    switch (breakpoint->type)
+    {
+    case BREAKPOINT_TYPE_ADDRESS:
+        for (unsigned int address = breakpoint->address; address <= breakpoint->end; address++)
+        {
+            breakpoint_set(breakpoints->execute, address);
+        }
+        break;
+    case BREAKPOINT_TYPE_MEMORY:
+        watchpoints_add(&breakpoints->watchpoints, WATCH_BUS_CPU, breakpoint->address, breakpoint->end, breakpoint->access, index);
+        break;
+    case BREAKPOINT_TYPE_PPU:
+        watchpoints_add(&breakpoints->watchpoints, WATCH_BUS_PPU, breakpoint->address & 0x3fff, breakpoint->end > 0x3fff ? 0x3fff : breakpoint->end, breakpoint->access, index);
+        break;
+    case BREAKPOINT_TYPE_OAM:
+        watchpoints_add(&breakpoints->watchpoints, WATCH_BUS_OAM, breakpoint->address & 0xff, breakpoint->end > 0xff ? 0xff : breakpoint->end, breakpoint->access, index);
+        break;
+    }
+}
+
+// Another breakpoint can share a removed bit, rebuild everything
+static void breakpoints_rebuild(BREAKPOINTS *breakpoints)
+{
+    memset(breakpoints->execute, 0, sizeof(breakpoints->execute));
+    watchpoints_clear(&breakpoints->watchpoints);
+
+    for (unsigned int i = 0; i < breakpoints->count; i++)
+    {
+        breakpoints_set_bits(breakpoints, i);
+    }
+
+    if (breakpoints->temporary >= 0)
+    {
+        breakpoint_set(breakpoints->execute, breakpoints->temporary);
+    }
+}
+
+BREAKPOINT *breakpoints_add(BREAKPOINTS *breakpoints, enum BREAKPOINT_TYPE type, unsigned short address, unsigned short end, unsigned char access)
+{
+    if (end < address)
+    {
+        end = address;
+    }
+
+    if (breakpoints->count == breakpoints->capacity)
+    {
+        breakpoints->capacity = breakpoints->capacity ? breakpoints->capacity * 2 : 16;
+        breakpoints->list = realloc(breakpoints->list, breakpoints->capacity * sizeof(BREAKPOINT));
+    }
+
+    BREAKPOINT *breakpoint = &breakpoints->list[breakpoints->count++];
+    breakpoint->type = type;
+    breakpoint->address = address;
+    breakpoint->end = end;
+    breakpoint->access = access;
+    breakpoint->condition = NULL;
+    breakpoint->hit_count = 0;
+    breakpoint->hits = 0;
+    breakpoint->log = NULL;
+
+    breakpoints_set_bits(breakpoints, breakpoints->count - 1);
+
+    return breakpoint;
+}
+
+void breakpoints_remove(BREAKPOINTS *breakpoints, unsigned int index)
+{
+    if (index >= breakpoints->count)
+    {
+        return;
+    }
+
+    free_expression(breakpoints->list[index].condition);
+    free_logpoint(breakpoints->list[index].log);
+
+    breakpoints->count--;
+    memmove(breakpoints->list + index, breakpoints->list + index + 1, (breakpoints->count - index) * sizeof(BREAKPOINT));
+
+    breakpoints_rebuild(breakpoints);
+}
+
+void breakpoints_set_temporary(BREAKPOINTS *breakpoints, unsigned short address, unsigned char sp)
+{
+    breakpoints->temporary = address;
+    breakpoints->temporary_sp = sp;
+    breakpoint_set(breakpoints->execute, address);
+}
+
+void breakpoints_clear_temporary(BREAKPOINTS *breakpoints)
+{
+    breakpoints->step_out_sp = -1;
+
+    if (breakpoints->temporary >= 0)
+    {
+        breakpoints->temporary = -1;
+        breakpoints_rebuild(breakpoints);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef _BREAKPOINT_H_
+#define _BREAKPOINT_H_
+
+#include "watchpoint.h"
+#include "expression.h"
+#include "logpoint.h"
+
+#define BREAKPOINT_BITMAP_SIZE(address_space) ((address_space) / 8)
+
+enum BREAKPOINT_TYPE
+{
+    BREAKPOINT_TYPE_ADDRESS, // execution of an instruction in the range
+    BREAKPOINT_TYPE_MEMORY,  // CPU bus access of the range
+    BREAKPOINT_TYPE_PPU,     // PPU bus ($2007) access of the range
+    BREAKPOINT_TYPE_OAM      // sprite RAM access of the range
+};
+
+typedef struct
+{
+    enum BREAKPOINT_TYPE type;
+    unsigned short address;
+    unsigned short end;   // inclusive
+    unsigned char access; // WATCH_READ, WATCH_WRITE and WATCH_CHANGE, unused for address breakpoints
+    EXPRESSION *condition; // only evaluated once the address matched, NULL = always
+    unsigned long hit_count; // stop from this hit on, 0 = every hit
+    unsigned long hits;      // matches where the condition held
+    LOGPOINT *log;           // logs the hit instead of stopping, NULL = stop
+} BREAKPOINT;
+
+/*
+ * Breakpoints as set by the user, one bit per address for execution so that the run loop tests
+ * them with a single lookup, and the watchpoints checked by the memory accesses for the others.
+ * The bitmap and the watchpoints are rebuilt from the list on removal.
+ */
+typedef struct
+{
+    BREAKPOINT *list;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned char execute[BREAKPOINT_BITMAP_SIZE(0x10000)];
+    WATCHPOINTS watchpoints;
+    int temporary;              // run-to or step over target, also set in the execute bitmap, -1 = none
+    unsigned char temporary_sp; // the target only stops with the stack at or above this, not in a recursive call
+    int step_out_sp;            // stop on the RTS or RTI that pops the stack above this, -1 = none
+} BREAKPOINTS;
+
+BREAKPOINTS *create_breakpoints();
+BREAKPOINT *breakpoints_add(BREAKPOINTS *breakpoints, enum BREAKPOINT_TYPE type, unsigned short address, unsigned short end, unsigned char access);
+void breakpoints_remove(BREAKPOINTS *breakpoints, unsigned int index);
+void breakpoints_set_temporary(BREAKPOINTS *breakpoints, unsigned short address, unsigned char sp);
+void breakpoints_clear_temporary(BREAKPOINTS *breakpoints);
+
+static inline int breakpoint_test(const unsigned char *bitmap, unsigned short address)
+{
+    return bitmap[address >> 3] & (1 << (address & 0x07));
+}
+
+#endif
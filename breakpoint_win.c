@@ -8,8 +8,15 @@ struct _BreakpointWindow
     GtkTreeView *breakpoint_tree_view;
     GtkButton *add_address_bp_button;
     GtkButton *add_memory_bp_button;
+    GtkButton *add_ppu_bp_button;
+    GtkButton *add_oam_bp_button;
+    GtkComboBoxText *access_combo;
     GtkButton *remove_button;
     GtkEntry *address_entry;
+    GtkEntry *condition_entry;
+    GtkSpinButton *hit_count_spin;
+    GtkEntry *log_entry;
+    GtkTextView *log_text_view;
 };
 
 G_DEFINE_TYPE(BreakpointWindow, breakpoint_window, GTK_TYPE_WINDOW);
@@ -26,40 +33,149 @@ static void breakpoint_window_class_init(BreakpointWindowClass *class)
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, breakpoint_tree_view);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, add_address_bp_button);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, add_memory_bp_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, add_ppu_bp_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, add_oam_bp_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, access_combo);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, remove_button);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, address_entry);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, condition_entry);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, hit_count_spin);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, log_entry);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), BreakpointWindow, log_text_view);
 }
 
 static void close_breakpoint_window(GtkWindow *win, DebuggerApp *app)
 {
+    refresh_coordinator_unregister(app->refresh, win);
     app->breakpoint_window = NULL;
 }
 
+static void refresh_breakpoint_window(gpointer view, gpointer data)
+{
+    update_breakpoint_window(BREAKPOINT_WINDOW(view), data);
+}
+
 static void close_oam_window(GtkWindow *win, DebuggerApp *app)
 {
     app->oam_window = NULL;
 }
 
-static void add_address_breakpoint(GtkButton *button, DebuggerApp *app)
+// Same order as the access combo box entries
+static const unsigned char ACCESS_KINDS[] = {WATCH_READ | WATCH_WRITE, WATCH_READ, WATCH_WRITE, WATCH_CHANGE};
+
+// Runs on the emulation thread, with its own compiled condition and log since the UI copy is only for display
+static void add_breakpoint_call(NES *nes, void *data)
 {
-    BreakpointWindow *breakpoint_window = BREAKPOINT_WINDOW(app->breakpoint_window);
+    BREAKPOINT *request = data;
+    BREAKPOINT *breakpoint = breakpoints_add(nes->breakpoints, request->type, request->address, request->end, request->access);
 
-    GtkTreeIter iter;
+    breakpoint->condition = request->condition;
+    breakpoint->hit_count = request->hit_count;
+    breakpoint->log = request->log;
 
-    gtk_list_store_append(app->breakpoints, &iter);
+    g_free(request);
+}
 
-    gtk_list_store_set(app->breakpoints, &iter, 0, BREAKPOINT_TYPE_ADDRESS, 1, gtk_entry_get_text(breakpoint_window->address_entry), -1);
+static void remove_breakpoint_call(NES *nes, void *data)
+{
+    breakpoints_remove(nes->breakpoints, GPOINTER_TO_UINT(data));
 }
 
-static void add_memory_breakpoint(GtkButton *button, DebuggerApp *app)
+static void add_breakpoint(DebuggerApp *app, enum BREAKPOINT_TYPE type)
 {
     BreakpointWindow *breakpoint_window = BREAKPOINT_WINDOW(app->breakpoint_window);
 
-    GtkTreeIter iter;
+    // "XXXX" or "XXXX-YYYY", symbols instead of addresses, a memory breakpoint on a symbol covers all its bytes
+    const char *end;
+    unsigned short start_address;
+    unsigned short end_address;
+    unsigned int size;
+    int result = debugger_app_parse_address(app, gtk_entry_get_text(breakpoint_window->address_entry), &start_address, &size, &end);
+
+    if (result == 0 && *end == '-')
+    {
+        result = debugger_app_parse_address(app, end + 1, &end_address, &size, NULL);
+    }
+    else
+    {
+        end_address = type == BREAKPOINT_TYPE_MEMORY ? start_address + size - 1 : start_address;
+    }
+
+    gtk_entry_set_icon_from_icon_name(breakpoint_window->address_entry, GTK_ENTRY_ICON_SECONDARY, result < 0 ? "dialog-error" : NULL);
+
+    if (result < 0)
+    {
+        return;
+    }
+
+    gint access = gtk_combo_box_get_active(GTK_COMBO_BOX(breakpoint_window->access_combo));
 
-    gtk_list_store_append(app->breakpoints, &iter);
+    // The condition is compiled once here, never while running
+    const gchar *condition_text = gtk_entry_get_text(breakpoint_window->condition_entry);
+    EXPRESSION *condition = NULL;
 
-    gtk_list_store_set(app->breakpoints, &iter, 0, BREAKPOINT_TYPE_MEMORY, 1, gtk_entry_get_text(breakpoint_window->address_entry), -1);
+    if (*condition_text)
+    {
+        condition = create_expression(condition_text);
+
+        if (!condition)
+        {
+            gtk_entry_set_icon_from_icon_name(breakpoint_window->condition_entry, GTK_ENTRY_ICON_SECONDARY, "dialog-error");
+            return;
+        }
+    }
+
+    gtk_entry_set_icon_from_icon_name(breakpoint_window->condition_entry, GTK_ENTRY_ICON_SECONDARY, NULL);
+
+    const gchar *log_text = gtk_entry_get_text(breakpoint_window->log_entry);
+    LOGPOINT *log = NULL;
+
+    if (*log_text)
+    {
+        log = create_logpoint(log_text);
+
+        if (!log)
+        {
+            free_expression(condition);
+            gtk_entry_set_icon_from_icon_name(breakpoint_window->log_entry, GTK_ENTRY_ICON_SECONDARY, "dialog-error");
+            return;
+        }
+    }
+
+    gtk_entry_set_icon_from_icon_name(breakpoint_window->log_entry, GTK_ENTRY_ICON_SECONDARY, NULL);
+
+    BREAKPOINT *breakpoint = breakpoints_add(app->nes->breakpoints, type, start_address, end_address, ACCESS_KINDS[access < 0 ? 0 : access]);
+    breakpoint->condition = condition;
+    breakpoint->hit_count = gtk_spin_button_get_value_as_int(breakpoint_window->hit_count_spin);
+    breakpoint->log = log;
+
+    BREAKPOINT *request = g_new(BREAKPOINT, 1);
+    *request = *breakpoint;
+    request->condition = condition ? create_expression(condition->source) : NULL;
+    request->log = log ? create_logpoint(log->source) : NULL;
+    emulator_thread_call(app->emulator, add_breakpoint_call, request);
+
+    debugger_app_sync_breakpoints(app);
+}
+
+static void add_address_breakpoint(GtkButton *button, DebuggerApp *app)
+{
+    add_breakpoint(app, BREAKPOINT_TYPE_ADDRESS);
+}
+
+static void add_memory_breakpoint(GtkButton *button, DebuggerApp *app)
+{
+    add_breakpoint(app, BREAKPOINT_TYPE_MEMORY);
+}
+
+static void add_ppu_breakpoint(GtkButton *button, DebuggerApp *app)
+{
+    add_breakpoint(app, BREAKPOINT_TYPE_PPU);
+}
+
+static void add_oam_breakpoint(GtkButton *button, DebuggerApp *app)
+{
+    add_breakpoint(app, BREAKPOINT_TYPE_OAM);
 }
 
 static void remove_breakpoint(GtkButton *button, DebuggerApp *app)
@@ -70,10 +186,17 @@ static void remove_breakpoint(GtkButton *button, DebuggerApp *app)
     GtkTreeModel *model;
     GtkTreeSelection *selection = gtk_tree_view_get_selection(breakpoint_window->breakpoint_tree_view);
 
-    if (gtk_tree_selection_count_selected_rows(selection))
+    if (gtk_tree_selection_get_selected(selection, &model, &iter))
     {
-        gtk_tree_selection_get_selected(selection, &model, &iter);
-        gtk_list_store_remove(app->breakpoints, &iter);
+        GtkTreePath *path = gtk_tree_model_get_path(model, &iter);
+
+        guint index = gtk_tree_path_get_indices(path)[0];
+        gtk_tree_path_free(path);
+
+        breakpoints_remove(app->nes->breakpoints, index);
+        emulator_thread_call(app->emulator, remove_breakpoint_call, GUINT_TO_POINTER(index));
+
+        debugger_app_sync_breakpoints(app);
     }
 }
 
@@ -91,10 +214,78 @@ BreakpointWindow *breakpoint_window_new(DebuggerApp *app)
     gtk_tree_view_append_column(window->breakpoint_tree_view, column);
     column = gtk_tree_view_column_new_with_attributes("Value", renderer, "text", 1, NULL);
     gtk_tree_view_append_column(window->breakpoint_tree_view, column);
+    column = gtk_tree_view_column_new_with_attributes("Condition", renderer, "text", 2, NULL);
+    gtk_tree_view_append_column(window->breakpoint_tree_view, column);
+    column = gtk_tree_view_column_new_with_attributes("Hits", renderer, "text", 3, NULL);
+    gtk_tree_view_append_column(window->breakpoint_tree_view, column);
 
     g_signal_connect(window->add_address_bp_button, "clicked", G_CALLBACK(add_address_breakpoint), app);
     g_signal_connect(window->add_memory_bp_button, "clicked", G_CALLBACK(add_memory_breakpoint), app);
+    g_signal_connect(window->add_ppu_bp_button, "clicked", G_CALLBACK(add_ppu_breakpoint), app);
+    g_signal_connect(window->add_oam_bp_button, "clicked", G_CALLBACK(add_oam_breakpoint), app);
     g_signal_connect(window->remove_button, "clicked", G_CALLBACK(remove_breakpoint), app);
 
+    refresh_coordinator_register(app->refresh, window, STATE_BREAKPOINTS, refresh_breakpoint_window);
+
     return window;
 }
+
+#define MAX_LOG_LINES 5000
+
+// Appends what the logpoints wrote since the last refresh, already merged in cycle order by the emulation thread
+static void flush_logpoints(BreakpointWindow *window, DebuggerApp *app)
+{
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(window->log_text_view);
+    GtkTextIter end;
+    gboolean appended = FALSE;
+    char *line;
+
+    gtk_text_buffer_get_end_iter(buffer, &end);
+
+    while ((line = emulator_thread_pop_log(app->emulator)))
+    {
+        gtk_text_buffer_insert(buffer, &end, line, -1);
+        gtk_text_buffer_insert(buffer, &end, "\n", 1);
+        g_free(line);
+        appended = TRUE;
+    }
+
+    if (!appended)
+    {
+        return;
+    }
+
+    gint lines = gtk_text_buffer_get_line_count(buffer);
+
+    if (lines > MAX_LOG_LINES)
+    {
+        GtkTextIter start, cut;
+        gtk_text_buffer_get_start_iter(buffer, &start);
+        gtk_text_buffer_get_iter_at_line(buffer, &cut, lines - MAX_LOG_LINES);
+        gtk_text_buffer_delete(buffer, &start, &cut);
+        gtk_text_buffer_get_end_iter(buffer, &end);
+    }
+
+    gtk_text_view_scroll_to_iter(window->log_text_view, &end, 0, FALSE, 0, 0);
+}
+
+void update_breakpoint_window(BreakpointWindow *window, DebuggerApp *app)
+{
+    if (!window)
+    {
+        return;
+    }
+
+    BREAKPOINTS *breakpoints = app->nes->breakpoints;
+    GtkTreeIter iter;
+    gboolean valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(app->breakpoints), &iter);
+
+    // Rows are in the same order as the core list
+    for (unsigned int i = 0; valid && i < breakpoints->count; i++)
+    {
+        gtk_list_store_set(app->breakpoints, &iter, 3, breakpoints->list[i].hits, -1);
+        valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(app->breakpoints), &iter);
+    }
+
+    flush_logpoints(window, app);
+}
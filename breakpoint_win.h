@@ -10,4 +10,6 @@ G_DECLARE_FINAL_TYPE(BreakpointWindow, breakpoint_window, BREAKPOINT, WINDOW, Gt
 
 BreakpointWindow *breakpoint_window_new(DebuggerApp *app);
 
+void update_breakpoint_window(BreakpointWindow *window, DebuggerApp *app);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cdl.h"
+#include "disassembler.h"
+
+CDL *create_cdl()
+{
+    CDL *cdl = malloc(sizeof(CDL));
+
+    cdl_reset(cdl, CDL_MAX_PRG_SIZE, CDL_MAX_CHR_SIZE);
+
+    return cdl;
+}
+
+// Clears the marks for a ROM of that size, as given by its header
+void cdl_reset(CDL *cdl, unsigned int prg_size, unsigned int chr_size)
+{
+    cdl->prg_size = prg_size > 0x4000 ? CDL_MAX_PRG_SIZE : 0x4000;
+    cdl->chr_size = chr_size ? CDL_MAX_CHR_SIZE : 0;
+
+    memset(cdl->opcodes, 0, sizeof(cdl->opcodes));
+    memset(cdl->operands, 0, sizeof(cdl->operands));
+    memset(cdl->data, 0, sizeof(cdl->data));
+    memset(cdl->rendered, 0, sizeof(cdl->rendered));
+    memset(cdl->chr_read, 0, sizeof(cdl->chr_read));
+}
+
+// Adds the marks of a log of the same ROM, returns -1 when the sizes differ
+int cdl_merge(CDL *cdl, const CDL *other)
+{
+    if (cdl->prg_size != other->prg_size || cdl->chr_size != other->chr_size)
+    {
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < CDL_MAX_PRG_SIZE / 8; i++)
+    {
+        cdl->opcodes[i] |= other->opcodes[i];
+        cdl->operands[i] |= other->operands[i];
+        cdl->data[i] |= other->data[i];
+    }
+
+    for (unsigned int i = 0; i < CDL_MAX_CHR_SIZE / 8; i++)
+    {
+        cdl->rendered[i] |= other->rendered[i];
+        cdl->chr_read[i] |= other->chr_read[i];
+    }
+
+    return 0;
+}
+
+// Bytes marked among the first size ones
+unsigned int cdl_count(const unsigned char *bitmap, unsigned int size)
+{
+    unsigned int count = 0;
+
+    for (unsigned int i = 0; i < size / 8; i++)
+    {
+        count += __builtin_popcount(bitmap[i]);
+    }
+
+    return count;
+}
+
+// Writes the log in the FCEUX format, the bank bits are those of the CPU address NROM maps the byte at
+int cdl_save(const CDL *cdl, FILE *file)
+{
+    unsigned int size = cdl->prg_size + cdl->chr_size;
+    unsigned char *flags = malloc(size);
+    unsigned short base = cdl->prg_size == CDL_MAX_PRG_SIZE ? 0x8000 : 0xc000;
+
+    for (unsigned int offset = 0; offset < cdl->prg_size; offset++)
+    {
+        unsigned char code = cdl_is_marked(cdl->opcodes, offset) | cdl_is_marked(cdl->operands, offset);
+        unsigned char data = cdl_is_marked(cdl->data, offset);
+
+        flags[offset] = code * CDL_FILE_CODE | data * CDL_FILE_DATA;
+
+        if (flags[offset])
+        {
+            flags[offset] |= ((base + offset) & 0x6000) >> CDL_FILE_BANK_SHIFT;
+        }
+    }
+
+    for (unsigned int offset = 0; offset < cdl->chr_size; offset++)
+    {
+        flags[cdl->prg_size + offset] = cdl_is_marked(cdl->rendered, offset) * CDL_FILE_RENDERED |
+                                        cdl_is_marked(cdl->chr_read, offset) * CDL_FILE_READ;
+    }
+
+    int result = fwrite(flags, 1, size, file) == size ? 0 : -1;
+
+    free(flags);
+
+    return result;
+}
+
+/*
+ * Adds the marks of a FCEUX log of the same ROM, returns -1 when its size does not match. The
+ * format only tells code from data: each run of code bytes of the PRG is decoded from its start
+ * to tell the opcodes from the operands.
+ */
+int cdl_load(CDL *cdl, FILE *file, const unsigned char *prg)
+{
+    unsigned int size = cdl->prg_size + cdl->chr_size;
+    unsigned char *flags = malloc(size + 1);
+
+    if (fread(flags, 1, size + 1, file) != size)
+    {
+        free(flags);
+        return -1;
+    }
+
+    unsigned int next_opcode = 0;
+
+    for (unsigned int offset = 0; offset < cdl->prg_size; offset++)
+    {
+        if (flags[offset] & CDL_FILE_DATA)
+        {
+            cdl_mark(cdl->data, offset);
+        }
+
+        if (!(flags[offset] & CDL_FILE_CODE))
+        {
+            continue;
+        }
+
+        if (offset >= next_opcode || !(flags[offset - 1] & CDL_FILE_CODE))
+        {
+            cdl_mark(cdl->opcodes, offset);
+            next_opcode = offset + OPCODES[prg[offset]].length;
+        }
+        else
+        {
+            cdl_mark(cdl->operands, offset);
+        }
+    }
+
+    for (unsigned int offset = 0; offset < cdl->chr_size; offset++)
+    {
+        if (flags[cdl->prg_size + offset] & CDL_FILE_RENDERED)
+        {
+            cdl_mark(cdl->rendered, offset);
+        }
+
+        if (flags[cdl->prg_size + offset] & CDL_FILE_READ)
+        {
+            cdl_mark(cdl->chr_read, offset);
+        }
+    }
+
+    free(flags);
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef _CDL_H_
+#define _CDL_H_
+
+#include <stdio.h>
+
+#define CDL_MAX_PRG_SIZE 0x8000 // NROM, the only mapping emulated
+#define CDL_MAX_CHR_SIZE 0x2000
+
+// Flags of a byte in a FCEUX .cdl file, the PRG bytes come first then the CHR ones
+#define CDL_FILE_CODE 0x01
+#define CDL_FILE_DATA 0x02
+#define CDL_FILE_BANK_SHIFT 11 // bits 13 and 14 of the CPU address go to bits 2 and 3
+#define CDL_FILE_BANK 0x0c
+#define CDL_FILE_RENDERED 0x01 // CHR
+#define CDL_FILE_READ 0x02     // CHR read through PPUDATA
+
+/*
+ * Code/data log, one bitmap per use with a bit per ROM byte. The CPU marks the bytes of each
+ * instruction it fetches as opcode and operands and the other PRG bytes it reads as data, the
+ * PPU the pattern bytes it renders.
+ */
+typedef struct
+{
+    unsigned int prg_size; // 16 or 32 KB
+    unsigned int chr_size; // 8 KB, 0 with CHR RAM
+    unsigned char opcodes[CDL_MAX_PRG_SIZE / 8];
+    unsigned char operands[CDL_MAX_PRG_SIZE / 8];
+    unsigned char data[CDL_MAX_PRG_SIZE / 8];
+    unsigned char rendered[CDL_MAX_CHR_SIZE / 8];
+    unsigned char chr_read[CDL_MAX_CHR_SIZE / 8];
+} CDL;
+
+static inline void cdl_mark(unsigned char *bitmap, unsigned int offset)
+{
+    bitmap[offset >> 3] |= 1 << (offset & 7);
+}
+
+static inline int cdl_is_marked(const unsigned char *bitmap, unsigned int offset)
+{
+    return (bitmap[offset >> 3] >> (offset & 7)) & 1;
+}
+
+// PRG offset of a CPU address from $8000 on, 16 KB are mirrored at $C000
+static inline unsigned int cdl_prg_offset(const CDL *cdl, unsigned short address)
+{
+    return (address - 0x8000) & (cdl->prg_size - 1);
+}
+
+CDL *create_cdl();
+void cdl_reset(CDL *cdl, unsigned int prg_size, unsigned int chr_size);
+int cdl_merge(CDL *cdl, const CDL *other);
+unsigned int cdl_count(const unsigned char *bitmap, unsigned int size);
+int cdl_save(const CDL *cdl, FILE *file);
+int cdl_load(CDL *cdl, FILE *file, const unsigned char *prg);
+
+#endif
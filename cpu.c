@@ -11,6 +11,7 @@ CPU *create_cpu(MEMORY *memory)
     cpu->registerY = 0;
     cpu->registerP = 0x24;
     cpu->sp = 0xfd;
+    cpu->cycles = 0;
 
     return cpu;
 }
@@ -21,6 +21,7 @@ typedef struct
     unsigned char registerP;
     unsigned short pc;
     unsigned char sp;
+    unsigned long long cycles;
 
     MEMORY *memory;
 } CPU;
@@ -0,0 +1,837 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug_info.h"
+
+#define DEBUG_LINE_LENGTH 4096
+#define DEBUG_NAME_LENGTH 256
+#define INES_SIZE 16           // header before the PRG in the ld65 output file
+#define NL_BANK_SIZE 0x4000    // FCEUX writes a .nl file per 16 KB bank
+#define DBG_LINE_MACRO 2       // line of a macro expansion, its invocation line covers the same bytes
+
+// Segment and span records of a .dbg file, by id, until the lines referring to them are resolved
+typedef struct
+{
+    unsigned int start;
+    int output_offset; // -1 when the segment is not in the output file
+} DBG_SEGMENT;
+
+typedef struct
+{
+    unsigned int segment;
+    unsigned int start;
+    unsigned int size;
+} DBG_SPAN;
+
+typedef struct
+{
+    unsigned int span;
+    unsigned int file;
+    unsigned int line;
+} DBG_LINE;
+
+typedef struct
+{
+    unsigned int *files; // SOURCE_FILE index plus one of each file id
+    unsigned int file_capacity;
+    DBG_SEGMENT *segments;
+    unsigned int segment_capacity;
+    DBG_SPAN *spans;
+    unsigned int span_capacity;
+    DBG_LINE *lines;
+    unsigned int line_count;
+    unsigned int line_capacity;
+} DBG_RECORDS;
+
+DEBUG_INFO *create_debug_info()
+{
+    DEBUG_INFO *info = calloc(1, sizeof(DEBUG_INFO));
+
+    return info;
+}
+
+void free_debug_info(DEBUG_INFO *info)
+{
+    for (unsigned int i = 0; i < info->file_count; i++)
+    {
+        free(info->files[i].text);
+        free(info->files[i].line_starts);
+    }
+
+    free(info->names);
+    free(info->symbols);
+    free(info->symbol_table);
+    free(info->spans);
+    free(info->files);
+    free(info);
+}
+
+// Makes room for index in an array grown by doubling, the new elements are zeroed
+static void *debug_reserve(void *array, unsigned int *capacity, unsigned int index, size_t element_size)
+{
+    if (index < *capacity)
+    {
+        return array;
+    }
+
+    unsigned int old_capacity = *capacity;
+
+    *capacity = old_capacity ? old_capacity : 64;
+
+    while (*capacity <= index)
+    {
+        *capacity *= 2;
+    }
+
+    array = realloc(array, *capacity * element_size);
+    memset((char *)array + old_capacity * element_size, 0, (*capacity - old_capacity) * element_size);
+
+    return array;
+}
+
+static unsigned int debug_info_add_name(DEBUG_INFO *info, const char *name, unsigned int length)
+{
+    unsigned int offset = info->names_size;
+
+    info->names = debug_reserve(info->names, &info->names_capacity, offset + length, 1);
+    memcpy(info->names + offset, name, length);
+    info->names[offset + length] = 0;
+    info->names_size += length + 1;
+
+    return offset;
+}
+
+static void debug_info_add_symbol(DEBUG_INFO *info, const char *name, unsigned int length, unsigned int location, unsigned int size)
+{
+    if (!length)
+    {
+        return;
+    }
+
+    info->symbols = debug_reserve(info->symbols, &info->symbol_capacity, info->symbol_count, sizeof(DEBUG_SYMBOL));
+
+    DEBUG_SYMBOL *symbol = &info->symbols[info->symbol_count++];
+
+    symbol->name = debug_info_add_name(info, name, length);
+    symbol->location = location;
+    symbol->size = size ? size : 1;
+}
+
+// Reads the whole file and where its lines start, the file name is tried as is then next to the .dbg
+static void debug_info_read_source(SOURCE_FILE *source, const char *name, const char *directory)
+{
+    FILE *file = fopen(name, "rb");
+
+    if (!file && directory && *name != '/')
+    {
+        char *path = malloc(strlen(directory) + strlen(name) + 2);
+
+        sprintf(path, "%s/%s", directory, name);
+        file = fopen(path, "rb");
+        free(path);
+    }
+
+    if (!file)
+    {
+        return;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    source->text = malloc(size + 1);
+    size = fread(source->text, 1, size, file);
+    source->text[size] = 0;
+    fclose(file);
+
+    unsigned int capacity = 0;
+
+    source->line_starts = debug_reserve(NULL, &capacity, 0, sizeof(unsigned int));
+    source->line_count = 1;
+
+    for (long i = 0; i < size; i++)
+    {
+        if (source->text[i] == '\n' && i + 1 < size)
+        {
+            source->line_starts = debug_reserve(source->line_starts, &capacity, source->line_count, sizeof(unsigned int));
+            source->line_starts[source->line_count++] = i + 1;
+        }
+    }
+}
+
+// Value of a key=value field of a .dbg record, NULL when the record does not have it
+static const char *dbg_field(const char *fields, const char *key)
+{
+    size_t length = strlen(key);
+    int quoted = 0;
+
+    for (const char *field = fields; *field; field++)
+    {
+        if ((field == fields || field[-1] == ',') && !quoted && !strncmp(field, key, length) && field[length] == '=')
+        {
+            return field + length + 1;
+        }
+
+        quoted ^= *field == '"';
+    }
+
+    return NULL;
+}
+
+// Decimal or 0x hexadecimal
+static long dbg_number(const char *fields, const char *key, long missing)
+{
+    const char *value = dbg_field(fields, key);
+
+    return value ? strtol(value, NULL, 0) : missing;
+}
+
+// Quoted string like names or bare word like types, returns its length or -1
+static int dbg_string(const char *fields, const char *key, char *text, unsigned int size)
+{
+    const char *value = dbg_field(fields, key);
+    unsigned int length = 0;
+
+    if (!value)
+    {
+        return -1;
+    }
+
+    char end = *value == '"' ? *value++ : ',';
+
+    while (*value && *value != end && length + 1 < size)
+    {
+        text[length++] = *value++;
+    }
+
+    text[length] = 0;
+
+    return length;
+}
+
+// Location of an offset in the segment, -1 for segments that are not in ROM
+static int dbg_location(const DBG_RECORDS *records, long segment, unsigned int offset)
+{
+    if (segment < 0 || segment >= records->segment_capacity)
+    {
+        return -1;
+    }
+
+    int output_offset = records->segments[segment].output_offset;
+
+    return output_offset < INES_SIZE ? -1 : (int)(DEBUG_ROM_LOCATION + output_offset - INES_SIZE + offset);
+}
+
+static void dbg_read_symbol(DEBUG_INFO *info, const DBG_RECORDS *records, const char *fields)
+{
+    char name[DEBUG_NAME_LENGTH];
+    char type[8];
+    char address_size[16];
+    int length = dbg_string(fields, "name", name, sizeof(name));
+    long value = dbg_number(fields, "val", -1);
+    long segment = dbg_number(fields, "seg", -1);
+
+    if (length <= 0 || value < 0 || dbg_string(fields, "type", type, sizeof(type)) < 0)
+    {
+        return;
+    }
+
+    int location = -1;
+
+    if (!strcmp(type, "lab") && segment >= 0 && segment < records->segment_capacity)
+    {
+        // Labels in ROM are known by their offset, the others (zero page, BSS) by their address
+        location = dbg_location(records, segment, value - records->segments[segment].start);
+
+        if (location < 0 && value < DEBUG_ROM_LOCATION)
+        {
+            location = value;
+        }
+    }
+    else if (!strcmp(type, "equ") && dbg_string(fields, "addrsize", address_size, sizeof(address_size)) >= 0 &&
+             !strcmp(address_size, "absolute") && value >= 0x100 && value < DEBUG_ROM_LOCATION)
+    {
+        // ca65 gives small constants a zero page size, absolute ones below the ROM are registers and RAM
+        location = value;
+    }
+
+    if (location >= 0)
+    {
+        debug_info_add_symbol(info, name, length, location, dbg_number(fields, "size", 1));
+    }
+}
+
+static void dbg_read_line(DBG_RECORDS *records, const char *fields)
+{
+    const char *spans = dbg_field(fields, "span");
+    long file = dbg_number(fields, "file", -1);
+    long line = dbg_number(fields, "line", -1);
+
+    if (!spans || file < 0 || line <= 0 || dbg_number(fields, "type", 0) == DBG_LINE_MACRO)
+    {
+        return;
+    }
+
+    // "span=12+13+20"
+    for (char *next = (char *)spans;;)
+    {
+        long span = strtol(next, &next, 10);
+
+        records->lines = debug_reserve(records->lines, &records->line_capacity, records->line_count, sizeof(DBG_LINE));
+        records->lines[records->line_count++] = (DBG_LINE){span, file, line};
+
+        if (*next++ != '+')
+        {
+            break;
+        }
+    }
+}
+
+static void dbg_read_record(DEBUG_INFO *info, DBG_RECORDS *records, const char *keyword, const char *fields, const char *directory)
+{
+    long id = dbg_number(fields, "id", -1);
+
+    if (!strcmp(keyword, "sym"))
+    {
+        dbg_read_symbol(info, records, fields);
+    }
+    else if (!strcmp(keyword, "line"))
+    {
+        dbg_read_line(records, fields);
+    }
+    else if (id < 0)
+    {
+        return;
+    }
+    else if (!strcmp(keyword, "file"))
+    {
+        char name[DEBUG_NAME_LENGTH];
+        int length = dbg_string(fields, "name", name, sizeof(name));
+
+        if (length < 0)
+        {
+            return;
+        }
+
+        info->files = realloc(info->files, (info->file_count + 1) * sizeof(SOURCE_FILE));
+
+        SOURCE_FILE *source = &info->files[info->file_count];
+
+        source->name = debug_info_add_name(info, name, length);
+        source->text = NULL;
+        source->line_starts = NULL;
+        source->line_count = 0;
+        debug_info_read_source(source, name, directory);
+
+        records->files = debug_reserve(records->files, &records->file_capacity, id, sizeof(unsigned int));
+        records->files[id] = ++info->file_count;
+    }
+    else if (!strcmp(keyword, "seg"))
+    {
+        records->segments = debug_reserve(records->segments, &records->segment_capacity, id, sizeof(DBG_SEGMENT));
+        records->segments[id].start = dbg_number(fields, "start", 0);
+        records->segments[id].output_offset = dbg_number(fields, "ooffs", -1);
+    }
+    else if (!strcmp(keyword, "span"))
+    {
+        records->spans = debug_reserve(records->spans, &records->span_capacity, id, sizeof(DBG_SPAN));
+        records->spans[id].segment = dbg_number(fields, "seg", 0);
+        records->spans[id].start = dbg_number(fields, "start", 0);
+        records->spans[id].size = dbg_number(fields, "size", 0);
+    }
+}
+
+/*
+ * Symbols and source lines of a ld65 --dbgfile for an iNES file. Lines come before the segments
+ * and spans they refer to, they are resolved once the whole file is read. Source files are read
+ * from where ca65 found them, or next to the .dbg.
+ */
+int debug_info_load_dbg(DEBUG_INFO *info, FILE *file, const char *directory)
+{
+    char *line = malloc(DEBUG_LINE_LENGTH);
+    DBG_RECORDS records = {0};
+
+    if (!fgets(line, DEBUG_LINE_LENGTH, file) || strncmp(line, "version\t", 8))
+    {
+        free(line);
+        return -1;
+    }
+
+    while (fgets(line, DEBUG_LINE_LENGTH, file))
+    {
+        char *fields = strchr(line, '\t');
+
+        if (!fields)
+        {
+            continue;
+        }
+
+        *fields++ = 0;
+        fields[strcspn(fields, "\r\n")] = 0;
+        dbg_read_record(info, &records, line, fields, directory);
+    }
+
+    for (unsigned int i = 0; i < records.line_count; i++)
+    {
+        DBG_LINE *dbg_line = &records.lines[i];
+
+        if (dbg_line->span >= records.span_capacity || dbg_line->file >= records.file_capacity || !records.files[dbg_line->file])
+        {
+            continue;
+        }
+
+        DBG_SPAN *span = &records.spans[dbg_line->span];
+        int location = dbg_location(&records, span->segment, span->start);
+
+        if (location < 0 || !span->size)
+        {
+            continue;
+        }
+
+        info->spans = debug_reserve(info->spans, &info->span_capacity, info->span_count, sizeof(SOURCE_SPAN));
+        info->spans[info->span_count++] = (SOURCE_SPAN){location, span->size, records.files[dbg_line->file] - 1, dbg_line->line};
+    }
+
+    free(records.files);
+    free(records.segments);
+    free(records.spans);
+    free(records.lines);
+    free(line);
+
+    return 0;
+}
+
+// FCEUX labels: "$C000#Name#Comment" or "$0300/10#Buffer#", of a PRG bank or of RAM when bank is -1
+int debug_info_load_nl(DEBUG_INFO *info, FILE *file, int bank)
+{
+    char line[DEBUG_LINE_LENGTH];
+
+    while (fgets(line, sizeof(line), file))
+    {
+        char *next;
+        unsigned int address;
+        unsigned int size = 1;
+
+        if (*line != '$')
+        {
+            continue;
+        }
+
+        address = strtoul(line + 1, &next, 16);
+
+        if (*next == '/')
+        {
+            size = strtoul(next + 1, &next, 16);
+        }
+
+        if (*next++ != '#')
+        {
+            continue;
+        }
+
+        unsigned int location = bank < 0 ? address : DEBUG_ROM_LOCATION + bank * NL_BANK_SIZE + (address & (NL_BANK_SIZE - 1));
+
+        if ((bank < 0) != (address < DEBUG_ROM_LOCATION))
+        {
+            continue;
+        }
+
+        debug_info_add_symbol(info, next, strcspn(next, "#\r\n"), location, size);
+    }
+
+    return 0;
+}
+
+// Location of an address of a Mesen memory type, -1 for the types that have none
+static int mlb_location(const char *type, unsigned int address)
+{
+    static const struct
+    {
+        const char *name;
+        unsigned int base;
+    } TYPES[] = {{"P", DEBUG_ROM_LOCATION}, {"NesPrgRom", DEBUG_ROM_LOCATION},
+                 {"R", 0}, {"NesInternalRam", 0},
+                 {"S", 0x6000}, {"NesSaveRam", 0x6000},
+                 {"W", 0x6000}, {"NesWorkRam", 0x6000},
+                 {"G", 0}, {"NesMemory", 0}};
+
+    for (unsigned int i = 0; i < sizeof(TYPES) / sizeof(TYPES[0]); i++)
+    {
+        if (!strcmp(type, TYPES[i].name))
+        {
+            unsigned int location = TYPES[i].base + address;
+
+            // Register labels are CPU addresses, the ROM is only known by offset
+            return TYPES[i].base == DEBUG_ROM_LOCATION || location < DEBUG_ROM_LOCATION ? (int)location : -1;
+        }
+    }
+
+    return -1;
+}
+
+// Mesen labels: "P:0123:Name:Comment" or "R:0300-030F:Buffer", the type names of Mesen 2 as well
+int debug_info_load_mlb(DEBUG_INFO *info, FILE *file)
+{
+    char line[DEBUG_LINE_LENGTH];
+
+    while (fgets(line, sizeof(line), file))
+    {
+        char *address_text = strchr(line, ':');
+
+        if (!address_text)
+        {
+            continue;
+        }
+
+        *address_text++ = 0;
+
+        char *next;
+        unsigned int address = strtoul(address_text, &next, 16);
+        unsigned int end = *next == '-' ? strtoul(next + 1, &next, 16) : address;
+        int location = mlb_location(line, address);
+
+        if (next == address_text || *next++ != ':' || location < 0 || end < address)
+        {
+            continue;
+        }
+
+        debug_info_add_symbol(info, next, strcspn(next, ":\r\n"), location, end - address + 1);
+    }
+
+    return 0;
+}
+
+/*
+ * Loads a file by its extension and indexes what was loaded so far, returns -1 when it cannot be
+ * read. The bank of a .nl file is in its name: "game.nes.ram.nl" or "game.nes.1.nl".
+ */
+int debug_info_load(DEBUG_INFO *info, const char *filename)
+{
+    const char *extension = strrchr(filename, '.');
+    FILE *file = extension ? fopen(filename, "r") : NULL;
+    int result = -1;
+
+    if (!file)
+    {
+        return -1;
+    }
+
+    if (!strcmp(extension, ".dbg"))
+    {
+        const char *slash = strrchr(filename, '/');
+        char *directory = slash ? strndup(filename, slash - filename) : NULL;
+
+        result = debug_info_load_dbg(info, file, directory);
+        free(directory);
+    }
+    else if (!strcmp(extension, ".nl"))
+    {
+        const char *bank_name = extension;
+
+        while (bank_name > filename && bank_name[-1] != '.')
+        {
+            bank_name--;
+        }
+
+        char *end;
+        long bank = strtol(bank_name, &end, 16);
+
+        if (!strncmp(bank_name, "ram.", 4))
+        {
+            result = debug_info_load_nl(info, file, -1);
+        }
+        else if (bank_name > filename && end == extension)
+        {
+            result = debug_info_load_nl(info, file, bank);
+        }
+    }
+    else if (!strcmp(extension, ".mlb"))
+    {
+        result = debug_info_load_mlb(info, file);
+    }
+
+    fclose(file);
+
+    if (result == 0)
+    {
+        debug_info_index(info);
+    }
+
+    return result;
+}
+
+// By location, the order of loading between symbols at the same location
+static int debug_symbol_compare(const void *a, const void *b)
+{
+    const DEBUG_SYMBOL *symbol_a = a;
+    const DEBUG_SYMBOL *symbol_b = b;
+
+    if (symbol_a->location != symbol_b->location)
+    {
+        return symbol_a->location < symbol_b->location ? -1 : 1;
+    }
+
+    return symbol_a->name < symbol_b->name ? -1 : symbol_a->name > symbol_b->name;
+}
+
+static int source_span_compare(const void *a, const void *b)
+{
+    const SOURCE_SPAN *span_a = a;
+    const SOURCE_SPAN *span_b = b;
+
+    if (span_a->location != span_b->location)
+    {
+        return span_a->location < span_b->location ? -1 : 1;
+    }
+
+    return span_a->size < span_b->size ? -1 : span_a->size > span_b->size;
+}
+
+static unsigned int debug_hash(const char *name)
+{
+    unsigned int hash = 2166136261u;
+
+    while (*name)
+    {
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    }
+
+    return hash;
+}
+
+/*
+ * Sorts what was loaded and hashes the names, the first symbol loaded keeps a name given twice.
+ * Spans starting at the same location keep the smallest one, the line that assembled it.
+ */
+void debug_info_index(DEBUG_INFO *info)
+{
+    qsort(info->symbols, info->symbol_count, sizeof(DEBUG_SYMBOL), debug_symbol_compare);
+    qsort(info->spans, info->span_count, sizeof(SOURCE_SPAN), source_span_compare);
+
+    unsigned int count = 0;
+
+    for (unsigned int i = 0; i < info->span_count; i++)
+    {
+        if (!count || info->spans[count - 1].location != info->spans[i].location)
+        {
+            info->spans[count++] = info->spans[i];
+        }
+    }
+
+    info->span_count = count;
+
+    info->symbol_table_capacity = 64;
+
+    while (info->symbol_table_capacity < info->symbol_count * 2)
+    {
+        info->symbol_table_capacity *= 2;
+    }
+
+    free(info->symbol_table);
+    info->symbol_table = calloc(info->symbol_table_capacity, sizeof(unsigned int));
+
+    unsigned int mask = info->symbol_table_capacity - 1;
+
+    for (unsigned int i = 0; i < info->symbol_count; i++)
+    {
+        const char *name = debug_info_name(info, info->symbols[i].name);
+        unsigned int slot = debug_hash(name) & mask;
+
+        while (info->symbol_table[slot] && strcmp(debug_info_name(info, info->symbols[info->symbol_table[slot] - 1].name), name))
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        // The symbols are sorted by location, the first loaded may come later
+        if (!info->symbol_table[slot] || info->symbols[info->symbol_table[slot] - 1].name > info->symbols[i].name)
+        {
+            info->symbol_table[slot] = i + 1;
+        }
+    }
+}
+
+const DEBUG_SYMBOL *debug_info_find_symbol(const DEBUG_INFO *info, const char *name)
+{
+    if (!info->symbol_table)
+    {
+        return NULL;
+    }
+
+    unsigned int mask = info->symbol_table_capacity - 1;
+
+    for (unsigned int slot = debug_hash(name) & mask; info->symbol_table[slot]; slot = (slot + 1) & mask)
+    {
+        const DEBUG_SYMBOL *symbol = &info->symbols[info->symbol_table[slot] - 1];
+
+        if (!strcmp(debug_info_name(info, symbol->name), name))
+        {
+            return symbol;
+        }
+    }
+
+    return NULL;
+}
+
+// The symbol the location is in, the first loaded of those starting at the same place, NULL when none
+const DEBUG_SYMBOL *debug_info_symbol_at(const DEBUG_INFO *info, unsigned int location)
+{
+    unsigned int low = 0;
+    unsigned int high = info->symbol_count;
+
+    // First symbol after the location
+    while (low < high)
+    {
+        unsigned int middle = (low + high) / 2;
+
+        if (info->symbols[middle].location <= location)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (!low)
+    {
+        return NULL;
+    }
+
+    const DEBUG_SYMBOL *symbol = &info->symbols[low - 1];
+
+    while (symbol > info->symbols && symbol[-1].location == symbol->location)
+    {
+        symbol--;
+    }
+
+    return location < symbol->location + symbol->size ? symbol : NULL;
+}
+
+// The span of the line that assembled the byte at the location, NULL when none did
+const SOURCE_SPAN *debug_info_span_at(const DEBUG_INFO *info, unsigned int location)
+{
+    unsigned int low = 0;
+    unsigned int high = info->span_count;
+
+    while (low < high)
+    {
+        unsigned int middle = (low + high) / 2;
+
+        if (info->spans[middle].location <= location)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (!low || location >= info->spans[low - 1].location + info->spans[low - 1].size)
+    {
+        return NULL;
+    }
+
+    return &info->spans[low - 1];
+}
+
+// Copies the text of the source line without its indentation, returns -1 when the file could not be read
+int debug_info_source_line(const DEBUG_INFO *info, const SOURCE_SPAN *span, char *text, unsigned int size)
+{
+    const SOURCE_FILE *source = &info->files[span->file];
+
+    if (!source->text || span->line > source->line_count || !size)
+    {
+        return -1;
+    }
+
+    const char *line = source->text + source->line_starts[span->line - 1];
+    unsigned int length = 0;
+
+    line += strspn(line, " \t");
+
+    while (line[length] && line[length] != '\n' && line[length] != '\r' && length + 1 < size)
+    {
+        text[length] = line[length] == '\t' ? ' ' : line[length];
+        length++;
+    }
+
+    text[length] = 0;
+
+    return length;
+}
+
+static unsigned int debug_map_append(char **text, unsigned int *size, unsigned int *capacity, const char *string)
+{
+    unsigned int offset = *size;
+    unsigned int length = strlen(string);
+
+    *text = debug_reserve(*text, capacity, offset + length, 1);
+    memcpy(*text + offset, string, length + 1);
+    *size += length + 1;
+
+    return offset + 1;
+}
+
+// Labels and lines of the CPU addresses with the PRG mapped at $8000 and mirrored when 16 KB, none without PRG
+DEBUG_ADDRESS_MAP *create_debug_address_map(const DEBUG_INFO *info, unsigned int prg_size)
+{
+    DEBUG_ADDRESS_MAP *map = malloc(sizeof(DEBUG_ADDRESS_MAP));
+    unsigned int *symbol_texts = calloc(info->symbol_count + 1, sizeof(unsigned int));
+    unsigned int *span_texts = calloc(info->span_count + 1, sizeof(unsigned int));
+    unsigned int size = 0;
+    unsigned int capacity = 0;
+
+    map->text = NULL;
+
+    for (unsigned int address = 0; address < DEBUG_ADDRESS_SPACE; address++)
+    {
+        unsigned int location = address < DEBUG_ROM_LOCATION ? address : DEBUG_ROM_LOCATION + ((address - DEBUG_ROM_LOCATION) & (prg_size - 1));
+        const DEBUG_SYMBOL *symbol = address < DEBUG_ROM_LOCATION || prg_size ? debug_info_symbol_at(info, location) : NULL;
+        const SOURCE_SPAN *span = address < DEBUG_ROM_LOCATION || prg_size ? debug_info_span_at(info, location) : NULL;
+
+        map->labels[address] = 0;
+        map->sources[address] = 0;
+
+        if (symbol && symbol->location == location)
+        {
+            unsigned int *text = &symbol_texts[symbol - info->symbols];
+
+            if (!*text)
+            {
+                *text = debug_map_append(&map->text, &size, &capacity, debug_info_name(info, symbol->name));
+            }
+
+            map->labels[address] = *text;
+        }
+
+        if (span)
+        {
+            unsigned int *text = &span_texts[span - info->spans];
+
+            if (!*text)
+            {
+                char source[DEBUG_NAME_LENGTH + 16];
+
+                snprintf(source, sizeof(source), "%s:%u", debug_info_name(info, info->files[span->file].name), span->line);
+                *text = debug_map_append(&map->text, &size, &capacity, source);
+            }
+
+            map->sources[address] = *text;
+        }
+    }
+
+    free(symbol_texts);
+    free(span_texts);
+
+    return map;
+}
+
+void free_debug_address_map(DEBUG_ADDRESS_MAP *map)
+{
+    free(map->text);
+    free(map);
+}
@@ -0,0 +1,88 @@
+#ifndef _DEBUG_INFO_H_
+#define _DEBUG_INFO_H_
+
+#include <stdio.h>
+
+// Locations are those of the cross-reference index: CPU addresses below $8000, PRG offsets from there on
+#define DEBUG_ROM_LOCATION 0x8000
+#define DEBUG_ADDRESS_SPACE 0x10000
+
+typedef struct
+{
+    unsigned int name; // offset in names
+    unsigned int location;
+    unsigned int size; // bytes the symbol names, 1 for a plain label
+} DEBUG_SYMBOL;
+
+// Bytes assembled from a source line
+typedef struct
+{
+    unsigned int location;
+    unsigned int size;
+    unsigned int file;
+    unsigned int line; // from 1
+} SOURCE_SPAN;
+
+typedef struct
+{
+    unsigned int name;         // offset in names
+    char *text;                // NULL when the file could not be read
+    unsigned int *line_starts; // offset of each line in text
+    unsigned int line_count;
+} SOURCE_FILE;
+
+/*
+ * Symbols and source lines of the loaded ROM, from ld65 .dbg files and FCEUX .nl or Mesen .mlb
+ * label files. Symbols are sorted by location and hashed by name, spans sorted by location, so
+ * that every lookup is a binary search or a probe. Nothing changes once debug_info_index ran
+ * after the last load.
+ */
+typedef struct
+{
+    char *names;
+    unsigned int names_size;
+    unsigned int names_capacity;
+    DEBUG_SYMBOL *symbols;
+    unsigned int symbol_count;
+    unsigned int symbol_capacity;
+    unsigned int *symbol_table; // symbol index plus one by name, open addressing
+    unsigned int symbol_table_capacity;
+    SOURCE_SPAN *spans;
+    unsigned int span_count;
+    unsigned int span_capacity;
+    SOURCE_FILE *files;
+    unsigned int file_count;
+} DEBUG_INFO;
+
+/*
+ * What the trace prints for each CPU address, resolved once for a NROM mapping so that writing
+ * a trace line only costs two array reads.
+ */
+typedef struct
+{
+    unsigned int labels[DEBUG_ADDRESS_SPACE];  // offset plus one in text of the symbol starting there
+    unsigned int sources[DEBUG_ADDRESS_SPACE]; // offset plus one in text of its "file:line"
+    char *text;
+} DEBUG_ADDRESS_MAP;
+
+DEBUG_INFO *create_debug_info();
+void free_debug_info(DEBUG_INFO *info);
+int debug_info_load(DEBUG_INFO *info, const char *filename);
+int debug_info_load_dbg(DEBUG_INFO *info, FILE *file, const char *directory);
+int debug_info_load_nl(DEBUG_INFO *info, FILE *file, int bank);
+int debug_info_load_mlb(DEBUG_INFO *info, FILE *file);
+void debug_info_index(DEBUG_INFO *info);
+const DEBUG_SYMBOL *debug_info_find_symbol(const DEBUG_INFO *info, const char *name);
+const DEBUG_SYMBOL *debug_info_symbol_at(const DEBUG_INFO *info, unsigned int location);
+const SOURCE_SPAN *debug_info_span_at(const DEBUG_INFO *info, unsigned int location);
+int debug_info_source_line(const DEBUG_INFO *info, const SOURCE_SPAN *span, char *text, unsigned int size);
+
+static inline const char *debug_info_name(const DEBUG_INFO *info, unsigned int name)
+{
+    return info->names + name;
+}
+
+DEBUG_ADDRESS_MAP *create_debug_address_map(const DEBUG_INFO *info, unsigned int prg_size);
+void free_debug_address_map(DEBUG_ADDRESS_MAP *map);
+
+#endif
@@ -1,10 +1,15 @@
 #include <gtk/gtk.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "debugger_app.h"
 #include "debugger_win.h"
 
 G_DEFINE_TYPE(DebuggerApp, debugger_app, GTK_TYPE_APPLICATION);
 
+static void debugger_app_request_refresh(DebuggerApp *app);
+static void set_recorder_call(NES *nes, void *data);
+
 static void debugger_app_activate(GApplication *app)
 {
     DebuggerAppWindow *win = debugger_app_window_new(DEBUGGER_APP(app));
@@ -13,17 +18,129 @@ static void debugger_app_activate(GApplication *app)
     debugger_app->win = GTK_APPLICATION_WINDOW(win);
 
     gtk_window_present(GTK_WINDOW(win));
+
+    // A snapshot published before the window existed is still waiting
+    debugger_app_request_refresh(debugger_app);
+}
+
+static void debugger_app_shutdown(GApplication *app)
+{
+    EMULATOR_THREAD *emulator = DEBUGGER_APP(app)->emulator;
+
+    emulator_thread_quit(emulator);
+
+    // The emulation thread is gone, the trace it was recording is closed here
+    if (emulator->nes->recorder)
+    {
+        set_recorder_call(emulator->nes, NULL);
+    }
+
+    G_APPLICATION_CLASS(debugger_app_parent_class)->shutdown(app);
 }
 
 static void debugger_app_class_init(DebuggerAppClass *class)
 {
     G_APPLICATION_CLASS(class)->activate = debugger_app_activate;
+    G_APPLICATION_CLASS(class)->shutdown = debugger_app_shutdown;
+}
+
+// Merges the references seen by the emulator since the last frame, returns the parts to refresh
+static guint64 debugger_app_merge_xrefs(DebuggerApp *app)
+{
+    XREF_BATCH *batch;
+
+    while ((batch = emulator_thread_pop_xrefs(app->emulator)))
+    {
+        // Batches logged before the last load refer to the previous ROM
+        for (unsigned int i = 0; app->xrefs && batch->rom_loads == app->rom_loads && i < batch->count; i++)
+        {
+            int to = xref_location(app->analysis, 0, batch->xrefs[i].to);
+            int from = xref_location(app->analysis, 0, batch->xrefs[i].from);
+
+            if (to >= 0 && from >= 0)
+            {
+                xref_index_add(app->xrefs, to, from, batch->xrefs[i].kinds);
+            }
+        }
+
+        g_free(batch);
+    }
+
+    if (!app->xrefs || !xref_index_commit(app->xrefs))
+    {
+        return 0;
+    }
+
+    app->xref_generation++;
+
+    return STATE_XREFS;
+}
+
+// Takes the newest snapshot once per display frame, however often the emulation thread publishes
+static gboolean debugger_app_tick(GtkWidget *widget, GdkFrameClock *frame_clock, DebuggerApp *app)
+{
+    app->refresh_tick = 0;
+
+    guint64 changes = emulator_thread_refresh_view(app->emulator) | debugger_app_merge_xrefs(app);
+
+    app->is_running = app->emulator->view.running;
+
+    refresh_coordinator_mark(app->refresh, changes);
+    refresh_coordinator_run(app->refresh, app);
+
+    // Nobody shows the logpoint lines without the breakpoint window
+    if (!app->breakpoint_window)
+    {
+        char *line;
+
+        while ((line = emulator_thread_pop_log(app->emulator)))
+        {
+            g_free(line);
+        }
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void debugger_app_request_refresh(DebuggerApp *app)
+{
+    if (!app->win || app->refresh_tick)
+    {
+        return;
+    }
+
+    app->refresh_tick = gtk_widget_add_tick_callback(GTK_WIDGET(app->win), (GtkTickCallback)debugger_app_tick, app, NULL);
+}
+
+// Main loop side of a publication by the emulation thread
+static gboolean debugger_app_published(DebuggerApp *app)
+{
+    debugger_app_request_refresh(app);
+
+    return G_SOURCE_REMOVE;
 }
 
 static void debugger_app_init(DebuggerApp *app)
 {
-    app->nes = create_nes();
-    app->breakpoints = gtk_list_store_new(2, G_TYPE_UINT, G_TYPE_STRING);
+    NES *nes = create_nes();
+    nes->xrefs = create_xref_log();
+    nes_set_cdl(nes, create_cdl());
+
+    app->emulator = create_emulator_thread(nes, G_SOURCE_FUNC(debugger_app_published), app);
+    app->nes = &app->emulator->view.nes;
+    app->refresh = create_refresh_coordinator();
+    app->refresh_tick = 0;
+    app->analysis = NULL;
+    app->xrefs = NULL;
+    app->timing = NULL;
+    app->rom_loads = 0;
+    app->xref_generation = 0;
+    app->debug_info = create_debug_info();
+    app->symbol_generation = 0;
+    app->is_recording = FALSE;
+    trace_filter_init(&app->trace_filter);
+    app->breakpoints = gtk_list_store_new(4, G_TYPE_UINT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_ULONG);
+    app->watches = gtk_list_store_new(3, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_POINTER);
 }
 
 DebuggerApp *debugger_app_new()
@@ -32,52 +149,339 @@ DebuggerApp *debugger_app_new()
                         "flags", G_APPLICATION_FLAGS_NONE, NULL);
 }
 
+static void set_symbols_call(NES *nes, void *data)
+{
+    if (nes->symbols)
+    {
+        free_debug_address_map(nes->symbols);
+    }
+
+    nes->symbols = data;
+}
+
+// The trace gets its own copy resolved for the mapping, the UI searches the debug info
+static void debugger_app_debug_info_changed(DebuggerApp *app)
+{
+    unsigned int prg_size = app->analysis ? MIN(app->analysis->prg_size, 2 * PRG_BANK_SIZE) : 0;
+    DEBUG_ADDRESS_MAP *map = app->debug_info->symbol_count || app->debug_info->span_count
+                                 ? create_debug_address_map(app->debug_info, prg_size)
+                                 : NULL;
+
+    emulator_thread_call(app->emulator, set_symbols_call, map);
+
+    app->symbol_generation++;
+    refresh_coordinator_mark(app->refresh, STATE_SYMBOLS);
+    debugger_app_sync_breakpoints(app);
+}
+
+// Symbols and source lines of a ld65 .dbg, FCEUX .nl or Mesen .mlb file, added to those already loaded
+int debugger_app_load_debug_info(DebuggerApp *app, const char *filename)
+{
+    if (debug_info_load(app->debug_info, filename) < 0)
+    {
+        return -1;
+    }
+
+    debugger_app_debug_info_changed(app);
+
+    return 0;
+}
+
+// Files the assembler or another emulator left next to the ROM: game.dbg, game.mlb, game.nes.ram.nl, game.nes.0.nl...
+static void debugger_app_load_companion_debug_info(DebuggerApp *app, const char *filename)
+{
+    const char *extension = strrchr(filename, '.');
+    int base_length = extension && !strchr(extension, '/') ? extension - filename : (int)strlen(filename);
+    unsigned int bank_count = app->analysis ? app->analysis->bank_count : 0;
+    gchar *name;
+
+    free_debug_info(app->debug_info);
+    app->debug_info = create_debug_info();
+
+    name = g_strdup_printf("%.*s.dbg", base_length, filename);
+    debug_info_load(app->debug_info, name);
+    g_free(name);
+
+    name = g_strdup_printf("%.*s.mlb", base_length, filename);
+    debug_info_load(app->debug_info, name);
+    g_free(name);
+
+    name = g_strdup_printf("%s.ram.nl", filename);
+    debug_info_load(app->debug_info, name);
+    g_free(name);
+
+    for (unsigned int bank = 0; bank < bank_count; bank++)
+    {
+        name = g_strdup_printf("%s.%X.nl", filename, bank);
+        debug_info_load(app->debug_info, name);
+        g_free(name);
+    }
+
+    debugger_app_debug_info_changed(app);
+}
+
+// Location of a CPU address for the debug info and the references, -1 in ROM without analysis
+int debugger_app_location(DebuggerApp *app, unsigned short address)
+{
+    return app->analysis || address < XREF_ROM_LOCATION ? xref_location(app->analysis, 0, address) : -1;
+}
+
+// Writes the symbol the address is in, like "buffer+3", returns 0 when there is none
+int debugger_app_symbol_name(DebuggerApp *app, unsigned short address, char *name, unsigned int size)
+{
+    int location = debugger_app_location(app, address);
+    const DEBUG_SYMBOL *symbol = location >= 0 ? debug_info_symbol_at(app->debug_info, location) : NULL;
+
+    if (!symbol)
+    {
+        return 0;
+    }
+
+    if ((unsigned int)location == symbol->location)
+    {
+        g_snprintf(name, size, "%s", debug_info_name(app->debug_info, symbol->name));
+    }
+    else
+    {
+        g_snprintf(name, size, "%s+%u", debug_info_name(app->debug_info, symbol->name), location - symbol->location);
+    }
+
+    return 1;
+}
+
+/*
+ * Reads a hex address or a symbol name at the start of the text, up to a '-' or a space. Returns
+ * -1 when it is neither, else the address and how many bytes the symbol names, 1 for an address.
+ */
+int debugger_app_parse_address(DebuggerApp *app, const char *text, unsigned short *address, unsigned int *size, const char **end)
+{
+    size_t length = strcspn(text, "- ");
+    gchar *word = g_strndup(text, length);
+    const DEBUG_SYMBOL *symbol = debug_info_find_symbol(app->debug_info, word);
+    char *hex_end;
+    long value = strtol(word, &hex_end, 16);
+    int result = 0;
+
+    if (symbol && (symbol->location < XREF_ROM_LOCATION || app->analysis))
+    {
+        *address = xref_location_address(app->analysis, symbol->location);
+        *size = symbol->size;
+    }
+    else if (length && !*hex_end && value >= 0 && value <= 0xffff)
+    {
+        *address = value;
+        *size = 1;
+    }
+    else
+    {
+        result = -1;
+    }
+
+    g_free(word);
+
+    if (end)
+    {
+        *end = text + length;
+    }
+
+    return result;
+}
+
+// The static references are known at once, the emulator adds the ones it sees while running
 void debugger_app_load_rom(DebuggerApp *app, const char *filename)
 {
-    load_rom(app->nes, filename);
+    g_clear_pointer(&app->xrefs, free_xref_index);
+    g_clear_pointer(&app->timing, free_timing);
+    g_clear_pointer(&app->analysis, free_analysis);
+
+    app->analysis = analyze_rom_file(filename);
+
+    if (app->analysis)
+    {
+        app->xrefs = create_xref_index(app->analysis->prg_size);
+        xref_index_add_analysis(app->xrefs, app->analysis);
+        xref_index_commit(app->xrefs);
+        app->timing = create_timing(app->analysis);
+    }
+
+    app->rom_loads++;
+    app->xref_generation++;
+    refresh_coordinator_mark(app->refresh, STATE_XREFS);
+
+    emulator_thread_load_rom(app->emulator, filename);
+    debugger_app_load_companion_debug_info(app, filename);
+}
+
+static void merge_cdl_call(NES *nes, void *data)
+{
+    // Left out when a ROM of another size was loaded in the meantime
+    if (nes->cdl)
+    {
+        cdl_merge(nes->cdl, data);
+    }
+
+    free(data);
 }
 
-static gboolean breakpoint_matches(GtkListStore *breakpoints, enum BREAKPOINT_TYPE breakpoint_type, unsigned short address)
+// Adds the marks of a FCEUX log to those of the loaded ROM, returns -1 when it cannot be read or is for another ROM
+int debugger_app_load_cdl(DebuggerApp *app, const char *filename)
 {
+    NES *nes = app->nes;
+    FILE *file = nes->cdl ? fopen(filename, "rb") : NULL;
+
+    if (!file)
+    {
+        return -1;
+    }
+
+    CDL *cdl = create_cdl();
+    unsigned char prg[CDL_MAX_PRG_SIZE];
+
+    cdl_reset(cdl, nes->cdl->prg_size, nes->cdl->chr_size);
+    nes_peek_range(nes, WATCH_BUS_CPU, PRG_ROM_LOWER_BANK, prg, cdl->prg_size);
+
+    int result = cdl_load(cdl, file, prg);
+    fclose(file);
+
+    if (result < 0)
+    {
+        free(cdl);
+        return -1;
+    }
+
+    emulator_thread_call(app->emulator, merge_cdl_call, cdl);
+
+    return 0;
+}
+
+// Writes the log as of the last snapshot in the FCEUX format
+int debugger_app_save_cdl(DebuggerApp *app, const char *filename)
+{
+    CDL *cdl = app->nes->cdl;
+    FILE *file = cdl ? fopen(filename, "wb") : NULL;
+
+    if (!file)
+    {
+        return -1;
+    }
+
+    int result = cdl_save(cdl, file);
+    result |= fclose(file);
+
+    return result < 0 ? -1 : 0;
+}
+
+// Closes the trace being recorded then records to the new one, if any
+static void set_recorder_call(NES *nes, void *data)
+{
+    if (nes->recorder && close_trace_writer(nes->recorder) < 0)
+    {
+        g_printerr("The trace could not be written completely\n");
+    }
+
+    nes->recorder = data;
+}
+
+// Records the instructions the emulator runs from now on that the trace filter lets through, in place of the trace being recorded
+int debugger_app_start_trace(DebuggerApp *app, const char *filename)
+{
+    TRACE_WRITER *writer = create_trace_writer(filename, &app->trace_filter, app->nes->memory->prg_size);
+
+    if (!writer)
+    {
+        return -1;
+    }
+
+    emulator_thread_call(app->emulator, set_recorder_call, writer);
+    app->is_recording = TRUE;
+
+    return 0;
+}
+
+void debugger_app_stop_trace(DebuggerApp *app)
+{
+    emulator_thread_call(app->emulator, set_recorder_call, NULL);
+    app->is_recording = FALSE;
+}
+
+// The list store is only a view of the breakpoints as the UI set them
+void debugger_app_sync_breakpoints(DebuggerApp *app)
+{
+    BREAKPOINTS *breakpoints = app->nes->breakpoints;
     GtkTreeIter iter;
-    gchar *value;
-    gint type;
-    gboolean valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(breakpoints), &iter);
 
-    while (valid)
+    gtk_list_store_clear(app->breakpoints);
+
+    for (unsigned int i = 0; i < breakpoints->count; i++)
     {
-        gtk_tree_model_get(GTK_TREE_MODEL(breakpoints), &iter, 0, &type, 1, &value, -1);
+        BREAKPOINT *breakpoint = &breakpoints->list[i];
+        gchar *value;
+
+        char name[64];
 
-        if (type == breakpoint_type && address == strtol(value, NULL, 16))
+        if (breakpoint->type == BREAKPOINT_TYPE_ADDRESS && breakpoint->end == breakpoint->address &&
+            debugger_app_symbol_name(app, breakpoint->address, name, sizeof(name)))
         {
-            g_free(value);
-            return TRUE;
+            value = g_strdup_printf("%04X %s", breakpoint->address, name);
+        }
+        else if (breakpoint->type == BREAKPOINT_TYPE_ADDRESS && breakpoint->end == breakpoint->address)
+        {
+            value = g_strdup_printf("%04X", breakpoint->address);
+        }
+        else if (breakpoint->type == BREAKPOINT_TYPE_ADDRESS)
+        {
+            value = g_strdup_printf("%04X-%04X", breakpoint->address, breakpoint->end);
+        }
+        else if (breakpoint->type == BREAKPOINT_TYPE_MEMORY && debugger_app_symbol_name(app, breakpoint->address, name, sizeof(name)))
+        {
+            value = g_strdup_printf("%04X-%04X %c%c%c %s", breakpoint->address, breakpoint->end,
+                                    breakpoint->access & WATCH_READ ? 'R' : '-',
+                                    breakpoint->access & WATCH_WRITE ? 'W' : '-',
+                                    breakpoint->access & WATCH_CHANGE ? 'C' : '-', name);
+        }
+        else
+        {
+            value = g_strdup_printf("%04X-%04X %c%c%c", breakpoint->address, breakpoint->end,
+                                    breakpoint->access & WATCH_READ ? 'R' : '-',
+                                    breakpoint->access & WATCH_WRITE ? 'W' : '-',
+                                    breakpoint->access & WATCH_CHANGE ? 'C' : '-');
         }
 
+        gtk_list_store_append(app->breakpoints, &iter);
+        gtk_list_store_set(app->breakpoints, &iter, 0, breakpoint->type, 1, value,
+                           2, breakpoint->condition ? breakpoint->condition->source : "", 3, breakpoint->hits, -1);
         g_free(value);
-
-        valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(breakpoints), &iter);
     }
+}
 
-    return FALSE;
+void debugger_app_run(DebuggerApp *app)
+{
+    app->is_running = TRUE;
+    emulator_thread_send(app->emulator, EMULATOR_RUN);
 }
 
-static gboolean run_function(DebuggerApp *app)
+void debugger_app_pause(DebuggerApp *app)
 {
-    if (breakpoint_matches(app->breakpoints, BREAKPOINT_TYPE_ADDRESS, app->nes->cpu->pc))
-        return G_SOURCE_REMOVE;
+    emulator_thread_send(app->emulator, EMULATOR_PAUSE);
+}
 
-    execute_instruction(app->nes);
-    update_debugger_window(app);
+void debugger_app_step(DebuggerApp *app)
+{
+    emulator_thread_send(app->emulator, EMULATOR_STEP);
+}
 
-    if (breakpoint_matches(app->breakpoints, BREAKPOINT_TYPE_MEMORY, app->nes->memory->last_read_address) || breakpoint_matches(app->breakpoints, BREAKPOINT_TYPE_MEMORY, app->nes->memory->last_write_address))
-        return G_SOURCE_REMOVE;
+// Steps only publish a snapshot once they are done
+void debugger_app_step_over(DebuggerApp *app)
+{
+    emulator_thread_send(app->emulator, EMULATOR_STEP_OVER);
+}
 
-    return app->is_running ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+void debugger_app_step_out(DebuggerApp *app)
+{
+    emulator_thread_send(app->emulator, EMULATOR_STEP_OUT);
 }
 
-void debugger_app_run(DebuggerApp *app)
+void debugger_app_run_to(DebuggerApp *app, unsigned short address)
 {
-    app->is_running = TRUE;
-    g_idle_add(G_SOURCE_FUNC(run_function), app);
-}
\ No newline at end of file
+    emulator_thread_run_to(app->emulator, address);
+}
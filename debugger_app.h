@@ -4,15 +4,15 @@
 #include <gtk/gtk.h>
 
 #include "nes.h"
+#include "emulator_thread.h"
+#include "refresh_coordinator.h"
+#include "analyzer.h"
+#include "xref.h"
+#include "debug_info.h"
+#include "timing.h"
 
 #define NB_MEMORY_WINDOW 16
 
-enum BREAKPOINT_TYPE
-{
-    BREAKPOINT_TYPE_ADDRESS,
-    BREAKPOINT_TYPE_MEMORY
-};
-
 struct _DebuggerApp
 {
     GtkApplication parent;
@@ -23,9 +23,23 @@ struct _DebuggerApp
     GtkWindow *memory_windows[NB_MEMORY_WINDOW];
     GtkWindow *breakpoint_window;
     GtkWindow *system_palette_window;
-    NES *nes;
+    GtkWindow *watch_window;
+    NES *nes; // last snapshot published by the emulation thread, changes go through emulator
+    EMULATOR_THREAD *emulator;
+    REFRESH_COORDINATOR *refresh; // windows refreshed at the next display frame after a publication
+    guint refresh_tick;           // pending tick callback on the main window, 0 when none
+    ANALYSIS *analysis;           // static analysis of the loaded ROM, NULL when it could not be read
+    XREF_INDEX *xrefs;            // references of the loaded ROM, NULL without analysis
+    TIMING *timing;               // cycle counts of the routines of the loaded ROM, NULL without analysis
+    unsigned int rom_loads;       // ROMs the UI asked the emulation thread to load
+    guint xref_generation;        // bumped whenever xrefs changes
+    DEBUG_INFO *debug_info;       // symbols and source lines of the loaded ROM, empty when none were loaded
+    guint symbol_generation;      // bumped whenever debug_info changes
     GtkListStore *breakpoints;
+    GtkListStore *watches; // source, formatted value and compiled EXPRESSION
     gboolean is_running;
+    gboolean is_recording;     // a binary trace of the emulator is being written
+    TRACE_FILTER trace_filter; // instructions the next recording keeps
 };
 
 G_DECLARE_FINAL_TYPE(DebuggerApp, debugger_app, DEBUGGER, APP, GtkApplication);
@@ -34,6 +48,21 @@ G_DECLARE_FINAL_TYPE(DebuggerApp, debugger_app, DEBUGGER, APP, GtkApplication);
 
 DebuggerApp *debugger_app_new();
 
+void debugger_app_load_rom(DebuggerApp *app, const char *filename);
+int debugger_app_load_cdl(DebuggerApp *app, const char *filename);
+int debugger_app_save_cdl(DebuggerApp *app, const char *filename);
+int debugger_app_load_debug_info(DebuggerApp *app, const char *filename);
+int debugger_app_start_trace(DebuggerApp *app, const char *filename);
+void debugger_app_stop_trace(DebuggerApp *app);
+int debugger_app_location(DebuggerApp *app, unsigned short address);
+int debugger_app_symbol_name(DebuggerApp *app, unsigned short address, char *name, unsigned int size);
+int debugger_app_parse_address(DebuggerApp *app, const char *text, unsigned short *address, unsigned int *size, const char **end);
 void debugger_app_run(DebuggerApp *app);
+void debugger_app_pause(DebuggerApp *app);
+void debugger_app_step(DebuggerApp *app);
+void debugger_app_step_over(DebuggerApp *app);
+void debugger_app_step_out(DebuggerApp *app);
+void debugger_app_run_to(DebuggerApp *app, unsigned short address);
+void debugger_app_sync_breakpoints(DebuggerApp *app);
 
 #endif
\ No newline at end of file
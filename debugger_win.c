@@ -9,6 +9,8 @@
 #include "disassembler_win.h"
 #include "breakpoint_win.h"
 #include "system_palette_win.h"
+#include "watch_win.h"
+#include "trace_win.h"
 #include "disassembler.h"
 
 struct _DebuggerAppWindow
@@ -30,12 +32,22 @@ struct _DebuggerAppWindow
     GtkToolButton *step_button;
     GtkToolButton *run_button;
     GtkToolButton *pause_button;
+    GtkToolButton *step_over_button;
+    GtkToolButton *step_out_button;
+    GtkToolButton *run_to_button;
+    GtkEntry *run_to_entry;
+    GtkMenuItem *load_cdl_menu_item;
+    GtkMenuItem *save_cdl_menu_item;
+    GtkMenuItem *load_debug_info_menu_item;
+    GtkMenuItem *record_trace_menu_item;
+    GtkMenuItem *open_trace_menu_item;
     GtkMenuItem *ppu_registers_window_menu_item;
     GtkMenuItem *ppu_tables_window_menu_item;
     GtkMenuItem *oam_window_menu_item;
     GtkMenuItem *memory_window_menu_item;
     GtkMenuItem *disassembler_window_menu_item;
     GtkMenuItem *breakpoint_menu_item;
+    GtkMenuItem *watch_menu_item;
     GtkMenuItem *system_palette_menu_item;
     GtkLabel *start_address_label;
     GtkLabel *nmi_handler_address;
@@ -79,53 +91,50 @@ static void update_status_flags(DebuggerAppWindow *win, unsigned char flags)
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(win->c_flag_check_button), flags & 0x01);
 }
 
-static void update_next_instruction(DebuggerAppWindow *win, NES *nes)
+// The emulator stops on an instruction it cannot run, the label tells why it does not go further
+static void update_next_instruction(DebuggerAppWindow *win, NES *nes, int illegal_pc)
 {
     INSTRUCTION instruction;
+    unsigned char bytes[3];
 
-    dis_parse_instruction(memory_read_byte(nes->memory, nes->cpu->pc),
-                          memory_read_byte(nes->memory, nes->cpu->pc + 1),
-                          memory_read_byte(nes->memory, nes->cpu->pc + 2),
-                          &instruction);
+    nes_peek_range(nes, WATCH_BUS_CPU, nes->cpu->pc, bytes, sizeof(bytes));
+    dis_parse_instruction(bytes[0], bytes[1], bytes[2], &instruction);
 
     char str[32];
-    dis_instruction_to_str(&instruction, nes->cpu->pc, str);
-    gtk_label_set_text(win->next_instruction_label, str);
-}
+    dis_instruction_to_str(&instruction, nes->cpu->pc, str, sizeof(str));
 
-static void update_memory_windows(DebuggerApp *app)
-{
-    for (int i = 0; i < NB_MEMORY_WINDOW; i++)
+    if (illegal_pc == nes->cpu->pc)
     {
-        if (app->memory_windows[i])
-        {
-            update_memory_window(MEMORY_WINDOW(app->memory_windows[i]), app->nes->memory);
-        }
+        gchar *text = g_strdup_printf("%s  (illegal or not emulated opcode $%02X, stopped)", str, bytes[0]);
+        gtk_label_set_text(win->next_instruction_label, text);
+        g_free(text);
+        return;
     }
+
+    gtk_label_set_text(win->next_instruction_label, str);
 }
 
-void update_debugger_window(DebuggerApp *app)
+// Only the main window, the other windows register their own refresh
+static void refresh_debugger_window(gpointer view, gpointer data)
 {
-    DebuggerAppWindow *debugger_window = DEBUGGER_APP_WINDOW(app->win);
+    DebuggerAppWindow *debugger_window = DEBUGGER_APP_WINDOW(view);
+    DebuggerApp *app = data;
 
     update_registers(debugger_window, app->nes);
     update_status_flags(debugger_window, app->nes->cpu->registerP);
-    update_next_instruction(debugger_window, app->nes);
-    update_ppu_registers_window(PPU_REGISTERS_WINDOW(app->ppu_registers_window), app->nes->ppu);
-    update_memory_windows(app);
-    update_ppu_tables_window(PPU_TABLES_WINDOW(app->ppu_tables_window), app->nes->ppu);
-    oam_window_update(app->oam_window, app->nes->ppu);
+    update_next_instruction(debugger_window, app->nes, app->emulator->view.illegal_pc);
 
     gchar *str;
-    str = g_strdup_printf("%04X", memory_read_word(app->nes->memory, 0xfffc));
+    str = g_strdup_printf("%04X", nes_peek_word(app->nes, 0xfffc));
     gtk_label_set_text(debugger_window->start_address_label, str);
     g_free(str);
 
-    str = g_strdup_printf("%04X", memory_read_word(app->nes->memory, 0xfffa));
+    str = g_strdup_printf("%04X", nes_peek_word(app->nes, 0xfffa));
     gtk_label_set_text(debugger_window->nmi_handler_address, str);
     g_free(str);
 
-    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(debugger_window->nmi_simulation_check_button), app->nes->interrupt_NMI);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(debugger_window->nmi_simulation_check_button),
+                                 scheduler_is_scheduled(app->nes->scheduler, EVENT_NMI));
 }
 
 static void open_rom(GtkWidget *widget, DebuggerApp *app)
@@ -142,9 +151,7 @@ static void open_rom(GtkWidget *widget, DebuggerApp *app)
     {
         char *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
         g_print("%s\n", filename);
-        load_rom(app->nes, filename);
-
-        update_debugger_window(app);
+        debugger_app_load_rom(app, filename);
     }
     else
     {
@@ -154,11 +161,166 @@ static void open_rom(GtkWidget *widget, DebuggerApp *app)
     gtk_widget_destroy(dialog);
 }
 
+// The chosen file, NULL when cancelled, to be freed with g_free
+static char *choose_file(const char *title, GtkFileChooserAction action, const char *accept_label)
+{
+    GtkWidget *dialog = gtk_file_chooser_dialog_new(title, NULL, action,
+                                                    "_Cancel", GTK_RESPONSE_CANCEL, accept_label, GTK_RESPONSE_ACCEPT, NULL);
+    char *filename = NULL;
+
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog), TRUE);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+    {
+        filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+    }
+
+    gtk_widget_destroy(dialog);
+
+    return filename;
+}
+
+static void load_cdl(GtkMenuItem *menu_item, DebuggerApp *app)
+{
+    char *filename = choose_file("Load code/data log", GTK_FILE_CHOOSER_ACTION_OPEN, "_Open");
+
+    if (filename && debugger_app_load_cdl(app, filename) < 0)
+    {
+        g_printerr("Cannot load %s, it must be the .cdl of the loaded ROM\n", filename);
+    }
+
+    g_free(filename);
+}
+
+static void save_cdl(GtkMenuItem *menu_item, DebuggerApp *app)
+{
+    char *filename = choose_file("Save code/data log", GTK_FILE_CHOOSER_ACTION_SAVE, "_Save");
+
+    if (filename && debugger_app_save_cdl(app, filename) < 0)
+    {
+        g_printerr("Cannot write %s\n", filename);
+    }
+
+    g_free(filename);
+}
+
+static void load_debug_info(GtkMenuItem *menu_item, DebuggerApp *app)
+{
+    char *filename = choose_file("Load symbols", GTK_FILE_CHOOSER_ACTION_OPEN, "_Open");
+
+    if (filename && debugger_app_load_debug_info(app, filename) < 0)
+    {
+        g_printerr("Cannot load %s, it must be a .dbg, .nl or .mlb file\n", filename);
+    }
+
+    g_free(filename);
+}
+
+// Asks which instructions to record, starting from the last filter. Returns FALSE when cancelled.
+static gboolean choose_trace_filter(DebuggerApp *app)
+{
+    GtkWidget *dialog = gtk_dialog_new_with_buttons("Trace filter", NULL, GTK_DIALOG_MODAL,
+                                                    "_Cancel", GTK_RESPONSE_CANCEL, "_Record", GTK_RESPONSE_ACCEPT, NULL);
+    GtkWidget *content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    GtkWidget *entry = gtk_entry_new();
+    char text[256];
+    gboolean accepted = FALSE;
+
+    trace_filter_to_str(&app->trace_filter, text, sizeof(text));
+    gtk_entry_set_text(GTK_ENTRY(entry), text);
+    gtk_entry_set_width_chars(GTK_ENTRY(entry), 60);
+    gtk_entry_set_placeholder_text(GTK_ENTRY(entry), "everything");
+    gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+    gtk_widget_set_tooltip_text(entry, "Terms separated by spaces, each optional: pc=8000-80FF,C000 bank=1 depth=0-2 "
+                                       "context=main|nmi frames=100-200");
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+    gtk_container_add(GTK_CONTAINER(content), entry);
+    gtk_widget_show(entry);
+
+    // Stays open until the filter reads
+    while (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+    {
+        if (trace_filter_parse(&app->trace_filter, gtk_entry_get_text(GTK_ENTRY(entry))) == 0)
+        {
+            accepted = TRUE;
+            break;
+        }
+
+        gtk_entry_set_icon_from_icon_name(GTK_ENTRY(entry), GTK_ENTRY_ICON_SECONDARY, "dialog-error");
+    }
+
+    gtk_widget_destroy(dialog);
+
+    return accepted;
+}
+
+// Starts recording a binary trace, or stops the one being recorded
+static void record_trace(GtkMenuItem *menu_item, DebuggerApp *app)
+{
+    if (app->is_recording)
+    {
+        debugger_app_stop_trace(app);
+        gtk_menu_item_set_label(menu_item, "Record trace...");
+        return;
+    }
+
+    char *filename = choose_file("Record trace", GTK_FILE_CHOOSER_ACTION_SAVE, "_Record");
+
+    if (filename && !choose_trace_filter(app))
+    {
+        g_free(filename);
+        return;
+    }
+
+    if (filename && debugger_app_start_trace(app, filename) < 0)
+    {
+        g_printerr("Cannot create %s\n", filename);
+    }
+    else if (filename)
+    {
+        gtk_menu_item_set_label(menu_item, "Stop recording trace");
+    }
+
+    g_free(filename);
+}
+
+static void open_trace_window(GtkMenuItem *menu_item, DebuggerApp *app)
+{
+    char *filename = choose_file("Open trace", GTK_FILE_CHOOSER_ACTION_OPEN, "_Open");
+    TraceWindow *window = filename ? trace_window_new(filename) : NULL;
+
+    if (filename && !window)
+    {
+        g_printerr("Cannot open %s, it must be a trace whose recording was stopped\n", filename);
+    }
+    else if (window)
+    {
+        gtk_widget_show_all(GTK_WIDGET(window));
+    }
+
+    g_free(filename);
+}
+
 static void step(GtkToolButton *button, DebuggerApp *app)
 {
-    execute_instruction(app->nes);
+    debugger_app_step(app);
+}
 
-    update_debugger_window(app);
+static void step_over(GtkToolButton *button, DebuggerApp *app)
+{
+    debugger_app_step_over(app);
+}
+
+static void step_out(GtkToolButton *button, DebuggerApp *app)
+{
+    debugger_app_step_out(app);
+}
+
+static void run_to(GtkWidget *widget, DebuggerApp *app)
+{
+    DebuggerAppWindow *debugger_window = DEBUGGER_APP_WINDOW(app->win);
+
+    debugger_app_run_to(app, strtol(gtk_entry_get_text(debugger_window->run_to_entry), NULL, 16));
 }
 
 static void run_command_cb(GtkToolButton *button, DebuggerApp *app)
@@ -168,7 +330,7 @@ static void run_command_cb(GtkToolButton *button, DebuggerApp *app)
 
 static void pause_command_cb(GtkToolButton *button, DebuggerApp *app)
 {
-    app->is_running = FALSE;
+    debugger_app_pause(app);
 }
 
 static void open_ppu_registers_window(GtkMenuItem *menu_item, DebuggerApp *app)
@@ -196,7 +358,7 @@ static void open_ppu_tables_window(GtkMenuItem *menu_item, DebuggerApp *app)
     app->ppu_tables_window = GTK_WINDOW(ppu_tables_window_new(app));
 
     gtk_widget_show_all(GTK_WIDGET(app->ppu_tables_window));
-    update_ppu_tables_window(PPU_TABLES_WINDOW(app->ppu_tables_window), app->nes->ppu);
+    update_ppu_tables_window(PPU_TABLES_WINDOW(app->ppu_tables_window), app->nes);
 }
 
 static void open_memory_window(GtkMenuItem *menu_item, DebuggerApp *app)
@@ -214,7 +376,7 @@ static void open_memory_window(GtkMenuItem *menu_item, DebuggerApp *app)
     app->memory_windows[i] = GTK_WINDOW(memory_window_new(app));
 
     gtk_widget_show_all(GTK_WIDGET(app->memory_windows[i]));
-    update_memory_window(MEMORY_WINDOW(app->memory_windows[i]), app->nes->memory);
+    update_memory_window(MEMORY_WINDOW(app->memory_windows[i]), app->nes);
 }
 
 static void open_breakpoint_window(GtkMenuItem *menu_item, DebuggerApp *app)
@@ -230,6 +392,20 @@ static void open_breakpoint_window(GtkMenuItem *menu_item, DebuggerApp *app)
     gtk_widget_show_all(GTK_WIDGET(app->breakpoint_window));
 }
 
+static void open_watch_window(GtkMenuItem *menu_item, DebuggerApp *app)
+{
+    if (app->watch_window)
+    {
+        gtk_window_present(app->watch_window);
+        return;
+    }
+
+    app->watch_window = GTK_WINDOW(watch_window_new(app));
+
+    gtk_widget_show_all(GTK_WIDGET(app->watch_window));
+    update_watch_window(WATCH_WINDOW(app->watch_window), app);
+}
+
 static void open_system_palette_window(GtkMenuItem *menu_item, DebuggerApp *app)
 {
     if (app->system_palette_window)
@@ -261,9 +437,20 @@ static void open_oam_window(GtkMenuItem *menu_item, DebuggerApp *app)
     gtk_widget_show_all(GTK_WIDGET(app->oam_window));
 }
 
+static void request_nmi_call(NES *nes, void *data)
+{
+    nes_request_nmi(nes);
+}
+
 static void simulate_nmi(GtkCheckButton *button, DebuggerApp *app)
 {
-    app->nes->interrupt_NMI = 1;
+    // Refreshing the window sets the button to the snapshot value, only a user click requests an NMI
+    if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button)) == scheduler_is_scheduled(app->nes->scheduler, EVENT_NMI))
+    {
+        return;
+    }
+
+    emulator_thread_call(app->emulator, request_nmi_call, NULL);
 }
 
 static void debugger_app_window_init(DebuggerAppWindow *window)
@@ -291,12 +478,22 @@ static void debugger_app_window_class_init(DebuggerAppWindowClass *class)
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, step_button);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, run_button);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, pause_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, step_over_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, step_out_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, run_to_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, run_to_entry);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, load_cdl_menu_item);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, save_cdl_menu_item);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, load_debug_info_menu_item);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, record_trace_menu_item);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, open_trace_menu_item);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, ppu_registers_window_menu_item);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, ppu_tables_window_menu_item);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, oam_window_menu_item);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, memory_window_menu_item);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, disassembler_window_menu_item);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, breakpoint_menu_item);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, watch_menu_item);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, system_palette_menu_item);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, start_address_label);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DebuggerAppWindow, nmi_handler_address);
@@ -311,14 +508,27 @@ DebuggerAppWindow *debugger_app_window_new(DebuggerApp *app)
     g_signal_connect(window->step_button, "clicked", G_CALLBACK(step), app);
     g_signal_connect(window->run_button, "clicked", G_CALLBACK(run_command_cb), app);
     g_signal_connect(window->pause_button, "clicked", G_CALLBACK(pause_command_cb), app);
+    g_signal_connect(window->step_over_button, "clicked", G_CALLBACK(step_over), app);
+    g_signal_connect(window->step_out_button, "clicked", G_CALLBACK(step_out), app);
+    g_signal_connect(window->run_to_button, "clicked", G_CALLBACK(run_to), app);
+    g_signal_connect(window->run_to_entry, "activate", G_CALLBACK(run_to), app);
+    g_signal_connect(window->load_cdl_menu_item, "activate", G_CALLBACK(load_cdl), app);
+    g_signal_connect(window->save_cdl_menu_item, "activate", G_CALLBACK(save_cdl), app);
+    g_signal_connect(window->load_debug_info_menu_item, "activate", G_CALLBACK(load_debug_info), app);
+    g_signal_connect(window->record_trace_menu_item, "activate", G_CALLBACK(record_trace), app);
+    g_signal_connect(window->open_trace_menu_item, "activate", G_CALLBACK(open_trace_window), app);
     g_signal_connect(window->ppu_registers_window_menu_item, "activate", G_CALLBACK(open_ppu_registers_window), app);
     g_signal_connect(window->ppu_tables_window_menu_item, "activate", G_CALLBACK(open_ppu_tables_window), app);
     g_signal_connect(window->oam_window_menu_item, "activate", G_CALLBACK(open_oam_window), app);
     g_signal_connect(window->memory_window_menu_item, "activate", G_CALLBACK(open_memory_window), app);
     g_signal_connect(window->disassembler_window_menu_item, "activate", G_CALLBACK(open_disassembler_window), app);
     g_signal_connect(window->breakpoint_menu_item, "activate", G_CALLBACK(open_breakpoint_window), app);
+    g_signal_connect(window->watch_menu_item, "activate", G_CALLBACK(open_watch_window), app);
     g_signal_connect(window->system_palette_menu_item, "activate", G_CALLBACK(open_system_palette_window), app);
     g_signal_connect(window->nmi_simulation_check_button, "clicked", G_CALLBACK(simulate_nmi), app);
 
+    // The next instruction is read at pc, any change of the code there comes with a change of the CPU state
+    refresh_coordinator_register(app->refresh, window, STATE_CPU | STATE_PRG_ROM | STATE_SCHEDULER, refresh_debugger_window);
+
     return window;
 }
@@ -10,6 +10,4 @@ G_DECLARE_FINAL_TYPE(DebuggerAppWindow, debugger_app_window, DEBUGGER, APP_WINDO
 
 DebuggerAppWindow *debugger_app_window_new(DebuggerApp *app);
 
-void update_debugger_window(DebuggerApp *app);
-
 #endif
\ No newline at end of file
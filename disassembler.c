@@ -1,255 +1,395 @@
-#include <stdlib.h>
-#include <stdio.h>
 #include <string.h>
 
 #include "disassembler.h"
+#include "cpu.h"
 
-INSTRUCTION_INFO INST_01 = {"ORA", INDEXED_INDIRECT};
-INSTRUCTION_INFO INST_05 = {"ORA", ZERO_PAGE};
-INSTRUCTION_INFO INST_06 = {"ASL", ZERO_PAGE};
-INSTRUCTION_INFO INST_09 = {"ORA", IMMEDIATE};
-INSTRUCTION_INFO INST_0A = {"ASL", ACCUMULATOR};
-INSTRUCTION_INFO INST_0D = {"ORA", ABSOLUTE};
-INSTRUCTION_INFO INST_0E = {"ASL", ABSOLUTE};
-INSTRUCTION_INFO INST_10 = {"BPL", RELATIVE};
-INSTRUCTION_INFO INST_11 = {"ORA", INDIRECT_INDEXED};
-INSTRUCTION_INFO INST_15 = {"ORA", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_16 = {"ASL", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_18 = {"CLC", IMPLIED};
-INSTRUCTION_INFO INST_19 = {"ORA", ABSOLUTE_Y};
-INSTRUCTION_INFO INST_1D = {"ORA", ABSOLUTE_X};
-INSTRUCTION_INFO INST_1E = {"ASL", ABSOLUTE_X};
-INSTRUCTION_INFO INST_20 = {"JSR", ABSOLUTE};
-INSTRUCTION_INFO INST_21 = {"AND", INDEXED_INDIRECT};
-INSTRUCTION_INFO INST_25 = {"AND", ZERO_PAGE};
-INSTRUCTION_INFO INST_29 = {"AND", IMMEDIATE};
-INSTRUCTION_INFO INST_2D = {"AND", ABSOLUTE};
-INSTRUCTION_INFO INST_31 = {"AND", INDIRECT_INDEXED};
-INSTRUCTION_INFO INST_35 = {"AND", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_38 = {"SEC", IMPLIED};
-INSTRUCTION_INFO INST_39 = {"AND", ABSOLUTE_Y};
-INSTRUCTION_INFO INST_3D = {"AND", ABSOLUTE_X};
-INSTRUCTION_INFO INST_40 = {"RTI", IMPLIED};
-INSTRUCTION_INFO INST_41 = {"EOR", INDEXED_INDIRECT};
-INSTRUCTION_INFO INST_45 = {"EOR", ZERO_PAGE};
-INSTRUCTION_INFO INST_46 = {"LSR", ZERO_PAGE};
-INSTRUCTION_INFO INST_48 = {"PHA", IMPLIED};
-INSTRUCTION_INFO INST_49 = {"EOR", IMMEDIATE};
-INSTRUCTION_INFO INST_4A = {"LSR", ACCUMULATOR};
-INSTRUCTION_INFO INST_4C = {"JMP", ABSOLUTE};
-INSTRUCTION_INFO INST_4D = {"EOR", ABSOLUTE};
-INSTRUCTION_INFO INST_51 = {"EOR", INDIRECT_INDEXED};
-INSTRUCTION_INFO INST_55 = {"EOR", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_59 = {"EOR", ABSOLUTE_Y};
-INSTRUCTION_INFO INST_5D = {"EOR", ABSOLUTE_X};
-INSTRUCTION_INFO INST_60 = {"RTS", IMPLIED};
-INSTRUCTION_INFO INST_61 = {"ADC", INDEXED_INDIRECT};
-INSTRUCTION_INFO INST_65 = {"ADC", ZERO_PAGE};
-INSTRUCTION_INFO INST_66 = {"ROR", ZERO_PAGE};
-INSTRUCTION_INFO INST_68 = {"PLA", IMPLIED};
-INSTRUCTION_INFO INST_69 = {"ADC", IMMEDIATE};
-INSTRUCTION_INFO INST_6A = {"ROR", ACCUMULATOR};
-INSTRUCTION_INFO INST_6C = {"JMP", INDIRECT};
-INSTRUCTION_INFO INST_6D = {"ADC", ABSOLUTE};
-INSTRUCTION_INFO INST_6E = {"ROR", ABSOLUTE};
-INSTRUCTION_INFO INST_71 = {"ADC", INDIRECT_INDEXED};
-INSTRUCTION_INFO INST_75 = {"ADC", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_76 = {"ROR", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_78 = {"SEI", IMPLIED};
-INSTRUCTION_INFO INST_79 = {"ADC", ABSOLUTE_Y};
-INSTRUCTION_INFO INST_7D = {"ADC", ABSOLUTE_X};
-INSTRUCTION_INFO INST_7E = {"ROR", ABSOLUTE_X};
-INSTRUCTION_INFO INST_81 = {"STA", INDEXED_INDIRECT};
-INSTRUCTION_INFO INST_84 = {"STY", ZERO_PAGE};
-INSTRUCTION_INFO INST_85 = {"STA", ZERO_PAGE};
-INSTRUCTION_INFO INST_86 = {"STX", ZERO_PAGE};
-INSTRUCTION_INFO INST_88 = {"DEY", IMPLIED};
-INSTRUCTION_INFO INST_8A = {"TXA", IMPLIED};
-INSTRUCTION_INFO INST_8C = {"STY", ABSOLUTE};
-INSTRUCTION_INFO INST_8D = {"STA", ABSOLUTE};
-INSTRUCTION_INFO INST_8E = {"STX", ABSOLUTE};
-INSTRUCTION_INFO INST_90 = {"BCC", RELATIVE};
-INSTRUCTION_INFO INST_91 = {"STA", INDIRECT_INDEXED};
-INSTRUCTION_INFO INST_94 = {"STY", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_95 = {"STA", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_96 = {"STX", ZERO_PAGE_Y};
-INSTRUCTION_INFO INST_98 = {"TYA", IMPLIED};
-INSTRUCTION_INFO INST_99 = {"STA", ABSOLUTE_Y};
-INSTRUCTION_INFO INST_9A = {"TXS", IMPLIED};
-INSTRUCTION_INFO INST_9D = {"STA", ABSOLUTE_X};
-INSTRUCTION_INFO INST_A0 = {"LDY", IMMEDIATE};
-INSTRUCTION_INFO INST_A1 = {"LDA", INDEXED_INDIRECT};
-INSTRUCTION_INFO INST_A2 = {"LDX", IMMEDIATE};
-INSTRUCTION_INFO INST_A4 = {"LDY", ZERO_PAGE};
-INSTRUCTION_INFO INST_A5 = {"LDA", ZERO_PAGE};
-INSTRUCTION_INFO INST_A6 = {"LDX", ZERO_PAGE};
-INSTRUCTION_INFO INST_A8 = {"TAY", IMPLIED};
-INSTRUCTION_INFO INST_A9 = {"LDA", IMMEDIATE};
-INSTRUCTION_INFO INST_AA = {"TAX", IMPLIED};
-INSTRUCTION_INFO INST_AC = {"LDY", ABSOLUTE};
-INSTRUCTION_INFO INST_AD = {"LDA", ABSOLUTE};
-INSTRUCTION_INFO INST_AE = {"LDX", ABSOLUTE};
-INSTRUCTION_INFO INST_B0 = {"BCS", RELATIVE};
-INSTRUCTION_INFO INST_B1 = {"LDA", INDIRECT_INDEXED};
-INSTRUCTION_INFO INST_B4 = {"LDY", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_B5 = {"LDA", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_B6 = {"LDX", ZERO_PAGE_Y};
-INSTRUCTION_INFO INST_B9 = {"LDA", ABSOLUTE_Y};
-INSTRUCTION_INFO INST_BC = {"LDY", ABSOLUTE_X};
-INSTRUCTION_INFO INST_BD = {"LDA", ABSOLUTE_X};
-INSTRUCTION_INFO INST_BE = {"LDX", ABSOLUTE_Y};
-INSTRUCTION_INFO INST_C0 = {"CPY", IMMEDIATE};
-INSTRUCTION_INFO INST_C1 = {"CMP", INDEXED_INDIRECT};
-INSTRUCTION_INFO INST_C4 = {"CPY", ZERO_PAGE};
-INSTRUCTION_INFO INST_C5 = {"CMP", ZERO_PAGE};
-INSTRUCTION_INFO INST_C6 = {"DEC", ZERO_PAGE};
-INSTRUCTION_INFO INST_C8 = {"INY", IMPLIED};
-INSTRUCTION_INFO INST_C9 = {"CMP", IMMEDIATE};
-INSTRUCTION_INFO INST_CA = {"DEX", IMPLIED};
-INSTRUCTION_INFO INST_CC = {"CPY", ABSOLUTE};
-INSTRUCTION_INFO INST_CD = {"CMP", ABSOLUTE};
-INSTRUCTION_INFO INST_CE = {"DEC", ABSOLUTE};
-INSTRUCTION_INFO INST_D0 = {"BNE", RELATIVE};
-INSTRUCTION_INFO INST_D1 = {"CMP", INDIRECT_INDEXED};
-INSTRUCTION_INFO INST_D5 = {"CMP", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_D6 = {"DEC", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_D8 = {"CLD", IMPLIED};
-INSTRUCTION_INFO INST_D9 = {"CMP", ABSOLUTE_Y};
-INSTRUCTION_INFO INST_DD = {"CMP", ABSOLUTE_X};
-INSTRUCTION_INFO INST_DE = {"DEC", ABSOLUTE_X};
-INSTRUCTION_INFO INST_E0 = {"CPX", IMMEDIATE};
-INSTRUCTION_INFO INST_E1 = {"SBC", INDEXED_INDIRECT};
-INSTRUCTION_INFO INST_E4 = {"CPX", ZERO_PAGE};
-INSTRUCTION_INFO INST_E5 = {"SBC", ZERO_PAGE};
-INSTRUCTION_INFO INST_E6 = {"INC", ZERO_PAGE};
-INSTRUCTION_INFO INST_E8 = {"INX", IMPLIED};
-INSTRUCTION_INFO INST_E9 = {"SBC", IMMEDIATE};
-INSTRUCTION_INFO INST_EC = {"CPX", ABSOLUTE};
-INSTRUCTION_INFO INST_ED = {"SBC", ABSOLUTE};
-INSTRUCTION_INFO INST_EE = {"INC", ABSOLUTE};
-INSTRUCTION_INFO INST_F0 = {"BEQ", RELATIVE};
-INSTRUCTION_INFO INST_F1 = {"SBC", INDIRECT_INDEXED};
-INSTRUCTION_INFO INST_F5 = {"SBC", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_F6 = {"INC", ZERO_PAGE_X};
-INSTRUCTION_INFO INST_F9 = {"SBC", ABSOLUTE_Y};
-INSTRUCTION_INFO INST_FD = {"SBC", ABSOLUTE_X};
-INSTRUCTION_INFO INST_FE = {"INC", ABSOLUTE_X};
-
-INSTRUCTION_INFO *instructions_info[] = {
-    &INST_01, 0, 0, 0, 0, &INST_05, 0, 0, 0, 0, &INST_0A, 0, 0, 0, 0, 0,
-    &INST_10, 0, 0, 0, 0, 0, 0, 0, &INST_18, 0, 0, 0, 0, 0, 0, 0,
-    &INST_20, 0, 0, 0, 0, &INST_25, 0, 0, 0, &INST_29, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, &INST_38, 0, 0, 0, 0, 0, 0, 0,
-    &INST_40, 0, 0, 0, 0, 0, &INST_46, 0, &INST_48, &INST_49, &INST_4A, 0, &INST_4C, &INST_4D, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    &INST_60, 0, 0, 0, 0, &INST_65, &INST_66, 0, &INST_68, &INST_69, 0, 0, &INST_6C, &INST_6D, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, &INST_78, 0, 0, 0, 0, 0, 0, 0,
-    0, &INST_81, 0, 0, &INST_84, &INST_85, &INST_86, 0, &INST_88, 0, &INST_8A, 0, 0, &INST_8D, 0, 0,
-    &INST_90, &INST_91, 0, 0, 0, 0, 0, 0, &INST_98, &INST_99, &INST_9A, 0, 0, &INST_9D, 0, 0,
-    &INST_A0, 0, &INST_A2, 0, &INST_A4, &INST_A5, &INST_A6, 0, &INST_A8, &INST_A9, &INST_AA, 0, 0, &INST_AD, 0, 0,
-    &INST_B0, &INST_B1, 0, 0, &INST_B4, &INST_B5, &INST_B6, 0, 0, &INST_B9, 0, 0, &INST_BC, &INST_BD, &INST_BE, 0,
-    &INST_C0, 0, 0, 0, &INST_C4, &INST_C5, &INST_C6, 0, &INST_C8, &INST_C9, &INST_CA, 0, 0, 0, 0, 0,
-    &INST_D0, 0, 0, 0, 0, 0, 0, 0, &INST_D8, &INST_D9, 0, 0, 0, 0, 0, 0,
-    &INST_E0, 0, 0, 0, &INST_E4, &INST_E5, &INST_E6, 0, &INST_E8, &INST_E9, 0, 0, 0, 0, 0, 0,
-    &INST_F0, &INST_F1, 0, 0, 0, &INST_F5, &INST_F6, 0, 0, &INST_F9, 0, 0, 0, &INST_FD, &INST_FE, 0};
-
-void dis_parse_instruction(unsigned char byte1, unsigned char byte2, unsigned char byte3,
-                           INSTRUCTION *instruction)
+#define ALL_FLAGS (FLAG_N | FLAG_V | FLAG_D | FLAG_I | FLAG_Z | FLAG_C)
+
+const char MNEMONIC_NAMES[NB_MNEMONICS][4] = {
+    "", "ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI", "BNE", "BPL", "BRK", "BVC", "BVS", "CLC", "CLD", "CLI",
+    "CLV", "CMP", "CPX", "CPY", "DEC", "DEX", "DEY", "EOR", "INC", "INX", "INY", "JMP", "JSR", "LDA", "LDX", "LDY",
+    "LSR", "NOP", "ORA", "PHA", "PHP", "PLA", "PLP", "ROL", "ROR", "RTI", "RTS", "SBC", "SEC", "SED", "SEI", "STA",
+    "STX", "STY", "TAX", "TAY", "TSX", "TXA", "TXS", "TYA"};
+
+#define UNOFFICIAL {MNEMONIC_NONE, IMPLIED, 1, 0, 0, 0, 0, 0} // decoded as a single unknown byte
+
+// Mnemonic, mode, length, cycles, extra cycles, flags read, flags written, access
+const OPCODE_INFO OPCODES[256] = {
+    [0x00] = {MNEMONIC_BRK, IMPLIED, 1, 7, 0, ALL_FLAGS, FLAG_I, 0},
+    [0x01] = {MNEMONIC_ORA, INDEXED_INDIRECT, 2, 6, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x02] = UNOFFICIAL,
+    [0x03] = UNOFFICIAL,
+    [0x04] = UNOFFICIAL,
+    [0x05] = {MNEMONIC_ORA, ZERO_PAGE, 2, 3, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x06] = {MNEMONIC_ASL, ZERO_PAGE, 2, 5, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x07] = UNOFFICIAL,
+    [0x08] = {MNEMONIC_PHP, IMPLIED, 1, 3, 0, ALL_FLAGS, 0, 0},
+    [0x09] = {MNEMONIC_ORA, IMMEDIATE, 2, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0x0a] = {MNEMONIC_ASL, ACCUMULATOR, 1, 2, 0, 0, FLAG_N | FLAG_Z | FLAG_C, 0},
+    [0x0b] = UNOFFICIAL,
+    [0x0c] = UNOFFICIAL,
+    [0x0d] = {MNEMONIC_ORA, ABSOLUTE, 3, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x0e] = {MNEMONIC_ASL, ABSOLUTE, 3, 6, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x0f] = UNOFFICIAL,
+    [0x10] = {MNEMONIC_BPL, RELATIVE, 2, 2, 2, FLAG_N, 0, ACCESS_JUMP},
+    [0x11] = {MNEMONIC_ORA, INDIRECT_INDEXED, 2, 5, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x12] = UNOFFICIAL,
+    [0x13] = UNOFFICIAL,
+    [0x14] = UNOFFICIAL,
+    [0x15] = {MNEMONIC_ORA, ZERO_PAGE_X, 2, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x16] = {MNEMONIC_ASL, ZERO_PAGE_X, 2, 6, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x17] = UNOFFICIAL,
+    [0x18] = {MNEMONIC_CLC, IMPLIED, 1, 2, 0, 0, FLAG_C, 0},
+    [0x19] = {MNEMONIC_ORA, ABSOLUTE_Y, 3, 4, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x1a] = UNOFFICIAL,
+    [0x1b] = UNOFFICIAL,
+    [0x1c] = UNOFFICIAL,
+    [0x1d] = {MNEMONIC_ORA, ABSOLUTE_X, 3, 4, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x1e] = {MNEMONIC_ASL, ABSOLUTE_X, 3, 7, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x1f] = UNOFFICIAL,
+    [0x20] = {MNEMONIC_JSR, ABSOLUTE, 3, 6, 0, 0, 0, ACCESS_CALL},
+    [0x21] = {MNEMONIC_AND, INDEXED_INDIRECT, 2, 6, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x22] = UNOFFICIAL,
+    [0x23] = UNOFFICIAL,
+    [0x24] = {MNEMONIC_BIT, ZERO_PAGE, 2, 3, 0, 0, FLAG_N | FLAG_V | FLAG_Z, ACCESS_READ},
+    [0x25] = {MNEMONIC_AND, ZERO_PAGE, 2, 3, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x26] = {MNEMONIC_ROL, ZERO_PAGE, 2, 5, 0, FLAG_C, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x27] = UNOFFICIAL,
+    [0x28] = {MNEMONIC_PLP, IMPLIED, 1, 4, 0, 0, ALL_FLAGS, 0},
+    [0x29] = {MNEMONIC_AND, IMMEDIATE, 2, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0x2a] = {MNEMONIC_ROL, ACCUMULATOR, 1, 2, 0, FLAG_C, FLAG_N | FLAG_Z | FLAG_C, 0},
+    [0x2b] = UNOFFICIAL,
+    [0x2c] = {MNEMONIC_BIT, ABSOLUTE, 3, 4, 0, 0, FLAG_N | FLAG_V | FLAG_Z, ACCESS_READ},
+    [0x2d] = {MNEMONIC_AND, ABSOLUTE, 3, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x2e] = {MNEMONIC_ROL, ABSOLUTE, 3, 6, 0, FLAG_C, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x2f] = UNOFFICIAL,
+    [0x30] = {MNEMONIC_BMI, RELATIVE, 2, 2, 2, FLAG_N, 0, ACCESS_JUMP},
+    [0x31] = {MNEMONIC_AND, INDIRECT_INDEXED, 2, 5, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x32] = UNOFFICIAL,
+    [0x33] = UNOFFICIAL,
+    [0x34] = UNOFFICIAL,
+    [0x35] = {MNEMONIC_AND, ZERO_PAGE_X, 2, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x36] = {MNEMONIC_ROL, ZERO_PAGE_X, 2, 6, 0, FLAG_C, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x37] = UNOFFICIAL,
+    [0x38] = {MNEMONIC_SEC, IMPLIED, 1, 2, 0, 0, FLAG_C, 0},
+    [0x39] = {MNEMONIC_AND, ABSOLUTE_Y, 3, 4, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x3a] = UNOFFICIAL,
+    [0x3b] = UNOFFICIAL,
+    [0x3c] = UNOFFICIAL,
+    [0x3d] = {MNEMONIC_AND, ABSOLUTE_X, 3, 4, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x3e] = {MNEMONIC_ROL, ABSOLUTE_X, 3, 7, 0, FLAG_C, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x3f] = UNOFFICIAL,
+    [0x40] = {MNEMONIC_RTI, IMPLIED, 1, 6, 0, 0, ALL_FLAGS, 0},
+    [0x41] = {MNEMONIC_EOR, INDEXED_INDIRECT, 2, 6, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x42] = UNOFFICIAL,
+    [0x43] = UNOFFICIAL,
+    [0x44] = UNOFFICIAL,
+    [0x45] = {MNEMONIC_EOR, ZERO_PAGE, 2, 3, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x46] = {MNEMONIC_LSR, ZERO_PAGE, 2, 5, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x47] = UNOFFICIAL,
+    [0x48] = {MNEMONIC_PHA, IMPLIED, 1, 3, 0, 0, 0, 0},
+    [0x49] = {MNEMONIC_EOR, IMMEDIATE, 2, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0x4a] = {MNEMONIC_LSR, ACCUMULATOR, 1, 2, 0, 0, FLAG_N | FLAG_Z | FLAG_C, 0},
+    [0x4b] = UNOFFICIAL,
+    [0x4c] = {MNEMONIC_JMP, ABSOLUTE, 3, 3, 0, 0, 0, ACCESS_JUMP},
+    [0x4d] = {MNEMONIC_EOR, ABSOLUTE, 3, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x4e] = {MNEMONIC_LSR, ABSOLUTE, 3, 6, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x4f] = UNOFFICIAL,
+    [0x50] = {MNEMONIC_BVC, RELATIVE, 2, 2, 2, FLAG_V, 0, ACCESS_JUMP},
+    [0x51] = {MNEMONIC_EOR, INDIRECT_INDEXED, 2, 5, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x52] = UNOFFICIAL,
+    [0x53] = UNOFFICIAL,
+    [0x54] = UNOFFICIAL,
+    [0x55] = {MNEMONIC_EOR, ZERO_PAGE_X, 2, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x56] = {MNEMONIC_LSR, ZERO_PAGE_X, 2, 6, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x57] = UNOFFICIAL,
+    [0x58] = {MNEMONIC_CLI, IMPLIED, 1, 2, 0, 0, FLAG_I, 0},
+    [0x59] = {MNEMONIC_EOR, ABSOLUTE_Y, 3, 4, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x5a] = UNOFFICIAL,
+    [0x5b] = UNOFFICIAL,
+    [0x5c] = UNOFFICIAL,
+    [0x5d] = {MNEMONIC_EOR, ABSOLUTE_X, 3, 4, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0x5e] = {MNEMONIC_LSR, ABSOLUTE_X, 3, 7, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x5f] = UNOFFICIAL,
+    [0x60] = {MNEMONIC_RTS, IMPLIED, 1, 6, 0, 0, 0, 0},
+    [0x61] = {MNEMONIC_ADC, INDEXED_INDIRECT, 2, 6, 0, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0x62] = UNOFFICIAL,
+    [0x63] = UNOFFICIAL,
+    [0x64] = UNOFFICIAL,
+    [0x65] = {MNEMONIC_ADC, ZERO_PAGE, 2, 3, 0, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0x66] = {MNEMONIC_ROR, ZERO_PAGE, 2, 5, 0, FLAG_C, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x67] = UNOFFICIAL,
+    [0x68] = {MNEMONIC_PLA, IMPLIED, 1, 4, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0x69] = {MNEMONIC_ADC, IMMEDIATE, 2, 2, 0, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, 0},
+    [0x6a] = {MNEMONIC_ROR, ACCUMULATOR, 1, 2, 0, FLAG_C, FLAG_N | FLAG_Z | FLAG_C, 0},
+    [0x6b] = UNOFFICIAL,
+    [0x6c] = {MNEMONIC_JMP, INDIRECT, 3, 5, 0, 0, 0, ACCESS_READ},
+    [0x6d] = {MNEMONIC_ADC, ABSOLUTE, 3, 4, 0, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0x6e] = {MNEMONIC_ROR, ABSOLUTE, 3, 6, 0, FLAG_C, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x6f] = UNOFFICIAL,
+    [0x70] = {MNEMONIC_BVS, RELATIVE, 2, 2, 2, FLAG_V, 0, ACCESS_JUMP},
+    [0x71] = {MNEMONIC_ADC, INDIRECT_INDEXED, 2, 5, 1, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0x72] = UNOFFICIAL,
+    [0x73] = UNOFFICIAL,
+    [0x74] = UNOFFICIAL,
+    [0x75] = {MNEMONIC_ADC, ZERO_PAGE_X, 2, 4, 0, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0x76] = {MNEMONIC_ROR, ZERO_PAGE_X, 2, 6, 0, FLAG_C, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x77] = UNOFFICIAL,
+    [0x78] = {MNEMONIC_SEI, IMPLIED, 1, 2, 0, 0, FLAG_I, 0},
+    [0x79] = {MNEMONIC_ADC, ABSOLUTE_Y, 3, 4, 1, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0x7a] = UNOFFICIAL,
+    [0x7b] = UNOFFICIAL,
+    [0x7c] = UNOFFICIAL,
+    [0x7d] = {MNEMONIC_ADC, ABSOLUTE_X, 3, 4, 1, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0x7e] = {MNEMONIC_ROR, ABSOLUTE_X, 3, 7, 0, FLAG_C, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ | ACCESS_WRITE},
+    [0x7f] = UNOFFICIAL,
+    [0x80] = UNOFFICIAL,
+    [0x81] = {MNEMONIC_STA, INDEXED_INDIRECT, 2, 6, 0, 0, 0, ACCESS_WRITE},
+    [0x82] = UNOFFICIAL,
+    [0x83] = UNOFFICIAL,
+    [0x84] = {MNEMONIC_STY, ZERO_PAGE, 2, 3, 0, 0, 0, ACCESS_WRITE},
+    [0x85] = {MNEMONIC_STA, ZERO_PAGE, 2, 3, 0, 0, 0, ACCESS_WRITE},
+    [0x86] = {MNEMONIC_STX, ZERO_PAGE, 2, 3, 0, 0, 0, ACCESS_WRITE},
+    [0x87] = UNOFFICIAL,
+    [0x88] = {MNEMONIC_DEY, IMPLIED, 1, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0x89] = UNOFFICIAL,
+    [0x8a] = {MNEMONIC_TXA, IMPLIED, 1, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0x8b] = UNOFFICIAL,
+    [0x8c] = {MNEMONIC_STY, ABSOLUTE, 3, 4, 0, 0, 0, ACCESS_WRITE},
+    [0x8d] = {MNEMONIC_STA, ABSOLUTE, 3, 4, 0, 0, 0, ACCESS_WRITE},
+    [0x8e] = {MNEMONIC_STX, ABSOLUTE, 3, 4, 0, 0, 0, ACCESS_WRITE},
+    [0x8f] = UNOFFICIAL,
+    [0x90] = {MNEMONIC_BCC, RELATIVE, 2, 2, 2, FLAG_C, 0, ACCESS_JUMP},
+    [0x91] = {MNEMONIC_STA, INDIRECT_INDEXED, 2, 6, 0, 0, 0, ACCESS_WRITE},
+    [0x92] = UNOFFICIAL,
+    [0x93] = UNOFFICIAL,
+    [0x94] = {MNEMONIC_STY, ZERO_PAGE_X, 2, 4, 0, 0, 0, ACCESS_WRITE},
+    [0x95] = {MNEMONIC_STA, ZERO_PAGE_X, 2, 4, 0, 0, 0, ACCESS_WRITE},
+    [0x96] = {MNEMONIC_STX, ZERO_PAGE_Y, 2, 4, 0, 0, 0, ACCESS_WRITE},
+    [0x97] = UNOFFICIAL,
+    [0x98] = {MNEMONIC_TYA, IMPLIED, 1, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0x99] = {MNEMONIC_STA, ABSOLUTE_Y, 3, 5, 0, 0, 0, ACCESS_WRITE},
+    [0x9a] = {MNEMONIC_TXS, IMPLIED, 1, 2, 0, 0, 0, 0},
+    [0x9b] = UNOFFICIAL,
+    [0x9c] = UNOFFICIAL,
+    [0x9d] = {MNEMONIC_STA, ABSOLUTE_X, 3, 5, 0, 0, 0, ACCESS_WRITE},
+    [0x9e] = UNOFFICIAL,
+    [0x9f] = UNOFFICIAL,
+    [0xa0] = {MNEMONIC_LDY, IMMEDIATE, 2, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0xa1] = {MNEMONIC_LDA, INDEXED_INDIRECT, 2, 6, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xa2] = {MNEMONIC_LDX, IMMEDIATE, 2, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0xa3] = UNOFFICIAL,
+    [0xa4] = {MNEMONIC_LDY, ZERO_PAGE, 2, 3, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xa5] = {MNEMONIC_LDA, ZERO_PAGE, 2, 3, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xa6] = {MNEMONIC_LDX, ZERO_PAGE, 2, 3, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xa7] = UNOFFICIAL,
+    [0xa8] = {MNEMONIC_TAY, IMPLIED, 1, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0xa9] = {MNEMONIC_LDA, IMMEDIATE, 2, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0xaa] = {MNEMONIC_TAX, IMPLIED, 1, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0xab] = UNOFFICIAL,
+    [0xac] = {MNEMONIC_LDY, ABSOLUTE, 3, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xad] = {MNEMONIC_LDA, ABSOLUTE, 3, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xae] = {MNEMONIC_LDX, ABSOLUTE, 3, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xaf] = UNOFFICIAL,
+    [0xb0] = {MNEMONIC_BCS, RELATIVE, 2, 2, 2, FLAG_C, 0, ACCESS_JUMP},
+    [0xb1] = {MNEMONIC_LDA, INDIRECT_INDEXED, 2, 5, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xb2] = UNOFFICIAL,
+    [0xb3] = UNOFFICIAL,
+    [0xb4] = {MNEMONIC_LDY, ZERO_PAGE_X, 2, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xb5] = {MNEMONIC_LDA, ZERO_PAGE_X, 2, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xb6] = {MNEMONIC_LDX, ZERO_PAGE_Y, 2, 4, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xb7] = UNOFFICIAL,
+    [0xb8] = {MNEMONIC_CLV, IMPLIED, 1, 2, 0, 0, FLAG_V, 0},
+    [0xb9] = {MNEMONIC_LDA, ABSOLUTE_Y, 3, 4, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xba] = {MNEMONIC_TSX, IMPLIED, 1, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0xbb] = UNOFFICIAL,
+    [0xbc] = {MNEMONIC_LDY, ABSOLUTE_X, 3, 4, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xbd] = {MNEMONIC_LDA, ABSOLUTE_X, 3, 4, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xbe] = {MNEMONIC_LDX, ABSOLUTE_Y, 3, 4, 1, 0, FLAG_N | FLAG_Z, ACCESS_READ},
+    [0xbf] = UNOFFICIAL,
+    [0xc0] = {MNEMONIC_CPY, IMMEDIATE, 2, 2, 0, 0, FLAG_N | FLAG_Z | FLAG_C, 0},
+    [0xc1] = {MNEMONIC_CMP, INDEXED_INDIRECT, 2, 6, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xc2] = UNOFFICIAL,
+    [0xc3] = UNOFFICIAL,
+    [0xc4] = {MNEMONIC_CPY, ZERO_PAGE, 2, 3, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xc5] = {MNEMONIC_CMP, ZERO_PAGE, 2, 3, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xc6] = {MNEMONIC_DEC, ZERO_PAGE, 2, 5, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ | ACCESS_WRITE},
+    [0xc7] = UNOFFICIAL,
+    [0xc8] = {MNEMONIC_INY, IMPLIED, 1, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0xc9] = {MNEMONIC_CMP, IMMEDIATE, 2, 2, 0, 0, FLAG_N | FLAG_Z | FLAG_C, 0},
+    [0xca] = {MNEMONIC_DEX, IMPLIED, 1, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0xcb] = UNOFFICIAL,
+    [0xcc] = {MNEMONIC_CPY, ABSOLUTE, 3, 4, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xcd] = {MNEMONIC_CMP, ABSOLUTE, 3, 4, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xce] = {MNEMONIC_DEC, ABSOLUTE, 3, 6, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ | ACCESS_WRITE},
+    [0xcf] = UNOFFICIAL,
+    [0xd0] = {MNEMONIC_BNE, RELATIVE, 2, 2, 2, FLAG_Z, 0, ACCESS_JUMP},
+    [0xd1] = {MNEMONIC_CMP, INDIRECT_INDEXED, 2, 5, 1, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xd2] = UNOFFICIAL,
+    [0xd3] = UNOFFICIAL,
+    [0xd4] = UNOFFICIAL,
+    [0xd5] = {MNEMONIC_CMP, ZERO_PAGE_X, 2, 4, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xd6] = {MNEMONIC_DEC, ZERO_PAGE_X, 2, 6, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ | ACCESS_WRITE},
+    [0xd7] = UNOFFICIAL,
+    [0xd8] = {MNEMONIC_CLD, IMPLIED, 1, 2, 0, 0, FLAG_D, 0},
+    [0xd9] = {MNEMONIC_CMP, ABSOLUTE_Y, 3, 4, 1, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xda] = UNOFFICIAL,
+    [0xdb] = UNOFFICIAL,
+    [0xdc] = UNOFFICIAL,
+    [0xdd] = {MNEMONIC_CMP, ABSOLUTE_X, 3, 4, 1, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xde] = {MNEMONIC_DEC, ABSOLUTE_X, 3, 7, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ | ACCESS_WRITE},
+    [0xdf] = UNOFFICIAL,
+    [0xe0] = {MNEMONIC_CPX, IMMEDIATE, 2, 2, 0, 0, FLAG_N | FLAG_Z | FLAG_C, 0},
+    [0xe1] = {MNEMONIC_SBC, INDEXED_INDIRECT, 2, 6, 0, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xe2] = UNOFFICIAL,
+    [0xe3] = UNOFFICIAL,
+    [0xe4] = {MNEMONIC_CPX, ZERO_PAGE, 2, 3, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xe5] = {MNEMONIC_SBC, ZERO_PAGE, 2, 3, 0, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xe6] = {MNEMONIC_INC, ZERO_PAGE, 2, 5, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ | ACCESS_WRITE},
+    [0xe7] = UNOFFICIAL,
+    [0xe8] = {MNEMONIC_INX, IMPLIED, 1, 2, 0, 0, FLAG_N | FLAG_Z, 0},
+    [0xe9] = {MNEMONIC_SBC, IMMEDIATE, 2, 2, 0, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, 0},
+    [0xea] = {MNEMONIC_NOP, IMPLIED, 1, 2, 0, 0, 0, 0},
+    [0xeb] = UNOFFICIAL,
+    [0xec] = {MNEMONIC_CPX, ABSOLUTE, 3, 4, 0, 0, FLAG_N | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xed] = {MNEMONIC_SBC, ABSOLUTE, 3, 4, 0, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xee] = {MNEMONIC_INC, ABSOLUTE, 3, 6, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ | ACCESS_WRITE},
+    [0xef] = UNOFFICIAL,
+    [0xf0] = {MNEMONIC_BEQ, RELATIVE, 2, 2, 2, FLAG_Z, 0, ACCESS_JUMP},
+    [0xf1] = {MNEMONIC_SBC, INDIRECT_INDEXED, 2, 5, 1, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xf2] = UNOFFICIAL,
+    [0xf3] = UNOFFICIAL,
+    [0xf4] = UNOFFICIAL,
+    [0xf5] = {MNEMONIC_SBC, ZERO_PAGE_X, 2, 4, 0, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xf6] = {MNEMONIC_INC, ZERO_PAGE_X, 2, 6, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ | ACCESS_WRITE},
+    [0xf7] = UNOFFICIAL,
+    [0xf8] = {MNEMONIC_SED, IMPLIED, 1, 2, 0, 0, FLAG_D, 0},
+    [0xf9] = {MNEMONIC_SBC, ABSOLUTE_Y, 3, 4, 1, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xfa] = UNOFFICIAL,
+    [0xfb] = UNOFFICIAL,
+    [0xfc] = UNOFFICIAL,
+    [0xfd] = {MNEMONIC_SBC, ABSOLUTE_X, 3, 4, 1, FLAG_C, FLAG_N | FLAG_V | FLAG_Z | FLAG_C, ACCESS_READ},
+    [0xfe] = {MNEMONIC_INC, ABSOLUTE_X, 3, 7, 0, 0, FLAG_N | FLAG_Z, ACCESS_READ | ACCESS_WRITE},
+    [0xff] = UNOFFICIAL};
+
+// The 2 hex digits of every byte, so that a byte is written with one load
+static const char HEX_PAIRS[] =
+    "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+#define UNKNOWN_FORMAT (INDIRECT_INDEXED + 1) // "??? 02 ???", the opcode between the marks
+#define OPERAND_COLUMN 12                     // after the address, its padding and the mnemonic
+
+/*
+ * Operand text of each format, copied whole after the mnemonic. The high then the low byte of
+ * the value are written at digits - 2 apart from the position, so that a byte operand leaves
+ * its low byte only and an operand without value writes past the end of the text.
+ */
+static const struct
 {
-    INSTRUCTION_INFO *info = instructions_info[byte1];
+    char text[8];
+    unsigned char position;
+    unsigned char digits;
+    unsigned char length;
+} OPERAND_TEXTS[] = {
+    [IMPLIED] = {"", 2, 0, 0},
+    [ACCUMULATOR] = {"A", 3, 0, 1},
+    [IMMEDIATE] = {"#$", 2, 2, 4},
+    [ZERO_PAGE] = {"$", 1, 2, 3},
+    [ZERO_PAGE_X] = {"$  ,X", 1, 2, 5},
+    [ZERO_PAGE_Y] = {"$  ,Y", 1, 2, 5},
+    [RELATIVE] = {"$", 1, 4, 5},
+    [ABSOLUTE] = {"$", 1, 4, 5},
+    [ABSOLUTE_X] = {"$    ,X", 1, 4, 7},
+    [ABSOLUTE_Y] = {"$    ,Y", 1, 4, 7},
+    [INDIRECT] = {"($    )", 2, 4, 7},
+    [INDEXED_INDIRECT] = {"($  ,X)", 2, 2, 7},
+    [INDIRECT_INDEXED] = {"($  ),Y", 2, 2, 7},
+    [UNKNOWN_FORMAT] = {"   ???", 0, 2, 6}};
 
-    instruction->opcode = byte1;
+// Mnemonic and the space after it, "???" for the unofficial opcodes
+static const char MNEMONIC_TEXTS[NB_MNEMONICS][4] = {
+    "??? ", "ADC ", "AND ", "ASL ", "BCC ", "BCS ", "BEQ ", "BIT ", "BMI ", "BNE ", "BPL ", "BRK ", "BVC ", "BVS ",
+    "CLC ", "CLD ", "CLI ", "CLV ", "CMP ", "CPX ", "CPY ", "DEC ", "DEX ", "DEY ", "EOR ", "INC ", "INX ", "INY ",
+    "JMP ", "JSR ", "LDA ", "LDX ", "LDY ", "LSR ", "NOP ", "ORA ", "PHA ", "PHP ", "PLA ", "PLP ", "ROL ", "ROR ",
+    "RTI ", "RTS ", "SBC ", "SEC ", "SED ", "SEI ", "STA ", "STX ", "STY ", "TAX ", "TAY ", "TSX ", "TXA ", "TXS ",
+    "TYA "};
 
-    if (!info)
-    {
-        instruction->mnemonic = 0;
-        instruction->length = 1;
-        return;
-    }
+/*
+ * Writes the line of the instruction at out, which has room for DIS_TEXT_SIZE bytes, and returns
+ * its length, without the terminating 0. Every part goes at a fixed column or one given by the
+ * format of the opcode, whole: the next one or the terminating 0 covers what is past the end.
+ */
+static inline unsigned int put_instruction(unsigned char opcode, unsigned short address, signed char displacement,
+                                           unsigned short pc, char *out)
+{
+    const OPCODE_INFO *info = &OPCODES[opcode];
+    // Masks rather than conditions, which the compiler turns into branches that data mispredicts
+    unsigned int unknown = -(unsigned int)(info->mnemonic == MNEMONIC_NONE);
+    unsigned int relative = -(unsigned int)(info->mode == RELATIVE);
+    unsigned int format = info->mode | (UNKNOWN_FORMAT & unknown);
+    unsigned int target = pc + 2 + displacement;
+    unsigned int value = (address & ~relative & ~unknown) | (target & relative & 0xffff) | (opcode & unknown);
+    char *operand = out + OPERAND_COLUMN + OPERAND_TEXTS[format].position;
 
-    instruction->mnemonic = info->mnemonic;
-    instruction->addressing_mode = info->addressing_mode;
+    memcpy(out, HEX_PAIRS + 2 * (pc >> 8), 2);
+    memcpy(out + 2, HEX_PAIRS + 2 * (pc & 0xff), 2);
+    memcpy(out + 4, "    ", 4);
+    memcpy(out + 8, MNEMONIC_TEXTS[info->mnemonic], 4);
+    memcpy(out + OPERAND_COLUMN, OPERAND_TEXTS[format].text, 8);
+    memcpy(operand, HEX_PAIRS + 2 * (value >> 8), 2);
+    memcpy(operand + OPERAND_TEXTS[format].digits - 2, HEX_PAIRS + 2 * (value & 0xff), 2);
 
-    switch (info->addressing_mode)
-    {
-    case IMPLIED:
-    case ACCUMULATOR:
-        instruction->length = 1;
-        break;
-    case IMMEDIATE:
-        instruction->length = 2;
-        instruction->value = byte2;
-        break;
-    case ZERO_PAGE:
-    case ZERO_PAGE_X:
-    case ZERO_PAGE_Y:
-    case INDIRECT_INDEXED:
-    case INDEXED_INDIRECT:
-        instruction->length = 2;
-        instruction->address = byte2;
-        break;
-    case RELATIVE:
-        instruction->length = 2;
-        instruction->displacement = byte2;
-        break;
-    case ABSOLUTE:
-    case ABSOLUTE_X:
-    case ABSOLUTE_Y:
-    case INDIRECT:
-        instruction->length = 3;
-        instruction->address = byte2 | (byte3 << 8);
-        break;
-    }
+    return OPERAND_COLUMN + OPERAND_TEXTS[format].length;
 }
 
-void dis_instruction_to_str(INSTRUCTION *instruction, unsigned short pc, char *str)
+unsigned int dis_instruction_to_str(const INSTRUCTION *instruction, unsigned short pc, char *str, unsigned int size)
 {
-    if (instruction->mnemonic == 0)
+    char line[DIS_TEXT_SIZE];
+    char *out = size >= DIS_TEXT_SIZE ? str : line;
+    unsigned int length = put_instruction(instruction->opcode, instruction->address, instruction->displacement, pc, out);
+
+    if (out == line)
     {
-        sprintf(str, "%04X    ??? %02X ???", pc, instruction->opcode);
-        return;
+        if (!size)
+        {
+            return 0;
+        }
+
+        length = length < size - 1 ? length : size - 1;
+        memcpy(str, line, length);
     }
 
-    sprintf(str, "%04X    %s ", pc, instruction->mnemonic);
-    char *operand_pointer = str + strlen(str);
+    str[length] = 0;
+
+    return length;
+}
+
+unsigned int dis_listing_to_str(const unsigned char *bytes, unsigned int size, unsigned short pc, char *text,
+                                unsigned int text_size, unsigned int *consumed)
+{
+    unsigned int offset = 0;
+    unsigned int length = 0;
 
-    switch (instruction->addressing_mode)
+    while (offset < size && length + DIS_TEXT_SIZE <= text_size)
     {
-    case ACCUMULATOR:
-        sprintf(operand_pointer, "A");
-        break;
-    case IMMEDIATE:
-        sprintf(operand_pointer, "#$%02X", instruction->value);
-        break;
-    case ZERO_PAGE:
-        sprintf(operand_pointer, "$%02X", instruction->address);
-        break;
-    case ZERO_PAGE_X:
-        sprintf(operand_pointer, "$%02X,X", instruction->address);
-        break;
-    case ZERO_PAGE_Y:
-        sprintf(operand_pointer, "$%02X,Y", instruction->address);
-        break;
-    case RELATIVE:
-        sprintf(operand_pointer, "$%04X", pc + 2 + instruction->displacement);
-        break;
-    case ABSOLUTE:
-        sprintf(operand_pointer, "$%04X", instruction->address);
-        break;
-    case ABSOLUTE_X:
-        sprintf(operand_pointer, "$%04X,X", instruction->address);
-        break;
-    case ABSOLUTE_Y:
-        sprintf(operand_pointer, "$%04X,Y", instruction->address);
-        break;
-    case INDIRECT:
-        sprintf(operand_pointer, "($%04X)", instruction->address);
-        break;
-    case INDEXED_INDIRECT:
-        sprintf(operand_pointer, "($%02X,X)", instruction->address);
-        break;
-    case INDIRECT_INDEXED:
-        sprintf(operand_pointer, "($%02X),Y", instruction->address);
-        break;
+        unsigned char opcode = bytes[offset];
+        unsigned char byte2 = offset + 1 < size ? bytes[offset + 1] : 0;
+        unsigned char byte3 = offset + 2 < size ? bytes[offset + 2] : 0;
+        unsigned short address = OPCODES[opcode].length == 3 ? byte2 | (byte3 << 8) : byte2;
+
+        length += put_instruction(opcode, address, byte2, pc + offset, text + length);
+        text[length++] = '\n';
+        offset += OPCODES[opcode].length;
     }
-}
\ No newline at end of file
+
+    *consumed = offset < size ? offset : size;
+
+    return length;
+}
@@ -1,6 +1,15 @@
 #ifndef _DISASSEMBLER_H_
 #define _DISASSEMBLER_H_
 
+#define DIS_TEXT_SIZE 24 // longest line of dis_instruction_to_str with its terminating 0
+#define DIS_MNEMONIC_COLUMN 8 // after the address and its padding
+
+// How an instruction uses the address of its operand
+#define ACCESS_READ 0x01
+#define ACCESS_WRITE 0x02
+#define ACCESS_JUMP 0x04 // branches and jumps, JMP through a pointer reads the pointer
+#define ACCESS_CALL 0x08
+
 enum ADDRESSING_MODE
 {
     IMPLIED,
@@ -18,11 +27,31 @@ enum ADDRESSING_MODE
     INDIRECT_INDEXED
 };
 
+enum MNEMONIC
+{
+    MNEMONIC_NONE, // unofficial opcodes
+    MNEMONIC_ADC, MNEMONIC_AND, MNEMONIC_ASL, MNEMONIC_BCC, MNEMONIC_BCS, MNEMONIC_BEQ, MNEMONIC_BIT, MNEMONIC_BMI,
+    MNEMONIC_BNE, MNEMONIC_BPL, MNEMONIC_BRK, MNEMONIC_BVC, MNEMONIC_BVS, MNEMONIC_CLC, MNEMONIC_CLD, MNEMONIC_CLI,
+    MNEMONIC_CLV, MNEMONIC_CMP, MNEMONIC_CPX, MNEMONIC_CPY, MNEMONIC_DEC, MNEMONIC_DEX, MNEMONIC_DEY, MNEMONIC_EOR,
+    MNEMONIC_INC, MNEMONIC_INX, MNEMONIC_INY, MNEMONIC_JMP, MNEMONIC_JSR, MNEMONIC_LDA, MNEMONIC_LDX, MNEMONIC_LDY,
+    MNEMONIC_LSR, MNEMONIC_NOP, MNEMONIC_ORA, MNEMONIC_PHA, MNEMONIC_PHP, MNEMONIC_PLA, MNEMONIC_PLP, MNEMONIC_ROL,
+    MNEMONIC_ROR, MNEMONIC_RTI, MNEMONIC_RTS, MNEMONIC_SBC, MNEMONIC_SEC, MNEMONIC_SED, MNEMONIC_SEI, MNEMONIC_STA,
+    MNEMONIC_STX, MNEMONIC_STY, MNEMONIC_TAX, MNEMONIC_TAY, MNEMONIC_TSX, MNEMONIC_TXA, MNEMONIC_TXS, MNEMONIC_TYA,
+    NB_MNEMONICS
+};
+
+// Everything known of an opcode, 8 bytes so that the whole table fits in 2 KB
 typedef struct
 {
-    const char *mnemonic;
-    enum ADDRESSING_MODE addressing_mode;
-} INSTRUCTION_INFO;
+    unsigned char mnemonic;      // MNEMONIC_
+    unsigned char mode;          // ADDRESSING_MODE, IMPLIED for the unofficial opcodes
+    unsigned char length;
+    unsigned char cycles;        // without the penalties
+    unsigned char extra_cycles;  // at most, for a page crossed by indexing or a taken branch
+    unsigned char flags_read;    // P register bits
+    unsigned char flags_written; // set or cleared
+    unsigned char access;        // ACCESS_ bits
+} OPCODE_INFO;
 
 typedef struct
 {
@@ -35,9 +64,36 @@ typedef struct
     unsigned short address;
 } INSTRUCTION;
 
-void dis_parse_instruction(unsigned char byte1, unsigned char byte2, unsigned char byte3,
-                           INSTRUCTION *instruction);
+extern const OPCODE_INFO OPCODES[256];
+extern const char MNEMONIC_NAMES[NB_MNEMONICS][4];
+
+// Inline, so that a loop walking instructions gets their length without going through memory
+static inline void dis_parse_instruction(unsigned char byte1, unsigned char byte2, unsigned char byte3,
+                                         INSTRUCTION *instruction)
+{
+    const OPCODE_INFO *info = &OPCODES[byte1];
+
+    instruction->opcode = byte1;
+    instruction->length = info->length;
+    instruction->mnemonic = info->mnemonic ? MNEMONIC_NAMES[info->mnemonic] : 0;
+    instruction->addressing_mode = info->mode;
+    instruction->value = byte2;
+    instruction->displacement = byte2;
+    instruction->address = info->length == 3 ? byte2 | (byte3 << 8) : byte2;
+}
+
+/*
+ * Writes the instruction as "C000    LDA $1234,X", cut to fit in size bytes with the terminating
+ * 0. Returns the length written.
+ */
+unsigned int dis_instruction_to_str(const INSTRUCTION *instruction, unsigned short pc, char *str, unsigned int size);
 
-void dis_instruction_to_str(INSTRUCTION *instruction, unsigned short pc, char *str);
+/*
+ * Writes the lines of the instructions in bytes, the first one at pc, each ended by a new line
+ * and without a terminating 0, while text has room for one more. Returns the length written,
+ * *consumed gets the bytes disassembled. An instruction cut by the end reads zeros past it.
+ */
+unsigned int dis_listing_to_str(const unsigned char *bytes, unsigned int size, unsigned short pc, char *text,
+                                unsigned int text_size, unsigned int *consumed);
 
-#endif
\ No newline at end of file
+#endif
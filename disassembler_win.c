@@ -1,15 +1,39 @@
 #include <gtk/gtk.h>
-#include <ctype.h>
+#include <string.h>
 
 #include "disassembler_win.h"
 #include "disassembler.h"
+#include "instruction_index.h"
+
+#define LINE_CACHE_SIZE 128 // lines with a cached layout, more than a window ever shows
+#define INLINE_XREFS 3      // references listed at the end of a line, the others are counted
+
+typedef struct
+{
+    int address; // -1 when the layout does not hold any line
+    unsigned char kind;
+    unsigned char bytes[3];
+    PangoLayout *layout;
+} LINE_LAYOUT;
 
 struct _DisassemblerWindow
 {
     GtkWindow parent;
     GtkEntry *disassembler_start_address_entry;
-    GtkTextView *disassembler_text_view;
-    unsigned short start_address;
+    GtkCheckButton *follow_pc_check_button;
+    GtkDrawingArea *disassembler_area;
+    GtkScrollbar *disassembler_scrollbar;
+    DebuggerApp *app;
+    INSTRUCTION_INDEX *index;
+    unsigned char bytes[INDEX_SPACE_SIZE];
+    unsigned char hints[INDEX_SPACE_SIZE];
+    LINE_LAYOUT layouts[LINE_CACHE_SIZE]; // indexed by line modulo the cache size
+    PangoFontDescription *font;
+    int char_width;
+    int line_height;
+    unsigned short pc;
+    guint xref_generation;   // of the references shown by the cached layouts
+    guint symbol_generation; // of the symbols shown by the cached layouts
 };
 
 G_DEFINE_TYPE(DisassemblerWindow, disassembler_window, GTK_TYPE_WINDOW);
@@ -17,6 +41,12 @@ G_DEFINE_TYPE(DisassemblerWindow, disassembler_window, GTK_TYPE_WINDOW);
 static void disassembler_window_init(DisassemblerWindow *window)
 {
     gtk_widget_init_template(GTK_WIDGET(window));
+
+    for (int i = 0; i < LINE_CACHE_SIZE; i++)
+    {
+        window->layouts[i].address = -1;
+        window->layouts[i].layout = NULL;
+    }
 }
 
 static void disassembler_window_class_init(DisassemblerWindowClass *class)
@@ -24,65 +54,415 @@ static void disassembler_window_class_init(DisassemblerWindowClass *class)
     gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), "/org/c4z/debuggerapp/disassembler_window.xml");
 
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DisassemblerWindow, disassembler_start_address_entry);
-    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DisassemblerWindow, disassembler_text_view);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DisassemblerWindow, follow_pc_check_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DisassemblerWindow, disassembler_area);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), DisassemblerWindow, disassembler_scrollbar);
 }
 
-static void update_disassembler_window(DisassemblerWindow *window, NES *nes)
+static void close_disassembler_window(GtkWindow *win, DebuggerApp *app)
 {
-    if (!window)
+    DisassemblerWindow *window = DISASSEMBLER_WINDOW(win);
+
+    refresh_coordinator_unregister(app->refresh, win);
+
+    for (int i = 0; i < LINE_CACHE_SIZE; i++)
+    {
+        g_clear_object(&window->layouts[i].layout);
+    }
+
+    g_clear_pointer(&window->font, pango_font_description_free);
+    g_clear_pointer(&window->index, free);
+}
+
+static GtkAdjustment *disassembler_window_adjustment(DisassemblerWindow *window)
+{
+    return gtk_range_get_adjustment(GTK_RANGE(window->disassembler_scrollbar));
+}
+
+// Appends who references the address, like "; xref C123 call, C200 jump +2"
+static void disassembler_window_append_xrefs(DisassemblerWindow *window, unsigned short address, GString *text)
+{
+    DebuggerApp *app = window->app;
+    int location = app->xrefs ? xref_location(app->analysis, 0, address) : -1;
+    unsigned int count = location >= 0 ? xref_index_count(app->xrefs, location) : 0;
+
+    if (!count)
     {
         return;
     }
 
-    GtkTextBuffer *buffer = gtk_text_view_get_buffer(window->disassembler_text_view);
-    GtkTextIter start;
-    GtkTextIter end;
+    XREF xrefs[INLINE_XREFS];
+    unsigned int shown = xref_index_list(app->xrefs, location, xrefs, INLINE_XREFS);
 
-    gtk_text_buffer_get_start_iter(buffer, &start);
-    gtk_text_buffer_get_end_iter(buffer, &end);
+    g_string_append(text, "  ; xref");
 
-    gtk_text_buffer_delete(buffer, &start, &end);
+    for (unsigned int i = 0; i < shown; i++)
+    {
+        g_string_append_printf(text, "%s %04X %s", i ? "," : "", xref_location_address(app->analysis, xrefs[i].from),
+                               xref_kinds_name(xrefs[i].kinds));
+    }
+
+    if (count > shown)
+    {
+        g_string_append_printf(text, " +%u", count - shown);
+    }
+}
+
+// Puts the symbol of the operand in place of its hex digits, like "LDA (pointer),Y"
+static void disassembler_window_name_operand(DisassemblerWindow *window, INSTRUCTION *instruction, unsigned short address, GString *text)
+{
+    enum ADDRESSING_MODE mode = instruction->addressing_mode;
+    unsigned short operand = mode == RELATIVE ? address + 2 + instruction->displacement : instruction->address;
+    char *dollar = strchr(text->str + DIS_MNEMONIC_COLUMN, '$');
+    char name[64];
+
+    if (mode == IMPLIED || mode == ACCUMULATOR || mode == IMMEDIATE || !dollar ||
+        !debugger_app_symbol_name(window->app, operand, name, sizeof(name)))
+    {
+        return;
+    }
+
+    gssize position = dollar - text->str;
+
+    g_string_erase(text, position, 1 + strspn(dollar + 1, "0123456789ABCDEF"));
+    g_string_insert(text, position, name);
+}
+
+// Appends the label of the address and the source line it was assembled from, like "; reset: main.s:12 sei"
+static void disassembler_window_append_source(DisassemblerWindow *window, unsigned short address, GString *text)
+{
+    DebuggerApp *app = window->app;
+    int location = debugger_app_location(app, address);
+    const DEBUG_SYMBOL *symbol = location >= 0 ? debug_info_symbol_at(app->debug_info, location) : NULL;
+    const SOURCE_SPAN *span = location >= 0 ? debug_info_span_at(app->debug_info, location) : NULL;
+    char line[64];
+
+    if (symbol && symbol->location == (unsigned int)location)
+    {
+        g_string_append_printf(text, "  ; %s:", debug_info_name(app->debug_info, symbol->name));
+    }
+
+    if (!span)
+    {
+        return;
+    }
+
+    g_string_append_printf(text, "%s %s:%u", symbol && symbol->location == (unsigned int)location ? "" : "  ;",
+                           debug_info_name(app->debug_info, app->debug_info->files[span->file].name), span->line);
+
+    if (debug_info_source_line(app->debug_info, span, line, sizeof(line)) > 0)
+    {
+        g_string_append_printf(text, " %s", line);
+    }
+}
+
+/*
+ * Appends the cycles a routine takes at its entry, like "; 120-385 cycles", or "; 120+ cycles" when
+ * loops or recursion leave the worst case unbounded. "+" after the worst case when indirect jumps
+ * were left out of the count, "!" when an NMI handler can overrun the vertical blank, as one with an unbounded worst case can.
+ */
+static void disassembler_window_append_timing(DisassemblerWindow *window, unsigned short address, GString *text)
+{
+    DebuggerApp *app = window->app;
+    int location = app->timing ? debugger_app_location(app, address) : -1;
+    unsigned int offset = location - XREF_ROM_LOCATION;
+    unsigned int best;
+    unsigned int worst;
+    unsigned char flags;
+
+    if (location < XREF_ROM_LOCATION || app->analysis->labels[offset] < LABEL_SUBROUTINE ||
+        timing_routine(app->timing, offset, &best, &worst, &flags) < 0)
+    {
+        return;
+    }
+
+    const char *over_budget = timing_over_budget(app->timing, offset) ? " !" : "";
+
+    if (timing_unbounded(worst, flags))
+    {
+        g_string_append_printf(text, "  ; %u+ cycles%s", best, over_budget);
+    }
+    else
+    {
+        g_string_append_printf(text, "  ; %u-%u%s cycles%s", best, worst, flags ? "+" : "", over_budget);
+    }
+}
+
+// Layouts are only rebuilt for lines whose bytes changed or that were scrolled into view
+static PangoLayout *disassembler_window_line_layout(DisassemblerWindow *window, unsigned int line)
+{
+    LINE_LAYOUT *entry = &window->layouts[line % LINE_CACHE_SIZE];
+    unsigned short address = instruction_index_address(window->index, line);
+    unsigned char kind = window->index->starts[address];
+    unsigned char bytes[3] = {window->bytes[address],
+                              window->bytes[(unsigned short)(address + 1)],
+                              window->bytes[(unsigned short)(address + 2)]};
+
+    if (entry->address == address && entry->kind == kind && !memcmp(entry->bytes, bytes, sizeof(bytes)))
+    {
+        return entry->layout;
+    }
+
+    if (!entry->layout)
+    {
+        entry->layout = gtk_widget_create_pango_layout(GTK_WIDGET(window->disassembler_area), NULL);
+        pango_layout_set_font_description(entry->layout, window->font);
+    }
 
-    unsigned short address = window->start_address;
     INSTRUCTION instruction;
     char str[32];
-    for (int i = 0; i < 100; i++)
+
+    if (kind == INDEX_DATA)
+    {
+        g_snprintf(str, sizeof(str), "%04X    .byte $%02X", address, bytes[0]);
+    }
+    else
+    {
+        dis_parse_instruction(bytes[0], bytes[1], bytes[2], &instruction);
+        dis_instruction_to_str(&instruction, address, str, sizeof(str));
+    }
+
+    GString *text = g_string_new(str);
+
+    if (kind != INDEX_DATA && instruction.mnemonic)
     {
-        dis_parse_instruction(memory_read_byte(nes->memory, address),
-                              memory_read_byte(nes->memory, address + 1),
-                              memory_read_byte(nes->memory, address + 2), &instruction);
+        disassembler_window_name_operand(window, &instruction, address, text);
+    }
+
+    disassembler_window_append_source(window, address, text);
+    disassembler_window_append_timing(window, address, text);
+    disassembler_window_append_xrefs(window, address, text);
+    pango_layout_set_text(entry->layout, text->str, text->len);
+    g_string_free(text, TRUE);
+
+    entry->address = address;
+    entry->kind = kind;
+    memcpy(entry->bytes, bytes, sizeof(bytes));
+
+    return entry->layout;
+}
 
-        dis_instruction_to_str(&instruction, address, str);
+static gboolean draw_disassembly(GtkWidget *widget, cairo_t *cr, DisassemblerWindow *window)
+{
+    guint width = gtk_widget_get_allocated_width(widget);
+    guint height = gtk_widget_get_allocated_height(widget);
+    unsigned int line_count = instruction_index_line_count(window->index);
+
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_rectangle(cr, 0, 0, width, height);
+    cairo_fill(cr);
 
-        gtk_text_buffer_get_end_iter(buffer, &end);
-        gtk_text_buffer_insert(buffer, &end, str, -1);
-        gtk_text_buffer_get_end_iter(buffer, &end);
-        gtk_text_buffer_insert(buffer, &end, "\n", -1);
+    unsigned int line = gtk_adjustment_get_value(disassembler_window_adjustment(window));
 
-        address += instruction.length;
+    for (int y = 0; y < (int)height && line < line_count; y += window->line_height, line++)
+    {
+        if (instruction_index_address(window->index, line) == window->pc)
+        {
+            cairo_set_source_rgb(cr, 1, 0.85, 0.4);
+            cairo_rectangle(cr, 0, y, width, window->line_height);
+            cairo_fill(cr);
+        }
+
+        cairo_set_source_rgb(cr, 0, 0, 0);
+        cairo_move_to(cr, window->char_width, y);
+        pango_cairo_show_layout(cr, disassembler_window_line_layout(window, line));
     }
+
+    return FALSE;
 }
 
-static void disassembler_start_address_changed(GtkEntry *entry, DebuggerApp *app)
+static void disassembler_window_set_line_count(DisassemblerWindow *window)
 {
-    DisassemblerWindow *disassembler_window = DISASSEMBLER_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(entry)));
+    GtkAdjustment *adjustment = disassembler_window_adjustment(window);
 
-    disassembler_window->start_address = strtol(gtk_entry_get_text(entry), NULL, 16);
-    update_disassembler_window(disassembler_window, app->nes);
+    gtk_adjustment_set_upper(adjustment, instruction_index_line_count(window->index));
+}
+
+// Scrolls so that the line of the address is on screen, a third of the way down when it was not
+static void disassembler_window_show_address(DisassemblerWindow *window, unsigned short address)
+{
+    GtkAdjustment *adjustment = disassembler_window_adjustment(window);
+    int line = instruction_index_line(window->index, address);
+    int first_line = gtk_adjustment_get_value(adjustment);
+    int page = gtk_adjustment_get_page_size(adjustment);
+
+    if (line < first_line || line >= first_line + page)
+    {
+        gtk_adjustment_set_value(adjustment, MAX(line - page / 3, 0));
+    }
+}
+
+// Opcodes the CPU fetched from the ROM and the bytes it only read as data
+static void disassembler_window_read_hints(DisassemblerWindow *window, NES *nes)
+{
+    CDL *cdl = nes->cdl;
+
+    memset(window->hints, INDEX_HINT_NONE, sizeof(window->hints));
+
+    for (unsigned int address = PRG_ROM_LOWER_BANK; cdl && address < INDEX_SPACE_SIZE; address++)
+    {
+        unsigned int offset = cdl_prg_offset(cdl, address);
+
+        if (cdl_is_marked(cdl->opcodes, offset))
+        {
+            window->hints[address] = INDEX_HINT_OPCODE;
+        }
+        else if (cdl_is_marked(cdl->data, offset) && !cdl_is_marked(cdl->operands, offset))
+        {
+            window->hints[address] = INDEX_HINT_DATA;
+        }
+    }
+}
+
+static void update_disassembler_window(DisassemblerWindow *window, NES *nes)
+{
+    if (!window)
+    {
+        return;
+    }
+
+    nes_peek_range(nes, WATCH_BUS_CPU, 0, window->bytes, sizeof(window->bytes));
+    disassembler_window_read_hints(window, nes);
+    instruction_index_update(window->index, window->bytes, window->hints);
+
+    if (window->xref_generation != window->app->xref_generation || window->symbol_generation != window->app->symbol_generation)
+    {
+        window->xref_generation = window->app->xref_generation;
+        window->symbol_generation = window->app->symbol_generation;
+
+        for (int i = 0; i < LINE_CACHE_SIZE; i++)
+        {
+            window->layouts[i].address = -1;
+        }
+    }
+
+    // The linear sweep can be out of step with the code, the executed instruction is never
+    instruction_index_anchor(window->index, nes->cpu->pc);
+    disassembler_window_set_line_count(window);
+
+    if (window->pc != nes->cpu->pc && gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(window->follow_pc_check_button)))
+    {
+        disassembler_window_show_address(window, nes->cpu->pc);
+    }
+
+    window->pc = nes->cpu->pc;
+
+    gtk_widget_queue_draw(GTK_WIDGET(window->disassembler_area));
+}
+
+static void refresh_disassembler_window(gpointer view, gpointer data)
+{
+    DebuggerApp *app = data;
+
+    update_disassembler_window(DISASSEMBLER_WINDOW(view), app->nes);
+}
+
+static void disassembler_area_size_allocate(GtkWidget *widget, GdkRectangle *allocation, DisassemblerWindow *window)
+{
+    GtkAdjustment *adjustment = disassembler_window_adjustment(window);
+    int page = allocation->height / window->line_height;
+
+    gtk_adjustment_configure(adjustment, gtk_adjustment_get_value(adjustment), 0,
+                             instruction_index_line_count(window->index), 1, page, page);
+}
+
+static void disassembler_window_scrolled(GtkAdjustment *adjustment, DisassemblerWindow *window)
+{
+    gtk_widget_queue_draw(GTK_WIDGET(window->disassembler_area));
+}
+
+static gboolean disassembler_area_scroll(GtkWidget *widget, GdkEventScroll *event, DisassemblerWindow *window)
+{
+    GtkAdjustment *adjustment = disassembler_window_adjustment(window);
+    double delta = 0;
+
+    switch (event->direction)
+    {
+    case GDK_SCROLL_UP:
+        delta = -3;
+        break;
+    case GDK_SCROLL_DOWN:
+        delta = 3;
+        break;
+    case GDK_SCROLL_SMOOTH:
+        delta = event->delta_y * 3;
+        break;
+    default:
+        break;
+    }
+
+    gtk_adjustment_set_value(adjustment, gtk_adjustment_get_value(adjustment) + delta);
+
+    return TRUE;
+}
+
+static void disassembler_start_address_changed(GtkEntry *entry, DisassemblerWindow *window)
+{
+    unsigned short address;
+    unsigned int size;
+
+    if (debugger_app_parse_address(window->app, gtk_entry_get_text(entry), &address, &size, NULL) < 0)
+    {
+        return;
+    }
+
+    // Going somewhere else would be undone by the next step
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(window->follow_pc_check_button), FALSE);
+
+    instruction_index_anchor(window->index, address);
+    disassembler_window_set_line_count(window);
+    gtk_adjustment_set_value(disassembler_window_adjustment(window), instruction_index_line(window->index, address));
 }
 
 DisassemblerWindow *disassembler_window_new(DebuggerApp *app)
 {
     DisassemblerWindow *window = g_object_new(DISASSEMBLER_WINDOW_TYPE, NULL);
+    GtkWidget *area = GTK_WIDGET(window->disassembler_area);
+    NES *nes = app->nes;
+
+    window->app = app;
+    window->pc = nes->cpu->pc;
+    window->xref_generation = app->xref_generation;
+    window->symbol_generation = app->symbol_generation;
+
+    nes_peek_range(nes, WATCH_BUS_CPU, 0, window->bytes, sizeof(window->bytes));
+    disassembler_window_read_hints(window, nes);
+    window->index = create_instruction_index(window->bytes);
+    instruction_index_update(window->index, window->bytes, window->hints);
 
-    window->start_address = app->nes->cpu->pc;
-    gchar *value = g_strdup_printf("%04X", window->start_address);
+    // Vectors and PC are where the code is known to start
+    instruction_index_anchor(window->index, nes_peek_word(nes, 0xfffc));
+    instruction_index_anchor(window->index, nes_peek_word(nes, 0xfffa));
+    instruction_index_anchor(window->index, nes_peek_word(nes, 0xfffe));
+    instruction_index_anchor(window->index, nes->cpu->pc);
+
+    window->font = pango_font_description_from_string("Monospace 10");
+    PangoLayout *layout = gtk_widget_create_pango_layout(area, "0");
+    pango_layout_set_font_description(layout, window->font);
+    pango_layout_get_pixel_size(layout, &window->char_width, &window->line_height);
+    g_object_unref(layout);
+
+    gtk_widget_set_size_request(area, 48 * window->char_width, 8 * window->line_height);
+    gtk_widget_add_events(area, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK);
+
+    gchar *value = g_strdup_printf("%04X", window->pc);
     gtk_entry_set_text(window->disassembler_start_address_entry, value);
     g_free(value);
 
-    update_disassembler_window(window, app->nes);
+    g_signal_connect(window, "destroy", G_CALLBACK(close_disassembler_window), app);
+    g_signal_connect(window->disassembler_start_address_entry, "activate", G_CALLBACK(disassembler_start_address_changed), window);
+    g_signal_connect(area, "draw", G_CALLBACK(draw_disassembly), window);
+    g_signal_connect(area, "size-allocate", G_CALLBACK(disassembler_area_size_allocate), window);
+    g_signal_connect(area, "scroll-event", G_CALLBACK(disassembler_area_scroll), window);
+    g_signal_connect(disassembler_window_adjustment(window), "value-changed", G_CALLBACK(disassembler_window_scrolled), window);
+
+    disassembler_window_set_line_count(window);
+    gtk_adjustment_set_value(disassembler_window_adjustment(window), instruction_index_line(window->index, window->pc));
 
-    g_signal_connect(window->disassembler_start_address_entry, "activate", G_CALLBACK(disassembler_start_address_changed), app);
+    // Code can be anywhere in RAM or ROM and the PC moves with every instruction, the log tells code from data
+    refresh_coordinator_register(app->refresh, window,
+                                 STATE_CPU | STATE_PRG_ROM | STATE_XREFS | STATE_CDL | STATE_SYMBOLS | emulator_state_cpu_range(0, IO_REGISTERS),
+                                 refresh_disassembler_window);
 
     return window;
 }
@@ -0,0 +1,510 @@
+#include <string.h>
+
+#include "emulator_thread.h"
+
+#define SNAPSHOT_FRESH 0x04
+#define SNAPSHOT_INDEX 0x03
+
+// g_atomic_int_exchange only exists since GLib 2.74
+static gint atomic_exchange(gint *atomic, gint value)
+{
+    gint old;
+
+    do
+    {
+        old = g_atomic_int_get(atomic);
+    } while (!g_atomic_int_compare_and_exchange(atomic, old, value));
+
+    return old;
+}
+
+static void emulator_snapshot_wire(EMULATOR_SNAPSHOT *snapshot)
+{
+    snapshot->nes.cpu = &snapshot->cpu;
+    snapshot->nes.ppu = &snapshot->ppu;
+    snapshot->nes.memory = &snapshot->memory;
+    snapshot->nes.ppu_memory = &snapshot->ppu_memory;
+    snapshot->nes.scheduler = &snapshot->scheduler;
+    snapshot->nes.trace = 0;
+    snapshot->cpu.memory = &snapshot->memory;
+    snapshot->memory.ppu = &snapshot->ppu;
+    snapshot->memory.cpu_cycles = &snapshot->cpu.cycles;
+    snapshot->memory.watchpoints = &snapshot->watchpoints;
+    snapshot->ppu.ppu_memory = &snapshot->ppu_memory;
+    snapshot->ppu.scheduler = &snapshot->scheduler;
+    snapshot->nes.cdl = snapshot->cdl.prg_size ? &snapshot->cdl : NULL;
+    snapshot->nes.symbols = NULL; // owned by the emulation thread, the UI has the debug info itself
+    snapshot->nes.recorder = NULL;
+    snapshot->memory.cdl = NULL;
+    snapshot->ppu.cdl = NULL;
+}
+
+// Logpoint rings merged in cycle order, drained at each frame whether or not a snapshot is published
+static void emulator_thread_drain_logs(EMULATOR_THREAD *thread)
+{
+    BREAKPOINTS *breakpoints = thread->nes->breakpoints;
+    unsigned long dropped = 0;
+
+    for (;;)
+    {
+        LOGPOINT *oldest = NULL;
+        LOG_ENTRY *oldest_entry = NULL;
+
+        for (unsigned int i = 0; i < breakpoints->count; i++)
+        {
+            LOGPOINT *log = breakpoints->list[i].log;
+            LOG_ENTRY *entry = log ? logpoint_next_unflushed(log, &dropped) : NULL;
+
+            if (entry && (!oldest_entry || entry->cycle < oldest_entry->cycle))
+            {
+                oldest = log;
+                oldest_entry = entry;
+            }
+        }
+
+        if (!oldest)
+        {
+            break;
+        }
+
+        g_async_queue_push(thread->logs, g_strdup(oldest_entry->text));
+        oldest->flushed++;
+    }
+
+    if (dropped)
+    {
+        g_async_queue_push(thread->logs, g_strdup_printf("(%lu log lines dropped)", dropped));
+    }
+}
+
+// References logged since the last frame go to the UI in one batch
+static void emulator_thread_drain_xrefs(EMULATOR_THREAD *thread)
+{
+    XREF_LOG *log = thread->nes->xrefs;
+
+    if (!log || !log->count)
+    {
+        return;
+    }
+
+    XREF_BATCH *batch = g_malloc(sizeof(XREF_BATCH) + log->count * sizeof(XREF));
+
+    batch->rom_loads = thread->rom_loads;
+    batch->count = log->count;
+    memcpy(batch->xrefs, log->pending, log->count * sizeof(XREF));
+    log->count = 0;
+
+    g_async_queue_push(thread->xrefs, batch);
+}
+
+static void emulator_thread_publish(EMULATOR_THREAD *thread, int running)
+{
+    NES *nes = thread->nes;
+    EMULATOR_SNAPSHOT *snapshot = &thread->slots[thread->back];
+    BREAKPOINTS *breakpoints = nes->breakpoints;
+
+    nes_sync_ppu(nes);
+
+    snapshot->cpu = *nes->cpu;
+    snapshot->memory = *nes->memory;
+    snapshot->ppu = *nes->ppu;
+    snapshot->ppu_memory = *nes->ppu_memory;
+    snapshot->scheduler = *nes->scheduler;
+    snapshot->running = running;
+    snapshot->illegal_pc = thread->illegal_pc;
+
+    if (nes->cdl)
+    {
+        snapshot->cdl = *nes->cdl;
+    }
+
+    if (breakpoints->count > snapshot->hits_capacity)
+    {
+        snapshot->hits_capacity = breakpoints->count;
+        snapshot->hits = g_renew(unsigned long, snapshot->hits, breakpoints->count);
+    }
+
+    for (unsigned int i = 0; i < breakpoints->count; i++)
+    {
+        snapshot->hits[i] = breakpoints->list[i].hits;
+    }
+
+    snapshot->breakpoint_count = breakpoints->count;
+
+    emulator_thread_drain_logs(thread);
+    emulator_thread_drain_xrefs(thread);
+
+    thread->back = atomic_exchange(&thread->middle, thread->back | SNAPSHOT_FRESH) & SNAPSHOT_INDEX;
+
+    if (g_atomic_int_compare_and_exchange(&thread->refresh_queued, 0, 1))
+    {
+        g_idle_add(thread->published, thread->published_data);
+    }
+}
+
+static gpointer emulator_thread_main(gpointer data)
+{
+    EMULATOR_THREAD *thread = data;
+    NES *nes = thread->nes;
+    int running = 0;
+    int stepping = 0; // step over, step out and run to only publish once done
+    unsigned long frame_number = nes->ppu->frame_number;
+
+    emulator_thread_publish(thread, 0);
+
+    for (;;)
+    {
+        EMULATOR_COMMAND *command = running ? g_async_queue_try_pop(thread->commands) : g_async_queue_pop(thread->commands);
+
+        if (command)
+        {
+            // The instruction that stopped the emulator is run again by the next command that runs any
+            if (command->type != EMULATOR_CALL && command->type != EMULATOR_PAUSE)
+            {
+                thread->illegal_pc = -1;
+            }
+
+            switch (command->type)
+            {
+            case EMULATOR_RUN:
+                running = 1;
+                stepping = 0;
+                break;
+            case EMULATOR_PAUSE:
+                nes_cancel_step(nes);
+                running = 0;
+                break;
+            case EMULATOR_STEP:
+                if (!running && execute_instruction(nes) < 0)
+                {
+                    thread->illegal_pc = nes->cpu->pc;
+                }
+                else if (!running)
+                {
+                    nes_breakpoint_hit(nes);
+                }
+                break;
+            case EMULATOR_STEP_OVER:
+                if (!running)
+                {
+                    int done = nes_step_over(nes);
+
+                    thread->illegal_pc = done < 0 ? nes->cpu->pc : -1;
+                    running = stepping = !done;
+                }
+                break;
+            case EMULATOR_STEP_OUT:
+                if (!running)
+                {
+                    nes_step_out(nes);
+                    running = stepping = 1;
+                }
+                break;
+            case EMULATOR_RUN_TO:
+                if (!running)
+                {
+                    nes_run_to(nes, command->address);
+                    running = stepping = 1;
+                }
+                break;
+            case EMULATOR_LOAD_ROM:
+                load_rom(nes, command->filename);
+                g_free(command->filename);
+                thread->rom_loads++;
+
+                if (nes->xrefs)
+                {
+                    xref_log_clear(nes->xrefs);
+                }
+                break;
+            case EMULATOR_CALL:
+                command->call(nes, command->data);
+                break;
+            case EMULATOR_QUIT:
+                g_free(command);
+                return NULL;
+            }
+
+            g_free(command);
+
+            if (!stepping)
+            {
+                emulator_thread_publish(thread, running);
+            }
+            continue;
+        }
+
+        int stopped = nes_run(nes, EMULATOR_BATCH_INSTRUCTIONS);
+
+        if (stopped)
+        {
+            thread->illegal_pc = stopped < 0 ? nes->cpu->pc : -1;
+            running = stepping = 0;
+            emulator_thread_publish(thread, 0);
+        }
+        else if (!stepping && nes->ppu->frame_number != frame_number)
+        {
+            frame_number = nes->ppu->frame_number;
+
+            // Nothing to gain copying a frame the UI will not see, it has not taken the last one
+            if (g_atomic_int_get(&thread->middle) & SNAPSHOT_FRESH)
+            {
+                emulator_thread_drain_logs(thread);
+                emulator_thread_drain_xrefs(thread);
+            }
+            else
+            {
+                emulator_thread_publish(thread, 1);
+            }
+        }
+    }
+}
+
+EMULATOR_THREAD *create_emulator_thread(NES *nes, GSourceFunc published, gpointer published_data)
+{
+    EMULATOR_THREAD *thread = g_new0(EMULATOR_THREAD, 1);
+
+    thread->nes = nes;
+    thread->commands = g_async_queue_new();
+    thread->logs = g_async_queue_new_full(g_free);
+    thread->xrefs = g_async_queue_new_full(g_free);
+    thread->back = 0;
+    thread->middle = 1;
+    thread->front = 2;
+    thread->published = published;
+    thread->published_data = published_data;
+    thread->illegal_pc = -1;
+
+    // The view starts as a copy of the powered-on NES, with the breakpoints the UI edits
+    thread->view.cpu = *nes->cpu;
+    thread->view.memory = *nes->memory;
+    thread->view.ppu = *nes->ppu;
+    thread->view.ppu_memory = *nes->ppu_memory;
+    thread->view.scheduler = *nes->scheduler;
+    thread->view.illegal_pc = -1;
+
+    if (nes->cdl)
+    {
+        thread->view.cdl = *nes->cdl;
+    }
+
+    emulator_snapshot_wire(&thread->view);
+
+    thread->view_breakpoints = create_breakpoints();
+    thread->view.nes.breakpoints = thread->view_breakpoints;
+
+    thread->thread = g_thread_new("emulator", emulator_thread_main, thread);
+
+    return thread;
+}
+
+static void emulator_thread_push(EMULATOR_THREAD *thread, EMULATOR_COMMAND *command)
+{
+    EMULATOR_COMMAND *copy = g_new(EMULATOR_COMMAND, 1);
+    *copy = *command;
+
+    g_async_queue_push(thread->commands, copy);
+}
+
+void emulator_thread_send(EMULATOR_THREAD *thread, enum EMULATOR_COMMAND_TYPE type)
+{
+    EMULATOR_COMMAND command = {type};
+
+    emulator_thread_push(thread, &command);
+}
+
+void emulator_thread_run_to(EMULATOR_THREAD *thread, unsigned short address)
+{
+    EMULATOR_COMMAND command = {EMULATOR_RUN_TO, .address = address};
+
+    emulator_thread_push(thread, &command);
+}
+
+void emulator_thread_load_rom(EMULATOR_THREAD *thread, const char *filename)
+{
+    EMULATOR_COMMAND command = {EMULATOR_LOAD_ROM, .filename = g_strdup(filename)};
+
+    emulator_thread_push(thread, &command);
+}
+
+// The call owns data and runs between two instruction batches
+void emulator_thread_call(EMULATOR_THREAD *thread, void (*call)(NES *nes, void *data), void *data)
+{
+    EMULATOR_COMMAND command = {EMULATOR_CALL, .call = call, .data = data};
+
+    emulator_thread_push(thread, &command);
+}
+
+// Parts of the state that differ between the view and a newer snapshot
+static guint64 emulator_snapshot_changes(EMULATOR_THREAD *thread, EMULATOR_SNAPSHOT *view, EMULATOR_SNAPSHOT *snapshot)
+{
+    guint64 changes = 0;
+
+    for (unsigned int page = 0; page < 8; page++)
+    {
+        if (memcmp(view->memory.ram + page * 256, snapshot->memory.ram + page * 256, 256))
+        {
+            changes |= STATE_RAM_PAGE(page);
+        }
+    }
+
+    CPU *old_cpu = &view->cpu;
+    CPU *cpu = &snapshot->cpu;
+
+    if (old_cpu->registerA != cpu->registerA || old_cpu->registerX != cpu->registerX || old_cpu->registerY != cpu->registerY ||
+        old_cpu->registerP != cpu->registerP || old_cpu->pc != cpu->pc || old_cpu->sp != cpu->sp || old_cpu->cycles != cpu->cycles ||
+        view->illegal_pc != snapshot->illegal_pc)
+    {
+        changes |= STATE_CPU;
+    }
+
+    PPU *old_ppu = &view->ppu;
+    PPU *ppu = &snapshot->ppu;
+
+    if (old_ppu->control_register != ppu->control_register || old_ppu->mask_register != ppu->mask_register ||
+        old_ppu->status_register != ppu->status_register || old_ppu->address != ppu->address)
+    {
+        changes |= STATE_PPU_REGISTERS;
+    }
+
+    if (old_ppu->scanline != ppu->scanline || old_ppu->dot != ppu->dot || old_ppu->frame_number != ppu->frame_number)
+    {
+        changes |= STATE_PPU_TIMING;
+    }
+
+    if (memcmp(old_ppu->spr_ram, ppu->spr_ram, sizeof(ppu->spr_ram)))
+    {
+        changes |= STATE_OAM;
+    }
+
+    PPU_MEMORY *old_ppu_memory = &view->ppu_memory;
+    PPU_MEMORY *ppu_memory = &snapshot->ppu_memory;
+
+    if (memcmp(old_ppu_memory->pattern_table_0, ppu_memory->pattern_table_0, sizeof(ppu_memory->pattern_table_0)) ||
+        memcmp(old_ppu_memory->pattern_table_1, ppu_memory->pattern_table_1, sizeof(ppu_memory->pattern_table_1)))
+    {
+        changes |= STATE_PATTERN_TABLES;
+    }
+
+    if (memcmp(old_ppu_memory->name_tables, ppu_memory->name_tables, sizeof(ppu_memory->name_tables)))
+    {
+        changes |= STATE_NAME_TABLES;
+    }
+
+    if (memcmp(old_ppu_memory->palettes, ppu_memory->palettes, sizeof(ppu_memory->palettes)))
+    {
+        changes |= STATE_PALETTES;
+    }
+
+    if (memcmp(view->memory.prg_rom_lower_bank, snapshot->memory.prg_rom_lower_bank, sizeof(snapshot->memory.prg_rom_lower_bank)) ||
+        memcmp(view->memory.prg_rom_upper_bank, snapshot->memory.prg_rom_upper_bank, sizeof(snapshot->memory.prg_rom_upper_bank)))
+    {
+        changes |= STATE_PRG_ROM;
+    }
+
+    for (int type = 0; type < NB_EVENT_TYPES; type++)
+    {
+        if (scheduler_is_scheduled(&view->scheduler, type) != scheduler_is_scheduled(&snapshot->scheduler, type))
+        {
+            changes |= STATE_SCHEDULER;
+        }
+    }
+
+    if (memcmp(&view->cdl, &snapshot->cdl, sizeof(snapshot->cdl)))
+    {
+        changes |= STATE_CDL;
+    }
+
+    if (g_async_queue_length(thread->logs) > 0)
+    {
+        changes |= STATE_BREAKPOINTS;
+    }
+
+    // Breakpoint edits not applied by the thread yet leave the counts out of step, keep the old ones
+    if (snapshot->breakpoint_count == thread->view_breakpoints->count)
+    {
+        for (unsigned int i = 0; i < snapshot->breakpoint_count; i++)
+        {
+            if (thread->view_breakpoints->list[i].hits != snapshot->hits[i])
+            {
+                thread->view_breakpoints->list[i].hits = snapshot->hits[i];
+                changes |= STATE_BREAKPOINTS;
+            }
+        }
+    }
+
+    return changes;
+}
+
+// Takes the newest snapshot as the view, returns the parts that changed, 0 when nothing new was published
+guint64 emulator_thread_refresh_view(EMULATOR_THREAD *thread)
+{
+    g_atomic_int_set(&thread->refresh_queued, 0);
+
+    if (!(g_atomic_int_get(&thread->middle) & SNAPSHOT_FRESH))
+    {
+        return 0;
+    }
+
+    thread->front = atomic_exchange(&thread->middle, thread->front) & SNAPSHOT_INDEX;
+
+    EMULATOR_SNAPSHOT *snapshot = &thread->slots[thread->front];
+    EMULATOR_SNAPSHOT *view = &thread->view;
+    guint64 changes = emulator_snapshot_changes(thread, view, snapshot);
+
+    view->cpu = snapshot->cpu;
+    view->memory = snapshot->memory;
+    view->ppu = snapshot->ppu;
+    view->ppu_memory = snapshot->ppu_memory;
+    view->scheduler = snapshot->scheduler;
+    view->cdl = snapshot->cdl;
+    view->running = snapshot->running;
+    view->illegal_pc = snapshot->illegal_pc;
+    emulator_snapshot_wire(view);
+
+    return changes;
+}
+
+// Parts a view of the CPU address range depends on
+guint64 emulator_state_cpu_range(unsigned short start, unsigned int length)
+{
+    guint64 parts = 0;
+
+    for (unsigned int address = start & 0xff00; address < (unsigned int)start + length; address += 0x100)
+    {
+        unsigned short wrapped = address;
+
+        if (wrapped < 0x2000)
+        {
+            parts |= STATE_RAM_PAGE((wrapped & 0x7ff) >> 8);
+        }
+        else if (wrapped < 0x4000)
+        {
+            parts |= STATE_PPU_REGISTERS;
+        }
+        else if (wrapped >= 0x8000)
+        {
+            parts |= STATE_PRG_ROM;
+        }
+    }
+
+    return parts;
+}
+
+// Next logpoint line, NULL when there is none, to be freed with g_free
+char *emulator_thread_pop_log(EMULATOR_THREAD *thread)
+{
+    return g_async_queue_try_pop(thread->logs);
+}
+
+// Next batch of references seen at runtime, NULL when there is none, to be freed with g_free
+XREF_BATCH *emulator_thread_pop_xrefs(EMULATOR_THREAD *thread)
+{
+    return g_async_queue_try_pop(thread->xrefs);
+}
+
+void emulator_thread_quit(EMULATOR_THREAD *thread)
+{
+    emulator_thread_send(thread, EMULATOR_QUIT);
+    g_thread_join(thread->thread);
+}
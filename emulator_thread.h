@@ -0,0 +1,117 @@
+#ifndef _EMULATOR_THREAD_H_
+#define _EMULATOR_THREAD_H_
+
+#include <glib.h>
+
+#include "nes.h"
+
+#define EMULATOR_BATCH_INSTRUCTIONS 1000 // instructions run between two looks at the command queue
+#define NB_SNAPSHOTS 3
+
+// Parts of the published state, a bit is set in the mask returned by a refresh when the part changed
+#define STATE_RAM_PAGE(page) ((guint64)1 << (page)) // 8 pages of 256 bytes, mirrors excluded
+#define STATE_CPU ((guint64)1 << 8)
+#define STATE_PPU_REGISTERS ((guint64)1 << 9)
+#define STATE_PPU_TIMING ((guint64)1 << 10) // scanline, dot and frame number
+#define STATE_OAM ((guint64)1 << 11)
+#define STATE_PATTERN_TABLES ((guint64)1 << 12)
+#define STATE_NAME_TABLES ((guint64)1 << 13)
+#define STATE_PALETTES ((guint64)1 << 14)
+#define STATE_PRG_ROM ((guint64)1 << 15)
+#define STATE_SCHEDULER ((guint64)1 << 16)
+#define STATE_BREAKPOINTS ((guint64)1 << 17) // hit counts or pending logpoint lines
+#define STATE_XREFS ((guint64)1 << 18)       // cross-references, marked by the UI when it merges new ones
+#define STATE_CDL ((guint64)1 << 19)         // code/data log
+#define STATE_SYMBOLS ((guint64)1 << 20)     // debug info, marked by the UI when it loads some
+#define NB_STATE_PARTS 21
+#define STATE_ALL (((guint64)1 << NB_STATE_PARTS) - 1)
+
+enum EMULATOR_COMMAND_TYPE
+{
+    EMULATOR_RUN,
+    EMULATOR_PAUSE,
+    EMULATOR_STEP,
+    EMULATOR_STEP_OVER,
+    EMULATOR_STEP_OUT,
+    EMULATOR_RUN_TO,
+    EMULATOR_LOAD_ROM,
+    EMULATOR_CALL,
+    EMULATOR_QUIT
+};
+
+typedef struct
+{
+    enum EMULATOR_COMMAND_TYPE type;
+    unsigned short address;              // EMULATOR_RUN_TO
+    char *filename;                      // EMULATOR_LOAD_ROM, freed by the emulation thread
+    void (*call)(NES *nes, void *data); // EMULATOR_CALL, runs on the emulation thread
+    void *data;
+} EMULATOR_COMMAND;
+
+// References logged by the emulation thread, for the ROM it had loaded rom_loads times
+typedef struct
+{
+    unsigned int rom_loads;
+    unsigned int count;
+    XREF xrefs[];
+} XREF_BATCH;
+
+/*
+ * Copy of the emulator state published by the emulation thread. The NES and the parts it
+ * points to are wired to the copies, so the windows read it exactly like the real one.
+ */
+typedef struct
+{
+    NES nes;
+    CPU cpu;
+    MEMORY memory;
+    PPU ppu;
+    PPU_MEMORY ppu_memory;
+    SCHEDULER scheduler;
+    WATCHPOINTS watchpoints; // always empty, reads of the copy must not hit the real watchpoints
+    CDL cdl;                 // read through nes.cdl, which is NULL when the NES does not log, never marked
+    unsigned long *hits;     // hit count of each breakpoint
+    unsigned int breakpoint_count;
+    unsigned int hits_capacity;
+    int running;
+    int illegal_pc; // of the instruction that could not be run and stopped the emulator, -1 when none did
+} EMULATOR_SNAPSHOT;
+
+/*
+ * The emulator runs on its own thread, commands reach it through a queue and it publishes
+ * snapshots through a triple buffer: the thread fills its back slot and swaps it with the
+ * middle one, the UI swaps the middle slot with its front one when it is newer. Neither side
+ * ever waits for the other.
+ */
+typedef struct
+{
+    NES *nes; // only touched by the emulation thread once started
+    GThread *thread;
+    GAsyncQueue *commands;
+    GAsyncQueue *logs;      // logpoint lines, oldest first
+    GAsyncQueue *xrefs;     // XREF_BATCH of references seen at runtime
+    unsigned int rom_loads; // ROMs loaded by the emulation thread
+    int illegal_pc;         // published with the snapshots, only touched by the emulation thread
+    EMULATOR_SNAPSHOT slots[NB_SNAPSHOTS];
+    int back;                    // emulation thread slot
+    int front;                   // UI slot
+    gint middle;                 // shared slot index, with SNAPSHOT_FRESH when the UI has not taken it yet
+    gint refresh_queued;         // a call to published is pending on the main loop
+    EMULATOR_SNAPSHOT view;      // what the windows read, refreshed from the front slot
+    BREAKPOINTS *view_breakpoints; // breakpoints as the UI set them, hits copied from the snapshots
+    GSourceFunc published;       // called on the main loop after a publication
+    gpointer published_data;
+} EMULATOR_THREAD;
+
+EMULATOR_THREAD *create_emulator_thread(NES *nes, GSourceFunc published, gpointer published_data);
+void emulator_thread_send(EMULATOR_THREAD *thread, enum EMULATOR_COMMAND_TYPE type);
+void emulator_thread_run_to(EMULATOR_THREAD *thread, unsigned short address);
+void emulator_thread_load_rom(EMULATOR_THREAD *thread, const char *filename);
+void emulator_thread_call(EMULATOR_THREAD *thread, void (*call)(NES *nes, void *data), void *data);
+guint64 emulator_thread_refresh_view(EMULATOR_THREAD *thread);
+guint64 emulator_state_cpu_range(unsigned short start, unsigned int length);
+char *emulator_thread_pop_log(EMULATOR_THREAD *thread);
+XREF_BATCH *emulator_thread_pop_xrefs(EMULATOR_THREAD *thread);
+void emulator_thread_quit(EMULATOR_THREAD *thread);
+
+#endif
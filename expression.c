@@ -0,0 +1,301 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "expression.h"
+
+typedef struct
+{
+    const char *text;
+    EXPRESSION *expression;
+    unsigned int capacity;
+    int depth;
+    int nesting; // parse_unary calls in progress
+    int error;
+} PARSER;
+
+typedef struct
+{
+    const char *token;
+    enum EXPRESSION_OPCODE opcode;
+} EXPRESSION_TOKEN;
+
+static const EXPRESSION_TOKEN VARIABLES[] = {
+    {"a", EXPR_REGISTER_A},
+    {"x", EXPR_REGISTER_X},
+    {"y", EXPR_REGISTER_Y},
+    {"p", EXPR_REGISTER_P},
+    {"sp", EXPR_REGISTER_SP},
+    {"pc", EXPR_REGISTER_PC},
+    {"cycles", EXPR_CYCLES},
+    {"frame", EXPR_FRAME},
+    {"scanline", EXPR_SCANLINE},
+    {"dot", EXPR_DOT},
+};
+
+// Binary operators from the lowest to the highest precedence, as in C. Longer tokens first.
+#define NB_PRECEDENCE_LEVELS 8
+
+static const EXPRESSION_TOKEN BINARY_OPERATORS[NB_PRECEDENCE_LEVELS][5] = {
+    {{"||", EXPR_OR}},
+    {{"&&", EXPR_AND}},
+    {{"|", EXPR_BIT_OR}},
+    {{"^", EXPR_BIT_XOR}},
+    {{"&", EXPR_BIT_AND}},
+    {{"==", EXPR_EQUAL}, {"!=", EXPR_NOT_EQUAL}},
+    {{"<=", EXPR_LESS_EQUAL}, {">=", EXPR_GREATER_EQUAL}, {"<", EXPR_LESS}, {">", EXPR_GREATER}},
+    {{"+", EXPR_ADD}, {"-", EXPR_SUBTRACT}},
+};
+
+static const EXPRESSION_TOKEN MULTIPLICATIVE_OPERATORS[] = {
+    {"*", EXPR_MULTIPLY},
+    {"/", EXPR_DIVIDE},
+    {"%", EXPR_MODULO},
+};
+
+static void emit(PARSER *parser, enum EXPRESSION_OPCODE opcode, long value)
+{
+    EXPRESSION *expression = parser->expression;
+
+    if (expression->count == parser->capacity)
+    {
+        parser->capacity = parser->capacity ? parser->capacity * 2 : 16;
+        expression->ops = realloc(expression->ops, parser->capacity * sizeof(EXPRESSION_OP));
+    }
+
+    expression->ops[expression->count].opcode = opcode;
+    expression->ops[expression->count].value = value;
+    expression->count++;
+
+    // Operands push one value, unary operators keep the depth, binary ones pop one
+    if (opcode <= EXPR_DOT)
+    {
+        parser->depth++;
+    }
+    else if (opcode >= EXPR_MULTIPLY)
+    {
+        parser->depth--;
+    }
+
+    if (parser->depth > EXPRESSION_MAX_DEPTH)
+    {
+        parser->error = 1;
+    }
+}
+
+static void skip_spaces(PARSER *parser)
+{
+    while (isspace((unsigned char)*parser->text))
+    {
+        parser->text++;
+    }
+}
+
+static int accept(PARSER *parser, const char *token)
+{
+    skip_spaces(parser);
+
+    size_t length = strlen(token);
+
+    if (strncmp(parser->text, token, length))
+    {
+        return 0;
+    }
+
+    // "|" must not match the start of "||", same for "&"
+    if (length == 1 && (*token == '|' || *token == '&') && parser->text[1] == *token)
+    {
+        return 0;
+    }
+
+    parser->text += length;
+
+    return 1;
+}
+
+static void parse_binary(PARSER *parser, int level);
+static void parse_unary(PARSER *parser);
+
+static void parse_operand(PARSER *parser)
+{
+    skip_spaces(parser);
+
+    const char *text = parser->text;
+
+    if (accept(parser, "-"))
+    {
+        parse_unary(parser);
+        emit(parser, EXPR_NEGATE, 0);
+    }
+    else if (accept(parser, "!"))
+    {
+        parse_unary(parser);
+        emit(parser, EXPR_NOT, 0);
+    }
+    else if (accept(parser, "~"))
+    {
+        parse_unary(parser);
+        emit(parser, EXPR_COMPLEMENT, 0);
+    }
+    else if (accept(parser, "("))
+    {
+        parse_binary(parser, 0);
+
+        if (!accept(parser, ")"))
+        {
+            parser->error = 1;
+        }
+    }
+    else if (accept(parser, "["))
+    {
+        parse_binary(parser, 0);
+        emit(parser, EXPR_READ, 0);
+
+        if (!accept(parser, "]"))
+        {
+            parser->error = 1;
+        }
+    }
+    else if (*text == '$' || *text == '%' || isdigit((unsigned char)*text))
+    {
+        int base = *text == '$' ? 16 : *text == '%' ? 2 : 10;
+        char *end;
+
+        long value = strtol(base == 10 ? text : text + 1, &end, base);
+
+        if (end == text + (base != 10))
+        {
+            parser->error = 1;
+        }
+
+        parser->text = end;
+        emit(parser, EXPR_CONSTANT, value);
+    }
+    else if (isalpha((unsigned char)*text))
+    {
+        size_t length = 0;
+
+        while (isalnum((unsigned char)text[length]))
+        {
+            length++;
+        }
+
+        parser->text += length;
+
+        for (unsigned int i = 0; i < sizeof(VARIABLES) / sizeof(VARIABLES[0]); i++)
+        {
+            if (strlen(VARIABLES[i].token) == length && !strncasecmp(VARIABLES[i].token, text, length))
+            {
+                emit(parser, VARIABLES[i].opcode, 0);
+                return;
+            }
+        }
+
+        parser->error = 1;
+    }
+    else
+    {
+        parser->error = 1;
+    }
+}
+
+// Each level of nesting recurses through every precedence level, so it is bounded like the stack depth
+static void parse_unary(PARSER *parser)
+{
+    if (parser->nesting == EXPRESSION_MAX_NESTING)
+    {
+        parser->error = 1;
+        return;
+    }
+
+    parser->nesting++;
+    parse_operand(parser);
+    parser->nesting--;
+}
+
+static void parse_multiplicative(PARSER *parser)
+{
+    parse_unary(parser);
+
+    while (!parser->error)
+    {
+        unsigned int i = 0;
+
+        while (i < sizeof(MULTIPLICATIVE_OPERATORS) / sizeof(MULTIPLICATIVE_OPERATORS[0]) &&
+               !accept(parser, MULTIPLICATIVE_OPERATORS[i].token))
+        {
+            i++;
+        }
+
+        if (i == sizeof(MULTIPLICATIVE_OPERATORS) / sizeof(MULTIPLICATIVE_OPERATORS[0]))
+        {
+            return;
+        }
+
+        parse_unary(parser);
+        emit(parser, MULTIPLICATIVE_OPERATORS[i].opcode, 0);
+    }
+}
+
+static void parse_binary(PARSER *parser, int level)
+{
+    if (level == NB_PRECEDENCE_LEVELS)
+    {
+        parse_multiplicative(parser);
+        return;
+    }
+
+    parse_binary(parser, level + 1);
+
+    while (!parser->error)
+    {
+        const EXPRESSION_TOKEN *operator = BINARY_OPERATORS[level];
+
+        while (operator->token && !accept(parser, operator->token))
+        {
+            operator++;
+        }
+
+        if (!operator->token)
+        {
+            return;
+        }
+
+        parse_binary(parser, level + 1);
+        emit(parser, operator->opcode, 0);
+    }
+}
+
+EXPRESSION *create_expression(const char *source)
+{
+    EXPRESSION *expression = malloc(sizeof(EXPRESSION));
+    expression->source = strdup(source);
+    expression->ops = NULL;
+    expression->count = 0;
+
+    PARSER parser = {source, expression, 0, 0, 0, 0};
+
+    parse_binary(&parser, 0);
+    skip_spaces(&parser);
+
+    if (parser.error || *parser.text)
+    {
+        free_expression(expression);
+        return NULL;
+    }
+
+    return expression;
+}
+
+void free_expression(EXPRESSION *expression)
+{
+    if (!expression)
+    {
+        return;
+    }
+
+    free(expression->source);
+    free(expression->ops);
+    free(expression);
+}
@@ -0,0 +1,62 @@
+#ifndef _EXPRESSION_H_
+#define _EXPRESSION_H_
+
+#define EXPRESSION_MAX_DEPTH 32   // values on the evaluation stack
+#define EXPRESSION_MAX_NESTING 64 // parentheses, brackets and unary operators inside one another
+
+enum EXPRESSION_OPCODE
+{
+    EXPR_CONSTANT,
+    EXPR_REGISTER_A,
+    EXPR_REGISTER_X,
+    EXPR_REGISTER_Y,
+    EXPR_REGISTER_P,
+    EXPR_REGISTER_SP,
+    EXPR_REGISTER_PC,
+    EXPR_CYCLES,
+    EXPR_FRAME,
+    EXPR_SCANLINE,
+    EXPR_DOT,
+    EXPR_READ, // replaces the address on top of the stack by the byte at that CPU address
+    EXPR_NEGATE,
+    EXPR_NOT,
+    EXPR_COMPLEMENT,
+    EXPR_MULTIPLY,
+    EXPR_DIVIDE,
+    EXPR_MODULO,
+    EXPR_ADD,
+    EXPR_SUBTRACT,
+    EXPR_LESS,
+    EXPR_LESS_EQUAL,
+    EXPR_GREATER,
+    EXPR_GREATER_EQUAL,
+    EXPR_EQUAL,
+    EXPR_NOT_EQUAL,
+    EXPR_BIT_AND,
+    EXPR_BIT_XOR,
+    EXPR_BIT_OR,
+    EXPR_AND,
+    EXPR_OR
+};
+
+typedef struct
+{
+    unsigned char opcode;
+    long value; // EXPR_CONSTANT only
+} EXPRESSION_OP;
+
+/*
+ * Condition or watch expression compiled once to a postfix program, e.g.
+ * "A == $10 && [$0300] > 5 && frame > 120". Evaluated by nes_evaluate without any parsing.
+ */
+typedef struct
+{
+    char *source;
+    EXPRESSION_OP *ops;
+    unsigned int count;
+} EXPRESSION;
+
+EXPRESSION *create_expression(const char *source); // NULL on syntax error
+void free_expression(EXPRESSION *expression);
+
+#endif
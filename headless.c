@@ -0,0 +1,977 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "headless.h"
+#include "nes.h"
+#include "analyzer.h"
+#include "assembler.h"
+#include "disassembler.h"
+#include "timing.h"
+#include "trace.h"
+
+#define BENCHMARK_IMAGE_SIZE (1024 * 1024) // bytes disassembled by each pass of the disassembler benchmark
+#define BENCHMARK_SECONDS 0.5
+#define BENCHMARK_OAM_IMAGES 256 // sprite tables evaluated by each pass of the sprite benchmark
+#define MAPPING_TEST_CHR 0x5a    // every CHR byte of the mapping test ROMs
+
+typedef struct
+{
+    const char *rom_filename;
+    unsigned long frames;
+    unsigned long render_every;       // draw one frame out of render_every, 0 = never
+    int benchmark;                    // also run every frame rendered and report the gain
+    const char *disassembly_filename; // analyze the ROM and write its source instead of running it
+    const char *cdl_filename;         // code/data log added to by the run, created when missing
+    int disassembly_benchmark;        // time the disassembly of the PRG instead of running it
+    int sprite_benchmark;             // time and compare both sprite evaluations, no ROM needed
+    int prg_mapping_test;             // check 16 and 32 KB ROMs are logged where they are mapped, no ROM needed
+    int export_test;                  // assemble exported sources back, of generated ROMs and of the ROM if given
+    int timing;                       // report the cycle counts of the routines instead of running it
+    const char *trace_filename;       // binary trace of the run
+    TRACE_FILTER trace_filter;        // instructions the trace keeps
+    const char *text_trace_filename;  // binary trace printed as text, instead of running a ROM
+    const char *trace_query;          // prints only the records it matches, with their index
+} HEADLESS_OPTIONS;
+
+static void usage()
+{
+    fprintf(stderr, "Usage: NesDebugger --headless [--frames N] [--render-every N] [--benchmark] [--disassemble out.s] [--cdl log.cdl]\n"
+                    "                             [--disassembly-benchmark] [--timing] [--trace out.trace [--trace-filter FILTER]] rom.nes\n"
+                    "       NesDebugger --headless --sprite-benchmark | --prg-mapping-test | --export-test [rom.nes]\n"
+                    "       NesDebugger --headless --trace-to-text in.trace [--trace-find QUERY]\n"
+                    "FILTER is like \"pc=8000-80FF,C000 bank=1 depth=0-2 context=nmi frames=100-200\", every term optional\n"
+                    "QUERY is like \"pc=8000 a=3F x=00 y=00 p=24 sp=FD address=0200\", every term optional\n");
+}
+
+static int parse_options(int argc, char *argv[], HEADLESS_OPTIONS *options)
+{
+    options->rom_filename = NULL;
+    options->frames = 600;
+    options->render_every = 1;
+    options->benchmark = 0;
+    options->disassembly_filename = NULL;
+    options->cdl_filename = NULL;
+    options->disassembly_benchmark = 0;
+    options->sprite_benchmark = 0;
+    options->prg_mapping_test = 0;
+    options->export_test = 0;
+    options->timing = 0;
+    options->trace_filename = NULL;
+    trace_filter_init(&options->trace_filter);
+    options->text_trace_filename = NULL;
+    options->trace_query = NULL;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            options->frames = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--render-every") == 0 && i + 1 < argc)
+        {
+            options->render_every = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--benchmark") == 0)
+        {
+            options->benchmark = 1;
+        }
+        else if (strcmp(argv[i], "--disassemble") == 0 && i + 1 < argc)
+        {
+            options->disassembly_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--disassembly-benchmark") == 0)
+        {
+            options->disassembly_benchmark = 1;
+        }
+        else if (strcmp(argv[i], "--sprite-benchmark") == 0)
+        {
+            options->sprite_benchmark = 1;
+        }
+        else if (strcmp(argv[i], "--prg-mapping-test") == 0)
+        {
+            options->prg_mapping_test = 1;
+        }
+        else if (strcmp(argv[i], "--export-test") == 0)
+        {
+            options->export_test = 1;
+        }
+        else if (strcmp(argv[i], "--timing") == 0)
+        {
+            options->timing = 1;
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            options->trace_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace-filter") == 0 && i + 1 < argc)
+        {
+            if (trace_filter_parse(&options->trace_filter, argv[++i]) < 0)
+            {
+                fprintf(stderr, "Bad trace filter: %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--trace-to-text") == 0 && i + 1 < argc)
+        {
+            options->text_trace_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace-find") == 0 && i + 1 < argc)
+        {
+            options->trace_query = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cdl") == 0 && i + 1 < argc)
+        {
+            options->cdl_filename = argv[++i];
+        }
+        else if (argv[i][0] != '-' && !options->rom_filename)
+        {
+            options->rom_filename = argv[i];
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return options->rom_filename || options->text_trace_filename || options->sprite_benchmark || options->prg_mapping_test ||
+                   options->export_test
+               ? 0
+               : -1;
+}
+
+static double elapsed_seconds(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Adds what an earlier run logged, a missing file is a first run
+static int load_code_data_log(NES *nes, const char *cdl_filename)
+{
+    unsigned char prg[CDL_MAX_PRG_SIZE];
+    FILE *file = fopen(cdl_filename, "rb");
+
+    if (!file)
+    {
+        return 0;
+    }
+
+    nes_peek_range(nes, WATCH_BUS_CPU, PRG_ROM_LOWER_BANK, prg, nes->cdl->prg_size);
+    int result = cdl_load(nes->cdl, file, prg);
+    fclose(file);
+
+    if (result < 0)
+    {
+        fprintf(stderr, "%s is not the code/data log of this ROM\n", cdl_filename);
+    }
+
+    return result;
+}
+
+static int save_code_data_log(NES *nes, const char *cdl_filename)
+{
+    CDL *cdl = nes->cdl;
+    FILE *file = fopen(cdl_filename, "wb");
+    int result = file ? cdl_save(cdl, file) : -1;
+
+    if (file)
+    {
+        result |= fclose(file);
+    }
+
+    if (result < 0)
+    {
+        fprintf(stderr, "Cannot write %s\n", cdl_filename);
+        return -1;
+    }
+
+    printf("Code/data log: %u opcode, %u operand and %u data bytes of %u KB PRG, %u of %u CHR bytes rendered\n",
+           cdl_count(cdl->opcodes, cdl->prg_size), cdl_count(cdl->operands, cdl->prg_size),
+           cdl_count(cdl->data, cdl->prg_size), cdl->prg_size / 1024, cdl_count(cdl->rendered, cdl->chr_size), cdl->chr_size);
+
+    return 0;
+}
+
+// Closes the trace of the run, returns -1 when it could not be written
+static int close_trace_recorder(NES *nes, const char *trace_filename)
+{
+    trace_writer_flush(nes->recorder);
+
+    unsigned long long record_count = nes->recorder->header.record_count;
+    unsigned long long size = nes->recorder->size;
+
+    if (close_trace_writer(nes->recorder) < 0)
+    {
+        fprintf(stderr, "Cannot write %s\n", trace_filename);
+        return -1;
+    }
+
+    nes->recorder = NULL;
+    printf("Trace: %llu instructions in %.1f MB, %.1f bytes each\n", record_count, size / 1e6,
+           record_count ? (double)size / record_count : 0);
+
+    return 0;
+}
+
+/*
+ * Runs the frames of a freshly loaded ROM and returns the frames per second, or a negative value
+ * on error. Rendered frames are converted to RGB like a front-end would do before display. With
+ * a code/data log, the run adds what it sees to the file. With a trace, it records the
+ * instructions the filter keeps up to the last frame or the one that stopped the run.
+ */
+static double run_frames(const char *rom_filename, unsigned long frames, unsigned long render_every, const char *cdl_filename,
+                         const char *trace_filename, const TRACE_FILTER *trace_filter)
+{
+    static unsigned char rgb[SCREEN_WIDTH * SCREEN_HEIGHT * 3];
+    struct timespec start;
+
+    NES *nes = create_nes();
+    nes->trace = 0;
+
+    if (cdl_filename)
+    {
+        nes_set_cdl(nes, create_cdl());
+    }
+
+    if (load_rom(nes, rom_filename) < 0)
+    {
+        fprintf(stderr, "Cannot open %s\n", rom_filename);
+        return -1;
+    }
+
+    if (cdl_filename && load_code_data_log(nes, cdl_filename) < 0)
+    {
+        return -1;
+    }
+
+    if (trace_filename && !(nes->recorder = create_trace_writer(trace_filename, trace_filter, nes->memory->prg_size)))
+    {
+        fprintf(stderr, "Cannot create %s\n", trace_filename);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned long frame = 0; frame < frames; frame++)
+    {
+        unsigned char render = render_every && frame % render_every == 0;
+
+        if (nes_run_frame(nes, render) < 0)
+        {
+            fprintf(stderr, "Stopped at frame %lu, PC $%04X\n", frame, nes->cpu->pc);
+
+            if (nes->recorder)
+            {
+                close_trace_recorder(nes, trace_filename);
+            }
+
+            return -1;
+        }
+
+        if (render)
+        {
+            ppu_frame_to_rgb(nes->ppu, rgb);
+        }
+    }
+
+    double fps = frames / elapsed_seconds(&start);
+
+    if (nes->recorder && close_trace_recorder(nes, trace_filename) < 0)
+    {
+        return -1;
+    }
+
+    if (cdl_filename && save_code_data_log(nes, cdl_filename) < 0)
+    {
+        return -1;
+    }
+
+    return fps;
+}
+
+// Prints the records the query matches after their index, damaged blocks are skipped
+static int find_in_trace(TRACE_READER *reader, const char *text)
+{
+    TRACE_QUERY query;
+    char line[128];
+    long long index = -1;
+
+    if (trace_query_parse(&query, text) < 0)
+    {
+        fprintf(stderr, "Bad trace query: %s\n", text);
+        return -1;
+    }
+
+    while ((index = trace_search(reader, &query, index + 1, reader->header->record_count)) >= 0)
+    {
+        trace_record_to_str(trace_record(reader, index), line, sizeof(line));
+        printf("%lld: %s\n", index, line);
+    }
+
+    return 0;
+}
+
+// Prints each record of a binary trace as a nestest-style line, or only those a query matches
+static int print_trace(const char *trace_filename, const char *query)
+{
+    TRACE_READER *reader = open_trace(trace_filename);
+    char line[128];
+
+    if (!reader)
+    {
+        fprintf(stderr, "%s is not a complete trace\n", trace_filename);
+        return -1;
+    }
+
+    if (query)
+    {
+        int result = find_in_trace(reader, query);
+
+        close_trace(reader);
+        return result;
+    }
+
+    for (unsigned long long i = 0; i < reader->header->record_count; i++)
+    {
+        const TRACE_RECORD *record = trace_record(reader, i);
+
+        if (!record)
+        {
+            fprintf(stderr, "%s is damaged from record %llu on\n", trace_filename, i);
+            close_trace(reader);
+            return -1;
+        }
+
+        trace_record_to_str(record, line, sizeof(line));
+        puts(line);
+    }
+
+    close_trace(reader);
+
+    return 0;
+}
+
+// Writes the ca65 source of the ROM found by the static analysis
+static int disassemble_rom(const char *rom_filename, const char *disassembly_filename)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    ANALYSIS *analysis = analyze_rom_file(rom_filename);
+    if (!analysis)
+    {
+        fprintf(stderr, "Cannot analyze %s\n", rom_filename);
+        return -1;
+    }
+
+    double seconds = elapsed_seconds(&start);
+    unsigned int labels = 0;
+
+    for (unsigned int offset = 0; offset < analysis->prg_size; offset++)
+    {
+        labels += analysis->labels[offset] != LABEL_NONE;
+    }
+
+    printf("%u KB PRG in %u banks analyzed in %.1f ms: %u code bytes, %u blocks, %u edges, %u labels\n",
+           analysis->prg_size / 1024, analysis->bank_count, seconds * 1000, analysis_code_bytes(analysis),
+           analysis->block_count, analysis->edge_count, labels);
+
+    FILE *file = fopen(disassembly_filename, "w");
+    int result = file ? analysis_export_ca65(analysis, file) : -1;
+
+    if (file)
+    {
+        result |= fclose(file);
+    }
+
+    if (result < 0)
+    {
+        fprintf(stderr, "Cannot write %s\n", disassembly_filename);
+        free_analysis(analysis);
+        return -1;
+    }
+
+    // The ld65 config goes next to the source, its extension replaced by .cfg
+    const char *base = strrchr(disassembly_filename, '/');
+    const char *extension = strrchr(base ? base : disassembly_filename, '.');
+    size_t length = extension ? (size_t)(extension - disassembly_filename) : strlen(disassembly_filename);
+    char *config_filename = malloc(length + sizeof(".cfg"));
+
+    memcpy(config_filename, disassembly_filename, length);
+    strcpy(config_filename + length, ".cfg");
+
+    file = fopen(config_filename, "w");
+    result = file ? analysis_export_ld65_config(analysis, file) : -1;
+
+    if (file)
+    {
+        result |= fclose(file);
+    }
+
+    if (result < 0)
+    {
+        fprintf(stderr, "Cannot write %s\n", config_filename);
+    }
+
+    free(config_filename);
+    free_analysis(analysis);
+
+    return result < 0 ? -1 : 0;
+}
+
+// Prints the cycle counts of the routines, returns how many NMI handlers can overrun the vertical blank
+static int report_timing(const char *rom_filename)
+{
+    ANALYSIS *analysis = analyze_rom_file(rom_filename);
+    if (!analysis)
+    {
+        fprintf(stderr, "Cannot analyze %s\n", rom_filename);
+        return -1;
+    }
+
+    TIMING *timing = create_timing(analysis);
+    int over_budget = timing_report(timing, stdout);
+
+    free_timing(timing);
+    free_analysis(analysis);
+
+    return over_budget;
+}
+
+/*
+ * Linear sweep over 1 MB made of copies of the PRG, written as listing lines into a buffer that
+ * is reused once full, like a file buffer would be.
+ */
+static int benchmark_disassembler(const char *rom_filename)
+{
+    static unsigned char image[BENCHMARK_IMAGE_SIZE];
+    static char listing[64 * 1024];
+    unsigned char header[INES_HEADER_SIZE];
+    FILE *file = fopen(rom_filename, "rb");
+    size_t prg_size = 0;
+
+    if (file && fread(header, 1, sizeof(header), file) == sizeof(header))
+    {
+        size_t size = header[4] * PRG_BANK_SIZE;
+        prg_size = fread(image, 1, size < BENCHMARK_IMAGE_SIZE ? size : BENCHMARK_IMAGE_SIZE, file);
+    }
+
+    if (file)
+    {
+        fclose(file);
+    }
+
+    if (!prg_size)
+    {
+        fprintf(stderr, "Cannot read %s\n", rom_filename);
+        return -1;
+    }
+
+    for (size_t offset = prg_size; offset < BENCHMARK_IMAGE_SIZE; offset++)
+    {
+        image[offset] = image[offset % prg_size];
+    }
+
+    unsigned long image_instructions = 0;
+
+    for (unsigned int offset = 0; offset < BENCHMARK_IMAGE_SIZE; offset += OPCODES[image[offset]].length)
+    {
+        image_instructions++;
+    }
+
+    struct timespec start;
+    unsigned long passes = 0;
+    unsigned long long text_size = 0;
+    double seconds;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    do
+    {
+        for (unsigned int offset = 0; offset < BENCHMARK_IMAGE_SIZE;)
+        {
+            unsigned int consumed;
+
+            text_size += dis_listing_to_str(image + offset, BENCHMARK_IMAGE_SIZE - offset, 0x8000 | (offset & 0x7fff),
+                                            listing, sizeof(listing), &consumed);
+            offset += consumed;
+        }
+
+        passes++;
+        seconds = elapsed_seconds(&start);
+    } while (seconds < BENCHMARK_SECONDS);
+
+    unsigned long long instructions = (unsigned long long)image_instructions * passes;
+
+    printf("%u KB disassembled %lu times in %.2f s: %.0f MB/s, %.1f M instructions/s, %.0f MB/s of text\n",
+           BENCHMARK_IMAGE_SIZE / 1024, passes, seconds, passes * (BENCHMARK_IMAGE_SIZE / 1e6) / seconds,
+           instructions / 1e6 / seconds, text_size / 1e6 / seconds);
+
+    return 0;
+}
+
+static int sprite_lines_equal(const SPRITE_LINE *a, const SPRITE_LINE *b)
+{
+    return a->count == b->count && a->overflow == b->overflow && a->sprite_0 == b->sprite_0 &&
+           memcmp(a->sprites, b->sprites, a->count) == 0;
+}
+
+// Evaluates every scanline of every sprite table until the time is up, returns the scanlines per second
+static double benchmark_sprite_evaluation(void (*evaluate)(PPU *, unsigned char, SPRITE_LINE *), PPU *ppu,
+                                          unsigned char oam[][NB_SPRITES * 4])
+{
+    struct timespec start;
+    unsigned long long scanlines = 0;
+    double seconds;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    do
+    {
+        for (unsigned int image = 0; image < BENCHMARK_OAM_IMAGES; image++)
+        {
+            SPRITE_LINE line;
+
+            memcpy(ppu->spr_ram, oam[image], sizeof(ppu->spr_ram));
+
+            for (unsigned int scanline = 0; scanline < 256; scanline++)
+            {
+                evaluate(ppu, scanline, &line);
+            }
+        }
+
+        scanlines += BENCHMARK_OAM_IMAGES * 256;
+        seconds = elapsed_seconds(&start);
+    } while (seconds < BENCHMARK_SECONDS);
+
+    return scanlines / seconds;
+}
+
+/*
+ * Sprite tables with random Y, half of them crowded into a few scanlines so that the overflow
+ * is hit, evaluated for every scanline in both sprite heights by the vector and the scalar code.
+ */
+static int benchmark_sprites()
+{
+    static unsigned char oam[BENCHMARK_OAM_IMAGES][NB_SPRITES * 4];
+    static PPU ppu;
+
+    srand(1);
+
+    for (unsigned int image = 0; image < BENCHMARK_OAM_IMAGES; image++)
+    {
+        unsigned char crowd = rand();
+
+        for (unsigned int i = 0; i < sizeof(oam[image]); i++)
+        {
+            oam[image][i] = rand();
+        }
+
+        for (unsigned int i = 0; image % 2 && i < NB_SPRITES; i++)
+        {
+            oam[image][i * 4] = crowd + rand() % 24;
+        }
+    }
+
+    for (unsigned char control = 0; control <= 0x20; control += 0x20)
+    {
+        ppu.control_register = control;
+
+        for (unsigned int image = 0; image < BENCHMARK_OAM_IMAGES; image++)
+        {
+            memcpy(ppu.spr_ram, oam[image], sizeof(ppu.spr_ram));
+
+            for (unsigned int scanline = 0; scanline < 256; scanline++)
+            {
+                SPRITE_LINE vector;
+                SPRITE_LINE scalar;
+
+                ppu_evaluate_sprites(&ppu, scanline, &vector);
+                ppu_evaluate_sprites_scalar(&ppu, scanline, &scalar);
+
+                if (!sprite_lines_equal(&vector, &scalar))
+                {
+                    fprintf(stderr, "Sprite evaluations differ: table %u, scanline %u, %u-pixel sprites\n", image,
+                            scanline, control ? 16 : 8);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    for (unsigned char control = 0; control <= 0x20; control += 0x20)
+    {
+        ppu.control_register = control;
+
+        double vector = benchmark_sprite_evaluation(ppu_evaluate_sprites, &ppu, oam);
+        double scalar = benchmark_sprite_evaluation(ppu_evaluate_sprites_scalar, &ppu, oam);
+
+        printf("%2u-pixel sprites: %.1f M scanlines/s, scalar %.1f M scanlines/s, gain x%.2f\n", control ? 16 : 8,
+               vector / 1e6, scalar / 1e6, vector / scalar);
+    }
+
+    printf("Both evaluations agree on %u sprite tables, every scanline and both heights\n", BENCHMARK_OAM_IMAGES);
+
+    return 0;
+}
+
+// NROM image whose last bank starts with LDA $8000, LDA $C010, JMP $C006, the other bytes are the bank number + 1
+static int write_mapping_test_rom(char *filename, unsigned int prg_banks)
+{
+    static const unsigned char code[] = {0xad, 0x00, 0x80, 0xad, 0x10, 0xc0, 0x4c, 0x06, 0xc0};
+    static unsigned char prg[CDL_MAX_PRG_SIZE];
+    static unsigned char chr[CDL_MAX_CHR_SIZE];
+    unsigned char header[INES_HEADER_SIZE] = {'N', 'E', 'S', 0x1a, prg_banks, 1};
+    unsigned int last = (prg_banks - 1) * PRG_BANK_SIZE;
+    int fd = mkstemp(filename);
+    FILE *file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+
+    if (!file)
+    {
+        return -1;
+    }
+
+    for (unsigned int bank = 0; bank < prg_banks; bank++)
+    {
+        memset(prg + bank * PRG_BANK_SIZE, bank + 1, PRG_BANK_SIZE);
+    }
+
+    memcpy(prg + last, code, sizeof(code));
+    prg[last + 0x3ffc] = 0x00; // reset vector
+    prg[last + 0x3ffd] = 0xc0;
+    memset(chr, MAPPING_TEST_CHR, sizeof(chr));
+
+    int result = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+                         fwrite(prg, 1, prg_banks * PRG_BANK_SIZE, file) == prg_banks * PRG_BANK_SIZE &&
+                         fwrite(chr, 1, sizeof(chr), file) == sizeof(chr)
+                     ? 0
+                     : -1;
+
+    return fclose(file) < 0 ? -1 : result;
+}
+
+// Reports a check that does not hold, returns -1 for it
+static int mapping_check(unsigned int prg_banks, const char *check, int holds)
+{
+    if (!holds)
+    {
+        fprintf(stderr, "%u KB PRG: %s does not hold\n", prg_banks * 16, check);
+    }
+
+    return holds ? 0 : -1;
+}
+
+/*
+ * Loads a test ROM and runs its first instructions, then checks that the memory map, the
+ * code/data log, its FCEUX file and the references of the analysis agree on where $C000 is.
+ */
+static int test_prg_mapping(unsigned int prg_banks)
+{
+    char filename[] = "/tmp/nes-mapping-XXXXXX";
+    unsigned char prg[CDL_MAX_PRG_SIZE];
+    unsigned char flags[CDL_MAX_PRG_SIZE + CDL_MAX_CHR_SIZE];
+    unsigned int last = (prg_banks - 1) * PRG_BANK_SIZE;
+    int failed = 0;
+
+    if (write_mapping_test_rom(filename, prg_banks) < 0)
+    {
+        fprintf(stderr, "Cannot write %s\n", filename);
+        return -1;
+    }
+
+    NES *nes = create_nes();
+    nes->trace = 0;
+    nes_set_cdl(nes, create_cdl());
+
+    ANALYSIS *analysis = load_rom(nes, filename) < 0 ? NULL : analyze_rom_file(filename);
+    unlink(filename);
+
+    if (!analysis)
+    {
+        fprintf(stderr, "Cannot load %s\n", filename);
+        return -1;
+    }
+
+    CDL *cdl = nes->cdl;
+
+    failed |= mapping_check(prg_banks, "$8000 reads the first bank", nes_peek(nes, WATCH_BUS_CPU, 0x8010) == 1);
+    failed |= mapping_check(prg_banks, "$C000 reads the last bank", nes_peek(nes, WATCH_BUS_CPU, 0xc010) == prg_banks);
+    failed |= mapping_check(prg_banks, "reset goes to $C000", nes->cpu->pc == 0xc000);
+    failed |= mapping_check(prg_banks, "CHR is read after the PRG", nes->ppu_memory->pattern_table_0[0] == MAPPING_TEST_CHR);
+    failed |= mapping_check(prg_banks, "the log has the size of the PRG", cdl->prg_size == prg_banks * PRG_BANK_SIZE);
+
+    for (int i = 0; i < 3; i++)
+    {
+        failed |= mapping_check(prg_banks, "the code runs", execute_instruction(nes) >= 0);
+    }
+
+    failed |= mapping_check(prg_banks, "the log marks the code at the offset of $C000",
+                            cdl_is_marked(cdl->opcodes, last) && cdl_is_marked(cdl->operands, last + 1) &&
+                                cdl_is_marked(cdl->opcodes, last + 3) && cdl_is_marked(cdl->opcodes, last + 6));
+    failed |= mapping_check(prg_banks, "the log marks the data at $8000 and $C010",
+                            cdl_is_marked(cdl->data, 0) && cdl_is_marked(cdl->data, last + 0x10));
+    failed |= mapping_check(prg_banks, "the references locate $C003 where the log does",
+                            xref_location(analysis, 0, 0xc003) == (int)(XREF_ROM_LOCATION + cdl_prg_offset(cdl, 0xc003)) &&
+                                cdl_prg_offset(cdl, 0xc003) == last + 3);
+
+    // The FCEUX file keeps the bank bits of $C000 and gives the same marks back
+    unsigned int size = cdl->prg_size + cdl->chr_size;
+    CDL *loaded = create_cdl();
+    FILE *file = tmpfile();
+
+    cdl_reset(loaded, cdl->prg_size, cdl->chr_size);
+    nes_peek_range(nes, WATCH_BUS_CPU, PRG_ROM_LOWER_BANK, prg, cdl->prg_size);
+
+    int saved = file && cdl_save(cdl, file) == 0 && fseek(file, 0, SEEK_SET) == 0 && fread(flags, 1, size, file) == size &&
+                fseek(file, 0, SEEK_SET) == 0 && cdl_load(loaded, file, prg) == 0;
+
+    failed |= mapping_check(prg_banks, "the log is saved and loaded back", saved);
+    failed |= mapping_check(prg_banks, "the file marks $C000 as code of its bank",
+                            saved && (flags[last] & (CDL_FILE_CODE | CDL_FILE_BANK)) ==
+                                         (CDL_FILE_CODE | (0xc000 & 0x6000) >> CDL_FILE_BANK_SHIFT));
+    failed |= mapping_check(prg_banks, "the loaded log has the same marks",
+                            saved && memcmp(loaded->opcodes, cdl->opcodes, sizeof(cdl->opcodes)) == 0 &&
+                                memcmp(loaded->operands, cdl->operands, sizeof(cdl->operands)) == 0 &&
+                                memcmp(loaded->data, cdl->data, sizeof(cdl->data)) == 0);
+
+    if (file)
+    {
+        fclose(file);
+    }
+
+    free(loaded);
+    free_analysis(analysis);
+
+    return failed;
+}
+
+/*
+ * NROM or UxROM image with code in every bank: the fixed bank runs through the addressing modes,
+ * zero page addresses in their absolute form included, and calls the switched bank. The other
+ * bytes are random data. Returns its size.
+ */
+static unsigned long build_export_test_rom(unsigned char *rom, unsigned int prg_banks, unsigned char mapper, int trainer)
+{
+    static const unsigned char reset[] = {
+        0x78, 0xd8, 0xa2, 0xff, 0x9a, 0xa9, 0x00, 0x85, 0x10, 0x8d, 0x10, 0x00, // SEI CLD LDX #$FF TXS LDA #0 STA $10 STA a:$0010
+        0x95, 0x10, 0x96, 0x10, 0xbe, 0x10, 0x00, 0xb9, 0x10, 0x00,             // STA $10,x STX $10,y LDX a:$0010,y LDA $0010,y
+        0xa1, 0x20, 0xb1, 0x20, 0xbd, 0x00, 0x03, 0x0a,                         // LDA ($20,x) LDA ($20),y LDA $0300,x ASL a
+        0x2c, 0x02, 0x20, 0x10, 0xfb, 0xad, 0x00, 0xc1, 0xd0, 0x02, 0xe6, 0x11, // BIT $2002 BPL BIT LDA $C100 BNE +2 INC $11
+        0x20, 0x00, 0x80, 0x6c, 0x00, 0x02};                                    // JSR $8000 JMP ($0200)
+    static const unsigned char nmi[] = {0x48, 0xe6, 0x12, 0x68, 0x40};        // PHA INC $12 PLA RTI
+    static const unsigned char switched[] = {0xa9, 0x00, 0x8d, 0x00, 0x80, 0xad, 0x10, 0x80, 0x60}; // LDA #bank STA $8000 LDA $8010 RTS
+    unsigned char header[INES_HEADER_SIZE] = {'N', 'E', 'S', 0x1a, prg_banks, mapper ? 0 : 1, mapper << 4 | (trainer ? 0x04 : 0)};
+    unsigned long prg_start = INES_HEADER_SIZE + (trainer ? INES_TRAINER_SIZE : 0);
+    unsigned long size = prg_start + prg_banks * PRG_BANK_SIZE + header[5] * 0x2000;
+    unsigned char *last = rom + prg_start + (prg_banks - 1) * PRG_BANK_SIZE;
+
+    srand(prg_banks);
+
+    for (unsigned long i = 0; i < size; i++)
+    {
+        rom[i] = rand();
+    }
+
+    memcpy(rom, header, sizeof(header));
+
+    for (unsigned int bank = 0; bank + 1 < prg_banks; bank++)
+    {
+        memcpy(rom + prg_start + bank * PRG_BANK_SIZE, switched, sizeof(switched));
+        rom[prg_start + bank * PRG_BANK_SIZE + 1] = bank;
+    }
+
+    memcpy(last, reset, sizeof(reset));
+    memcpy(last + 0x80, nmi, sizeof(nmi));
+    last[0x90] = 0x40; // RTI
+
+    // A 16 KB ROM has no switched bank, its JSR goes to the RTI instead
+    if (prg_banks == 1)
+    {
+        last[sizeof(reset) - 5] = 0x90;
+        last[sizeof(reset) - 4] = 0xc0;
+    }
+
+    memcpy(last + 0x3ffa, (const unsigned char[]){0x80, 0xc0, 0x00, 0xc0, 0x90, 0xc0}, 6);
+
+    return size;
+}
+
+// Exports the analysis of the image then assembles it back, returns 0 when it gives the same bytes
+static int test_export_round_trip(const char *name, const unsigned char *rom, unsigned long size)
+{
+    ANALYSIS *analysis = create_analysis(rom, size);
+
+    if (!analysis)
+    {
+        fprintf(stderr, "%s: not an iNES image\n", name);
+        return -1;
+    }
+
+    unsigned long expected = INES_HEADER_SIZE + (analysis->trainer ? INES_TRAINER_SIZE : 0) + analysis->prg_size + analysis->chr_size;
+    unsigned char *image = malloc(expected);
+    FILE *file = tmpfile();
+    char *text = NULL;
+    long assembled = -1;
+    unsigned int error_line = 0;
+
+    if (file && analysis_export_ca65(analysis, file) == 0)
+    {
+        long length = ftell(file);
+
+        text = malloc(length + 1);
+        rewind(file);
+        text[fread(text, 1, length, file)] = 0;
+        assembled = assemble_listing(text, image, expected, &error_line);
+    }
+
+    int result = -1;
+
+    if (assembled < 0)
+    {
+        fprintf(stderr, "%s: the source does not assemble, line %u\n", name, error_line);
+    }
+    else if ((unsigned long)assembled != expected || memcmp(image, rom, expected))
+    {
+        unsigned long offset = 0;
+
+        while (offset < (unsigned long)assembled && offset < expected && image[offset] == rom[offset])
+        {
+            offset++;
+        }
+
+        fprintf(stderr, "%s: %ld bytes assembled for %lu, first difference at $%05lX\n", name, assembled, expected, offset);
+    }
+    else
+    {
+        printf("%s: %u KB PRG, assembled back to the same %lu bytes\n", name, analysis->prg_size / 1024, expected);
+        result = 0;
+    }
+
+    if (file)
+    {
+        fclose(file);
+    }
+
+    free(text);
+    free(image);
+    free_analysis(analysis);
+
+    return result;
+}
+
+// Generated NROM and UxROM images, and the ROM file when one is given
+static int test_export(const char *rom_filename)
+{
+    static unsigned char rom[INES_HEADER_SIZE + INES_TRAINER_SIZE + 8 * PRG_BANK_SIZE + 0x2000];
+    int failed = 0;
+
+    failed |= test_export_round_trip("NROM 16 KB", rom, build_export_test_rom(rom, 1, 0, 0));
+    failed |= test_export_round_trip("NROM 16 KB with a trainer", rom, build_export_test_rom(rom, 1, 0, 1));
+    failed |= test_export_round_trip("NROM 32 KB", rom, build_export_test_rom(rom, 2, 0, 0));
+    failed |= test_export_round_trip("UxROM 128 KB", rom, build_export_test_rom(rom, 8, 2, 0));
+
+    if (rom_filename)
+    {
+        FILE *file = fopen(rom_filename, "rb");
+        long size = file && fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+        unsigned char *image = size > 0 ? malloc(size) : NULL;
+
+        if (image && fseek(file, 0, SEEK_SET) == 0 && fread(image, 1, size, file) == (size_t)size)
+        {
+            failed |= test_export_round_trip(rom_filename, image, size);
+        }
+        else
+        {
+            fprintf(stderr, "Cannot read %s\n", rom_filename);
+            failed = -1;
+        }
+
+        if (file)
+        {
+            fclose(file);
+        }
+
+        free(image);
+    }
+
+    return failed;
+}
+
+int headless_main(int argc, char *argv[])
+{
+    HEADLESS_OPTIONS options;
+
+    if (parse_options(argc, argv, &options) < 0)
+    {
+        usage();
+        return 1;
+    }
+
+    if (options.text_trace_filename)
+    {
+        return print_trace(options.text_trace_filename, options.trace_query) < 0;
+    }
+
+    if (options.export_test)
+    {
+        return test_export(options.rom_filename) != 0;
+    }
+
+    if (options.prg_mapping_test)
+    {
+        int failed = test_prg_mapping(1) | test_prg_mapping(2);
+
+        printf("PRG mapping of 16 and 32 KB ROMs: %s\n", failed ? "FAILED" : "ok");
+        return failed != 0;
+    }
+
+    if (options.sprite_benchmark)
+    {
+        return benchmark_sprites() < 0;
+    }
+
+    if (options.disassembly_benchmark)
+    {
+        return benchmark_disassembler(options.rom_filename) < 0;
+    }
+
+    if (options.timing)
+    {
+        int over_budget = report_timing(options.rom_filename);
+
+        return over_budget < 0 ? 1 : over_budget > 0 ? 2 : 0;
+    }
+
+    if (options.disassembly_filename)
+    {
+        return disassemble_rom(options.rom_filename, options.disassembly_filename) < 0;
+    }
+
+    double fps = run_frames(options.rom_filename, options.frames, options.render_every, options.cdl_filename,
+                            options.trace_filename, &options.trace_filter);
+    if (fps < 0)
+    {
+        return 1;
+    }
+
+    printf("%lu frames, rendering 1 out of %lu: %.1f fps\n", options.frames, options.render_every, fps);
+
+    if (options.benchmark)
+    {
+        double full_fps = run_frames(options.rom_filename, options.frames, 1, NULL, NULL, NULL);
+        if (full_fps < 0)
+        {
+            return 1;
+        }
+
+        printf("%lu frames, rendering all: %.1f fps\n", options.frames, full_fps);
+        printf("Gain: x%.2f\n", fps / full_fps);
+    }
+
+    return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef _HEADLESS_H_
+#define _HEADLESS_H_
+
+int headless_main(int argc, char *argv[]);
+
+#endif
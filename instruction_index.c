@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "instruction_index.h"
+#include "disassembler.h"
+
+// Length of the line starting at the address
+static unsigned char instruction_index_length(INSTRUCTION_INDEX *index, unsigned int address)
+{
+    return index->starts[address] == INDEX_DATA ? 1 : OPCODES[index->bytes[address]].length;
+}
+
+// Decodes from address on, past the end until it lands on an old boundary, from where nothing can change
+static void instruction_index_decode(INSTRUCTION_INDEX *index, unsigned int address, unsigned int end)
+{
+    while (address < INDEX_SPACE_SIZE)
+    {
+        if (address > end && index->starts[address])
+        {
+            break;
+        }
+
+        unsigned char kind = index->hints[address] == INDEX_HINT_DATA ? INDEX_DATA : INDEX_INSTRUCTION;
+        unsigned char length = OPCODES[index->bytes[address]].length;
+
+        // An instruction running into a known opcode cannot be one, it is shown as a byte
+        for (unsigned int i = 1; i < length && address + i < INDEX_SPACE_SIZE; i++)
+        {
+            if (index->hints[address + i] == INDEX_HINT_OPCODE)
+            {
+                kind = INDEX_DATA;
+            }
+        }
+
+        if (kind == INDEX_DATA)
+        {
+            length = 1;
+        }
+
+        index->starts[address] = kind;
+
+        for (unsigned int i = 1; i < length && address + i < INDEX_SPACE_SIZE; i++)
+        {
+            index->starts[address + i] = 0;
+        }
+
+        address += length;
+    }
+
+    index->lines_dirty = 1;
+}
+
+INSTRUCTION_INDEX *create_instruction_index(const unsigned char *bytes)
+{
+    INSTRUCTION_INDEX *index = malloc(sizeof(INSTRUCTION_INDEX));
+
+    memcpy(index->bytes, bytes, sizeof(index->bytes));
+    memset(index->hints, INDEX_HINT_NONE, sizeof(index->hints));
+    memset(index->starts, 0, sizeof(index->starts));
+    instruction_index_decode(index, 0, INDEX_SPACE_SIZE - 1);
+
+    return index;
+}
+
+// Takes the new content and hints of the address space, returns 1 when a boundary may have moved
+int instruction_index_update(INSTRUCTION_INDEX *index, const unsigned char *bytes, const unsigned char *hints)
+{
+    int changed = 0;
+
+    for (unsigned int page = 0; page < INDEX_SPACE_SIZE; page += INDEX_PAGE_SIZE)
+    {
+        if (!memcmp(index->bytes + page, bytes + page, INDEX_PAGE_SIZE) &&
+            !memcmp(index->hints + page, hints + page, INDEX_PAGE_SIZE))
+        {
+            continue;
+        }
+
+        memcpy(index->bytes + page, bytes + page, INDEX_PAGE_SIZE);
+        memcpy(index->hints + page, hints + page, INDEX_PAGE_SIZE);
+
+        // An instruction is at most 3 bytes long, the one holding the first byte began at most 2 bytes before
+        unsigned int start = page;
+
+        for (unsigned int back = 1; back <= 2 && page >= back; back++)
+        {
+            if (index->starts[page - back] && instruction_index_length(index, page - back) > back)
+            {
+                start = page - back;
+                break;
+            }
+        }
+
+        instruction_index_decode(index, start, page + INDEX_PAGE_SIZE - 1);
+        changed = 1;
+    }
+
+    return changed;
+}
+
+// Makes the address an instruction start, for the PC or a known entry point the sweep went past
+void instruction_index_anchor(INSTRUCTION_INDEX *index, unsigned short address)
+{
+    if (index->starts[address])
+    {
+        return;
+    }
+
+    // The instruction the address was in the middle of stays, both are shown
+    instruction_index_decode(index, address, address);
+}
+
+static void instruction_index_build_lines(INSTRUCTION_INDEX *index)
+{
+    if (!index->lines_dirty)
+    {
+        return;
+    }
+
+    index->line_count = 0;
+
+    for (unsigned int address = 0; address < INDEX_SPACE_SIZE; address++)
+    {
+        if (index->starts[address])
+        {
+            index->lines[index->line_count++] = address;
+        }
+    }
+
+    index->lines_dirty = 0;
+}
+
+unsigned int instruction_index_line_count(INSTRUCTION_INDEX *index)
+{
+    instruction_index_build_lines(index);
+
+    return index->line_count;
+}
+
+// Line of the instruction starting at the address, or of the last one before it
+unsigned int instruction_index_line(INSTRUCTION_INDEX *index, unsigned short address)
+{
+    instruction_index_build_lines(index);
+
+    unsigned int low = 0;
+    unsigned int high = index->line_count;
+
+    while (high - low > 1)
+    {
+        unsigned int middle = (low + high) / 2;
+
+        if (index->lines[middle] <= address)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+unsigned short instruction_index_address(INSTRUCTION_INDEX *index, unsigned int line)
+{
+    instruction_index_build_lines(index);
+
+    return index->lines[line < index->line_count ? line : index->line_count - 1];
+}
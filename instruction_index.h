@@ -0,0 +1,39 @@
+#ifndef _INSTRUCTION_INDEX_H_
+#define _INSTRUCTION_INDEX_H_
+
+#define INDEX_SPACE_SIZE 0x10000
+#define INDEX_PAGE_SIZE 0x100
+
+// What is known of a byte, from the code/data log
+#define INDEX_HINT_NONE 0
+#define INDEX_HINT_OPCODE 1 // an instruction was fetched from it
+#define INDEX_HINT_DATA 2   // only read as data, it is shown as a byte
+
+// Kinds of line start
+#define INDEX_INSTRUCTION 1
+#define INDEX_DATA 2
+
+/*
+ * Instruction boundaries of the whole CPU address space, as found by a linear sweep. Only the
+ * pages whose bytes or hints changed are decoded again, until the sweep falls back on the old
+ * boundaries. Lines are the instruction starts in address order. Hints keep data bytes out of
+ * the code and known opcodes from being swallowed by the instruction before them.
+ */
+typedef struct
+{
+    unsigned char bytes[INDEX_SPACE_SIZE];
+    unsigned char hints[INDEX_SPACE_SIZE];  // INDEX_HINT_ of each byte
+    unsigned char starts[INDEX_SPACE_SIZE]; // INDEX_INSTRUCTION or INDEX_DATA where a line starts
+    unsigned short lines[INDEX_SPACE_SIZE]; // address of each line
+    unsigned int line_count;
+    int lines_dirty; // starts changed since the lines were built
+} INSTRUCTION_INDEX;
+
+INSTRUCTION_INDEX *create_instruction_index(const unsigned char *bytes);
+int instruction_index_update(INSTRUCTION_INDEX *index, const unsigned char *bytes, const unsigned char *hints);
+void instruction_index_anchor(INSTRUCTION_INDEX *index, unsigned short address);
+unsigned int instruction_index_line_count(INSTRUCTION_INDEX *index);
+unsigned int instruction_index_line(INSTRUCTION_INDEX *index, unsigned short address);
+unsigned short instruction_index_address(INSTRUCTION_INDEX *index, unsigned int line);
+
+#endif
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "logpoint.h"
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+static void free_logpoint_parts(LOGPOINT *logpoint)
+{
+    for (unsigned int i = 0; i <= logpoint->value_count; i++)
+    {
+        free(logpoint->literals[i]);
+    }
+
+    for (unsigned int i = 0; i < logpoint->value_count; i++)
+    {
+        free_expression(logpoint->values[i]);
+    }
+}
+
+LOGPOINT *create_logpoint(const char *source)
+{
+    LOGPOINT *logpoint = malloc(sizeof(LOGPOINT));
+    logpoint->source = strdup(source);
+    logpoint->value_count = 0;
+    logpoint->written = 0;
+    logpoint->flushed = 0;
+
+    const char *text = source;
+
+    for (;;)
+    {
+        const char *open = strchr(text, '{');
+        const char *close = open ? strchr(open, '}') : NULL;
+
+        if (!open || !close || logpoint->value_count == LOGPOINT_MAX_VALUES)
+        {
+            logpoint->literals[logpoint->value_count] = strdup(text);
+            break;
+        }
+
+        logpoint->literals[logpoint->value_count] = strndup(text, open - text);
+
+        char *expression_source = strndup(open + 1, close - open - 1);
+        EXPRESSION *expression = create_expression(expression_source);
+        free(expression_source);
+
+        if (!expression)
+        {
+            free_logpoint_parts(logpoint);
+            free(logpoint->source);
+            free(logpoint);
+            return NULL;
+        }
+
+        logpoint->values[logpoint->value_count++] = expression;
+        text = close + 1;
+    }
+
+    logpoint->ring = malloc(LOGPOINT_RING_SIZE * sizeof(LOG_ENTRY));
+
+    return logpoint;
+}
+
+void free_logpoint(LOGPOINT *logpoint)
+{
+    if (!logpoint)
+    {
+        return;
+    }
+
+    free_logpoint_parts(logpoint);
+    free(logpoint->ring);
+    free(logpoint->source);
+    free(logpoint);
+}
+
+static char *append_literal(char *out, const char *end, const char *literal)
+{
+    while (*literal && out < end)
+    {
+        *out++ = *literal++;
+    }
+
+    return out;
+}
+
+// At least two digits, like the rest of the debugger
+static char *append_hex(char *out, const char *end, unsigned long value)
+{
+    char digits[2 * sizeof(value)];
+    int count = 0;
+
+    do
+    {
+        digits[count++] = HEX_DIGITS[value & 0x0f];
+        value >>= 4;
+    } while (value || count < 2);
+
+    while (count && out < end)
+    {
+        *out++ = digits[--count];
+    }
+
+    return out;
+}
+
+// Called on every hit: no allocation and no printf
+void logpoint_write(LOGPOINT *logpoint, const long *values, unsigned long long cycle)
+{
+    LOG_ENTRY *entry = &logpoint->ring[logpoint->written++ % LOGPOINT_RING_SIZE];
+    char *out = entry->text;
+    const char *end = entry->text + LOGPOINT_LINE_LENGTH - 1;
+
+    entry->cycle = cycle;
+
+    for (unsigned int i = 0; i < logpoint->value_count; i++)
+    {
+        out = append_literal(out, end, logpoint->literals[i]);
+        out = append_hex(out, end, values[i]);
+    }
+
+    out = append_literal(out, end, logpoint->literals[logpoint->value_count]);
+    *out = '\0';
+}
+
+// Oldest entry not given to the UI yet, NULL when drained. The caller increments flushed once it used the entry.
+// Entries overwritten before the UI got to them are counted in dropped.
+LOG_ENTRY *logpoint_next_unflushed(LOGPOINT *logpoint, unsigned long *dropped)
+{
+    if (logpoint->written - logpoint->flushed > LOGPOINT_RING_SIZE)
+    {
+        *dropped += logpoint->written - logpoint->flushed - LOGPOINT_RING_SIZE;
+        logpoint->flushed = logpoint->written - LOGPOINT_RING_SIZE;
+    }
+
+    if (logpoint->flushed == logpoint->written)
+    {
+        return NULL;
+    }
+
+    return &logpoint->ring[logpoint->flushed % LOGPOINT_RING_SIZE];
+}
@@ -0,0 +1,37 @@
+#ifndef _LOGPOINT_H_
+#define _LOGPOINT_H_
+
+#include "expression.h"
+
+#define LOGPOINT_RING_SIZE 256
+#define LOGPOINT_LINE_LENGTH 96
+#define LOGPOINT_MAX_VALUES 8
+
+typedef struct
+{
+    unsigned long long cycle; // CPU cycle of the hit, to merge the logpoints in order
+    char text[LOGPOINT_LINE_LENGTH];
+} LOG_ENTRY;
+
+/*
+ * Message template such as "X = {X} at {pc}", split into literal text and expressions whose
+ * values are printed in hex. Hits are formatted into a ring allocated once, the UI drains it on
+ * refresh and the oldest lines are overwritten if it does not keep up.
+ */
+typedef struct
+{
+    char *source;
+    char *literals[LOGPOINT_MAX_VALUES + 1]; // literal text before each value, and after the last one
+    EXPRESSION *values[LOGPOINT_MAX_VALUES];
+    unsigned int value_count;
+    LOG_ENTRY *ring;
+    unsigned long written;
+    unsigned long flushed;
+} LOGPOINT;
+
+LOGPOINT *create_logpoint(const char *source); // NULL if an expression does not compile
+void free_logpoint(LOGPOINT *logpoint);
+void logpoint_write(LOGPOINT *logpoint, const long *values, unsigned long long cycle);
+LOG_ENTRY *logpoint_next_unflushed(LOGPOINT *logpoint, unsigned long *dropped);
+
+#endif
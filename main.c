@@ -1,9 +1,16 @@
 #include <gtk/gtk.h>
+#include <string.h>
 
 #include "debugger_app.h"
+#include "headless.h"
 
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0)
+    {
+        return headless_main(argc - 2, argv + 2);
+    }
+
     DebuggerApp *app;
     app = debugger_app_new();
 
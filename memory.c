@@ -9,15 +9,42 @@ MEMORY *create_memory(PPU *ppu)
     MEMORY *memory = malloc(sizeof(MEMORY));
 
     memory->ppu = ppu;
-    memory->last_read_address = 0;
-    memory->last_write_address = 0;
+    memory->prg_size = sizeof(memory->prg_rom_lower_bank);
+    memory->stall_cycles = 0;
+    memory->cpu_cycles = NULL;
+    memory->watchpoints = NULL;
+    memory->cdl = NULL;
+    memory->fetch_address = 0;
+    memory->fetch_length = 0;
 
     return memory;
 }
 
+// The bytes of the instruction being fetched are code, any other read makes a data byte
+static void memory_log_prg_read(MEMORY *memory, unsigned short address)
+{
+    CDL *cdl = memory->cdl;
+    unsigned int offset = cdl_prg_offset(cdl, address);
+    unsigned short position = address - memory->fetch_address;
+
+    if (position >= memory->fetch_length)
+    {
+        cdl_mark(cdl->data, offset);
+    }
+    else
+    {
+        cdl_mark(position ? cdl->operands : cdl->opcodes, offset);
+    }
+}
+
 unsigned char memory_read_byte(MEMORY *memory, unsigned short address)
 {
-    memory->last_read_address = address;
+    watchpoints_check(memory->watchpoints, WATCH_BUS_CPU, address, WATCH_READ);
+
+    if (address >= PRG_ROM_LOWER_BANK && memory->cdl)
+    {
+        memory_log_prg_read(memory, address);
+    }
 
     if (address >= PRG_ROM_UPPER_BANK)
     {
@@ -37,6 +64,8 @@ unsigned char memory_read_byte(MEMORY *memory, unsigned short address)
 
     if (address >= IO_REGISTERS)
     {
+        ppu_catch_up(memory->ppu, *memory->cpu_cycles);
+
         if (address == PPU_STATUS_REGISTER)
         {
             unsigned char status = memory->ppu->status_register;
@@ -48,12 +77,21 @@ unsigned char memory_read_byte(MEMORY *memory, unsigned short address)
 
         if (address == PPU_DATA)
         {
+            unsigned short ppu_address = memory->ppu->address & 0x3fff;
+
+            watchpoints_check(memory->watchpoints, WATCH_BUS_PPU, ppu_address, WATCH_READ);
+
+            if (memory->cdl && ppu_address < NAME_TABLE_0 && memory->cdl->chr_size)
+            {
+                cdl_mark(memory->cdl->chr_read, ppu_address);
+            }
         }
 
         return 0;
     }
 
-    return memory->ram[address];
+    // The 2 KB of RAM are mirrored up to $1FFF
+    return memory->ram[address & 0x7ff];
 }
 
 unsigned short memory_read_word(MEMORY *memory, unsigned short address)
@@ -66,9 +104,68 @@ unsigned short memory_read_word_zero_page(MEMORY *memory, unsigned short address
     return memory_read_byte(memory, address) | (memory_read_byte(memory, (address + 1) & 0xff) << 8);
 }
 
+static void memory_watch_ppu_write(MEMORY *memory, unsigned char value)
+{
+    unsigned short address = memory->ppu->address & 0x3fff;
+
+    if (watchpoints_covered(memory->watchpoints, WATCH_BUS_PPU, address))
+    {
+        unsigned char changed = ppu_memory_read(memory->ppu->ppu_memory, address) != value;
+
+        watchpoints_match(memory->watchpoints, WATCH_BUS_PPU, address, changed ? WATCH_WRITE | WATCH_CHANGE : WATCH_WRITE);
+    }
+}
+
+// Bytes of the CPU page sprite DMA copies, RAM mirrors included, registers and expansion ROM read 0
+static const unsigned char *memory_dma_source(MEMORY *memory, unsigned char page)
+{
+    static const unsigned char zero_page[0x100];
+    unsigned short address = page << 8;
+
+    if (address >= PRG_ROM_UPPER_BANK)
+    {
+        return memory->prg_rom_upper_bank + (address - PRG_ROM_UPPER_BANK);
+    }
+
+    if (address >= PRG_ROM_LOWER_BANK)
+    {
+        return memory->prg_rom_lower_bank + (address - PRG_ROM_LOWER_BANK);
+    }
+
+    return address < IO_REGISTERS ? memory->ram + (address & 0x7ff) : zero_page;
+}
+
+// Sprite DMA reads a whole CPU page and writes every sprite RAM byte
+static void memory_watch_sprite_dma(MEMORY *memory, unsigned char page)
+{
+    const unsigned char *source = memory_dma_source(memory, page);
+    WATCHPOINTS *watchpoints = memory->watchpoints;
+
+    if (watchpoints_covered(watchpoints, WATCH_BUS_CPU, page << 8) & WATCH_READ)
+    {
+        for (unsigned int i = 0; i < 0x100; i++)
+        {
+            watchpoints_match(watchpoints, WATCH_BUS_CPU, (page << 8) | i, WATCH_READ);
+        }
+    }
+
+    if (watchpoints_covered(watchpoints, WATCH_BUS_OAM, 0))
+    {
+        for (unsigned int i = 0; i < sizeof(memory->ppu->spr_ram); i++)
+        {
+            unsigned char changed = memory->ppu->spr_ram[i] != source[i];
+
+            watchpoints_match(watchpoints, WATCH_BUS_OAM, i, changed ? WATCH_WRITE | WATCH_CHANGE : WATCH_WRITE);
+        }
+    }
+}
+
 void memory_write(MEMORY *memory, unsigned short address, unsigned char value)
 {
-    memory->last_write_address = address;
+    // Register writes always count as a change, ROM writes never do
+    unsigned char changed = address < IO_REGISTERS ? memory->ram[address & 0x7ff] != value : address < EXPANSION_ROM;
+
+    watchpoints_check(memory->watchpoints, WATCH_BUS_CPU, address, changed ? WATCH_WRITE | WATCH_CHANGE : WATCH_WRITE);
 
     if (address >= EXPANSION_ROM)
     {
@@ -77,10 +174,12 @@ void memory_write(MEMORY *memory, unsigned short address, unsigned char value)
 
     if (address >= IO_REGISTERS)
     {
+        ppu_catch_up(memory->ppu, *memory->cpu_cycles);
+
         switch (address)
         {
         case PPU_CONTROL_REGISTER:
-            memory->ppu->control_register = value;
+            ppu_write_control(memory->ppu, value);
             break;
         case PPU_MASK_REGISTER:
             memory->ppu->mask_register = value;
@@ -95,16 +194,22 @@ void memory_write(MEMORY *memory, unsigned short address, unsigned char value)
             ppu_write_address(memory->ppu, value);
             break;
         case PPU_DATA:
+            memory_watch_ppu_write(memory, value);
             ppu_write_data(memory->ppu, value);
             break;
         case SPRITE_DMA_REGISTER:
             printf("I/O Registers, memory write at $%04X = $%02X\n", address, value);
-            memcpy(memory->ppu->spr_ram, memory->ram + 0x100 * value, sizeof(memory->ppu->spr_ram));
+            memory_watch_sprite_dma(memory, value);
+            memcpy(memory->ppu->spr_ram, memory_dma_source(memory, value), sizeof(memory->ppu->spr_ram));
+            memory->stall_cycles += 513;
             break;
         }
+
+        // Register writes can move the next vblank (odd frame skip)
+        ppu_schedule_events(memory->ppu);
     }
     else
     {
-        memory->ram[address] = value;
+        memory->ram[address & 0x7ff] = value;
     }
 }
@@ -2,6 +2,8 @@
 #define _MEMORY_H_
 
 #include "ppu.h"
+#include "watchpoint.h"
+#include "cdl.h"
 
 #define IO_REGISTERS 0x2000
 #define EXPANSION_ROM 0x4020
@@ -18,8 +20,13 @@ typedef struct
     PPU *ppu;
     unsigned char prg_rom_lower_bank[16 * 1024];
     unsigned char prg_rom_upper_bank[16 * 1024];
-    unsigned short last_read_address;
-    unsigned short last_write_address;
+    unsigned int prg_size;           // of the ROM, its first bank is at $8000 and its last one at $C000
+    unsigned short stall_cycles;     // CPU cycles taken by sprite DMA
+    unsigned long long *cpu_cycles; // PPU accesses catch the PPU up to this cycle
+    WATCHPOINTS *watchpoints;       // checked on every CPU, PPU and sprite RAM access
+    CDL *cdl;                       // code/data log of the ROM reads, NULL when not logged
+    unsigned short fetch_address;   // instruction being fetched, its bytes are logged as code
+    unsigned char fetch_length;
 } MEMORY;
 
 MEMORY *create_memory(PPU *ppu);
@@ -1,14 +1,46 @@
 #include <gtk/gtk.h>
-#include <ctype.h>
+#include <string.h>
 
 #include "memory_win.h"
 
+#define BYTES_PER_ROW 16
+#define ROW_CACHE_SIZE 128 // rows with a cached layout, more than a window ever shows
+#define HEX_COLUMN 6       // in characters from the start of a row
+#define ASCII_COLUMN (HEX_COLUMN + BYTES_PER_ROW * 3 + 1)
+#define ROW_LENGTH (ASCII_COLUMN + BYTES_PER_ROW)
+#define MAX_SPACE_SIZE 0x10000
+#define TOOLTIP_XREFS 8 // references listed by the tooltip of a byte, the others are counted
+
+// Size of each address space, in the order of the memory combo box entries
+static const unsigned int SPACE_SIZES[NB_WATCH_BUSES] = {0x10000, 0x4000, NB_SPRITES * 4};
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+typedef struct
+{
+    int row; // -1 when the layout does not hold any row
+    PangoLayout *layout;
+} ROW_LAYOUT;
+
 struct _MemoryWindow
 {
     GtkWindow parent;
+    GtkComboBoxText *memory_space_combo;
     GtkEntry *memory_start_address_entry;
-    GtkTextView *memory_text_view;
-    unsigned short start_address;
+    GtkDrawingArea *memory_area;
+    GtkScrollbar *memory_scrollbar;
+    DebuggerApp *app;
+    enum WATCH_BUS bus;
+    unsigned int size;
+    unsigned char bytes[MAX_SPACE_SIZE];
+    unsigned char previous[MAX_SPACE_SIZE];
+    unsigned char changed[MAX_SPACE_SIZE]; // 1 for the bytes that changed at the last refresh
+    ROW_LAYOUT layouts[ROW_CACHE_SIZE];    // indexed by row modulo the cache size
+    PangoFontDescription *font;
+    int char_width;
+    int line_height;
+    int selected;       // address of the selected byte, -1 when none
+    int edited_nibbles; // hex digits typed at the selected byte
 };
 
 G_DEFINE_TYPE(MemoryWindow, memory_window, GTK_TYPE_WINDOW);
@@ -17,22 +49,34 @@ static void memory_window_init(MemoryWindow *window)
 {
     gtk_widget_init_template(GTK_WIDGET(window));
 
-    window->start_address = 0;
-    gchar *value = g_strdup_printf("%04X", window->start_address);
-    gtk_entry_set_text(window->memory_start_address_entry, value);
-    g_free(value);
+    window->bus = WATCH_BUS_CPU;
+    window->size = SPACE_SIZES[WATCH_BUS_CPU];
+    window->selected = -1;
+    window->edited_nibbles = 0;
+
+    for (int i = 0; i < ROW_CACHE_SIZE; i++)
+    {
+        window->layouts[i].row = -1;
+        window->layouts[i].layout = NULL;
+    }
+
+    gtk_entry_set_text(window->memory_start_address_entry, "0000");
 }
 
 static void memory_window_class_init(MemoryWindowClass *class)
 {
     gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), "/org/c4z/debuggerapp/memory_window.xml");
 
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), MemoryWindow, memory_space_combo);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), MemoryWindow, memory_start_address_entry);
-    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), MemoryWindow, memory_text_view);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), MemoryWindow, memory_area);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), MemoryWindow, memory_scrollbar);
 }
 
 static void close_memory_window(GtkWindow *window, DebuggerApp *app)
 {
+    MemoryWindow *memory_window = MEMORY_WINDOW(window);
+
     for (int i = 0; i < NB_MEMORY_WINDOW; i++)
     {
         if (app->memory_windows[i] == window)
@@ -40,67 +84,547 @@ static void close_memory_window(GtkWindow *window, DebuggerApp *app)
             app->memory_windows[i] = NULL;
         }
     }
+
+    refresh_coordinator_unregister(app->refresh, window);
+
+    for (int i = 0; i < ROW_CACHE_SIZE; i++)
+    {
+        g_clear_object(&memory_window->layouts[i].layout);
+    }
+
+    g_clear_pointer(&memory_window->font, pango_font_description_free);
+}
+
+static GtkAdjustment *memory_window_adjustment(MemoryWindow *window)
+{
+    return gtk_range_get_adjustment(GTK_RANGE(window->memory_scrollbar));
+}
+
+static int memory_window_first_row(MemoryWindow *window)
+{
+    return gtk_adjustment_get_value(memory_window_adjustment(window));
+}
+
+static void memory_window_format_row(MemoryWindow *window, int row, char *text)
+{
+    unsigned int address = row * BYTES_PER_ROW;
+
+    memset(text, ' ', ROW_LENGTH);
+    text[ROW_LENGTH] = '\0';
+
+    text[0] = HEX_DIGITS[(address >> 12) & 0x0f];
+    text[1] = HEX_DIGITS[(address >> 8) & 0x0f];
+    text[2] = HEX_DIGITS[(address >> 4) & 0x0f];
+    text[3] = HEX_DIGITS[address & 0x0f];
+
+    for (int i = 0; i < BYTES_PER_ROW; i++)
+    {
+        unsigned char byte = window->bytes[address + i];
+
+        text[HEX_COLUMN + i * 3] = HEX_DIGITS[byte >> 4];
+        text[HEX_COLUMN + i * 3 + 1] = HEX_DIGITS[byte & 0x0f];
+        text[ASCII_COLUMN + i] = g_ascii_isprint(byte) ? byte : '.';
+    }
+}
+
+// Layouts are only rebuilt for rows whose bytes changed or that were scrolled into view
+static PangoLayout *memory_window_row_layout(MemoryWindow *window, int row)
+{
+    ROW_LAYOUT *entry = &window->layouts[row % ROW_CACHE_SIZE];
+
+    if (entry->row == row)
+    {
+        return entry->layout;
+    }
+
+    if (!entry->layout)
+    {
+        entry->layout = gtk_widget_create_pango_layout(GTK_WIDGET(window->memory_area), NULL);
+        pango_layout_set_font_description(entry->layout, window->font);
+    }
+
+    char text[ROW_LENGTH + 1];
+    memory_window_format_row(window, row, text);
+    pango_layout_set_text(entry->layout, text, ROW_LENGTH);
+    entry->row = row;
+
+    return entry->layout;
+}
+
+static void memory_window_invalidate_row(MemoryWindow *window, int row)
+{
+    ROW_LAYOUT *entry = &window->layouts[row % ROW_CACHE_SIZE];
+
+    if (entry->row == row)
+    {
+        entry->row = -1;
+    }
+}
+
+// Compares a word at a time, only the words that differ are looked at byte by byte
+static void memory_window_diff(MemoryWindow *window)
+{
+    for (unsigned int i = 0; i < window->size; i += sizeof(guint64))
+    {
+        guint64 current;
+        guint64 previous;
+
+        memcpy(&current, window->bytes + i, sizeof(current));
+        memcpy(&previous, window->previous + i, sizeof(previous));
+
+        if (current == previous)
+        {
+            memset(window->changed + i, 0, sizeof(guint64));
+            continue;
+        }
+
+        for (unsigned int j = i; j < i + sizeof(guint64); j++)
+        {
+            window->changed[j] = window->bytes[j] != window->previous[j];
+        }
+
+        memory_window_invalidate_row(window, i / BYTES_PER_ROW);
+    }
+}
+
+static void refresh_memory_window(gpointer view, gpointer data)
+{
+    DebuggerApp *app = data;
+
+    update_memory_window(MEMORY_WINDOW(view), app->nes);
+}
+
+// Only the rows on screen decide when the window is refreshed
+static void memory_window_register(MemoryWindow *window)
+{
+    GtkAdjustment *adjustment = memory_window_adjustment(window);
+    unsigned int first_row = gtk_adjustment_get_value(adjustment);
+    unsigned int rows = gtk_adjustment_get_page_size(adjustment) + 1;
+    guint64 parts;
+
+    switch (window->bus)
+    {
+    case WATCH_BUS_PPU:
+        parts = STATE_PATTERN_TABLES | STATE_NAME_TABLES | STATE_PALETTES;
+        break;
+    case WATCH_BUS_OAM:
+        parts = STATE_OAM;
+        break;
+    default:
+        parts = emulator_state_cpu_range(first_row * BYTES_PER_ROW, rows * BYTES_PER_ROW);
+        break;
+    }
+
+    refresh_coordinator_register(window->app->refresh, window, parts, refresh_memory_window);
 }
 
-void update_memory_window(MemoryWindow *window, MEMORY *memory)
+void update_memory_window(MemoryWindow *window, NES *nes)
 {
     if (!window)
     {
         return;
     }
 
-    GtkTextBuffer *buffer = gtk_text_view_get_buffer(window->memory_text_view);
-    GtkTextIter start;
-    GtkTextIter end;
+    memcpy(window->previous, window->bytes, window->size);
+    nes_peek_range(nes, window->bus, 0, window->bytes, window->size);
+    memory_window_diff(window);
 
-    gtk_text_buffer_get_start_iter(buffer, &start);
-    gtk_text_buffer_get_end_iter(buffer, &end);
+    gtk_widget_queue_draw(GTK_WIDGET(window->memory_area));
+}
 
-    gtk_text_buffer_delete(buffer, &start, &end);
+static void memory_window_set_space(MemoryWindow *window, enum WATCH_BUS bus)
+{
+    window->bus = bus;
+    window->size = SPACE_SIZES[bus];
+    window->selected = -1;
+    window->edited_nibbles = 0;
 
-    unsigned short start_address = window->start_address;
+    nes_peek_range(window->app->nes, bus, 0, window->bytes, window->size);
+    memcpy(window->previous, window->bytes, window->size);
+    memset(window->changed, 0, window->size);
 
-    for (int i = 0; i < 100; i++)
+    for (int i = 0; i < ROW_CACHE_SIZE; i++)
     {
-        gchar *str = g_strdup_printf("%04X    %02X %02X %02X %02X %02X %02X %02X %02X    %c%c%c%c%c%c%c%c\n", start_address,
-                                     memory_read_byte(memory, start_address),
-                                     memory_read_byte(memory, start_address + 1),
-                                     memory_read_byte(memory, start_address + 2),
-                                     memory_read_byte(memory, start_address + 3),
-                                     memory_read_byte(memory, start_address + 4),
-                                     memory_read_byte(memory, start_address + 5),
-                                     memory_read_byte(memory, start_address + 6),
-                                     memory_read_byte(memory, start_address + 7),
-                                     isprint(memory_read_byte(memory, start_address)) ? memory_read_byte(memory, start_address) : 0x2e,
-                                     isprint(memory_read_byte(memory, start_address + 1)) ? memory_read_byte(memory, start_address + 1) : 0x2e,
-                                     isprint(memory_read_byte(memory, start_address + 2)) ? memory_read_byte(memory, start_address + 2) : 0x2e,
-                                     isprint(memory_read_byte(memory, start_address + 3)) ? memory_read_byte(memory, start_address + 3) : 0x2e,
-                                     isprint(memory_read_byte(memory, start_address + 4)) ? memory_read_byte(memory, start_address + 4) : 0x2e,
-                                     isprint(memory_read_byte(memory, start_address + 5)) ? memory_read_byte(memory, start_address + 5) : 0x2e,
-                                     isprint(memory_read_byte(memory, start_address + 6)) ? memory_read_byte(memory, start_address + 6) : 0x2e,
-                                     isprint(memory_read_byte(memory, start_address + 7)) ? memory_read_byte(memory, start_address + 7) : 0x2e);
+        window->layouts[i].row = -1;
+    }
+
+    GtkAdjustment *adjustment = memory_window_adjustment(window);
+    gtk_adjustment_set_upper(adjustment, window->size / BYTES_PER_ROW);
+    gtk_adjustment_set_value(adjustment, 0);
+
+    memory_window_register(window);
+    gtk_widget_queue_draw(GTK_WIDGET(window->memory_area));
+}
 
-        gtk_text_buffer_get_end_iter(buffer, &end);
-        gtk_text_buffer_insert(buffer, &end, str, -1);
-        g_free(str);
+// Scrolls as little as possible to show the row of the address
+static void memory_window_show_address(MemoryWindow *window, unsigned int address)
+{
+    GtkAdjustment *adjustment = memory_window_adjustment(window);
+    int row = address / BYTES_PER_ROW;
+    int first_row = memory_window_first_row(window);
+    int page = gtk_adjustment_get_page_size(adjustment);
+
+    if (row < first_row)
+    {
+        gtk_adjustment_set_value(adjustment, row);
+    }
+    else if (page > 0 && row >= first_row + page)
+    {
+        gtk_adjustment_set_value(adjustment, row - page + 1);
+    }
+}
 
-        start_address += 8;
+static void memory_window_select(MemoryWindow *window, int address)
+{
+    if (address < 0 || address >= (int)window->size)
+    {
+        return;
     }
+
+    window->selected = address;
+    window->edited_nibbles = 0;
+
+    memory_window_show_address(window, address);
+    gtk_widget_queue_draw(GTK_WIDGET(window->memory_area));
+}
+
+// Runs on the emulation thread, the bus, address and value are packed in the pointer
+static void poke_call(NES *nes, void *data)
+{
+    guint packed = GPOINTER_TO_UINT(data);
+
+    nes_poke(nes, packed >> 24, (packed >> 8) & 0xffff, packed & 0xff);
 }
 
-static void memory_start_address_changed(GtkEntry *entry, DebuggerApp *app)
+static void memory_window_poke(MemoryWindow *window, unsigned int address, unsigned char value)
 {
-    MemoryWindow *memory_window = MEMORY_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(entry)));
+    DebuggerApp *app = window->app;
+
+    // Registers have no backing to write to
+    if (!nes_poke(app->nes, window->bus, address, value))
+    {
+        return;
+    }
+
+    window->bytes[address] = value;
+    memory_window_invalidate_row(window, address / BYTES_PER_ROW);
 
-    memory_window->start_address = strtol(gtk_entry_get_text(entry), NULL, 16);
-    update_memory_window(memory_window, app->nes->memory);
+    emulator_thread_call(app->emulator, poke_call, GUINT_TO_POINTER((window->bus << 24) | (address << 8) | value));
+}
+
+static void memory_window_highlight(cairo_t *cr, MemoryWindow *window, int index, int y)
+{
+    cairo_rectangle(cr, (HEX_COLUMN + index * 3) * window->char_width, y, 2 * window->char_width, window->line_height);
+    cairo_rectangle(cr, (ASCII_COLUMN + index) * window->char_width, y, window->char_width, window->line_height);
+    cairo_fill(cr);
+}
+
+static gboolean draw_memory(GtkWidget *widget, cairo_t *cr, MemoryWindow *window)
+{
+    guint width = gtk_widget_get_allocated_width(widget);
+    guint height = gtk_widget_get_allocated_height(widget);
+    int rows = window->size / BYTES_PER_ROW;
+
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_rectangle(cr, 0, 0, width, height);
+    cairo_fill(cr);
+
+    int row = memory_window_first_row(window);
+
+    for (int y = 0; y < (int)height && row < rows; y += window->line_height, row++)
+    {
+        for (int i = 0; i < BYTES_PER_ROW; i++)
+        {
+            int address = row * BYTES_PER_ROW + i;
+
+            if (address == window->selected)
+            {
+                cairo_set_source_rgb(cr, 0.6, 0.75, 1);
+                memory_window_highlight(cr, window, i, y);
+            }
+            else if (window->changed[address])
+            {
+                cairo_set_source_rgb(cr, 1, 0.85, 0.4);
+                memory_window_highlight(cr, window, i, y);
+            }
+        }
+
+        cairo_set_source_rgb(cr, 0, 0, 0);
+        cairo_move_to(cr, 0, y);
+        pango_cairo_show_layout(cr, memory_window_row_layout(window, row));
+    }
+
+    return FALSE;
+}
+
+static void memory_area_size_allocate(GtkWidget *widget, GdkRectangle *allocation, MemoryWindow *window)
+{
+    GtkAdjustment *adjustment = memory_window_adjustment(window);
+    int page = allocation->height / window->line_height;
+
+    gtk_adjustment_configure(adjustment, gtk_adjustment_get_value(adjustment), 0, window->size / BYTES_PER_ROW,
+                             1, page, page);
+    memory_window_register(window);
+}
+
+static void memory_window_scrolled(GtkAdjustment *adjustment, MemoryWindow *window)
+{
+    memory_window_register(window);
+    gtk_widget_queue_draw(GTK_WIDGET(window->memory_area));
+}
+
+static gboolean memory_area_scroll(GtkWidget *widget, GdkEventScroll *event, MemoryWindow *window)
+{
+    GtkAdjustment *adjustment = memory_window_adjustment(window);
+    double delta = 0;
+
+    switch (event->direction)
+    {
+    case GDK_SCROLL_UP:
+        delta = -3;
+        break;
+    case GDK_SCROLL_DOWN:
+        delta = 3;
+        break;
+    case GDK_SCROLL_SMOOTH:
+        delta = event->delta_y * 3;
+        break;
+    default:
+        break;
+    }
+
+    gtk_adjustment_set_value(adjustment, gtk_adjustment_get_value(adjustment) + delta);
+
+    return TRUE;
+}
+
+// Address of the byte at the position in the hex or ASCII columns, -1 when there is none
+static int memory_window_address_at(MemoryWindow *window, int x, int y, GdkRectangle *cell)
+{
+    int row = memory_window_first_row(window) + y / window->line_height;
+    int column = x / window->char_width;
+    int index = -1;
+    int width = 1;
+
+    if (column >= HEX_COLUMN && column < HEX_COLUMN + BYTES_PER_ROW * 3)
+    {
+        index = (column - HEX_COLUMN) / 3;
+        column = HEX_COLUMN + index * 3;
+        width = 2;
+    }
+    else if (column >= ASCII_COLUMN && column < ROW_LENGTH)
+    {
+        index = column - ASCII_COLUMN;
+    }
+
+    if (index < 0 || y < 0 || row * BYTES_PER_ROW + index >= (int)window->size)
+    {
+        return -1;
+    }
+
+    if (cell)
+    {
+        cell->x = column * window->char_width;
+        cell->y = y / window->line_height * window->line_height;
+        cell->width = width * window->char_width;
+        cell->height = window->line_height;
+    }
+
+    return row * BYTES_PER_ROW + index;
+}
+
+static gboolean memory_area_button_press(GtkWidget *widget, GdkEventButton *event, MemoryWindow *window)
+{
+    int address = memory_window_address_at(window, event->x, event->y, NULL);
+
+    gtk_widget_grab_focus(widget);
+
+    window->selected = -1;
+
+    if (address >= 0)
+    {
+        memory_window_select(window, address);
+    }
+
+    gtk_widget_queue_draw(widget);
+
+    return TRUE;
+}
+
+// Names the CPU byte under the pointer and lists who references it, elsewhere the editing hint is shown
+static gboolean memory_area_query_tooltip(GtkWidget *widget, gint x, gint y, gboolean keyboard_mode,
+                                          GtkTooltip *tooltip, MemoryWindow *window)
+{
+    DebuggerApp *app = window->app;
+    GdkRectangle cell;
+    int address = memory_window_address_at(window, x, y, &cell);
+    int location = address >= 0 && window->bus == WATCH_BUS_CPU ? debugger_app_location(app, address) : -1;
+    unsigned int count = location >= 0 && app->xrefs ? xref_index_count(app->xrefs, location) : 0;
+    const SOURCE_SPAN *span = location >= 0 ? debug_info_span_at(app->debug_info, location) : NULL;
+    char name[64];
+    int named = location >= 0 && debugger_app_symbol_name(app, address, name, sizeof(name));
+
+    if (keyboard_mode || (!count && !named && !span))
+    {
+        return FALSE;
+    }
+
+    GString *text = g_string_new(NULL);
+
+    g_string_append_printf(text, "$%04X", address);
+
+    if (named)
+    {
+        g_string_append_printf(text, " %s", name);
+    }
+
+    if (span)
+    {
+        char line[80];
+
+        g_string_append_printf(text, "\n%s:%u", debug_info_name(app->debug_info, app->debug_info->files[span->file].name), span->line);
+
+        if (debug_info_source_line(app->debug_info, span, line, sizeof(line)) > 0)
+        {
+            g_string_append_printf(text, " %s", line);
+        }
+    }
+
+    if (count)
+    {
+        XREF xrefs[TOOLTIP_XREFS];
+        unsigned int shown = xref_index_list(app->xrefs, location, xrefs, TOOLTIP_XREFS);
+
+        g_string_append(text, "\nreferenced by:");
+
+        for (unsigned int i = 0; i < shown; i++)
+        {
+            g_string_append_printf(text, "\n%04X %s", xref_location_address(app->analysis, xrefs[i].from),
+                                   xref_kinds_name(xrefs[i].kinds));
+        }
+
+        if (count > shown)
+        {
+            g_string_append_printf(text, "\n%u more", count - shown);
+        }
+    }
+
+    gtk_tooltip_set_text(tooltip, text->str);
+    g_string_free(text, TRUE);
+
+    // Asked again once the pointer leaves the byte
+    gtk_tooltip_set_tip_area(tooltip, &cell);
+
+    return TRUE;
+}
+
+// Arrows move the selection, hex digits change the selected byte, high nibble first
+static gboolean memory_area_key_press(GtkWidget *widget, GdkEventKey *event, MemoryWindow *window)
+{
+    if (window->selected < 0)
+    {
+        return FALSE;
+    }
+
+    switch (event->keyval)
+    {
+    case GDK_KEY_Left:
+        memory_window_select(window, window->selected - 1);
+        return TRUE;
+    case GDK_KEY_Right:
+        memory_window_select(window, window->selected + 1);
+        return TRUE;
+    case GDK_KEY_Up:
+        memory_window_select(window, window->selected - BYTES_PER_ROW);
+        return TRUE;
+    case GDK_KEY_Down:
+        memory_window_select(window, window->selected + BYTES_PER_ROW);
+        return TRUE;
+    case GDK_KEY_Escape:
+        window->selected = -1;
+        gtk_widget_queue_draw(widget);
+        return TRUE;
+    }
+
+    int digit = event->keyval < 0x80 ? g_ascii_xdigit_value(event->keyval) : -1;
+
+    if (digit < 0)
+    {
+        return FALSE;
+    }
+
+    unsigned char value = window->bytes[window->selected];
+    value = window->edited_nibbles ? (value & 0xf0) | digit : (digit << 4) | (value & 0x0f);
+
+    memory_window_poke(window, window->selected, value);
+
+    if (++window->edited_nibbles == 2)
+    {
+        memory_window_select(window, window->selected + 1);
+    }
+
+    gtk_widget_queue_draw(widget);
+
+    return TRUE;
+}
+
+static void memory_space_changed(GtkComboBox *combo, MemoryWindow *window)
+{
+    gint bus = gtk_combo_box_get_active(combo);
+
+    memory_window_set_space(window, bus < 0 ? WATCH_BUS_CPU : bus);
+}
+
+static void memory_start_address_changed(GtkEntry *entry, MemoryWindow *window)
+{
+    unsigned short cpu_address;
+    unsigned int size;
+    unsigned int address = strtol(gtk_entry_get_text(entry), NULL, 16);
+
+    // Symbols are CPU addresses
+    if (window->bus == WATCH_BUS_CPU && debugger_app_parse_address(window->app, gtk_entry_get_text(entry), &cpu_address, &size, NULL) == 0)
+    {
+        address = cpu_address;
+    }
+
+    if (address >= window->size)
+    {
+        address = window->size - 1;
+    }
+
+    gtk_adjustment_set_value(memory_window_adjustment(window), address / BYTES_PER_ROW);
+    memory_window_select(window, address);
 }
 
 MemoryWindow *memory_window_new(DebuggerApp *app)
 {
     MemoryWindow *window = g_object_new(MEMORY_WINDOW_TYPE, NULL);
+    GtkWidget *area = GTK_WIDGET(window->memory_area);
+
+    window->app = app;
+
+    // Every row is laid out with the same monospace font, measured once
+    window->font = pango_font_description_from_string("Monospace 10");
+    PangoLayout *layout = gtk_widget_create_pango_layout(area, "0");
+    pango_layout_set_font_description(layout, window->font);
+    pango_layout_get_pixel_size(layout, &window->char_width, &window->line_height);
+    g_object_unref(layout);
+
+    gtk_widget_set_size_request(area, ROW_LENGTH * window->char_width, 8 * window->line_height);
+    gtk_widget_add_events(area, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK | GDK_BUTTON_PRESS_MASK | GDK_KEY_PRESS_MASK);
+
     g_signal_connect(window, "destroy", G_CALLBACK(close_memory_window), app);
-    g_signal_connect(window->memory_start_address_entry, "activate", G_CALLBACK(memory_start_address_changed), app);
+    g_signal_connect(window->memory_space_combo, "changed", G_CALLBACK(memory_space_changed), window);
+    g_signal_connect(window->memory_start_address_entry, "activate", G_CALLBACK(memory_start_address_changed), window);
+    g_signal_connect(area, "draw", G_CALLBACK(draw_memory), window);
+    g_signal_connect(area, "size-allocate", G_CALLBACK(memory_area_size_allocate), window);
+    g_signal_connect(area, "scroll-event", G_CALLBACK(memory_area_scroll), window);
+    g_signal_connect(area, "button-press-event", G_CALLBACK(memory_area_button_press), window);
+    g_signal_connect(area, "key-press-event", G_CALLBACK(memory_area_key_press), window);
+    g_signal_connect(area, "query-tooltip", G_CALLBACK(memory_area_query_tooltip), window);
+    g_signal_connect(memory_window_adjustment(window), "value-changed", G_CALLBACK(memory_window_scrolled), window);
+
+    memory_window_set_space(window, WATCH_BUS_CPU);
 
     return window;
 }
@@ -10,6 +10,6 @@ G_DECLARE_FINAL_TYPE(MemoryWindow, memory_window, MEMORY, WINDOW, GtkWindow);
 
 MemoryWindow *memory_window_new(DebuggerApp *app);
 
-void update_memory_window(MemoryWindow *window, MEMORY *memory);
+void update_memory_window(MemoryWindow *window, NES *nes);
 
 #endif
\ No newline at end of file
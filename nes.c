@@ -1,9 +1,18 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "nes.h"
 
 #define LOG(...) printf(__VA_ARGS__)
+#define TRACE(...) (logstream ? fprintf(logstream, __VA_ARGS__) : 0)
+
+#define OPCODE_JSR 0x20
+#define OPCODE_RTI 0x40
+#define OPCODE_RTS 0x60
+
+// Flag tested by each branch opcode, indexed by bits 6-7 of the opcode. Bit 5 is the expected flag value
+static const unsigned char BRANCH_FLAGS[4] = {FLAG_N, FLAG_V, FLAG_C, FLAG_Z};
 
 char *dump_registers(CPU *cpu)
 {
@@ -17,21 +26,49 @@ char *dump_registers(CPU *cpu)
 NES *create_nes()
 {
     NES *nes = malloc(sizeof(NES));
+    nes->scheduler = create_scheduler();
     nes->ppu_memory = create_ppu_memory();
-    nes->ppu = create_ppu(nes->ppu_memory);
+    nes->ppu = create_ppu(nes->ppu_memory, nes->scheduler);
     nes->memory = create_memory(nes->ppu);
     nes->cpu = create_cpu(nes->memory);
+    nes->memory->cpu_cycles = &nes->cpu->cycles;
+    nes->breakpoints = create_breakpoints();
+    nes->memory->watchpoints = &nes->breakpoints->watchpoints;
+    nes->trace = 1;
+    nes->xrefs = NULL;
+    nes->cdl = NULL;
+    nes->symbols = NULL;
+    nes->recorder = NULL;
 
     return nes;
 }
 
-void load_rom(NES *nes, const char *filename)
+int load_rom(NES *nes, const char *filename)
 {
     FILE *rom_file = fopen(filename, "rb");
 
+    if (!rom_file)
+    {
+        return -1;
+    }
+
+    unsigned char header[16];
+    fread(header, 1, sizeof(header), rom_file);
+
+    // The log is for the sizes of the new ROM, before the reset vector is read
+    if (nes->cdl)
+    {
+        cdl_reset(nes->cdl, header[4] * 16 * 1024, header[5] * 8 * 1024);
+    }
+
+    // The first bank at $8000 and the last one at $C000, the same one for 16 KB. CHR follows the PRG.
+    unsigned int prg_banks = header[4] ? header[4] : 1;
+
+    nes->memory->prg_size = prg_banks * 16 * 1024;
+
     fseek(rom_file, 16, SEEK_SET);
     fread(nes->memory->prg_rom_lower_bank, 1, 16 * 1024, rom_file);
-    fseek(rom_file, 16, SEEK_SET);
+    fseek(rom_file, 16 + (prg_banks - 1) * 16 * 1024, SEEK_SET);
     fread(nes->memory->prg_rom_upper_bank, 1, 16 * 1024, rom_file);
 
     fread(nes->ppu_memory->pattern_table_0, 1, 4 * 1024, rom_file);
@@ -40,46 +77,217 @@ void load_rom(NES *nes, const char *filename)
     fclose(rom_file);
 
     nes->cpu->pc = memory_read_word(nes->memory, 0x0fffc);
+
+    return 0;
+}
+
+// Logs how the CPU and the PPU use the ROM bytes from now on, NULL stops logging
+void nes_set_cdl(NES *nes, CDL *cdl)
+{
+    nes->cdl = cdl;
+    nes->memory->cdl = cdl;
+    nes->ppu->cdl = cdl;
 }
 
 void execute_rts(NES *nes)
 {
     CPU *cpu = nes->cpu;
-    MEMORY *memory = nes->memory;
 
     unsigned char lowAddress = pop(cpu);
     unsigned char highAddress = pop(cpu);
     cpu->pc = ((highAddress << 8) | lowAddress) + 1;
 }
 
+// Handles the events due at the current CPU cycle
+static void nes_run_events(NES *nes)
+{
+    CPU *cpu = nes->cpu;
+    unsigned long long now = cpu->cycles * MASTER_CYCLES_PER_CPU_CYCLE;
+
+    while (nes->scheduler->next_cycle <= now)
+    {
+        switch (scheduler_pop(nes->scheduler))
+        {
+        case EVENT_VBLANK_START:
+        case EVENT_VBLANK_END:
+            ppu_catch_up(nes->ppu, cpu->cycles);
+            break;
+        case EVENT_NMI:
+            trigger_NMI(cpu);
+            cpu->cycles += 7;
+
+            if (nes->recorder)
+            {
+                trace_writer_enter_nmi(nes->recorder);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/*
+ * Address the operand of the instruction at pc designates with the current registers, the
+ * pointer for a JMP through one. Instructions never change the register they index with, so the
+ * registers they left give the address they used.
+ */
+static unsigned short nes_operand_address(NES *nes, unsigned short pc, enum ADDRESSING_MODE mode)
+{
+    CPU *cpu = nes->cpu;
+    unsigned short address = nes_peek(nes, WATCH_BUS_CPU, pc + 1);
+
+    if (mode == ABSOLUTE || mode == ABSOLUTE_X || mode == ABSOLUTE_Y || mode == INDIRECT)
+    {
+        address |= nes_peek(nes, WATCH_BUS_CPU, pc + 2) << 8;
+    }
+
+    switch (mode)
+    {
+    case ZERO_PAGE_X:
+        address = (address + cpu->registerX) & 0xff;
+        break;
+    case ZERO_PAGE_Y:
+        address = (address + cpu->registerY) & 0xff;
+        break;
+    case ABSOLUTE_X:
+        address += cpu->registerX;
+        break;
+    case ABSOLUTE_Y:
+        address += cpu->registerY;
+        break;
+    case INDEXED_INDIRECT:
+        address = nes_peek(nes, WATCH_BUS_CPU, (address + cpu->registerX) & 0xff) |
+                  nes_peek(nes, WATCH_BUS_CPU, (address + cpu->registerX + 1) & 0xff) << 8;
+        break;
+    case INDIRECT_INDEXED:
+        address = (nes_peek(nes, WATCH_BUS_CPU, address) | nes_peek(nes, WATCH_BUS_CPU, (address + 1) & 0xff) << 8) + cpu->registerY;
+        break;
+    case RELATIVE:
+        address = pc + 2 + (signed char)address;
+        break;
+    default:
+        break;
+    }
+
+    return address;
+}
+
+// Logs the operand of the instruction just run
+static void nes_log_xrefs(NES *nes, unsigned short pc, unsigned char opcode)
+{
+    unsigned char kinds = OPCODES[opcode].access;
+
+    if (!kinds)
+    {
+        return;
+    }
+
+    enum ADDRESSING_MODE mode = OPCODES[opcode].mode;
+    unsigned short address = nes_operand_address(nes, pc, mode);
+
+    if (mode == INDIRECT)
+    {
+        // The pointer is read, then the jump goes where it pointed
+        xref_log_add(nes->xrefs, address, pc, XREF_READ);
+        address = nes->cpu->pc;
+        kinds = XREF_JUMP;
+    }
+
+    xref_log_add(nes->xrefs, address, pc, kinds);
+}
+
+// Records the instruction about to run, with the value its operand has before it runs
+static void nes_record_instruction(NES *nes, unsigned char opcode)
+{
+    CPU *cpu = nes->cpu;
+    const OPCODE_INFO *info = &OPCODES[opcode];
+    TRACE_RECORD record = {0};
+
+    record.cycle = cpu->cycles;
+    record.frame = nes->ppu->frame_number;
+    record.pc = cpu->pc;
+    record.bytes[0] = opcode;
+    record.a = cpu->registerA;
+    record.x = cpu->registerX;
+    record.y = cpu->registerY;
+    record.p = cpu->registerP;
+    record.sp = cpu->sp;
+
+    for (unsigned int i = 1; i < info->length; i++)
+    {
+        record.bytes[i] = nes_peek(nes, WATCH_BUS_CPU, cpu->pc + i);
+    }
+
+    if (info->access)
+    {
+        unsigned short address = nes_operand_address(nes, cpu->pc, info->mode);
+
+        // The pointer does not cross its page, like the JMP does
+        if (info->mode == INDIRECT)
+        {
+            address = nes_peek(nes, WATCH_BUS_CPU, address) |
+                      nes_peek(nes, WATCH_BUS_CPU, (address & 0xff00) | ((address + 1) & 0xff)) << 8;
+        }
+
+        record.address = address;
+        record.value = nes_peek(nes, WATCH_BUS_CPU, address);
+        record.flags = TRACE_RECORD_ADDRESS;
+    }
+
+    trace_write(nes->recorder, &record);
+}
+
 int execute_instruction(NES *nes)
 {
     CPU *cpu = nes->cpu;
     MEMORY *memory = nes->memory;
-    memory->last_read_address = 0;
-    memory->last_write_address = 0;
+    nes->breakpoints->watchpoints.match_count = 0;
 
-    if (nes->interrupt_NMI && (nes->ppu->control_register & 0x80))
+    if (cpu->cycles * MASTER_CYCLES_PER_CPU_CYCLE >= nes->scheduler->next_cycle)
     {
-        nes->interrupt_NMI = 0;
-        trigger_NMI(cpu);
+        nes_run_events(nes);
     }
 
+    unsigned int cycles = 0;
+
+    unsigned short instruction_pc = cpu->pc;
+
+    // The opcode tells how many of the bytes that follow the code/data log takes as operands
+    memory->fetch_address = cpu->pc;
+    memory->fetch_length = 1;
     unsigned char inst = memory_read_byte(memory, cpu->pc);
+    memory->fetch_length = nes->cdl ? OPCODES[inst].length : 0;
+
+    if (nes->recorder)
+    {
+        if (trace_writer_accepts(nes->recorder, cpu->pc, nes->ppu->frame_number))
+        {
+            nes_record_instruction(nes, inst);
+        }
+
+        trace_writer_follow(nes->recorder, inst);
+    }
 
     char *logBuffer;
     size_t logSize;
-    FILE *logstream = open_memstream(&logBuffer, &logSize);
+    FILE *logstream = NULL;
+    char *logRegisters = NULL;
+
+    if (nes->trace)
+    {
+        logstream = open_memstream(&logBuffer, &logSize);
+        logRegisters = dump_registers(cpu);
+    }
 
-    char *logRegisters = dump_registers(cpu);
-    fprintf(logstream, "%04X  %02X", cpu->pc, inst);
+    TRACE("%04X  %02X", cpu->pc, inst);
     cpu->pc++;
 
-    unsigned short address;
+    unsigned short address = 0; // read by the page crossing penalties, set by every opcode that has one
     char disp;
     unsigned char value;
     unsigned short sum;
-    unsigned short indirect_address;
+    unsigned short indirect_address = 0;
     unsigned char carry;
     unsigned char zeropage_indexed_address;
     switch (inst)
@@ -91,8 +299,8 @@ int execute_instruction(NES *nes)
         indirect_address = memory_read_word_zero_page(memory, (address + cpu->registerX) & 0xff);
         value = memory_read_byte(memory, indirect_address);
         cpu->registerA |= value;
-        fprintf(logstream, " %02X     ", address & 0xff);
-        fprintf(logstream, "ORA ($%02X,X) @ %02X = %04X = %02X", address & 0xff, (address + cpu->registerX) & 0xff, indirect_address, value);
+        TRACE(" %02X     ", address & 0xff);
+        TRACE("ORA ($%02X,X) @ %02X = %04X = %02X", address & 0xff, (address + cpu->registerX) & 0xff, indirect_address, value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
@@ -101,8 +309,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ORA $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("ORA $%02X = %02X", address, value);
         cpu->registerA |= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -112,8 +320,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ASL $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("ASL $%02X = %02X", address, value);
         set_flag_cond(cpu, FLAG_C, value & 0x80);
         value = value << 1;
         set_flag_cond(cpu, FLAG_Z, value == 0);
@@ -122,22 +330,22 @@ int execute_instruction(NES *nes)
         break;
     case 0x08:
         // PHP
-        fprintf(logstream, "        PHP");
+        TRACE("        PHP");
         push(cpu, cpu->registerP | 0x30);
         break;
     case 0x09:
         // OR immediate
         value = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", value);
-        fprintf(logstream, "ORA #$%02X", value);
+        TRACE(" %02X     ", value);
+        TRACE("ORA #$%02X", value);
         cpu->registerA |= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
     case 0x0a:
         // ASL A
-        fprintf(logstream, "        ASL A");
+        TRACE("        ASL A");
         set_flag_cond(cpu, FLAG_C, cpu->registerA & 0x80);
         cpu->registerA = cpu->registerA << 1;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
@@ -148,8 +356,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ORA $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ORA $%04X = %02X", address, value);
         cpu->registerA |= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -159,8 +367,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ASL $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ASL $%04X = %02X", address, value);
         set_flag_cond(cpu, FLAG_C, value & 0x80);
         value = value << 1;
         set_flag_cond(cpu, FLAG_Z, value == 0);
@@ -171,8 +379,8 @@ int execute_instruction(NES *nes)
         // BPL
         disp = memory_read_byte(memory, cpu->pc);
         cpu->pc += 1;
-        fprintf(logstream, " %02X     ", disp);
-        fprintf(logstream, "BPL $%04X", cpu->pc + disp);
+        TRACE(" %02X     ", disp);
+        TRACE("BPL $%04X", cpu->pc + disp);
         if (!get_flag(cpu, FLAG_N))
         {
             cpu->pc += disp;
@@ -184,8 +392,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, address);
         value = memory_read_byte(memory, indirect_address + cpu->registerY);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ORA ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X     ", address);
+        TRACE("ORA ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
         cpu->registerA |= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -196,8 +404,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ORA $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("ORA $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         cpu->registerA |= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -208,8 +416,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ASL $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("ASL $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         set_flag_cond(cpu, FLAG_C, value & 0x80);
         value = value << 1;
         set_flag_cond(cpu, FLAG_Z, value == 0);
@@ -219,15 +427,15 @@ int execute_instruction(NES *nes)
     case 0x18:
         // CLC
         clear_flag(cpu, FLAG_C);
-        fprintf(logstream, "        CLC");
+        TRACE("        CLC");
         break;
     case 0x19:
         // ORA absolute, Y
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerY);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ORA $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ORA $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
         cpu->registerA |= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -237,8 +445,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ORA $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ORA $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         cpu->registerA |= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -248,8 +456,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ASL $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ASL $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         set_flag_cond(cpu, FLAG_C, value & 0x80);
         value = value << 1;
         set_flag_cond(cpu, FLAG_Z, value == 0);
@@ -260,8 +468,8 @@ int execute_instruction(NES *nes)
         // JSR
         address = memory_read_word(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "JSR $%04X", address);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("JSR $%04X", address);
         push(cpu, (cpu->pc >> 8) & 0xff);
         push(cpu, cpu->pc & 0xff);
         cpu->pc = address;
@@ -273,8 +481,8 @@ int execute_instruction(NES *nes)
         indirect_address = memory_read_word_zero_page(memory, (address + cpu->registerX) & 0xff);
         value = memory_read_byte(memory, indirect_address);
         cpu->registerA &= value;
-        fprintf(logstream, " %02X     ", address & 0xff);
-        fprintf(logstream, "AND ($%02X,X) @ %02X = %04X = %02X", address & 0xff, (address + cpu->registerX) & 0xff, indirect_address, value);
+        TRACE(" %02X     ", address & 0xff);
+        TRACE("AND ($%02X,X) @ %02X = %04X = %02X", address & 0xff, (address + cpu->registerX) & 0xff, indirect_address, value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
@@ -283,8 +491,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "BIT $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("BIT $%02X = %02X", address, value);
         set_flag_cond(cpu, FLAG_Z, (cpu->registerA & value) == 0);
         set_flag_cond(cpu, FLAG_N, value & 0x80);
         set_flag_cond(cpu, FLAG_V, value & 0x40);
@@ -294,8 +502,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "AND $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("AND $%02X = %02X", address, value);
         cpu->registerA &= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -305,8 +513,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ROL $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("ROL $%02X = %02X", address, value);
         carry = get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_C, (value >> 7) & 0x01);
         value = (value << 1) | carry;
@@ -324,22 +532,22 @@ int execute_instruction(NES *nes)
         break;
     case 0x28:
         // PLP
-        fprintf(logstream, "        PLP");
+        TRACE("        PLP");
         cpu->registerP = (cpu->registerP & 0x30) | (pop(cpu) & 0xcf);
         break;
     case 0x29:
         // AND immediate
         value = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", value);
-        fprintf(logstream, "AND #$%02X", value);
+        TRACE(" %02X     ", value);
+        TRACE("AND #$%02X", value);
         cpu->registerA &= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
     case 0x2a:
         // ROL A
-        fprintf(logstream, "        ROL A");
+        TRACE("        ROL A");
         value = (cpu->registerA >> 7) & 0x01;
         cpu->registerA = (cpu->registerA << 1) | get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_C, value);
@@ -351,8 +559,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "BIT $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("BIT $%04X = %02X", address, value);
         set_flag_cond(cpu, FLAG_Z, (cpu->registerA & value) == 0);
         set_flag_cond(cpu, FLAG_N, value & 0x80);
         set_flag_cond(cpu, FLAG_V, value & 0x40);
@@ -362,8 +570,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "AND $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("AND $%04X = %02X", address, value);
         cpu->registerA &= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -373,8 +581,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ROL $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ROL $%04X = %02X", address, value);
         carry = get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_C, (value >> 7) & 0x01);
         value = (value << 1) | carry;
@@ -386,8 +594,8 @@ int execute_instruction(NES *nes)
         // BMI
         disp = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", disp);
-        fprintf(logstream, "BMI $%04X", cpu->pc + disp);
+        TRACE(" %02X     ", disp);
+        TRACE("BMI $%04X", cpu->pc + disp);
         if (get_flag(cpu, FLAG_N))
         {
             cpu->pc += disp;
@@ -399,8 +607,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, address);
         value = memory_read_byte(memory, indirect_address + cpu->registerY);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "AND ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X     ", address);
+        TRACE("AND ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
         cpu->registerA &= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -411,8 +619,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "AND $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("AND $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         cpu->registerA &= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -423,8 +631,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ROL $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("ROL $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         carry = get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_C, (value >> 7) & 0x01);
         value = (value << 1) | carry;
@@ -435,15 +643,15 @@ int execute_instruction(NES *nes)
     case 0x38:
         // SEC
         set_flag(cpu, FLAG_C);
-        fprintf(logstream, "        SEC");
+        TRACE("        SEC");
         break;
     case 0x39:
         // AND absolute, Y
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerY);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "AND $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("AND $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
         cpu->registerA &= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -453,8 +661,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "AND $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("AND $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         cpu->registerA &= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -464,8 +672,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ROL $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ROL $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         carry = get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_C, (value >> 7) & 0x01);
         value = (value << 1) | carry;
@@ -475,7 +683,7 @@ int execute_instruction(NES *nes)
         break;
     case 0x40:
         // RTI
-        fprintf(logstream, "        RTI");
+        TRACE("        RTI");
         cpu->registerP = (cpu->registerP & 0x30) | (pop(cpu) & 0xcf);
         cpu->pc = pop(cpu) | (pop(cpu) << 8);
         break;
@@ -486,8 +694,8 @@ int execute_instruction(NES *nes)
         indirect_address = memory_read_word_zero_page(memory, (address + cpu->registerX) & 0xff);
         value = memory_read_byte(memory, indirect_address);
         cpu->registerA ^= value;
-        fprintf(logstream, " %02X     ", address & 0xff);
-        fprintf(logstream, "EOR ($%02X,X) @ %02X = %04X = %02X", address & 0xff, (address + cpu->registerX) & 0xff, indirect_address, value);
+        TRACE(" %02X     ", address & 0xff);
+        TRACE("EOR ($%02X,X) @ %02X = %04X = %02X", address & 0xff, (address + cpu->registerX) & 0xff, indirect_address, value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
@@ -496,8 +704,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "EOR $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("EOR $%02X = %02X", address, value);
         cpu->registerA ^= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -507,8 +715,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "LSR $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("LSR $%02X = %02X", address, value);
         set_flag_cond(cpu, FLAG_C, value & 0x01);
         value = value >> 1;
         memory_write(memory, address, value);
@@ -517,22 +725,22 @@ int execute_instruction(NES *nes)
         break;
     case 0x48:
         // PHA
-        fprintf(logstream, "        PHA");
+        TRACE("        PHA");
         push(cpu, cpu->registerA);
         break;
     case 0x49:
         // EOR immediate
         value = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", value);
-        fprintf(logstream, "EOR #$%02X", value);
+        TRACE(" %02X     ", value);
+        TRACE("EOR #$%02X", value);
         cpu->registerA ^= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
     case 0x4a:
         // LSR A
-        fprintf(logstream, "        LSR A");
+        TRACE("        LSR A");
         set_flag_cond(cpu, FLAG_C, cpu->registerA & 0x01);
         cpu->registerA = cpu->registerA >> 1;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
@@ -541,8 +749,8 @@ int execute_instruction(NES *nes)
     case 0x4c:
         // JMP absolute
         address = memory_read_word(memory, cpu->pc);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "JMP $%04X", address);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("JMP $%04X", address);
         cpu->pc = address;
         break;
     case 0x4d:
@@ -550,8 +758,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "EOR $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("EOR $%04X = %02X", address, value);
         cpu->registerA ^= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -561,8 +769,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "LSR $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("LSR $%04X = %02X", address, value);
         set_flag_cond(cpu, FLAG_C, value & 0x01);
         value = value >> 1;
         memory_write(memory, address, value);
@@ -573,8 +781,8 @@ int execute_instruction(NES *nes)
         // BVC
         disp = memory_read_byte(memory, cpu->pc);
         cpu->pc += 1;
-        fprintf(logstream, " %02X     ", disp);
-        fprintf(logstream, "BVC $%04X", cpu->pc + disp);
+        TRACE(" %02X     ", disp);
+        TRACE("BVC $%04X", cpu->pc + disp);
         if (!get_flag(cpu, FLAG_V))
         {
             cpu->pc += disp;
@@ -586,8 +794,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, address);
         value = memory_read_byte(memory, indirect_address + cpu->registerY);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "EOR ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X     ", address);
+        TRACE("EOR ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
         cpu->registerA ^= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -598,8 +806,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "EOR $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("EOR $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         cpu->registerA ^= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -610,8 +818,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "LSR $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("LSR $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         set_flag_cond(cpu, FLAG_C, value & 0x01);
         value = value >> 1;
         memory_write(memory, zeropage_indexed_address, value);
@@ -623,8 +831,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerY);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "EOR $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("EOR $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
         cpu->registerA ^= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -634,8 +842,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "EOR $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("EOR $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         cpu->registerA ^= value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -645,8 +853,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "LSR $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("LSR $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         set_flag_cond(cpu, FLAG_C, value & 0x01);
         value = value >> 1;
         memory_write(memory, address + cpu->registerX, value);
@@ -655,7 +863,7 @@ int execute_instruction(NES *nes)
         break;
     case 0x60:
         // RTS
-        fprintf(logstream, "        RTS");
+        TRACE("        RTS");
         execute_rts(nes);
         break;
     case 0x61:
@@ -664,8 +872,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, (address + cpu->registerX) & 0xff);
         value = memory_read_byte(memory, indirect_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ADC ($%02X,X) @ %02X = %04X = %02X", address, (address + cpu->registerX) & 0xff, indirect_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("ADC ($%02X,X) @ %02X = %04X = %02X", address, (address + cpu->registerX) & 0xff, indirect_address, value);
         sum = cpu->registerA + value + get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_V, (value < 0x80 && cpu->registerA < 0x80 && sum > 0x7f) || (value >= 0x80 && cpu->registerA >= 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -678,8 +886,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ADC $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("ADC $%02X = %02X", address, value);
         sum = cpu->registerA + value + get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_V, (value < 0x80 && cpu->registerA < 0x80 && sum > 0x7f) || (value >= 0x80 && cpu->registerA >= 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -692,8 +900,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ROR $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("ROR $%02X = %02X", address, value);
         carry = get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_C, value & 0x01);
         value = (value >> 1) | (carry << 7);
@@ -703,7 +911,7 @@ int execute_instruction(NES *nes)
         break;
     case 0x68:
         // PLA
-        fprintf(logstream, "        PLA");
+        TRACE("        PLA");
         cpu->registerA = pop(cpu);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
@@ -712,8 +920,8 @@ int execute_instruction(NES *nes)
         // ADC immediate
         value = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", value);
-        fprintf(logstream, "ADC #$%02X", value);
+        TRACE(" %02X     ", value);
+        TRACE("ADC #$%02X", value);
         sum = cpu->registerA + value + get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_V, (value < 0x80 && cpu->registerA < 0x80 && sum > 0x7f) || (value >= 0x80 && cpu->registerA >= 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -723,7 +931,7 @@ int execute_instruction(NES *nes)
         break;
     case 0x6a:
         // ROR A
-        fprintf(logstream, "        ROR A");
+        TRACE("        ROR A");
         value = get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_C, cpu->registerA & 0x01);
         cpu->registerA = (cpu->registerA >> 1) | (value << 7);
@@ -735,8 +943,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         indirect_address = memory_read_byte(memory, address) | (memory_read_byte(memory, ((address & 0xff00) + ((address + 1) & 0xff))) << 8);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "JMP ($%04X) = %04X", address, indirect_address);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("JMP ($%04X) = %04X", address, indirect_address);
         cpu->pc = indirect_address;
         break;
     case 0x6d:
@@ -744,8 +952,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ADC $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ADC $%04X = %02X", address, value);
         sum = cpu->registerA + value + get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_V, (value < 0x80 && cpu->registerA < 0x80 && sum > 0x7f) || (value >= 0x80 && cpu->registerA >= 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -758,8 +966,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ROR $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ROR $%04X = %02X", address, value);
         carry = get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_C, value & 0x01);
         value = (value >> 1) | (carry << 7);
@@ -771,8 +979,8 @@ int execute_instruction(NES *nes)
         // BVS
         disp = memory_read_byte(memory, cpu->pc);
         cpu->pc += 1;
-        fprintf(logstream, " %02X     ", disp);
-        fprintf(logstream, "BVS $%04X", cpu->pc + disp);
+        TRACE(" %02X     ", disp);
+        TRACE("BVS $%04X", cpu->pc + disp);
         if (get_flag(cpu, FLAG_V))
         {
             cpu->pc += disp;
@@ -784,8 +992,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, address);
         value = memory_read_byte(memory, indirect_address + cpu->registerY);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ADC ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X     ", address);
+        TRACE("ADC ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
         sum = cpu->registerA + value + get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_V, (value < 0x80 && cpu->registerA < 0x80 && sum > 0x7f) || (value >= 0x80 && cpu->registerA >= 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -799,8 +1007,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ADC $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("ADC $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         sum = cpu->registerA + value + get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_V, (value < 0x80 && cpu->registerA < 0x80 && sum > 0x7f) || (value >= 0x80 && cpu->registerA >= 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -814,8 +1022,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "ROR $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("ROR $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         carry = get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_C, value & 0x01);
         value = (value >> 1) | (carry << 7);
@@ -825,7 +1033,7 @@ int execute_instruction(NES *nes)
         break;
     case 0x78:
         // SEI
-        fprintf(logstream, "        SEI");
+        TRACE("        SEI");
         set_flag(cpu, FLAG_I);
         break;
     case 0x79:
@@ -833,8 +1041,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerY);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ADC $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ADC $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
         sum = cpu->registerA + value + get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_V, (value < 0x80 && cpu->registerA < 0x80 && sum > 0x7f) || (value >= 0x80 && cpu->registerA >= 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -847,8 +1055,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ADC $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ADC $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         sum = cpu->registerA + value + get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_V, (value < 0x80 && cpu->registerA < 0x80 && sum > 0x7f) || (value >= 0x80 && cpu->registerA >= 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -861,8 +1069,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "ROR $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("ROR $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         carry = get_flag(cpu, FLAG_C);
         set_flag_cond(cpu, FLAG_C, value & 0x01);
         value = (value >> 1) | (carry << 7);
@@ -875,44 +1083,44 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, (address + cpu->registerX) & 0xff);
-        fprintf(logstream, " %02X     ", address & 0xff);
-        fprintf(logstream, "STA ($%02X,X) @ %02X = %04X = %02X", address & 0xff, (address + cpu->registerX) & 0xff, indirect_address, memory_read_byte(memory, indirect_address));
+        TRACE(" %02X     ", address & 0xff);
+        TRACE("STA ($%02X,X) @ %02X = %04X = %02X", address & 0xff, (address + cpu->registerX) & 0xff, indirect_address, memory_read_byte(memory, indirect_address));
         memory_write(memory, indirect_address, cpu->registerA);
         break;
     case 0x84:
         // STY zero page
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "STY $%02X = %02X", address, memory_read_byte(memory, address));
+        TRACE(" %02X     ", address);
+        TRACE("STY $%02X = %02X", address, memory_read_byte(memory, address));
         memory_write(memory, address, cpu->registerY);
         break;
     case 0x85:
         // STA zero page
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "STA $%02X = %02X", address, memory_read_byte(memory, address));
+        TRACE(" %02X     ", address);
+        TRACE("STA $%02X = %02X", address, memory_read_byte(memory, address));
         memory_write(memory, address, cpu->registerA);
         break;
     case 0x86:
         // STX zero page
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "STX $%02X = %02X", address, memory_read_byte(memory, address));
+        TRACE(" %02X     ", address);
+        TRACE("STX $%02X = %02X", address, memory_read_byte(memory, address));
         memory_write(memory, address, cpu->registerX);
         break;
     case 0x88:
         // DEY
-        fprintf(logstream, "        DEY");
+        TRACE("        DEY");
         cpu->registerY--;
         set_flag_cond(cpu, FLAG_N, cpu->registerY & 0x80);
         set_flag_cond(cpu, FLAG_Z, cpu->registerY == 0);
         break;
     case 0x8a:
         // TXA
-        fprintf(logstream, "        TXA");
+        TRACE("        TXA");
         cpu->registerA = cpu->registerX;
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
@@ -921,32 +1129,32 @@ int execute_instruction(NES *nes)
         // STY absolute
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "STY $%04X = %02X", address, memory_read_byte(memory, address));
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("STY $%04X = %02X", address, memory_read_byte(memory, address));
         memory_write(memory, address, cpu->registerY);
         break;
     case 0x8d:
         // STA absolute
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "STA $%04X = %02X", address, memory_read_byte(memory, address));
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("STA $%04X = %02X", address, memory_read_byte(memory, address));
         memory_write(memory, address, cpu->registerA);
         break;
     case 0x8e:
         // STX absolute
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "STX $%04X = %02X", address, memory_read_byte(memory, address));
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("STX $%04X = %02X", address, memory_read_byte(memory, address));
         memory_write(memory, address, cpu->registerX);
         break;
     case 0x90:
         // BCC
         disp = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", disp);
-        fprintf(logstream, "BCC $%04X", cpu->pc + disp);
+        TRACE(" %02X     ", disp);
+        TRACE("BCC $%04X", cpu->pc + disp);
         if (!get_flag(cpu, FLAG_C))
         {
             cpu->pc += disp;
@@ -958,8 +1166,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, address);
         value = memory_read_byte(memory, indirect_address + cpu->registerY);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "STA ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X     ", address);
+        TRACE("STA ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
         memory_write(memory, indirect_address + cpu->registerY, cpu->registerA);
         break;
     case 0x94:
@@ -968,8 +1176,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "STY $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("STY $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         memory_write(memory, zeropage_indexed_address, cpu->registerY);
         break;
     case 0x95:
@@ -978,8 +1186,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "STA $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("STA $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         memory_write(memory, zeropage_indexed_address, cpu->registerA);
         break;
     case 0x96:
@@ -988,13 +1196,13 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerY;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "STX $%02X,Y @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("STX $%02X,Y @ %02X = %02X", address, zeropage_indexed_address, value);
         memory_write(memory, zeropage_indexed_address, cpu->registerX);
         break;
     case 0x98:
         // TYA
-        fprintf(logstream, "        TYA");
+        TRACE("        TYA");
         cpu->registerA = cpu->registerY;
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
@@ -1004,13 +1212,13 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerY);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "STA $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("STA $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
         memory_write(memory, address + cpu->registerY, cpu->registerA);
         break;
     case 0x9a:
         // TXS
-        fprintf(logstream, "        TXS");
+        TRACE("        TXS");
         cpu->sp = cpu->registerX;
         break;
     case 0x9d:
@@ -1018,16 +1226,16 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "STA $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("STA $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         memory_write(memory, address + cpu->registerX, cpu->registerA);
         break;
     case 0xa0:
         // LDY immediate
         cpu->registerY = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", cpu->registerY);
-        fprintf(logstream, "LDY #$%02X", cpu->registerY);
+        TRACE(" %02X     ", cpu->registerY);
+        TRACE("LDY #$%02X", cpu->registerY);
         set_flag_cond(cpu, FLAG_Z, cpu->registerY == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerY & 0x80);
         break;
@@ -1037,8 +1245,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, (address + cpu->registerX) & 0xff);
         cpu->registerA = memory_read_byte(memory, indirect_address);
-        fprintf(logstream, " %02X     ", address & 0xff);
-        fprintf(logstream, "LDA ($%02X,X) @ %02X = %04X = %02X", address & 0xff, (address + cpu->registerX) & 0xff, indirect_address, cpu->registerA);
+        TRACE(" %02X     ", address & 0xff);
+        TRACE("LDA ($%02X,X) @ %02X = %04X = %02X", address & 0xff, (address + cpu->registerX) & 0xff, indirect_address, cpu->registerA);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
@@ -1046,8 +1254,8 @@ int execute_instruction(NES *nes)
         // LDX immediate
         cpu->registerX = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", cpu->registerX);
-        fprintf(logstream, "LDX #$%02X", cpu->registerX);
+        TRACE(" %02X     ", cpu->registerX);
+        TRACE("LDX #$%02X", cpu->registerX);
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerX & 0x80);
         break;
@@ -1056,8 +1264,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         cpu->registerY = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "LDY $%02X = %02X", address, cpu->registerY);
+        TRACE(" %02X     ", address);
+        TRACE("LDY $%02X = %02X", address, cpu->registerY);
         set_flag_cond(cpu, FLAG_Z, cpu->registerY == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerY & 0x80);
         break;
@@ -1066,8 +1274,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         cpu->registerA = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "LDA $%02X = %02X", address, cpu->registerA);
+        TRACE(" %02X     ", address);
+        TRACE("LDA $%02X = %02X", address, cpu->registerA);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
@@ -1076,15 +1284,15 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         cpu->registerX = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "LDX $%02X = %02X", address, cpu->registerX);
+        TRACE(" %02X     ", address);
+        TRACE("LDX $%02X = %02X", address, cpu->registerX);
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerX & 0x80);
         break;
     case 0xa8:
         // TAY
         cpu->registerY = cpu->registerA;
-        fprintf(logstream, "        TAY");
+        TRACE("        TAY");
         set_flag_cond(cpu, FLAG_Z, cpu->registerY == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerY & 0x80);
         break;
@@ -1092,14 +1300,14 @@ int execute_instruction(NES *nes)
         // LDA immediate
         cpu->registerA = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", cpu->registerA);
-        fprintf(logstream, "LDA #$%02X", cpu->registerA);
+        TRACE(" %02X     ", cpu->registerA);
+        TRACE("LDA #$%02X", cpu->registerA);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
     case 0xaa:
         // TAX
-        fprintf(logstream, "        TAX");
+        TRACE("        TAX");
         cpu->registerX = cpu->registerA;
         set_flag_cond(cpu, FLAG_N, cpu->registerX & 0x80);
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == 0);
@@ -1108,9 +1316,9 @@ int execute_instruction(NES *nes)
         // LDY absolute
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
         cpu->registerY = memory_read_byte(memory, address);
-        fprintf(logstream, "LDY $%04X = %02X", address, cpu->registerY);
+        TRACE("LDY $%04X = %02X", address, cpu->registerY);
         set_flag_cond(cpu, FLAG_Z, cpu->registerY == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerY & 0x80);
         break;
@@ -1118,9 +1326,9 @@ int execute_instruction(NES *nes)
         // LDA absolute
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
         cpu->registerA = memory_read_byte(memory, address);
-        fprintf(logstream, "LDA $%04X = %02X", address, cpu->registerA);
+        TRACE("LDA $%04X = %02X", address, cpu->registerA);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
@@ -1128,9 +1336,9 @@ int execute_instruction(NES *nes)
         // LDX absolute
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
         cpu->registerX = memory_read_byte(memory, address);
-        fprintf(logstream, "LDX $%04X = %02X", address, cpu->registerX);
+        TRACE("LDX $%04X = %02X", address, cpu->registerX);
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerX & 0x80);
         break;
@@ -1138,8 +1346,8 @@ int execute_instruction(NES *nes)
         // BCS
         disp = memory_read_byte(memory, cpu->pc);
         cpu->pc += 1;
-        fprintf(logstream, " %02X     ", disp);
-        fprintf(logstream, "BCS $%04X", cpu->pc + disp);
+        TRACE(" %02X     ", disp);
+        TRACE("BCS $%04X", cpu->pc + disp);
         if (get_flag(cpu, FLAG_C))
         {
             cpu->pc += disp;
@@ -1151,8 +1359,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, address);
         value = memory_read_byte(memory, indirect_address + cpu->registerY);
-        fprintf(logstream, " %02X     ", address & 0xff);
-        fprintf(logstream, "LDA ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X     ", address & 0xff);
+        TRACE("LDA ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
         cpu->registerA = value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
@@ -1162,8 +1370,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         cpu->registerY = memory_read_byte(memory, (address + cpu->registerX) & 0xff);
-        fprintf(logstream, " %02X     ", address & 0xff);
-        fprintf(logstream, "LDY $%02X,X @ %02X = %02X", address, (address + cpu->registerX) & 0xff, cpu->registerY);
+        TRACE(" %02X     ", address & 0xff);
+        TRACE("LDY $%02X,X @ %02X = %02X", address, (address + cpu->registerX) & 0xff, cpu->registerY);
         set_flag_cond(cpu, FLAG_Z, cpu->registerY == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerY & 0x80);
         break;
@@ -1173,8 +1381,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         cpu->registerA = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "LDA $%02X,X @ %02X = %02X", address, zeropage_indexed_address, cpu->registerA);
+        TRACE(" %02X     ", address);
+        TRACE("LDA $%02X,X @ %02X = %02X", address, zeropage_indexed_address, cpu->registerA);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
@@ -1184,14 +1392,14 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerY;
         cpu->registerX = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "LDX $%02X,Y @ %02X = %02X", address, zeropage_indexed_address, cpu->registerX);
+        TRACE(" %02X     ", address);
+        TRACE("LDX $%02X,Y @ %02X = %02X", address, zeropage_indexed_address, cpu->registerX);
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerX & 0x80);
         break;
     case 0xb8:
         // CLV
-        fprintf(logstream, "        CLV");
+        TRACE("        CLV");
         clear_flag(cpu, FLAG_V);
         break;
     case 0xb9:
@@ -1199,15 +1407,15 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerY);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "LDA $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("LDA $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
         cpu->registerA = value;
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
     case 0xba:
         // TSX
-        fprintf(logstream, "        TSX");
+        TRACE("        TSX");
         cpu->registerX = cpu->sp;
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerX & 0x80);
@@ -1217,8 +1425,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         cpu->registerY = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "LDY $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, cpu->registerY);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("LDY $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, cpu->registerY);
         set_flag_cond(cpu, FLAG_Z, cpu->registerY == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerY & 0x80);
         break;
@@ -1227,8 +1435,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         cpu->registerA = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "LDA $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, cpu->registerA);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("LDA $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, cpu->registerA);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerA & 0x80);
         break;
@@ -1237,8 +1445,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         cpu->registerX = memory_read_byte(memory, address + cpu->registerY);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "LDX $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, cpu->registerX);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("LDX $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, cpu->registerX);
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerX & 0x80);
         break;
@@ -1246,8 +1454,8 @@ int execute_instruction(NES *nes)
         // CPY immediate
         value = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", value);
-        fprintf(logstream, "CPY #$%02X", value);
+        TRACE(" %02X     ", value);
+        TRACE("CPY #$%02X", value);
         set_flag_cond(cpu, FLAG_C, cpu->registerY >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerY == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerY - value) & 0x80);
@@ -1258,8 +1466,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, (address + cpu->registerX) & 0xff);
         value = memory_read_byte(memory, indirect_address);
-        fprintf(logstream, " %02X     ", address & 0xff);
-        fprintf(logstream, "CMP ($%02X,X) @ %02X = %04X = %02X", address, (address + cpu->registerX) & 0xff, indirect_address, value);
+        TRACE(" %02X     ", address & 0xff);
+        TRACE("CMP ($%02X,X) @ %02X = %04X = %02X", address, (address + cpu->registerX) & 0xff, indirect_address, value);
         set_flag_cond(cpu, FLAG_C, cpu->registerA >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerA - value) & 0x80);
@@ -1269,8 +1477,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "CPY $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("CPY $%02X = %02X", address, value);
         set_flag_cond(cpu, FLAG_C, cpu->registerY >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerY == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerY - value) & 0x80);
@@ -1280,8 +1488,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "CMP $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("CMP $%02X = %02X", address, value);
         set_flag_cond(cpu, FLAG_C, cpu->registerA >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerA - value) & 0x80);
@@ -1291,8 +1499,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "DEC $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("DEC $%02X = %02X", address, value);
         value--;
         set_flag_cond(cpu, FLAG_Z, value == 0);
         set_flag_cond(cpu, FLAG_N, value & 0x80);
@@ -1300,7 +1508,7 @@ int execute_instruction(NES *nes)
         break;
     case 0xc8:
         // INY
-        fprintf(logstream, "        INY");
+        TRACE("        INY");
         cpu->registerY++;
         set_flag_cond(cpu, FLAG_Z, cpu->registerY == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerY & 0x80);
@@ -1309,15 +1517,15 @@ int execute_instruction(NES *nes)
         // CMP immediate
         value = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", value);
-        fprintf(logstream, "CMP #$%02X", value);
+        TRACE(" %02X     ", value);
+        TRACE("CMP #$%02X", value);
         set_flag_cond(cpu, FLAG_C, cpu->registerA >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerA - value) & 0x80);
         break;
     case 0xca:
         // DEX
-        fprintf(logstream, "        DEX");
+        TRACE("        DEX");
         cpu->registerX--;
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerX & 0x80);
@@ -1327,8 +1535,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "CPY $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("CPY $%04X = %02X", address, value);
         set_flag_cond(cpu, FLAG_C, cpu->registerY >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerY == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerY - value) & 0x80);
@@ -1338,8 +1546,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "CMP $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("CMP $%04X = %02X", address, value);
         set_flag_cond(cpu, FLAG_C, cpu->registerA >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerA - value) & 0x80);
@@ -1349,8 +1557,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "DEC $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("DEC $%04X = %02X", address, value);
         value--;
         set_flag_cond(cpu, FLAG_Z, value == 0);
         set_flag_cond(cpu, FLAG_N, value & 0x80);
@@ -1360,8 +1568,8 @@ int execute_instruction(NES *nes)
         // BNE
         disp = memory_read_byte(memory, cpu->pc);
         cpu->pc += 1;
-        fprintf(logstream, " %02X     ", disp);
-        fprintf(logstream, "BNE $%02X", cpu->pc + disp);
+        TRACE(" %02X     ", disp);
+        TRACE("BNE $%02X", cpu->pc + disp);
         if (!get_flag(cpu, FLAG_Z))
         {
             cpu->pc += disp;
@@ -1373,8 +1581,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, address);
         value = memory_read_byte(memory, indirect_address + cpu->registerY);
-        fprintf(logstream, " %02X     ", address & 0xff);
-        fprintf(logstream, "CMP ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X     ", address & 0xff);
+        TRACE("CMP ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
         set_flag_cond(cpu, FLAG_C, cpu->registerA >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerA - value) & 0x80);
@@ -1385,8 +1593,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "CMP $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("CMP $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         set_flag_cond(cpu, FLAG_C, cpu->registerA >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerA - value) & 0x80);
@@ -1397,8 +1605,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "DEC $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("DEC $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         value--;
         set_flag_cond(cpu, FLAG_Z, value == 0);
         set_flag_cond(cpu, FLAG_N, value & 0x80);
@@ -1406,7 +1614,7 @@ int execute_instruction(NES *nes)
         break;
     case 0xd8:
         // CLD
-        fprintf(logstream, "        CLD");
+        TRACE("        CLD");
         clear_flag(cpu, FLAG_D);
         break;
     case 0xd9:
@@ -1414,8 +1622,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerY);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "CMP $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("CMP $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
         set_flag_cond(cpu, FLAG_C, cpu->registerA >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerA - value) & 0x80);
@@ -1425,8 +1633,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "CMP $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("CMP $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         set_flag_cond(cpu, FLAG_C, cpu->registerA >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerA == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerA - value) & 0x80);
@@ -1436,8 +1644,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "DEC $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("DEC $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         value--;
         set_flag_cond(cpu, FLAG_Z, value == 0);
         set_flag_cond(cpu, FLAG_N, value & 0x80);
@@ -1447,8 +1655,8 @@ int execute_instruction(NES *nes)
         // CPX immediate
         value = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", value);
-        fprintf(logstream, "CPX #$%02X", value);
+        TRACE(" %02X     ", value);
+        TRACE("CPX #$%02X", value);
         set_flag_cond(cpu, FLAG_C, cpu->registerX >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerX - value) & 0x80);
@@ -1459,8 +1667,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, (address + cpu->registerX) & 0xff);
         value = memory_read_byte(memory, indirect_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "SBC ($%02X,X) @ %02X = %04X = %02X", address, (address + cpu->registerX) & 0xff, indirect_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("SBC ($%02X,X) @ %02X = %04X = %02X", address, (address + cpu->registerX) & 0xff, indirect_address, value);
         sum = cpu->registerA - value - (~get_flag(cpu, FLAG_C) & 0x01);
         set_flag_cond(cpu, FLAG_V, (cpu->registerA < 0x80 && value >= 0x80 && sum >= 0x80) || (cpu->registerA >= 0x80 && value < 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -1473,8 +1681,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "CPX $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("CPX $%02X = %02X", address, value);
         set_flag_cond(cpu, FLAG_C, cpu->registerX >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerX - value) & 0x80);
@@ -1484,8 +1692,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "SBC $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("SBC $%02X = %02X", address, value);
         sum = cpu->registerA - value - (~get_flag(cpu, FLAG_C) & 0x01);
         set_flag_cond(cpu, FLAG_V, (cpu->registerA < 0x80 && value >= 0x80 && sum >= 0x80) || (cpu->registerA >= 0x80 && value < 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -1498,8 +1706,8 @@ int execute_instruction(NES *nes)
         address = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "INC $%02X = %02X", address, value);
+        TRACE(" %02X     ", address);
+        TRACE("INC $%02X = %02X", address, value);
         value++;
         set_flag_cond(cpu, FLAG_Z, value == 0);
         set_flag_cond(cpu, FLAG_N, value & 0x80);
@@ -1507,7 +1715,7 @@ int execute_instruction(NES *nes)
         break;
     case 0xe8:
         // INCX
-        fprintf(logstream, "        INX");
+        TRACE("        INX");
         cpu->registerX++;
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == 0);
         set_flag_cond(cpu, FLAG_N, cpu->registerX & 0x80);
@@ -1516,8 +1724,8 @@ int execute_instruction(NES *nes)
         // SBC immediate
         value = memory_read_byte(memory, cpu->pc);
         cpu->pc++;
-        fprintf(logstream, " %02X     ", value);
-        fprintf(logstream, "SBC #$%02X", value);
+        TRACE(" %02X     ", value);
+        TRACE("SBC #$%02X", value);
         sum = cpu->registerA - value - (~get_flag(cpu, FLAG_C) & 0x01);
         set_flag_cond(cpu, FLAG_V, (cpu->registerA < 0x80 && value >= 0x80 && sum >= 0x80) || (cpu->registerA >= 0x80 && value < 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -1527,15 +1735,15 @@ int execute_instruction(NES *nes)
         break;
     case 0xea:
         // NOP
-        fprintf(logstream, "        NOP");
+        TRACE("        NOP");
         break;
     case 0xec:
         // CPX absolute
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "CPX $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("CPX $%04X = %02X", address, value);
         set_flag_cond(cpu, FLAG_C, cpu->registerX >= value);
         set_flag_cond(cpu, FLAG_Z, cpu->registerX == value);
         set_flag_cond(cpu, FLAG_N, (cpu->registerX - value) & 0x80);
@@ -1545,8 +1753,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "SBC $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("SBC $%04X = %02X", address, value);
         sum = cpu->registerA - value - (~get_flag(cpu, FLAG_C) & 0x01);
         set_flag_cond(cpu, FLAG_V, (cpu->registerA < 0x80 && value >= 0x80 && sum >= 0x80) || (cpu->registerA >= 0x80 && value < 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -1559,8 +1767,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "INC $%04X = %02X", address, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("INC $%04X = %02X", address, value);
         value++;
         memory_write(memory, address, value);
         set_flag_cond(cpu, FLAG_N, value & 0x80);
@@ -1570,8 +1778,8 @@ int execute_instruction(NES *nes)
         // BEQ
         disp = memory_read_byte(memory, cpu->pc);
         cpu->pc += 1;
-        fprintf(logstream, " %02X     ", disp);
-        fprintf(logstream, "BEQ $%02X", cpu->pc + disp);
+        TRACE(" %02X     ", disp);
+        TRACE("BEQ $%02X", cpu->pc + disp);
         if (get_flag(cpu, FLAG_Z))
         {
             cpu->pc += disp;
@@ -1583,8 +1791,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         indirect_address = memory_read_word_zero_page(memory, address);
         value = memory_read_byte(memory, indirect_address + cpu->registerY);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "SBC ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X     ", address);
+        TRACE("SBC ($%02X),Y = %04X @ %04X = %02X", address, indirect_address, (indirect_address + cpu->registerY) & 0xffff, value);
         sum = cpu->registerA - value - (~get_flag(cpu, FLAG_C) & 0x01);
         set_flag_cond(cpu, FLAG_V, (cpu->registerA < 0x80 && value >= 0x80 && sum >= 0x80) || (cpu->registerA >= 0x80 && value < 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -1598,8 +1806,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "SBC $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("SBC $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         sum = cpu->registerA - value - (~get_flag(cpu, FLAG_C) & 0x01);
         set_flag_cond(cpu, FLAG_V, (cpu->registerA < 0x80 && value >= 0x80 && sum >= 0x80) || (cpu->registerA >= 0x80 && value < 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -1613,8 +1821,8 @@ int execute_instruction(NES *nes)
         cpu->pc++;
         zeropage_indexed_address = address + cpu->registerX;
         value = memory_read_byte(memory, zeropage_indexed_address);
-        fprintf(logstream, " %02X     ", address);
-        fprintf(logstream, "INC $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
+        TRACE(" %02X     ", address);
+        TRACE("INC $%02X,X @ %02X = %02X", address, zeropage_indexed_address, value);
         value++;
         set_flag_cond(cpu, FLAG_Z, value == 0);
         set_flag_cond(cpu, FLAG_N, value & 0x80);
@@ -1622,7 +1830,7 @@ int execute_instruction(NES *nes)
         break;
     case 0xf8:
         // SED
-        fprintf(logstream, "        SED");
+        TRACE("        SED");
         set_flag(cpu, FLAG_D);
         break;
     case 0xf9:
@@ -1630,8 +1838,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerY);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "SBC $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("SBC $%04X,Y @ %04X = %02X", address, (address + cpu->registerY) & 0xffff, value);
         sum = cpu->registerA - value - (~get_flag(cpu, FLAG_C) & 0x01);
         set_flag_cond(cpu, FLAG_V, (cpu->registerA < 0x80 && value >= 0x80 && sum >= 0x80) || (cpu->registerA >= 0x80 && value < 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -1644,8 +1852,8 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "SBC $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("SBC $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         sum = cpu->registerA - value - (~get_flag(cpu, FLAG_C) & 0x01);
         set_flag_cond(cpu, FLAG_V, (cpu->registerA < 0x80 && value >= 0x80 && sum >= 0x80) || (cpu->registerA >= 0x80 && value < 0x80 && sum < 0x80));
         cpu->registerA = sum & 0xff;
@@ -1658,23 +1866,545 @@ int execute_instruction(NES *nes)
         address = memory_read_word(memory, cpu->pc);
         cpu->pc += 2;
         value = memory_read_byte(memory, address + cpu->registerX);
-        fprintf(logstream, " %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
-        fprintf(logstream, "INC $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
+        TRACE(" %02X %02X  ", address & 0xff, (address >> 8) & 0xff);
+        TRACE("INC $%04X,X @ %04X = %02X", address, (address + cpu->registerX) & 0xffff, value);
         value++;
         memory_write(memory, address + cpu->registerX, value);
         set_flag_cond(cpu, FLAG_N, value & 0x80);
         set_flag_cond(cpu, FLAG_Z, value == 0);
         break;
     default:
-        fprintf(stderr, "Illegal instruction 0x%02x\n", inst);
+        // The CPU stays on the instruction so that the caller can show where it stopped
+        cpu->pc = instruction_pc;
+
+        if (logstream)
+        {
+            fclose(logstream);
+            free(logBuffer);
+            free(logRegisters);
+        }
+
+        fprintf(stderr, "Illegal instruction 0x%02x at %04X\n", inst, instruction_pc);
         return -1;
     }
 
-    fclose(logstream);
+    if (nes->xrefs)
+    {
+        nes_log_xrefs(nes, instruction_pc, inst);
+    }
+
+    // Interrupt vectors are read as data
+    memory->fetch_length = 0;
+
+    const OPCODE_INFO *info = &OPCODES[inst];
+
+    cycles += info->cycles;
+
+    // Only the opcodes with extra cycles pay for a taken branch or an index crossing a page
+    if (info->extra_cycles)
+    {
+        switch (info->mode)
+        {
+        case RELATIVE:
+            if (!get_flag(cpu, BRANCH_FLAGS[inst >> 6]) == !(inst & 0x20))
+            {
+                cycles += ((instruction_pc + 2) ^ cpu->pc) & 0xff00 ? 2 : 1;
+            }
+            break;
+        case ABSOLUTE_X:
+            cycles += ((address + cpu->registerX) ^ address) & 0xff00 ? 1 : 0;
+            break;
+        case ABSOLUTE_Y:
+            cycles += ((address + cpu->registerY) ^ address) & 0xff00 ? 1 : 0;
+            break;
+        case INDIRECT_INDEXED:
+            cycles += ((indirect_address + cpu->registerY) ^ indirect_address) & 0xff00 ? 1 : 0;
+            break;
+        default:
+            break;
+        }
+    }
+
+    cycles += memory->stall_cycles;
+    memory->stall_cycles = 0;
+
+    cpu->cycles += cycles;
+
+    if (logstream)
+    {
+        fclose(logstream);
+
+        // Resolved beforehand for every address, the trace does not search
+        if (nes->symbols && nes->symbols->labels[instruction_pc])
+        {
+            printf("%s:\n", nes->symbols->text + nes->symbols->labels[instruction_pc] - 1);
+        }
+
+        printf("%-48s%s", logBuffer, logRegisters);
+
+        if (nes->symbols && nes->symbols->sources[instruction_pc])
+        {
+            printf("  ; %s", nes->symbols->text + nes->symbols->sources[instruction_pc] - 1);
+        }
+
+        printf("\n");
+        // printf("$%04X\n", memory_read_word(memory, 0x02));
+        free(logBuffer);
+        free(logRegisters);
+    }
+
+    return 0;
+}
+
+void nes_sync_ppu(NES *nes)
+{
+    ppu_catch_up(nes->ppu, nes->cpu->cycles);
+}
+
+// Forces an NMI before the next instruction, whatever the PPU control register says
+void nes_request_nmi(NES *nes)
+{
+    scheduler_schedule(nes->scheduler, EVENT_NMI, nes->cpu->cycles * MASTER_CYCLES_PER_CPU_CYCLE);
+}
+
+/*
+ * Debug reads, without any of the side effects of a bus read: no watchpoint, no PPU catch-up,
+ * no vblank flag clear. The backing of an address is returned with the number of bytes that
+ * follow it contiguously, so ranges are copied in a few memcpy. NULL means the value has to
+ * be computed, which is the case of the I/O registers and the unmapped addresses.
+ */
+static unsigned char *nes_peek_backing(NES *nes, enum WATCH_BUS bus, unsigned short address, unsigned int *run)
+{
+    if (bus == WATCH_BUS_OAM)
+    {
+        *run = 0x100 - (address & 0xff);
+        return nes->ppu->spr_ram + (address & 0xff);
+    }
+
+    if (bus == WATCH_BUS_PPU)
+    {
+        address &= 0x3fff;
+
+        if (address >= IMAGE_PALETTE)
+        {
+            *run = 0x4000 - address;
+            return nes->ppu_memory->palettes + (address - IMAGE_PALETTE);
+        }
+
+        if (address >= NAME_TABLE_0)
+        {
+            // $3000-$3EFF mirrors the name tables
+            unsigned short offset = (address - NAME_TABLE_0) & 0x0fff;
+
+            *run = address < 0x3000 ? 0x1000 - offset : IMAGE_PALETTE - address;
+            return nes->ppu_memory->name_tables + offset;
+        }
+
+        if (address >= PATTERN_TABLE_1)
+        {
+            *run = NAME_TABLE_0 - address;
+            return nes->ppu_memory->pattern_table_1 + (address - PATTERN_TABLE_1);
+        }
+
+        *run = PATTERN_TABLE_1 - address;
+        return nes->ppu_memory->pattern_table_0 + address;
+    }
+
+    if (address >= PRG_ROM_UPPER_BANK)
+    {
+        *run = 0x10000 - address;
+        return nes->memory->prg_rom_upper_bank + (address - PRG_ROM_UPPER_BANK);
+    }
 
-    printf("%-48s%s\n", logBuffer, logRegisters);
-    // printf("$%04X\n", memory_read_word(memory, 0x02));
-    free(logBuffer);
+    if (address >= PRG_ROM_LOWER_BANK)
+    {
+        *run = PRG_ROM_UPPER_BANK - address;
+        return nes->memory->prg_rom_lower_bank + (address - PRG_ROM_LOWER_BANK);
+    }
+
+    if (address >= EXPANSION_ROM)
+    {
+        *run = PRG_ROM_LOWER_BANK - address;
+        return NULL;
+    }
+
+    if (address >= IO_REGISTERS)
+    {
+        *run = 1;
+        return NULL;
+    }
+
+    // The 2 KB of RAM are mirrored up to $1FFF
+    *run = 0x800 - (address & 0x07ff);
+    return nes->memory->ram + (address & 0x07ff);
+}
+
+// Value of an address without backing, the PPU registers show their last value, everything else reads 0
+static unsigned char nes_peek_register(NES *nes, unsigned short address)
+{
+    // The APU and controller registers are not emulated
+    if (address >= 0x4000)
+    {
+        return 0;
+    }
+
+    switch (IO_REGISTERS + (address & 0x07))
+    {
+    case PPU_CONTROL_REGISTER:
+        return nes->ppu->control_register;
+    case PPU_MASK_REGISTER:
+        return nes->ppu->mask_register;
+    case PPU_STATUS_REGISTER:
+        return nes->ppu->status_register;
+    default:
+        return 0;
+    }
+}
+
+unsigned char nes_peek(NES *nes, enum WATCH_BUS bus, unsigned short address)
+{
+    unsigned int run;
+    unsigned char *backing = nes_peek_backing(nes, bus, address, &run);
+
+    return backing ? *backing : nes_peek_register(nes, address);
+}
+
+// Copies length bytes from address on, wrapping around the end of the address space
+void nes_peek_range(NES *nes, enum WATCH_BUS bus, unsigned short address, unsigned char *buffer, unsigned int length)
+{
+    while (length)
+    {
+        unsigned int run;
+        unsigned char *backing = nes_peek_backing(nes, bus, address, &run);
+
+        if (run > length)
+        {
+            run = length;
+        }
+
+        if (backing)
+        {
+            memcpy(buffer, backing, run);
+        }
+        else
+        {
+            for (unsigned int i = 0; i < run; i++)
+            {
+                buffer[i] = nes_peek_register(nes, address + i);
+            }
+        }
+
+        buffer += run;
+        address += run;
+        length -= run;
+    }
+}
+
+// Debug write to the backing of an address, ROM included, registers are left alone. Returns 0 when nothing was written
+int nes_poke(NES *nes, enum WATCH_BUS bus, unsigned short address, unsigned char value)
+{
+    unsigned int run;
+    unsigned char *backing = nes_peek_backing(nes, bus, address, &run);
+
+    if (!backing)
+    {
+        return 0;
+    }
+
+    *backing = value;
+
+    return 1;
+}
+
+unsigned short nes_peek_word(NES *nes, unsigned short address)
+{
+    return nes_peek(nes, WATCH_BUS_CPU, address) | (nes_peek(nes, WATCH_BUS_CPU, address + 1) << 8);
+}
+
+long nes_evaluate(NES *nes, const EXPRESSION *expression)
+{
+    long stack[EXPRESSION_MAX_DEPTH];
+    int top = -1;
+
+    for (unsigned int i = 0; i < expression->count; i++)
+    {
+        const EXPRESSION_OP *op = &expression->ops[i];
+
+        switch (op->opcode)
+        {
+        case EXPR_CONSTANT:
+            stack[++top] = op->value;
+            break;
+        case EXPR_REGISTER_A:
+            stack[++top] = nes->cpu->registerA;
+            break;
+        case EXPR_REGISTER_X:
+            stack[++top] = nes->cpu->registerX;
+            break;
+        case EXPR_REGISTER_Y:
+            stack[++top] = nes->cpu->registerY;
+            break;
+        case EXPR_REGISTER_P:
+            stack[++top] = nes->cpu->registerP;
+            break;
+        case EXPR_REGISTER_SP:
+            stack[++top] = nes->cpu->sp;
+            break;
+        case EXPR_REGISTER_PC:
+            stack[++top] = nes->cpu->pc;
+            break;
+        case EXPR_CYCLES:
+            stack[++top] = nes->cpu->cycles;
+            break;
+        case EXPR_FRAME:
+            stack[++top] = nes->ppu->frame_number;
+            break;
+        case EXPR_SCANLINE:
+            nes_sync_ppu(nes);
+            stack[++top] = nes->ppu->scanline;
+            break;
+        case EXPR_DOT:
+            nes_sync_ppu(nes);
+            stack[++top] = nes->ppu->dot;
+            break;
+        case EXPR_READ:
+            stack[top] = nes_peek(nes, WATCH_BUS_CPU, stack[top]);
+            break;
+        case EXPR_NEGATE:
+            stack[top] = (long)(0ul - stack[top]);
+            break;
+        case EXPR_NOT:
+            stack[top] = !stack[top];
+            break;
+        case EXPR_COMPLEMENT:
+            stack[top] = ~stack[top];
+            break;
+        default:
+        {
+            long right = stack[top--];
+            long left = stack[top];
+
+            // Arithmetic wraps around instead of overflowing, a division by 0 gives 0 and one by -1 a negation
+            switch (op->opcode)
+            {
+            case EXPR_MULTIPLY:
+                stack[top] = (long)((unsigned long)left * right);
+                break;
+            case EXPR_DIVIDE:
+                stack[top] = right == -1 ? (long)(0ul - left) : right ? left / right : 0;
+                break;
+            case EXPR_MODULO:
+                stack[top] = right == -1 || !right ? 0 : left % right;
+                break;
+            case EXPR_ADD:
+                stack[top] = (long)((unsigned long)left + right);
+                break;
+            case EXPR_SUBTRACT:
+                stack[top] = (long)((unsigned long)left - right);
+                break;
+            case EXPR_LESS:
+                stack[top] = left < right;
+                break;
+            case EXPR_LESS_EQUAL:
+                stack[top] = left <= right;
+                break;
+            case EXPR_GREATER:
+                stack[top] = left > right;
+                break;
+            case EXPR_GREATER_EQUAL:
+                stack[top] = left >= right;
+                break;
+            case EXPR_EQUAL:
+                stack[top] = left == right;
+                break;
+            case EXPR_NOT_EQUAL:
+                stack[top] = left != right;
+                break;
+            case EXPR_BIT_AND:
+                stack[top] = left & right;
+                break;
+            case EXPR_BIT_XOR:
+                stack[top] = left ^ right;
+                break;
+            case EXPR_BIT_OR:
+                stack[top] = left | right;
+                break;
+            case EXPR_AND:
+                stack[top] = left && right;
+                break;
+            case EXPR_OR:
+                stack[top] = left || right;
+                break;
+            }
+            break;
+        }
+        }
+    }
+
+    return stack[top];
+}
+
+static void nes_log(NES *nes, LOGPOINT *logpoint)
+{
+    long values[LOGPOINT_MAX_VALUES];
+
+    for (unsigned int i = 0; i < logpoint->value_count; i++)
+    {
+        values[i] = nes_evaluate(nes, logpoint->values[i]);
+    }
+
+    logpoint_write(logpoint, values, nes->cpu->cycles);
+}
+
+// The address already matched: count the hit if the condition holds, then log it or stop once the hit count is reached
+static int nes_breakpoint_triggered(NES *nes, BREAKPOINT *breakpoint)
+{
+    if (breakpoint->condition && !nes_evaluate(nes, breakpoint->condition))
+    {
+        return 0;
+    }
+
+    breakpoint->hits++;
+
+    if (breakpoint->log)
+    {
+        nes_log(nes, breakpoint->log);
+        return 0;
+    }
+
+    return breakpoint->hits >= breakpoint->hit_count;
+}
+
+// Checked after each instruction: the next instruction and any watched access the last one made
+int nes_breakpoint_hit(NES *nes)
+{
+    BREAKPOINTS *breakpoints = nes->breakpoints;
+    WATCHPOINTS *watchpoints = &breakpoints->watchpoints;
+    unsigned short pc = nes->cpu->pc;
+    int hit = 0;
+
+    if (breakpoint_test(breakpoints->execute, pc))
+    {
+        if (pc == breakpoints->temporary && nes->cpu->sp >= breakpoints->temporary_sp)
+        {
+            hit = 1;
+        }
+
+        for (unsigned int i = 0; i < breakpoints->count; i++)
+        {
+            BREAKPOINT *breakpoint = &breakpoints->list[i];
+
+            if (breakpoint->type == BREAKPOINT_TYPE_ADDRESS && pc >= breakpoint->address && pc <= breakpoint->end)
+            {
+                hit |= nes_breakpoint_triggered(nes, breakpoint);
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < watchpoints->match_count; i++)
+    {
+        hit |= nes_breakpoint_triggered(nes, &breakpoints->list[watchpoints->matches[i]]);
+    }
+
+    watchpoints->match_count = 0;
+
+    return hit;
+}
+
+/*
+ * Runs up to max_instructions without refreshing anything, returns 1 when a breakpoint or the
+ * step target stopped it and -1 on an instruction that cannot be run, the PC is left on it.
+ */
+int nes_run(NES *nes, unsigned long max_instructions)
+{
+    BREAKPOINTS *breakpoints = nes->breakpoints;
+    CPU *cpu = nes->cpu;
+
+    for (unsigned long i = 0; i < max_instructions; i++)
+    {
+        int returning = 0;
+
+        if (breakpoints->step_out_sp >= 0)
+        {
+            unsigned char opcode = nes_peek(nes, WATCH_BUS_CPU, cpu->pc);
+            returning = opcode == OPCODE_RTS || opcode == OPCODE_RTI;
+        }
+
+        if (execute_instruction(nes) < 0)
+        {
+            breakpoints_clear_temporary(breakpoints);
+            return -1;
+        }
+
+        int stopped = returning && cpu->sp > breakpoints->step_out_sp;
+
+        // Breakpoints count their hits even when the step target stops at the same time
+        stopped |= nes_breakpoint_hit(nes);
+
+        if (stopped)
+        {
+            breakpoints_clear_temporary(breakpoints);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Runs over a subroutine call like a single instruction, returns 1 when done without needing
+ * nes_run and -1 on an instruction that cannot be run.
+ */
+int nes_step_over(NES *nes)
+{
+    CPU *cpu = nes->cpu;
+
+    if (nes_peek(nes, WATCH_BUS_CPU, cpu->pc) != OPCODE_JSR)
+    {
+        if (execute_instruction(nes) < 0)
+        {
+            return -1;
+        }
+
+        nes_breakpoint_hit(nes);
+        return 1;
+    }
+
+    breakpoints_set_temporary(nes->breakpoints, cpu->pc + 3, cpu->sp);
+
+    return 0;
+}
+
+// Runs until the current subroutine or interrupt handler returns
+void nes_step_out(NES *nes)
+{
+    nes->breakpoints->step_out_sp = nes->cpu->sp;
+}
+
+void nes_run_to(NES *nes, unsigned short address)
+{
+    breakpoints_set_temporary(nes->breakpoints, address, 0);
+}
+
+// Pausing abandons the step in progress
+void nes_cancel_step(NES *nes)
+{
+    breakpoints_clear_temporary(nes->breakpoints);
+}
+
+int nes_run_frame(NES *nes, unsigned char output_enabled)
+{
+    unsigned long frame_number = nes->ppu->frame_number;
+
+    nes->ppu->output_enabled = output_enabled;
+
+    while (nes->ppu->frame_number == frame_number)
+    {
+        if (execute_instruction(nes) < 0)
+        {
+            return -1;
+        }
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -5,6 +5,11 @@
 #include "ppu.h"
 #include "memory.h"
 #include "ppu-memory.h"
+#include "scheduler.h"
+#include "breakpoint.h"
+#include "xref.h"
+#include "debug_info.h"
+#include "trace.h"
 
 typedef struct
 {
@@ -12,11 +17,32 @@ typedef struct
     PPU *ppu;
     MEMORY *memory;
     PPU_MEMORY *ppu_memory;
-    unsigned char interrupt_NMI;
+    SCHEDULER *scheduler;
+    BREAKPOINTS *breakpoints;
+    unsigned char trace;        // print a nestest-style line for each instruction
+    XREF_LOG *xrefs;            // references made by the executed instructions, NULL when not recorded
+    CDL *cdl;                   // how the ROM bytes were used, NULL when not logged
+    DEBUG_ADDRESS_MAP *symbols; // labels and source lines of the trace, NULL without debug info
+    TRACE_WRITER *recorder;     // binary trace of the executed instructions, NULL when not recording
 } NES;
 
 NES *create_nes();
-void load_rom(NES *nes, const char *filename);
+int load_rom(NES *nes, const char *filename);
+void nes_set_cdl(NES *nes, CDL *cdl);
 int execute_instruction(NES *nes);
+void nes_sync_ppu(NES *nes);
+void nes_request_nmi(NES *nes);
+int nes_breakpoint_hit(NES *nes);
+long nes_evaluate(NES *nes, const EXPRESSION *expression);
+unsigned char nes_peek(NES *nes, enum WATCH_BUS bus, unsigned short address);
+void nes_peek_range(NES *nes, enum WATCH_BUS bus, unsigned short address, unsigned char *buffer, unsigned int length);
+unsigned short nes_peek_word(NES *nes, unsigned short address);
+int nes_poke(NES *nes, enum WATCH_BUS bus, unsigned short address, unsigned char value);
+int nes_run_frame(NES *nes, unsigned char output_enabled);
+int nes_run(NES *nes, unsigned long max_instructions);
+int nes_step_over(NES *nes);
+void nes_step_out(NES *nes);
+void nes_run_to(NES *nes, unsigned short address);
+void nes_cancel_step(NES *nes);
 
 #endif
\ No newline at end of file
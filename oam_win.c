@@ -1,11 +1,29 @@
 #include <gtk/gtk.h>
+#include <string.h>
 
 #include "oam_win.h"
 
+#define SPRITE_SCALE 4
+#define SCREEN_SCALE 2
+
+typedef struct _DrawSpriteCallbackArgs
+{
+    ObjectAttributeMemoryWindow *window;
+    unsigned int sprite_index;
+} DrawSpriteCallbackArgs;
+
 struct _ObjectAttributeMemoryWindow
 {
     GtkWindow parent;
     GtkGrid *oam_grid;
+    GtkDrawingArea *screen_area;
+    GtkWidget *sprite_areas[NB_SPRITES];
+    GtkLabel *sprite_labels[NB_SPRITES];
+    DrawSpriteCallbackArgs sprite_args[NB_SPRITES];
+    PPU *ppu;
+    unsigned char spr_ram[NB_SPRITES * 4];
+    unsigned char sprite_palettes[16];
+    unsigned char control_register;
 };
 
 G_DEFINE_TYPE(ObjectAttributeMemoryWindow, oam_window, GTK_TYPE_WINDOW);
@@ -20,67 +38,174 @@ static void oam_window_class_init(ObjectAttributeMemoryWindowClass *class)
     gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), "/org/c4z/debuggerapp/oam_window.xml");
 
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), ObjectAttributeMemoryWindow, oam_grid);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), ObjectAttributeMemoryWindow, screen_area);
 }
 
 static void oam_window_close_cb(GtkWindow *win, DebuggerApp *app)
 {
+    refresh_coordinator_unregister(app->refresh, win);
     app->oam_window = NULL;
 }
 
-ObjectAttributeMemoryWindow *oam_window_new(DebuggerApp *app)
+static void oam_window_refresh(gpointer view, gpointer data)
 {
-    ObjectAttributeMemoryWindow *window = g_object_new(OAM_WINDOW_TYPE, NULL);
+    DebuggerApp *app = data;
 
-    g_signal_connect(window, "destroy", G_CALLBACK(oam_window_close_cb), app);
+    oam_window_update(view, app->nes->ppu);
+}
 
-    for (unsigned int i = 0; i < NB_SPRITES; i++)
+static unsigned char sprite_height(PPU *ppu)
+{
+    return (ppu->control_register & 0x20) ? 16 : 8;
+}
+
+static unsigned short sprite_row_address(PPU *ppu, unsigned char tile, unsigned char row)
+{
+    if (sprite_height(ppu) == 16)
     {
-        GtkWidget *text_view = gtk_text_view_new();
-        gtk_text_view_set_editable(GTK_TEXT_VIEW(text_view), FALSE);
-        gtk_grid_attach(window->oam_grid, text_view, i % 4, i / 4, 1, 1);
+        // 8x16 sprites: bit 0 of the tile number selects the pattern table, rows 8-15 use the next tile
+        return ((tile & 0x01) << 12) | (((tile & 0xfe) + (row >> 3)) << 4) | (row & 0x07);
     }
 
-    oam_window_update(window, app->nes->ppu);
+    return ((ppu->control_register & 0x08) << 9) | (tile << 4) | row;
+}
 
-    return window;
+static void draw_sprite_pixels(cairo_t *cr, PPU *ppu, unsigned int sprite_index, double x, double y, double scale)
+{
+    unsigned char *sprite = ppu->spr_ram + sprite_index * 4;
+    unsigned char attributes = sprite[2];
+    unsigned char height = sprite_height(ppu);
+
+    for (unsigned char row = 0; row < height; row++)
+    {
+        unsigned char pattern_row = (attributes & 0x80) ? height - 1 - row : row;
+        unsigned short lower_row_address = sprite_row_address(ppu, sprite[1], pattern_row);
+
+        unsigned char lower_row = ppu_memory_read(ppu->ppu_memory, lower_row_address);
+        unsigned char upper_row = ppu_memory_read(ppu->ppu_memory, lower_row_address + 8);
+
+        for (unsigned char col = 0; col < 8; col++)
+        {
+            unsigned char bit = (attributes & 0x40) ? col : 7 - col;
+            unsigned char color = ((lower_row >> bit) & 0x01) | (((upper_row >> bit) & 0x01) << 1);
+
+            if (!color)
+            {
+                continue;
+            }
+
+            unsigned char palette_entry = ppu_memory_read(ppu->ppu_memory, SPRITE_PALETTE + 4 * (attributes & 0x03) + color);
+            COLOR *rgb = &SYSTEM_PALETTE[palette_entry & 0x3f];
+
+            cairo_set_source_rgb(cr, rgb->red / (double)256, rgb->green / (double)256, rgb->blue / (double)256);
+            cairo_rectangle(cr, x + col * scale, y + row * scale, scale, scale);
+            cairo_fill(cr);
+        }
+    }
 }
 
-static void oam_window_set_sprite_attributes(ObjectAttributeMemoryWindow *window, PPU *ppu, unsigned int sprite_index)
+static gboolean draw_sprite(GtkWidget *widget, cairo_t *cr, DrawSpriteCallbackArgs *args)
 {
-    GtkTextView *text_view = GTK_TEXT_VIEW(gtk_grid_get_child_at(window->oam_grid, sprite_index % 4, sprite_index / 4));
+    guint width = gtk_widget_get_allocated_width(widget);
+    guint height = gtk_widget_get_allocated_height(widget);
+    cairo_set_source_rgb(cr, 0, 0, 0);
+    cairo_rectangle(cr, 0, 0, width, height);
+    cairo_fill(cr);
 
-    GtkTextBuffer *buffer = gtk_text_view_get_buffer(text_view);
-    GtkTextIter start;
-    GtkTextIter end;
+    draw_sprite_pixels(cr, args->window->ppu, args->sprite_index, 0, 0, SPRITE_SCALE);
 
-    unsigned int sprite_offset = sprite_index * 4;
-    gtk_text_buffer_get_start_iter(buffer, &start);
-    gtk_text_buffer_get_end_iter(buffer, &end);
-    gtk_text_buffer_delete(buffer, &start, &end);
+    return FALSE;
+}
 
-    gchar *str;
+static gboolean draw_screen(GtkWidget *widget, cairo_t *cr, ObjectAttributeMemoryWindow *window)
+{
+    PPU *ppu = window->ppu;
 
-    gtk_text_buffer_get_end_iter(buffer, &end);
-    str = g_strdup_printf("Tile %u\n", ppu->spr_ram[sprite_offset + 1]);
-    gtk_text_buffer_insert(buffer, &end, str, -1);
-    g_free(str);
+    cairo_set_source_rgb(cr, 0, 0, 0);
+    cairo_rectangle(cr, 0, 0, SCREEN_WIDTH * SCREEN_SCALE, SCREEN_HEIGHT * SCREEN_SCALE);
+    cairo_fill(cr);
 
-    gtk_text_buffer_get_end_iter(buffer, &end);
-    str = g_strdup_printf("X: %u\n", ppu->spr_ram[sprite_offset + 3]);
-    gtk_text_buffer_insert(buffer, &end, str, -1);
-    g_free(str);
+    // Lower OAM indexes have priority, so draw them last
+    for (int i = NB_SPRITES - 1; i >= 0; i--)
+    {
+        unsigned char *sprite = ppu->spr_ram + i * 4;
 
-    gtk_text_buffer_get_end_iter(buffer, &end);
-    str = g_strdup_printf("Y: %u\n", ppu->spr_ram[sprite_offset] + 1);
-    gtk_text_buffer_insert(buffer, &end, str, -1);
-    g_free(str);
+        // Sprites are drawn one line below their Y coordinate, $EF and above are hidden
+        if (sprite[0] >= 0xef)
+        {
+            continue;
+        }
+
+        double x = sprite[3] * SCREEN_SCALE;
+        double y = (sprite[0] + 1) * SCREEN_SCALE;
 
-    gtk_text_buffer_get_end_iter(buffer, &end);
-    str = g_strdup_printf("----------\n");
-    gtk_text_buffer_insert(buffer, &end, str, -1);
+        draw_sprite_pixels(cr, ppu, i, x, y, SCREEN_SCALE);
+
+        cairo_set_source_rgb(cr, 0.8, 0.8, 0.2);
+        cairo_set_line_width(cr, 1);
+        cairo_rectangle(cr, x + 0.5, y + 0.5, 8 * SCREEN_SCALE - 1, sprite_height(ppu) * SCREEN_SCALE - 1);
+        cairo_stroke(cr);
+    }
+
+    return FALSE;
+}
+
+static void oam_window_set_sprite_attributes(ObjectAttributeMemoryWindow *window, PPU *ppu, unsigned int sprite_index)
+{
+    unsigned char *sprite = ppu->spr_ram + sprite_index * 4;
+
+    gchar *str = g_strdup_printf("#%02u Tile $%02X\nX: %u Y: %u\nPalette %u %c%c%c", sprite_index, sprite[1],
+                                 sprite[3], sprite[0] + 1, sprite[2] & 0x03,
+                                 sprite[2] & 0x40 ? 'H' : '-',
+                                 sprite[2] & 0x80 ? 'V' : '-',
+                                 sprite[2] & 0x20 ? 'B' : 'F');
+    gtk_label_set_text(window->sprite_labels[sprite_index], str);
     g_free(str);
 }
 
+ObjectAttributeMemoryWindow *oam_window_new(DebuggerApp *app)
+{
+    ObjectAttributeMemoryWindow *window = g_object_new(OAM_WINDOW_TYPE, NULL);
+    PPU *ppu = app->nes->ppu;
+
+    window->ppu = ppu;
+
+    g_signal_connect(window, "destroy", G_CALLBACK(oam_window_close_cb), app);
+    g_signal_connect(window->screen_area, "draw", G_CALLBACK(draw_screen), window);
+
+    for (unsigned int i = 0; i < NB_SPRITES; i++)
+    {
+        GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+
+        window->sprite_args[i].window = window;
+        window->sprite_args[i].sprite_index = i;
+
+        window->sprite_areas[i] = gtk_drawing_area_new();
+        gtk_widget_set_size_request(window->sprite_areas[i], 8 * SPRITE_SCALE, 16 * SPRITE_SCALE);
+        gtk_widget_set_halign(window->sprite_areas[i], GTK_ALIGN_START);
+        g_signal_connect(window->sprite_areas[i], "draw", G_CALLBACK(draw_sprite), &window->sprite_args[i]);
+        gtk_box_pack_start(GTK_BOX(box), window->sprite_areas[i], FALSE, FALSE, 0);
+
+        window->sprite_labels[i] = GTK_LABEL(gtk_label_new(NULL));
+        gtk_label_set_xalign(window->sprite_labels[i], 0);
+        gtk_box_pack_start(GTK_BOX(box), GTK_WIDGET(window->sprite_labels[i]), FALSE, FALSE, 0);
+
+        gtk_grid_attach(window->oam_grid, box, i % 8, i / 8, 1, 1);
+
+        oam_window_set_sprite_attributes(window, ppu, i);
+    }
+
+    memcpy(window->spr_ram, ppu->spr_ram, sizeof(window->spr_ram));
+    memcpy(window->sprite_palettes, ppu->ppu_memory->palettes + (SPRITE_PALETTE - IMAGE_PALETTE), sizeof(window->sprite_palettes));
+    window->control_register = ppu->control_register;
+
+    // Sprite size and pattern table come from the control register
+    refresh_coordinator_register(app->refresh, window, STATE_OAM | STATE_PATTERN_TABLES | STATE_PALETTES | STATE_PPU_REGISTERS,
+                                 oam_window_refresh);
+
+    return window;
+}
+
 void oam_window_update(ObjectAttributeMemoryWindow *window, PPU *ppu)
 {
     if (!window)
@@ -88,8 +213,43 @@ void oam_window_update(ObjectAttributeMemoryWindow *window, PPU *ppu)
         return;
     }
 
+    guint64 changed = 0;
+    unsigned char *sprite_palettes = ppu->ppu_memory->palettes + (SPRITE_PALETTE - IMAGE_PALETTE);
+
+    // Sprite size, sprite pattern table and sprite palettes affect every entry
+    if ((window->control_register ^ ppu->control_register) & 0x28 ||
+        memcmp(window->sprite_palettes, sprite_palettes, sizeof(window->sprite_palettes)))
+    {
+        changed = ~(guint64)0;
+    }
+    else
+    {
+        for (unsigned int i = 0; i < NB_SPRITES; i++)
+        {
+            if (memcmp(window->spr_ram + i * 4, ppu->spr_ram + i * 4, 4))
+            {
+                changed |= (guint64)1 << i;
+            }
+        }
+    }
+
+    if (!changed)
+    {
+        return;
+    }
+
     for (unsigned int i = 0; i < NB_SPRITES; i++)
     {
-        oam_window_set_sprite_attributes(window, ppu, i);
+        if (changed & ((guint64)1 << i))
+        {
+            oam_window_set_sprite_attributes(window, ppu, i);
+            gtk_widget_queue_draw(window->sprite_areas[i]);
+        }
     }
-}
\ No newline at end of file
+
+    gtk_widget_queue_draw(GTK_WIDGET(window->screen_area));
+
+    memcpy(window->spr_ram, ppu->spr_ram, sizeof(window->spr_ram));
+    memcpy(window->sprite_palettes, sprite_palettes, sizeof(window->sprite_palettes));
+    window->control_register = ppu->control_register;
+}
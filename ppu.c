@@ -1,4 +1,9 @@
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "ppu.h"
 
@@ -71,18 +76,42 @@ COLOR SYSTEM_PALETTE[] = {
     {0, 0, 0},
     {0, 0, 0}};
 
-PPU *create_ppu(PPU_MEMORY *ppu_memory)
+PPU *create_ppu(PPU_MEMORY *ppu_memory, SCHEDULER *scheduler)
 {
     PPU *ppu = malloc(sizeof(PPU));
 
     ppu->ppu_memory = ppu_memory;
+    ppu->scheduler = scheduler;
+    ppu->control_register = 0x00;
+    ppu->mask_register = 0x00;
     ppu->status_register = 0x00;
     ppu->address = 0x0000;
     ppu->address_write_low = 0;
+    ppu->scanline = PRE_RENDER_SCANLINE;
+    ppu->dot = 0;
+    ppu->frame_number = 0;
+    ppu->output_enabled = 1;
+    ppu->sprite_line.count = 0;
+    ppu->sprite_line.sprite_0 = 0;
+    ppu->sprite_0_hit_dot = 0;
+    ppu->cycle = 0;
+    ppu->cdl = NULL;
+    ppu_schedule_events(ppu);
 
     return ppu;
 }
 
+void ppu_write_control(PPU *ppu, unsigned char value)
+{
+    // Enabling NMI generation during vblank raises an NMI immediately
+    if (!(ppu->control_register & 0x80) && (value & 0x80) && (ppu->status_register & 0x80))
+    {
+        scheduler_schedule(ppu->scheduler, EVENT_NMI, ppu->cycle * MASTER_CYCLES_PER_CPU_CYCLE);
+    }
+
+    ppu->control_register = value;
+}
+
 void ppu_write_address(PPU *ppu, unsigned char value)
 {
     if (ppu->address_write_low)
@@ -101,4 +130,438 @@ void ppu_write_data(PPU *ppu, unsigned char value)
 {
     ppu_memory_write(ppu->ppu_memory, ppu->address, value);
     ppu->address += (ppu->control_register & 0x04) ? 32 : 1;
+}
+
+static unsigned char ppu_sprite_height(PPU *ppu)
+{
+    return (ppu->control_register & 0x20) ? 16 : 8;
+}
+
+/*
+ * Builds the sprite line from the 64-bit mask of sprites in range. The overflow flag is set
+ * when more than 8 sprites are in range, the hardware diagonal scan bug is not reproduced.
+ */
+static void ppu_sprite_line_from_mask(unsigned long long in_range, SPRITE_LINE *line)
+{
+    line->sprite_0 = in_range & 0x01;
+    line->overflow = __builtin_popcountll(in_range) > NB_SPRITES_PER_LINE;
+    line->count = 0;
+
+    while (in_range && line->count < NB_SPRITES_PER_LINE)
+    {
+        line->sprites[line->count++] = __builtin_ctzll(in_range);
+        in_range &= in_range - 1;
+    }
+}
+
+/*
+ * Sprite evaluation for a scanline: a sprite is in range when 0 <= scanline - Y < sprite height.
+ * Sprites evaluated during scanline N are drawn on scanline N + 1.
+ */
+void ppu_evaluate_sprites_scalar(PPU *ppu, unsigned char scanline, SPRITE_LINE *line)
+{
+    unsigned char height = ppu_sprite_height(ppu);
+    unsigned long long in_range = 0;
+
+    for (unsigned int i = 0; i < NB_SPRITES; i++)
+    {
+        int row = scanline - ppu->spr_ram[i * 4];
+
+        if (row >= 0 && row < height)
+        {
+            in_range |= 1ULL << i;
+        }
+    }
+
+    ppu_sprite_line_from_mask(in_range, line);
+}
+
+#ifdef __SSE2__
+void ppu_evaluate_sprites(PPU *ppu, unsigned char scanline, SPRITE_LINE *line)
+{
+    const __m128i y_mask = _mm_set1_epi32(0xff);
+    const __m128i scanline_vector = _mm_set1_epi8(scanline);
+    const __m128i last_row = _mm_set1_epi8(ppu_sprite_height(ppu) - 1);
+    unsigned long long in_range = 0;
+
+    // 16 sprites per iteration: keep the Y byte of each 4-byte entry and pack them into one vector
+    for (unsigned int i = 0; i < NB_SPRITES; i += 16)
+    {
+        const __m128i *entries = (const __m128i *)(ppu->spr_ram + i * 4);
+        __m128i y_0_7 = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128(entries), y_mask),
+                                        _mm_and_si128(_mm_loadu_si128(entries + 1), y_mask));
+        __m128i y_8_15 = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128(entries + 2), y_mask),
+                                         _mm_and_si128(_mm_loadu_si128(entries + 3), y_mask));
+        __m128i y = _mm_packus_epi16(y_0_7, y_8_15);
+
+        // Unsigned compares: Y <= scanline and scanline - Y <= height - 1
+        __m128i row = _mm_subs_epu8(scanline_vector, y);
+        __m128i above = _mm_cmpeq_epi8(_mm_max_epu8(y, scanline_vector), scanline_vector);
+        __m128i within = _mm_cmpeq_epi8(_mm_min_epu8(row, last_row), row);
+
+        in_range |= (unsigned long long)_mm_movemask_epi8(_mm_and_si128(above, within)) << i;
+    }
+
+    ppu_sprite_line_from_mask(in_range, line);
+}
+#else
+void ppu_evaluate_sprites(PPU *ppu, unsigned char scanline, SPRITE_LINE *line)
+{
+    ppu_evaluate_sprites_scalar(ppu, scanline, line);
+}
+#endif
+
+// Both planes of a pattern row are rendered
+static void ppu_log_pattern_row(PPU *ppu, unsigned short lower_row_address)
+{
+    if (ppu->cdl && ppu->cdl->chr_size)
+    {
+        cdl_mark(ppu->cdl->rendered, lower_row_address);
+        cdl_mark(ppu->cdl->rendered, lower_row_address + 8);
+    }
+}
+
+/*
+ * Background pixels of the tiles first_tile to last_tile of a scanline, as palette << 2 | color.
+ * Scrolling is not emulated: the nametable selected in the control register is drawn at 0,0.
+ */
+static void ppu_fetch_background(PPU *ppu, unsigned char line, unsigned char first_tile, unsigned char last_tile, unsigned char *pixels)
+{
+    unsigned short name_table = NAME_TABLE_0 + (ppu->control_register & 0x03) * 0x400;
+    unsigned short pattern_table = (ppu->control_register & 0x10) << 8;
+    unsigned char tile_row = line >> 3;
+
+    for (unsigned char tile_col = first_tile; tile_col <= last_tile; tile_col++)
+    {
+        unsigned char tile = ppu_memory_read(ppu->ppu_memory, name_table + tile_row * 32 + tile_col);
+        unsigned char attributes = ppu_memory_read(ppu->ppu_memory, name_table + 0x3c0 + (tile_row >> 2) * 8 + (tile_col >> 2));
+        unsigned char palette = (attributes >> (((tile_row & 0x02) << 1) | (tile_col & 0x02))) & 0x03;
+
+        unsigned short lower_row_address = pattern_table | (tile << 4) | (line & 0x07);
+        ppu_log_pattern_row(ppu, lower_row_address);
+        unsigned char lower_row = ppu_memory_read(ppu->ppu_memory, lower_row_address);
+        unsigned char upper_row = ppu_memory_read(ppu->ppu_memory, lower_row_address + 8);
+
+        unsigned char *pixel = pixels + (tile_col << 3);
+        for (int j = 7; j >= 0; j--)
+        {
+            unsigned char color = ((lower_row >> j) & 0x01) | (((upper_row >> j) & 0x01) << 1);
+            *pixel++ = color ? (palette << 2) | color : 0;
+        }
+    }
+}
+
+// The 8 pixels of a sprite on the scanline it is drawn on, as colors 0-3 from left to right
+static void ppu_fetch_sprite(PPU *ppu, unsigned char sprite_index, unsigned char line, unsigned char *pixels)
+{
+    unsigned char *sprite = ppu->spr_ram + sprite_index * 4;
+    unsigned char height = ppu_sprite_height(ppu);
+    unsigned char row = line - 1 - sprite[0];
+    unsigned short lower_row_address;
+
+    if (sprite[2] & 0x80)
+    {
+        row = height - 1 - row;
+    }
+
+    if (height == 16)
+    {
+        lower_row_address = ((sprite[1] & 0x01) << 12) | (((sprite[1] & 0xfe) + (row >> 3)) << 4) | (row & 0x07);
+    }
+    else
+    {
+        lower_row_address = ((ppu->control_register & 0x08) << 9) | (sprite[1] << 4) | row;
+    }
+
+    ppu_log_pattern_row(ppu, lower_row_address);
+    unsigned char lower_row = ppu_memory_read(ppu->ppu_memory, lower_row_address);
+    unsigned char upper_row = ppu_memory_read(ppu->ppu_memory, lower_row_address + 8);
+
+    for (int i = 0; i < 8; i++)
+    {
+        unsigned char bit = (sprite[2] & 0x40) ? i : 7 - i;
+        pixels[i] = ((lower_row >> bit) & 0x01) | (((upper_row >> bit) & 0x01) << 1);
+    }
+}
+
+/*
+ * Sprite 0 hits on the first x where both the sprite 0 and the background pixels are opaque,
+ * never at x = 255 and not in the leftmost 8 pixels when either of them is clipped there.
+ */
+static void ppu_find_sprite_0_hit(PPU *ppu, unsigned char *background, unsigned char *sprite_0)
+{
+    unsigned char sprite_x = ppu->spr_ram[3];
+
+    for (int i = 0; i < 8 && sprite_x + i < SCREEN_WIDTH - 1; i++)
+    {
+        unsigned char x = sprite_x + i;
+
+        if (x < 8 && (ppu->mask_register & 0x06) != 0x06)
+        {
+            continue;
+        }
+
+        if (sprite_0[i] && (background[x] & 0x03))
+        {
+            ppu->sprite_0_hit_dot = x + 1;
+            return;
+        }
+    }
+}
+
+static void ppu_draw_scanline(PPU *ppu)
+{
+    unsigned char line = ppu->scanline;
+    unsigned char show_background = ppu->mask_register & 0x08;
+    unsigned char show_sprites = ppu->mask_register & 0x10;
+    unsigned char background[SCREEN_WIDTH] = {0};
+    unsigned char sprite_pixels[8];
+
+    ppu->sprite_0_hit_dot = 0;
+
+    if (!ppu->output_enabled)
+    {
+        // Only sprite 0 hit is observable by the program, fetch the tiles under sprite 0
+        if (show_background && show_sprites && ppu->sprite_line.sprite_0)
+        {
+            unsigned char sprite_x = ppu->spr_ram[3];
+            unsigned char last_tile = sprite_x < SCREEN_WIDTH - 8 ? (sprite_x + 7) >> 3 : 31;
+
+            ppu_fetch_background(ppu, line, sprite_x >> 3, last_tile, background);
+            ppu_fetch_sprite(ppu, 0, line, sprite_pixels);
+            ppu_find_sprite_0_hit(ppu, background, sprite_pixels);
+        }
+
+        return;
+    }
+
+    // Sprite pixels as behind background << 5 | palette << 2 | color, 0 = transparent
+    unsigned char sprites[SCREEN_WIDTH] = {0};
+
+    if (show_background)
+    {
+        ppu_fetch_background(ppu, line, 0, 31, background);
+
+        if (!(ppu->mask_register & 0x02))
+        {
+            memset(background, 0, 8);
+        }
+    }
+
+    if (show_sprites)
+    {
+        for (int i = 0; i < ppu->sprite_line.count; i++)
+        {
+            unsigned char sprite_index = ppu->sprite_line.sprites[i];
+            unsigned char *sprite = ppu->spr_ram + sprite_index * 4;
+
+            ppu_fetch_sprite(ppu, sprite_index, line, sprite_pixels);
+
+            if (sprite_index == 0 && show_background)
+            {
+                ppu_find_sprite_0_hit(ppu, background, sprite_pixels);
+            }
+
+            for (int j = 0; j < 8 && sprite[3] + j < SCREEN_WIDTH; j++)
+            {
+                unsigned char x = sprite[3] + j;
+
+                // Lower OAM indexes win, even when they are behind the background
+                if (!sprites[x] && sprite_pixels[j] && (x >= 8 || (ppu->mask_register & 0x04)))
+                {
+                    sprites[x] = ((sprite[2] & 0x20) ? 0x20 : 0) | ((sprite[2] & 0x03) << 2) | sprite_pixels[j];
+                }
+            }
+        }
+    }
+
+    unsigned char *output = ppu->frame_buffer + line * SCREEN_WIDTH;
+    unsigned char *palettes = ppu->ppu_memory->palettes;
+
+    for (int x = 0; x < SCREEN_WIDTH; x++)
+    {
+        unsigned char sprite = sprites[x];
+        unsigned char palette_index;
+
+        if (sprite && (!(sprite & 0x20) || !(background[x] & 0x03)))
+        {
+            palette_index = (SPRITE_PALETTE - IMAGE_PALETTE) + (sprite & 0x1f);
+        }
+        else
+        {
+            palette_index = (background[x] & 0x03) ? background[x] : 0;
+        }
+
+        output[x] = palettes[palette_index] & 0x3f;
+    }
+}
+
+static void ppu_scanline_event(PPU *ppu)
+{
+    if (ppu->dot == ppu->sprite_0_hit_dot)
+    {
+        ppu->status_register |= 0x40;
+        ppu->sprite_0_hit_dot = 0;
+    }
+
+    if (ppu->dot == 1)
+    {
+        if (ppu->scanline == VBLANK_SCANLINE)
+        {
+            ppu->status_register |= 0x80;
+            ppu->frame_number++;
+
+            // Due immediately, the CPU takes it before its next instruction
+            if (ppu->control_register & 0x80)
+            {
+                scheduler_schedule(ppu->scheduler, EVENT_NMI, ppu->cycle * MASTER_CYCLES_PER_CPU_CYCLE);
+            }
+        }
+        else if (ppu->scanline == PRE_RENDER_SCANLINE)
+        {
+            // Clears vblank, sprite 0 hit and sprite overflow
+            ppu->status_register &= ~0xe0;
+        }
+    }
+
+    if (ppu->dot == 257 && (ppu->scanline < SCREEN_HEIGHT || ppu->scanline == PRE_RENDER_SCANLINE))
+    {
+        // Sprites for the next scanline, nothing is evaluated on the pre-render scanline
+        if ((ppu->mask_register & 0x18) && ppu->scanline != PRE_RENDER_SCANLINE)
+        {
+            ppu_evaluate_sprites(ppu, ppu->scanline, &ppu->sprite_line);
+            if (ppu->sprite_line.overflow)
+            {
+                ppu->status_register |= 0x20;
+            }
+        }
+        else
+        {
+            ppu->sprite_line.count = 0;
+            ppu->sprite_line.sprite_0 = 0;
+        }
+    }
+}
+
+static unsigned short ppu_scanline_length(PPU *ppu)
+{
+    // The pre-render scanline is one dot shorter on odd frames when rendering is enabled
+    if (ppu->scanline == PRE_RENDER_SCANLINE && (ppu->frame_number & 0x01) && (ppu->mask_register & 0x18))
+    {
+        return DOTS_PER_SCANLINE - 1;
+    }
+
+    return DOTS_PER_SCANLINE;
+}
+
+static unsigned short ppu_next_event_dot(PPU *ppu)
+{
+    unsigned short next = ppu_scanline_length(ppu);
+
+    if (ppu->dot < 1)
+    {
+        next = 1;
+    }
+    else if (ppu->dot < 257)
+    {
+        next = 257;
+    }
+
+    if (ppu->sprite_0_hit_dot > ppu->dot && ppu->sprite_0_hit_dot < next)
+    {
+        next = ppu->sprite_0_hit_dot;
+    }
+
+    return next;
+}
+
+// Advances the PPU by a number of dots (3 per CPU cycle), jumping from one scanline event to the next
+void ppu_run(PPU *ppu, unsigned int dots)
+{
+    while (dots)
+    {
+        unsigned short next = ppu_next_event_dot(ppu);
+        unsigned int until_next = next - ppu->dot;
+
+        if (until_next > dots)
+        {
+            ppu->dot += dots;
+            return;
+        }
+
+        dots -= until_next;
+        ppu->dot = next;
+
+        if (ppu->dot == ppu_scanline_length(ppu))
+        {
+            ppu->dot = 0;
+            ppu->scanline = (ppu->scanline + 1) % SCANLINES_PER_FRAME;
+
+            if (ppu->scanline < SCREEN_HEIGHT)
+            {
+                ppu_draw_scanline(ppu);
+            }
+        }
+        else
+        {
+            ppu_scanline_event(ppu);
+        }
+    }
+}
+
+/*
+ * The PPU is only brought up to date when the CPU can observe it: register and sprite DMA
+ * accesses, and its vblank start and end events.
+ */
+void ppu_catch_up(PPU *ppu, unsigned long long cpu_cycle)
+{
+    if (cpu_cycle > ppu->cycle)
+    {
+        ppu_run(ppu, (cpu_cycle - ppu->cycle) * 3);
+        ppu->cycle = cpu_cycle;
+    }
+
+    ppu_schedule_events(ppu);
+}
+
+static unsigned int ppu_dots_until(PPU *ppu, unsigned short scanline, unsigned short dot)
+{
+    unsigned int position = ppu->scanline * DOTS_PER_SCANLINE + ppu->dot;
+    unsigned int target = scanline * DOTS_PER_SCANLINE + dot;
+
+    if (position < target)
+    {
+        return target - position;
+    }
+
+    unsigned int dots = DOTS_PER_FRAME - position + target;
+
+    // Odd frame skip, unless the pre-render scanline is already past it
+    if ((ppu->frame_number & 0x01) && (ppu->mask_register & 0x18) &&
+        position < PRE_RENDER_SCANLINE * DOTS_PER_SCANLINE + DOTS_PER_SCANLINE - 1)
+    {
+        dots--;
+    }
+
+    return dots;
+}
+
+// Schedules the next vblank start and end from the current PPU position, called after each catch up
+void ppu_schedule_events(PPU *ppu)
+{
+    unsigned long long now = ppu->cycle * MASTER_CYCLES_PER_CPU_CYCLE;
+
+    scheduler_schedule(ppu->scheduler, EVENT_VBLANK_START, now + ppu_dots_until(ppu, VBLANK_SCANLINE, 1) * MASTER_CYCLES_PER_DOT);
+    scheduler_schedule(ppu->scheduler, EVENT_VBLANK_END, now + ppu_dots_until(ppu, PRE_RENDER_SCANLINE, 1) * MASTER_CYCLES_PER_DOT);
+}
+
+void ppu_frame_to_rgb(PPU *ppu, unsigned char *rgb)
+{
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++)
+    {
+        COLOR *color = &SYSTEM_PALETTE[ppu->frame_buffer[i]];
+        *rgb++ = color->red;
+        *rgb++ = color->green;
+        *rgb++ = color->blue;
+    }
 }
\ No newline at end of file
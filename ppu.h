@@ -2,6 +2,8 @@
 #define _PPU_H_
 
 #include "ppu-memory.h"
+#include "scheduler.h"
+#include "cdl.h"
 
 #define PPU_CONTROL_REGISTER 0x2000
 #define PPU_MASK_REGISTER 0x2001
@@ -11,6 +13,23 @@
 #define PPU_ADDRESS 0x2006
 #define PPU_DATA 0x2007
 #define NB_SPRITES 64
+#define NB_SPRITES_PER_LINE 8
+
+#define SCREEN_WIDTH 256
+#define SCREEN_HEIGHT 240
+#define DOTS_PER_SCANLINE 341
+#define SCANLINES_PER_FRAME 262
+#define VBLANK_SCANLINE 241
+#define PRE_RENDER_SCANLINE 261
+#define DOTS_PER_FRAME (DOTS_PER_SCANLINE * SCANLINES_PER_FRAME)
+
+typedef struct
+{
+    unsigned char count;                          // number of sprites in range, up to NB_SPRITES_PER_LINE
+    unsigned char sprites[NB_SPRITES_PER_LINE];   // OAM indexes of the sprites to draw, in priority order
+    unsigned char overflow;                       // more than NB_SPRITES_PER_LINE sprites in range
+    unsigned char sprite_0;                       // sprite 0 is one of the sprites to draw
+} SPRITE_LINE;
 
 typedef struct
 {
@@ -21,6 +40,16 @@ typedef struct
     unsigned char status_register;
     unsigned short address;
     unsigned char address_write_low; // 0 = write to high address byte, 1 = write to low address byte
+    unsigned short scanline;         // 0-239 visible, 240 post-render, 241-260 vblank, 261 pre-render
+    unsigned short dot;
+    unsigned long frame_number;      // incremented at the start of each vblank
+    unsigned char output_enabled;    // 0 = only timing, sprite 0 hit and overflow are computed
+    SPRITE_LINE sprite_line;         // sprites evaluated for the next scanline
+    unsigned short sprite_0_hit_dot; // dot of the current scanline where sprite 0 hits, 0 = no hit
+    unsigned char frame_buffer[SCREEN_WIDTH * SCREEN_HEIGHT]; // system palette indexes
+    unsigned long long cycle; // CPU cycle the PPU has caught up to
+    SCHEDULER *scheduler;     // receives vblank start/end and NMI events
+    CDL *cdl;                 // code/data log of the rendered pattern bytes, NULL when not logged
 } PPU;
 
 typedef struct
@@ -32,9 +61,16 @@ typedef struct
 
 COLOR SYSTEM_PALETTE[64];
 
-PPU *create_ppu(PPU_MEMORY *ppu_memory);
+PPU *create_ppu(PPU_MEMORY *ppu_memory, SCHEDULER *scheduler);
 void update_ppu(PPU *ppu);
+void ppu_run(PPU *ppu, unsigned int dots);
+void ppu_catch_up(PPU *ppu, unsigned long long cpu_cycle);
+void ppu_schedule_events(PPU *ppu);
+void ppu_frame_to_rgb(PPU *ppu, unsigned char *rgb);
+void ppu_write_control(PPU *ppu, unsigned char value);
 void ppu_write_address(PPU *ppu, unsigned char value);
 void ppu_write_data(PPU *ppu, unsigned char value);
+void ppu_evaluate_sprites(PPU *ppu, unsigned char scanline, SPRITE_LINE *line);
+void ppu_evaluate_sprites_scalar(PPU *ppu, unsigned char scanline, SPRITE_LINE *line);
 
 #endif
\ No newline at end of file
@@ -75,21 +75,43 @@ static void ppu_registers_window_class_init(PPURegistersWindowClass *class)
 
 static void close_ppu_registers_window(GtkWindow *win, DebuggerApp *app)
 {
+    refresh_coordinator_unregister(app->refresh, win);
     app->ppu_registers_window = NULL;
 }
 
-static void ppu_status_vblank_clicked(GtkToggleButton *button, DebuggerApp *app)
+static void refresh_ppu_registers_window(gpointer view, gpointer data)
+{
+    DebuggerApp *app = data;
+
+    update_ppu_registers_window(PPU_REGISTERS_WINDOW(view), app->nes->ppu);
+}
+
+static void set_vblank_call(NES *nes, void *data)
 {
-    if (gtk_toggle_button_get_active(button))
+    if (GPOINTER_TO_INT(data))
     {
-        app->nes->ppu->status_register |= 0x80;
+        nes->ppu->status_register |= 0x80;
     }
     else
     {
-        app->nes->ppu->status_register &= ~0x80;
+        nes->ppu->status_register &= ~0x80;
     }
 }
 
+static void ppu_status_vblank_clicked(GtkToggleButton *button, DebuggerApp *app)
+{
+    gboolean active = gtk_toggle_button_get_active(button);
+
+    // Refreshing the window sets the button to the snapshot value, only a user click changes it
+    if (active == !!(app->nes->ppu->status_register & 0x80))
+    {
+        return;
+    }
+
+    set_vblank_call(app->nes, GINT_TO_POINTER(active));
+    emulator_thread_call(app->emulator, set_vblank_call, GINT_TO_POINTER(active));
+}
+
 PPURegistersWindow *ppu_registers_window_new(DebuggerApp *app)
 {
     PPURegistersWindow *window = g_object_new(PPU_REGISTERS_WINDOW_TYPE, NULL);
@@ -97,6 +119,8 @@ PPURegistersWindow *ppu_registers_window_new(DebuggerApp *app)
     g_signal_connect(window, "destroy", G_CALLBACK(close_ppu_registers_window), app);
     g_signal_connect(window->ppu_status_vblank_check_button, "clicked", G_CALLBACK(ppu_status_vblank_clicked), app);
 
+    refresh_coordinator_register(app->refresh, window, STATE_PPU_REGISTERS, refresh_ppu_registers_window);
+
     return window;
 }
 
@@ -34,9 +34,17 @@ static void ppu_tables_window_class_init(PPUTablesWindowClass *class)
 
 static void close_ppu_tables_window(GtkWindow *win, DebuggerApp *app)
 {
+    refresh_coordinator_unregister(app->refresh, win);
     app->ppu_tables_window = NULL;
 }
 
+static void refresh_ppu_tables_window(gpointer view, gpointer data)
+{
+    DebuggerApp *app = data;
+
+    update_ppu_tables_window(PPU_TABLES_WINDOW(view), app->nes);
+}
+
 static gboolean draw_pattern_table(GtkWidget *widget, cairo_t *cr, DrawPatternTableCallbackArgs *args)
 {
     guint width = gtk_widget_get_allocated_width(widget);
@@ -104,23 +112,31 @@ PPUTablesWindow *ppu_tables_window_new(DebuggerApp *app)
         }
     }
 
+    refresh_coordinator_register(app->refresh, window, STATE_PATTERN_TABLES | STATE_NAME_TABLES, refresh_ppu_tables_window);
+
     return window;
 }
 
-void update_ppu_tables_window(PPUTablesWindow *win, PPU *ppu)
+void update_ppu_tables_window(PPUTablesWindow *win, NES *nes)
 {
     if (!win)
     {
         return;
     }
 
+    gtk_widget_queue_draw(GTK_WIDGET(win->pattern_table_left_area));
+    gtk_widget_queue_draw(GTK_WIDGET(win->pattern_table_right_area));
+
+    unsigned char tiles[30 * 32];
+    nes_peek_range(nes, WATCH_BUS_PPU, NAME_TABLE_0, tiles, sizeof(tiles));
+
     for (int row = 0; row < 30; row++)
     {
         for (int col = 0; col < 32; col++)
         {
             GtkLabel *label = GTK_LABEL(gtk_grid_get_child_at(win->name_table_0_grid, col, row));
 
-            gchar *text = g_strdup_printf("%02X", ppu_memory_read(ppu->ppu_memory, NAME_TABLE_0 + row * 32 + col));
+            gchar *text = g_strdup_printf("%02X", tiles[row * 32 + col]);
             gtk_label_set_text(label, text);
             g_free(text);
         }
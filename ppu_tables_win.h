@@ -11,6 +11,6 @@ G_DECLARE_FINAL_TYPE(PPUTablesWindow, ppu_tables_window, PPU, TABLES_WINDOW, Gtk
 
 PPUTablesWindow *ppu_tables_window_new(DebuggerApp *app);
 
-void update_ppu_tables_window(PPUTablesWindow *win, PPU *ppu);
+void update_ppu_tables_window(PPUTablesWindow *win, NES *nes);
 
 #endif
\ No newline at end of file
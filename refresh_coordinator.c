@@ -0,0 +1,109 @@
+#include <stdlib.h>
+
+#include "refresh_coordinator.h"
+
+REFRESH_COORDINATOR *create_refresh_coordinator()
+{
+    REFRESH_COORDINATOR *coordinator = malloc(sizeof(REFRESH_COORDINATOR));
+
+    coordinator->views = g_array_new(FALSE, FALSE, sizeof(REFRESH_VIEW));
+    coordinator->generation = 0;
+
+    for (int i = 0; i < NB_STATE_PARTS; i++)
+    {
+        coordinator->part_generations[i] = 0;
+    }
+
+    return coordinator;
+}
+
+static REFRESH_VIEW *refresh_coordinator_find(REFRESH_COORDINATOR *coordinator, gpointer view)
+{
+    for (guint i = 0; i < coordinator->views->len; i++)
+    {
+        REFRESH_VIEW *registered = &g_array_index(coordinator->views, REFRESH_VIEW, i);
+
+        if (registered->view == view)
+        {
+            return registered;
+        }
+    }
+
+    return NULL;
+}
+
+// The view is taken as up to date, registering it again only changes its parts
+void refresh_coordinator_register(REFRESH_COORDINATOR *coordinator, gpointer view, guint64 parts, REFRESH_FUNCTION refresh)
+{
+    REFRESH_VIEW *registered = refresh_coordinator_find(coordinator, view);
+
+    if (registered)
+    {
+        registered->parts = parts;
+        registered->refresh = refresh;
+        return;
+    }
+
+    REFRESH_VIEW new_view = {view, parts, refresh, coordinator->generation};
+    g_array_append_val(coordinator->views, new_view);
+}
+
+void refresh_coordinator_unregister(REFRESH_COORDINATOR *coordinator, gpointer view)
+{
+    for (guint i = 0; i < coordinator->views->len; i++)
+    {
+        if (g_array_index(coordinator->views, REFRESH_VIEW, i).view == view)
+        {
+            g_array_remove_index_fast(coordinator->views, i);
+            return;
+        }
+    }
+}
+
+void refresh_coordinator_mark(REFRESH_COORDINATOR *coordinator, guint64 parts)
+{
+    if (!parts)
+    {
+        return;
+    }
+
+    coordinator->generation++;
+
+    for (int i = 0; i < NB_STATE_PARTS; i++)
+    {
+        if (parts & ((guint64)1 << i))
+        {
+            coordinator->part_generations[i] = coordinator->generation;
+        }
+    }
+}
+
+static int refresh_view_is_stale(REFRESH_COORDINATOR *coordinator, REFRESH_VIEW *view)
+{
+    for (int i = 0; i < NB_STATE_PARTS; i++)
+    {
+        if ((view->parts & ((guint64)1 << i)) && coordinator->part_generations[i] > view->generation)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Refreshes the views showing a part marked since their last refresh
+void refresh_coordinator_run(REFRESH_COORDINATOR *coordinator, gpointer data)
+{
+    for (guint i = 0; i < coordinator->views->len; i++)
+    {
+        REFRESH_VIEW *view = &g_array_index(coordinator->views, REFRESH_VIEW, i);
+        int stale = view->generation != coordinator->generation && refresh_view_is_stale(coordinator, view);
+
+        view->generation = coordinator->generation;
+
+        if (stale)
+        {
+            view->refresh(view->view, data);
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef _REFRESH_COORDINATOR_H_
+#define _REFRESH_COORDINATOR_H_
+
+#include <glib.h>
+
+#include "emulator_thread.h"
+
+typedef void (*REFRESH_FUNCTION)(gpointer view, gpointer data);
+
+typedef struct
+{
+    gpointer view;
+    guint64 parts; // STATE_ parts the view shows
+    REFRESH_FUNCTION refresh;
+    guint64 generation; // coordinator generation at the last refresh
+} REFRESH_VIEW;
+
+/*
+ * Views register the parts of the state they show and are only refreshed when one of them
+ * changed since their last refresh. Each part remembers the generation it last changed in.
+ */
+typedef struct
+{
+    GArray *views;
+    guint64 generation;
+    guint64 part_generations[NB_STATE_PARTS];
+} REFRESH_COORDINATOR;
+
+REFRESH_COORDINATOR *create_refresh_coordinator();
+void refresh_coordinator_register(REFRESH_COORDINATOR *coordinator, gpointer view, guint64 parts, REFRESH_FUNCTION refresh);
+void refresh_coordinator_unregister(REFRESH_COORDINATOR *coordinator, gpointer view);
+void refresh_coordinator_mark(REFRESH_COORDINATOR *coordinator, guint64 parts);
+void refresh_coordinator_run(REFRESH_COORDINATOR *coordinator, gpointer data);
+
+#endif
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+
+#include "scheduler.h"
+
+SCHEDULER *create_scheduler()
+{
+    SCHEDULER *scheduler = malloc(sizeof(SCHEDULER));
+
+    for (int i = 0; i < NB_EVENT_TYPES; i++)
+    {
+        scheduler->positions[i] = -1;
+    }
+    scheduler->count = 0;
+    scheduler->next_cycle = NO_EVENT_CYCLE;
+
+    return scheduler;
+}
+
+static void scheduler_swap(SCHEDULER *scheduler, unsigned int i, unsigned int j)
+{
+    EVENT event = scheduler->heap[i];
+    scheduler->heap[i] = scheduler->heap[j];
+    scheduler->heap[j] = event;
+
+    scheduler->positions[scheduler->heap[i].type] = i;
+    scheduler->positions[scheduler->heap[j].type] = j;
+}
+
+static void scheduler_sift_up(SCHEDULER *scheduler, unsigned int i)
+{
+    while (i > 0 && scheduler->heap[(i - 1) / 2].cycle > scheduler->heap[i].cycle)
+    {
+        scheduler_swap(scheduler, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void scheduler_sift_down(SCHEDULER *scheduler, unsigned int i)
+{
+    for (;;)
+    {
+        unsigned int smallest = i;
+        unsigned int left = 2 * i + 1;
+        unsigned int right = 2 * i + 2;
+
+        if (left < scheduler->count && scheduler->heap[left].cycle < scheduler->heap[smallest].cycle)
+        {
+            smallest = left;
+        }
+        if (right < scheduler->count && scheduler->heap[right].cycle < scheduler->heap[smallest].cycle)
+        {
+            smallest = right;
+        }
+        if (smallest == i)
+        {
+            return;
+        }
+
+        scheduler_swap(scheduler, i, smallest);
+        i = smallest;
+    }
+}
+
+static void scheduler_remove_at(SCHEDULER *scheduler, unsigned int i)
+{
+    scheduler->positions[scheduler->heap[i].type] = -1;
+    scheduler->count--;
+
+    if (i < scheduler->count)
+    {
+        EVENT moved = scheduler->heap[scheduler->count];
+
+        scheduler->heap[i] = moved;
+        scheduler->positions[moved.type] = i;
+        scheduler_sift_up(scheduler, i);
+        scheduler_sift_down(scheduler, scheduler->positions[moved.type]);
+    }
+}
+
+static void scheduler_update_next_cycle(SCHEDULER *scheduler)
+{
+    scheduler->next_cycle = scheduler->count ? scheduler->heap[0].cycle : NO_EVENT_CYCLE;
+}
+
+// Schedules an event, replacing the pending event of the same type if any
+void scheduler_schedule(SCHEDULER *scheduler, enum EVENT_TYPE type, unsigned long long cycle)
+{
+    int i = scheduler->positions[type];
+
+    if (i < 0)
+    {
+        i = scheduler->count++;
+        scheduler->heap[i].type = type;
+        scheduler->positions[type] = i;
+    }
+
+    scheduler->heap[i].cycle = cycle;
+    scheduler_sift_up(scheduler, i);
+    scheduler_sift_down(scheduler, scheduler->positions[type]);
+    scheduler_update_next_cycle(scheduler);
+}
+
+void scheduler_cancel(SCHEDULER *scheduler, enum EVENT_TYPE type)
+{
+    if (scheduler->positions[type] >= 0)
+    {
+        scheduler_remove_at(scheduler, scheduler->positions[type]);
+        scheduler_update_next_cycle(scheduler);
+    }
+}
+
+int scheduler_is_scheduled(SCHEDULER *scheduler, enum EVENT_TYPE type)
+{
+    return scheduler->positions[type] >= 0;
+}
+
+// Removes and returns the earliest event, the scheduler must not be empty
+enum EVENT_TYPE scheduler_pop(SCHEDULER *scheduler)
+{
+    enum EVENT_TYPE type = scheduler->heap[0].type;
+
+    scheduler_remove_at(scheduler, 0);
+    scheduler_update_next_cycle(scheduler);
+
+    return type;
+}
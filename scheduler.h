@@ -0,0 +1,38 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+// Event timestamps are in master clock cycles, shared by the CPU and the PPU (NTSC)
+#define MASTER_CYCLES_PER_CPU_CYCLE 12
+#define MASTER_CYCLES_PER_DOT 4
+#define NO_EVENT_CYCLE 0xffffffffffffffffULL
+
+enum EVENT_TYPE
+{
+    EVENT_VBLANK_START,
+    EVENT_VBLANK_END,
+    EVENT_NMI,
+    NB_EVENT_TYPES
+};
+
+typedef struct
+{
+    unsigned long long cycle;
+    enum EVENT_TYPE type;
+} EVENT;
+
+// Min-heap of pending events, at most one per event type
+typedef struct
+{
+    EVENT heap[NB_EVENT_TYPES];
+    int positions[NB_EVENT_TYPES]; // heap index of each event type, -1 when not scheduled
+    unsigned int count;
+    unsigned long long next_cycle; // cycle of the earliest event, NO_EVENT_CYCLE when empty
+} SCHEDULER;
+
+SCHEDULER *create_scheduler();
+void scheduler_schedule(SCHEDULER *scheduler, enum EVENT_TYPE type, unsigned long long cycle);
+void scheduler_cancel(SCHEDULER *scheduler, enum EVENT_TYPE type);
+int scheduler_is_scheduled(SCHEDULER *scheduler, enum EVENT_TYPE type);
+enum EVENT_TYPE scheduler_pop(SCHEDULER *scheduler);
+
+#endif
@@ -0,0 +1,338 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "timing.h"
+#include "disassembler.h"
+
+#define TIMING_VISITING 1
+#define TIMING_DONE 2
+
+// Paths through a ROM decoded from data can add up to more than 32 bits, the sums stop at the top
+static inline unsigned int timing_add(unsigned int a, unsigned int b)
+{
+    return a + b < a ? ~0u : a + b;
+}
+
+// Index of the block starting at the offset, -1 when no decoded block does
+static int timing_find_block(const ANALYSIS *analysis, unsigned int offset)
+{
+    unsigned int low = 0;
+    unsigned int high = analysis->block_count;
+
+    while (low < high)
+    {
+        unsigned int middle = (low + high) / 2;
+
+        if (analysis->blocks[middle].start < offset)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low < analysis->block_count && analysis->blocks[low].start == offset ? (int)low : -1;
+}
+
+static void timing_visit(TIMING *timing, unsigned int index);
+
+// Counts of the block at the target, or nothing with the flag when it is on the path being counted or unknown
+static const BLOCK_TIMING *timing_target(TIMING *timing, unsigned int offset, unsigned char cut_flag, unsigned char *flags)
+{
+    int index = timing_find_block(timing->analysis, offset);
+
+    if (index < 0)
+    {
+        *flags |= TIMING_UNKNOWN_TARGET;
+        return NULL;
+    }
+
+    timing_visit(timing, index);
+
+    if (timing->blocks[index].state != TIMING_DONE)
+    {
+        *flags |= cut_flag;
+        return NULL;
+    }
+
+    *flags |= timing->blocks[index].flags;
+
+    return &timing->blocks[index];
+}
+
+// Taken branches cost a cycle, and another one when the target is in another page than the next instruction
+static unsigned int timing_edge_cycles(const ANALYSIS *analysis, const CFG_EDGE *edge)
+{
+    if (edge->kind != EDGE_BRANCH)
+    {
+        return 0;
+    }
+
+    unsigned short next = analysis_address(analysis, edge->from) + 2;
+    unsigned short target = analysis_address(analysis, edge->to);
+
+    return 1 + (((next ^ target) & 0xff00) != 0);
+}
+
+static void timing_visit(TIMING *timing, unsigned int index)
+{
+    const ANALYSIS *analysis = timing->analysis;
+    const BASIC_BLOCK *block = &analysis->blocks[index];
+    BLOCK_TIMING *result = &timing->blocks[index];
+
+    if (result->state)
+    {
+        return;
+    }
+
+    result->state = TIMING_VISITING;
+
+    unsigned int best = 0;
+    unsigned int worst = 0;
+    unsigned int last = block->start;
+    unsigned char flags = 0;
+
+    for (unsigned int offset = block->start; offset < block->end; offset += OPCODES[analysis->prg[offset]].length)
+    {
+        const OPCODE_INFO *info = &OPCODES[analysis->prg[offset]];
+
+        best += info->cycles;
+        worst += info->cycles + (info->mode == RELATIVE ? 0 : info->extra_cycles);
+        last = offset;
+    }
+
+    // A JSR into the switched bank has a callee in each bank, the edges of an instruction are together
+    const CFG_EDGE *edges = analysis->edges + block->first_edge;
+
+    for (unsigned int i = 0; i < block->edge_count;)
+    {
+        unsigned int from = edges[i].from;
+        unsigned int call_best = ~0u;
+        unsigned int call_worst = 0;
+
+        for (; i < block->edge_count && edges[i].from == from; i++)
+        {
+            const BLOCK_TIMING *callee = edges[i].kind == EDGE_CALL ? timing_target(timing, edges[i].to, TIMING_RECURSION, &flags) : NULL;
+
+            if (callee)
+            {
+                call_best = callee->best < call_best ? callee->best : call_best;
+                call_worst = callee->worst > call_worst ? callee->worst : call_worst;
+            }
+        }
+
+        best = timing_add(best, call_worst ? call_best : 0);
+        worst = timing_add(worst, call_worst);
+    }
+
+    // Then the cheapest and the most expensive way out
+    unsigned int next_best = ~0u;
+    unsigned int next_worst = 0;
+    int successors = 0;
+
+    for (unsigned int i = 0; i < block->edge_count; i++)
+    {
+        if (edges[i].from != last || edges[i].kind == EDGE_CALL)
+        {
+            continue;
+        }
+
+        const BLOCK_TIMING *next = timing_target(timing, edges[i].to, TIMING_LOOP, &flags);
+        unsigned int cycles = timing_edge_cycles(analysis, &edges[i]);
+
+        successors++;
+
+        if (next)
+        {
+            next_best = timing_add(next->best, cycles) < next_best ? timing_add(next->best, cycles) : next_best;
+            next_worst = timing_add(next->worst, cycles) > next_worst ? timing_add(next->worst, cycles) : next_worst;
+        }
+    }
+
+    if (block->falls_through)
+    {
+        const BLOCK_TIMING *next = timing_target(timing, block->end, TIMING_LOOP, &flags);
+
+        successors++;
+
+        if (next)
+        {
+            next_best = next->best < next_best ? next->best : next_best;
+            next_worst = next->worst > next_worst ? next->worst : next_worst;
+        }
+    }
+
+    // JMP (indirect) without a known table goes somewhere that cannot be counted
+    if (!successors && analysis->prg[last] == 0x6c)
+    {
+        flags |= TIMING_UNKNOWN_TARGET;
+    }
+
+    result->best = timing_add(best, next_best == ~0u ? 0 : next_best);
+    result->worst = timing_add(worst, next_worst);
+    result->flags = flags;
+    result->state = TIMING_DONE;
+}
+
+// Counts every block reachable from a label, the routines first so that their own paths are complete
+TIMING *create_timing(const ANALYSIS *analysis)
+{
+    TIMING *timing = malloc(sizeof(TIMING));
+
+    timing->analysis = analysis;
+    timing->blocks = calloc(analysis->block_count ? analysis->block_count : 1, sizeof(BLOCK_TIMING));
+
+    for (int kind = LABEL_RESET; kind >= LABEL_SUBROUTINE; kind--)
+    {
+        for (unsigned int i = 0; i < analysis->block_count; i++)
+        {
+            if (analysis->labels[analysis->blocks[i].start] == kind)
+            {
+                timing_visit(timing, i);
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < analysis->block_count; i++)
+    {
+        timing_visit(timing, i);
+    }
+
+    return timing;
+}
+
+void free_timing(TIMING *timing)
+{
+    free(timing->blocks);
+    free(timing);
+}
+
+// Counts from an instruction starting a block, interrupt handlers with the interrupt sequence. Returns -1 elsewhere.
+int timing_routine(const TIMING *timing, unsigned int offset, unsigned int *best, unsigned int *worst, unsigned char *flags)
+{
+    int index = offset < timing->analysis->prg_size ? timing_find_block(timing->analysis, offset) : -1;
+
+    if (index < 0)
+    {
+        return -1;
+    }
+
+    enum LABEL_KIND kind = timing->analysis->labels[offset];
+    unsigned int interrupt = kind == LABEL_NMI || kind == LABEL_IRQ ? TIMING_INTERRUPT_CYCLES : 0;
+
+    *best = timing_add(timing->blocks[index].best, interrupt);
+    *worst = timing_add(timing->blocks[index].worst, interrupt);
+    *flags = timing->blocks[index].flags;
+
+    return 0;
+}
+
+// Loops and recursion have no known upper bound, and nor has a sum that stopped at the top
+int timing_unbounded(unsigned int worst, unsigned char flags)
+{
+    return worst == ~0u || (flags & (TIMING_LOOP | TIMING_RECURSION));
+}
+
+// An NMI handler that may still be running when the vertical blank is over, any with an unbounded worst case
+int timing_over_budget(const TIMING *timing, unsigned int offset)
+{
+    unsigned int best;
+    unsigned int worst;
+    unsigned char flags;
+
+    return timing->analysis->labels[offset] == LABEL_NMI && timing_routine(timing, offset, &best, &worst, &flags) == 0 &&
+           (worst > TIMING_VBLANK_CYCLES || timing_unbounded(worst, flags));
+}
+
+/*
+ * Writes a line per routine: the vectors, then the subroutines in ROM order. Returns how many NMI
+ * handlers go or may go over the vertical blank.
+ */
+unsigned int timing_report(const TIMING *timing, FILE *file)
+{
+    const ANALYSIS *analysis = timing->analysis;
+    unsigned int over_budget = 0;
+    char name[24];
+    char worst_text[16];
+
+    fprintf(file, "; CPU cycles from the entry to the return, calls included. Subroutines start after\n"
+                  "; the JSR that calls them, handlers with the 7 cycles of the interrupt.\n"
+                  "; NMI budget: %u cycles, a handler with an unbounded worst case may go over it.\n",
+            TIMING_VBLANK_CYCLES);
+    fprintf(file, "%-16s %-7s %7s %9s  %s\n", "Routine", "Address", "Best", "Worst", "Notes");
+
+    for (int kind = LABEL_RESET; kind >= LABEL_SUBROUTINE; kind--)
+    {
+        for (unsigned int i = 0; i < analysis->block_count; i++)
+        {
+            unsigned int offset = analysis->blocks[i].start;
+            unsigned int best;
+            unsigned int worst;
+            unsigned char flags;
+
+            if (analysis->labels[offset] != kind || timing_routine(timing, offset, &best, &worst, &flags) < 0)
+            {
+                continue;
+            }
+
+            const char *separator = "  ";
+            int unbounded = timing_unbounded(worst, flags);
+
+            if (unbounded)
+            {
+                snprintf(worst_text, sizeof(worst_text), "unbounded");
+            }
+            else
+            {
+                snprintf(worst_text, sizeof(worst_text), "%u", worst);
+            }
+
+            analysis_label_name(analysis, offset, name);
+            fprintf(file, "%-16s %02X:%04X %7u %9s", name, offset / PRG_BANK_SIZE, analysis_address(analysis, offset), best,
+                    worst_text);
+
+            // An unbounded worst case overruns by an unknown amount, if at all when what was counted fits
+            if (timing_over_budget(timing, offset))
+            {
+                if (unbounded && worst <= TIMING_VBLANK_CYCLES)
+                {
+                    fprintf(file, "%sMAY GO OVER BUDGET", separator);
+                }
+                else if (unbounded)
+                {
+                    fprintf(file, "%sOVER BUDGET", separator);
+                }
+                else
+                {
+                    fprintf(file, "%sOVER BUDGET by %u", separator, worst - TIMING_VBLANK_CYCLES);
+                }
+
+                separator = ", ";
+                over_budget++;
+            }
+
+            if (flags & TIMING_LOOP)
+            {
+                fprintf(file, "%sloops counted once", separator);
+                separator = ", ";
+            }
+
+            if (flags & TIMING_RECURSION)
+            {
+                fprintf(file, "%srecursive", separator);
+                separator = ", ";
+            }
+
+            if (flags & TIMING_UNKNOWN_TARGET)
+            {
+                fprintf(file, "%sindirect jump", separator);
+            }
+
+            fprintf(file, "\n");
+        }
+    }
+
+    return over_budget;
+}
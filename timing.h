@@ -0,0 +1,43 @@
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+#include <stdio.h>
+
+#include "analyzer.h"
+
+#define TIMING_VBLANK_CYCLES 2273  // 20 NTSC scanlines of 341 dots, 3 dots per CPU cycle
+#define TIMING_INTERRUPT_CYCLES 7 // pushing PC and P then reading the vector
+
+// Why a count may be short of what the code can take
+#define TIMING_LOOP 0x01           // loops are counted once through
+#define TIMING_RECURSION 0x02      // calls back into a routine being counted are left out
+#define TIMING_UNKNOWN_TARGET 0x04 // a path ends at an indirect jump or a target that was not decoded
+
+typedef struct
+{
+    unsigned int best;  // fewest cycles from the start of the block to the return, calls included
+    unsigned int worst; // most cycles, every indexed access crossing a page
+    unsigned char flags;
+    unsigned char state;
+} BLOCK_TIMING;
+
+/*
+ * Best and worst case cycle counts over the loop-free paths of the control flow graph, from each
+ * block to the RTS or RTI that ends its routine. Branches cost their taken cycle and, since both
+ * addresses are known, their page crossing on the taken edge only. A JSR costs its callee. An
+ * edge back to a block of the path being counted is left out, so a loop body counts once.
+ */
+typedef struct
+{
+    const ANALYSIS *analysis;
+    BLOCK_TIMING *blocks; // same order as the blocks of the analysis
+} TIMING;
+
+TIMING *create_timing(const ANALYSIS *analysis);
+void free_timing(TIMING *timing);
+int timing_routine(const TIMING *timing, unsigned int offset, unsigned int *best, unsigned int *worst, unsigned char *flags);
+int timing_unbounded(unsigned int worst, unsigned char flags);
+int timing_over_budget(const TIMING *timing, unsigned int offset);
+unsigned int timing_report(const TIMING *timing, FILE *file);
+
+#endif
@@ -0,0 +1,910 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+#include "disassembler.h"
+
+#define TRACE_ENCODED_BYTES 26 // of a record, the reserved ones are never written
+
+// Bytes of a record by how often they change from one instruction to the next, so that the mask of most records fits in a byte or two
+static const unsigned char ENCODING_ORDER[TRACE_ENCODED_BYTES] = {
+    offsetof(TRACE_RECORD, cycle),
+    offsetof(TRACE_RECORD, a),
+    offsetof(TRACE_RECORD, x),
+    offsetof(TRACE_RECORD, y),
+    offsetof(TRACE_RECORD, p),
+    offsetof(TRACE_RECORD, sp),
+    offsetof(TRACE_RECORD, value),
+    offsetof(TRACE_RECORD, pc),
+    offsetof(TRACE_RECORD, pc) + 1,
+    offsetof(TRACE_RECORD, cycle) + 1,
+    offsetof(TRACE_RECORD, address),
+    offsetof(TRACE_RECORD, address) + 1,
+    offsetof(TRACE_RECORD, bytes),
+    offsetof(TRACE_RECORD, bytes) + 1,
+    offsetof(TRACE_RECORD, bytes) + 2,
+    offsetof(TRACE_RECORD, flags),
+    offsetof(TRACE_RECORD, frame),
+    offsetof(TRACE_RECORD, cycle) + 2,
+    offsetof(TRACE_RECORD, cycle) + 3,
+    offsetof(TRACE_RECORD, cycle) + 4,
+    offsetof(TRACE_RECORD, cycle) + 5,
+    offsetof(TRACE_RECORD, cycle) + 6,
+    offsetof(TRACE_RECORD, cycle) + 7,
+    offsetof(TRACE_RECORD, frame) + 1,
+    offsetof(TRACE_RECORD, frame) + 2,
+    offsetof(TRACE_RECORD, frame) + 3};
+
+/*
+ * What the record has that the previous one and the last one at the same PC did not tell: the
+ * frames gone by and the bytes that differ. Applying it twice gives the record back.
+ */
+static void trace_delta(TRACE_RECORD *delta, const TRACE_RECORD *previous, const TRACE_PREDICTION *prediction)
+{
+    delta->bytes[0] ^= prediction->bytes[0];
+    delta->bytes[1] ^= prediction->bytes[1];
+    delta->bytes[2] ^= prediction->bytes[2];
+    delta->address ^= prediction->address;
+    delta->a ^= previous->a;
+    delta->x ^= previous->x;
+    delta->y ^= previous->y;
+    delta->p ^= previous->p;
+    delta->sp ^= previous->sp;
+    delta->value ^= previous->value;
+    delta->flags ^= previous->flags;
+}
+
+// PC and cycle of the next instruction: where it went the last time, else the next one in memory after the base cycles
+static void trace_expect(const TRACE_PREDICTION *predictions, const TRACE_RECORD *previous, unsigned short *pc,
+                         unsigned long long *cycle)
+{
+    const TRACE_PREDICTION *prediction = &predictions[previous->pc & (TRACE_PREDICTIONS - 1)];
+    const OPCODE_INFO *info = &OPCODES[previous->bytes[0]];
+
+    *pc = prediction->seen ? prediction->next : previous->pc + info->length;
+    *cycle = previous->cycle + (prediction->seen ? prediction->cycles : info->cycles);
+}
+
+// Remembers the record at its PC and where the previous one went to, the first record of a block has no previous one
+static void trace_learn(TRACE_PREDICTION *predictions, const TRACE_RECORD *previous, const TRACE_RECORD *record, unsigned int i)
+{
+    TRACE_PREDICTION *prediction = &predictions[record->pc & (TRACE_PREDICTIONS - 1)];
+
+    if (i)
+    {
+        TRACE_PREDICTION *from = &predictions[previous->pc & (TRACE_PREDICTIONS - 1)];
+
+        from->next = record->pc;
+        from->cycles = record->cycle - previous->cycle;
+        from->seen = 1;
+    }
+
+    memcpy(prediction->bytes, record->bytes, sizeof(prediction->bytes));
+    prediction->address = record->address;
+}
+
+// Returns the size written to out, at most count * TRACE_ENCODED_SIZE
+unsigned int trace_encode_block(const TRACE_RECORD *records, unsigned int count, unsigned char *out)
+{
+    TRACE_PREDICTION predictions[TRACE_PREDICTIONS] = {0};
+    TRACE_RECORD previous = {0};
+    unsigned char *start = out;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const TRACE_RECORD *record = &records[i];
+        TRACE_RECORD delta = *record;
+        const unsigned char *bytes = (const unsigned char *)&delta;
+        unsigned short pc;
+        unsigned long long cycle;
+        unsigned int mask = 0;
+
+        trace_expect(predictions, &previous, &pc, &cycle);
+        delta.pc -= pc;
+        delta.cycle -= cycle;
+        delta.frame -= previous.frame;
+        trace_delta(&delta, &previous, &predictions[record->pc & (TRACE_PREDICTIONS - 1)]);
+
+        for (unsigned int j = 0; j < TRACE_ENCODED_BYTES; j++)
+        {
+            mask |= (bytes[ENCODING_ORDER[j]] != 0) << j;
+        }
+
+        // 7 bits of the mask per byte, the high bit tells that more follow
+        do
+        {
+            *out++ = (mask & 0x7f) | (mask > 0x7f ? 0x80 : 0);
+            mask >>= 7;
+        } while (mask);
+
+        for (unsigned int j = 0; j < TRACE_ENCODED_BYTES; j++)
+        {
+            *out = bytes[ENCODING_ORDER[j]];
+            out += *out != 0;
+        }
+
+        trace_learn(predictions, &previous, record, i);
+        previous = *record;
+    }
+
+    return out - start;
+}
+
+// Returns -1 when the data does not hold count records
+int trace_decode_block(const unsigned char *data, unsigned int size, TRACE_RECORD *records, unsigned int count)
+{
+    TRACE_PREDICTION predictions[TRACE_PREDICTIONS] = {0};
+    TRACE_RECORD previous = {0};
+    const unsigned char *end = data + size;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        TRACE_RECORD *record = &records[i];
+        unsigned char *bytes = (unsigned char *)record;
+        unsigned short pc;
+        unsigned long long cycle;
+        unsigned int mask = 0;
+        unsigned int shift = 0;
+
+        do
+        {
+            if (data == end || shift > 21)
+            {
+                return -1;
+            }
+
+            mask |= (*data & 0x7f) << shift;
+            shift += 7;
+        } while (*data++ & 0x80);
+
+        memset(record, 0, sizeof(TRACE_RECORD));
+
+        for (unsigned int j = 0; mask; j++, mask >>= 1)
+        {
+            if (!(mask & 1))
+            {
+                continue;
+            }
+
+            if (data == end || j >= TRACE_ENCODED_BYTES)
+            {
+                return -1;
+            }
+
+            bytes[ENCODING_ORDER[j]] = *data++;
+        }
+
+        trace_expect(predictions, &previous, &pc, &cycle);
+        record->pc += pc;
+        record->cycle += cycle;
+        record->frame += previous.frame;
+        trace_delta(record, &previous, &predictions[record->pc & (TRACE_PREDICTIONS - 1)]);
+        trace_learn(predictions, &previous, record, i);
+        previous = *record;
+    }
+
+    return data == end ? 0 : -1;
+}
+
+// Lets every instruction through
+void trace_filter_init(TRACE_FILTER *filter)
+{
+    filter->range_count = 0;
+    filter->bank = -1;
+    filter->min_depth = 0;
+    filter->max_depth = UINT_MAX;
+    filter->contexts = TRACE_CONTEXT_ALL;
+    filter->first_frame = 0;
+    filter->last_frame = ULONG_MAX;
+}
+
+// Reads "first", "first-last" or "first-" for everything from first on. Returns NULL on error.
+static const char *trace_parse_range(const char *text, int base, unsigned long *first, unsigned long *last, unsigned long max)
+{
+    char *end;
+
+    text += base == 16 && *text == '$';
+    *first = strtoul(text, &end, base);
+
+    if (end == text || *first > max)
+    {
+        return NULL;
+    }
+
+    *last = *first;
+    text = end;
+
+    if (*text != '-')
+    {
+        return text;
+    }
+
+    text++;
+    text += base == 16 && *text == '$';
+    *last = strtoul(text, &end, base);
+
+    if (end == text)
+    {
+        *last = max;
+    }
+
+    return *last >= *first && *last <= max ? end : NULL;
+}
+
+/*
+ * Reads terms separated by spaces, like "pc=8000-80FF,C000 bank=1 depth=0-2 context=nmi
+ * frames=100-". PCs are in hex, every term is optional. Returns -1 on error, the filter is then
+ * left as it was.
+ */
+int trace_filter_parse(TRACE_FILTER *filter, const char *text)
+{
+    TRACE_FILTER parsed;
+    unsigned long first;
+    unsigned long last;
+
+    trace_filter_init(&parsed);
+
+    while (*text)
+    {
+        if (isspace((unsigned char)*text))
+        {
+            text++;
+            continue;
+        }
+
+        if (!strncmp(text, "pc=", 3))
+        {
+            text += 3;
+
+            do
+            {
+                text += *text == ',';
+
+                if (parsed.range_count == TRACE_FILTER_RANGES || !(text = trace_parse_range(text, 16, &first, &last, 0xffff)))
+                {
+                    return -1;
+                }
+
+                parsed.range_starts[parsed.range_count] = first;
+                parsed.range_ends[parsed.range_count++] = last;
+            } while (*text == ',');
+        }
+        else if (!strncmp(text, "bank=", 5))
+        {
+            if (!(text = trace_parse_range(text + 5, 10, &first, &last, 0xff)) || first != last)
+            {
+                return -1;
+            }
+
+            parsed.bank = first;
+        }
+        else if (!strncmp(text, "depth=", 6))
+        {
+            if (!(text = trace_parse_range(text + 6, 10, &first, &last, UINT_MAX)))
+            {
+                return -1;
+            }
+
+            parsed.min_depth = first;
+            parsed.max_depth = last;
+        }
+        else if (!strncmp(text, "frames=", 7))
+        {
+            if (!(text = trace_parse_range(text + 7, 10, &parsed.first_frame, &parsed.last_frame, ULONG_MAX)))
+            {
+                return -1;
+            }
+        }
+        else if (!strncmp(text, "context=main", 12) || !strncmp(text, "context=nmi", 11))
+        {
+            parsed.contexts = text[8] == 'm' ? TRACE_CONTEXT_MAIN : TRACE_CONTEXT_NMI;
+            text += text[8] == 'm' ? 12 : 11;
+        }
+        else
+        {
+            return -1;
+        }
+
+        if (*text && !isspace((unsigned char)*text))
+        {
+            return -1;
+        }
+    }
+
+    *filter = parsed;
+
+    return 0;
+}
+
+// Writes the filter as trace_filter_parse reads it, empty when it lets everything through. Returns the length like snprintf.
+int trace_filter_to_str(const TRACE_FILTER *filter, char *str, unsigned int size)
+{
+    char text[256];
+    int length = 0;
+
+    text[0] = 0;
+
+    for (unsigned int i = 0; i < filter->range_count; i++)
+    {
+        length += sprintf(text + length, i ? ",%04X" : "pc=%04X", filter->range_starts[i]);
+
+        if (filter->range_ends[i] != filter->range_starts[i])
+        {
+            length += sprintf(text + length, "-%04X", filter->range_ends[i]);
+        }
+    }
+
+    if (filter->bank >= 0)
+    {
+        length += sprintf(text + length, " bank=%d", filter->bank);
+    }
+
+    if (filter->min_depth || filter->max_depth != UINT_MAX)
+    {
+        length += sprintf(text + length, " depth=%u", filter->min_depth);
+
+        if (filter->max_depth != filter->min_depth)
+        {
+            length += filter->max_depth == UINT_MAX ? sprintf(text + length, "-") : sprintf(text + length, "-%u", filter->max_depth);
+        }
+    }
+
+    if (filter->contexts != TRACE_CONTEXT_ALL)
+    {
+        length += sprintf(text + length, filter->contexts == TRACE_CONTEXT_NMI ? " context=nmi" : " context=main");
+    }
+
+    if (filter->first_frame || filter->last_frame != ULONG_MAX)
+    {
+        length += sprintf(text + length, " frames=%lu", filter->first_frame);
+
+        if (filter->last_frame != filter->first_frame)
+        {
+            length += filter->last_frame == ULONG_MAX ? sprintf(text + length, "-") : sprintf(text + length, "-%lu", filter->last_frame);
+        }
+    }
+
+    return snprintf(str, size, "%s", text[0] == ' ' ? text + 1 : text);
+}
+
+// The depth or the context changed, the instructions that follow are let through or not
+static void trace_writer_update(TRACE_WRITER *writer)
+{
+    const TRACE_FILTER *filter = &writer->filter;
+    unsigned char context = writer->nmi_depth ? TRACE_CONTEXT_NMI : TRACE_CONTEXT_MAIN;
+
+    writer->open = writer->depth >= filter->min_depth && writer->depth <= filter->max_depth && (filter->contexts & context);
+}
+
+// Sets the bits of the PCs from first to last
+static void trace_writer_allow(TRACE_WRITER *writer, unsigned int first, unsigned int last)
+{
+    for (unsigned int pc = first; pc <= last; pc++)
+    {
+        writer->pcs[pc >> 3] |= 1 << (pc & 7);
+    }
+}
+
+// Turns the ranges and the bank of the filter into a bit per PC
+static void trace_writer_compile(TRACE_WRITER *writer)
+{
+    const TRACE_FILTER *filter = &writer->filter;
+
+    memset(writer->pcs, 0, sizeof(writer->pcs));
+
+    if (!filter->range_count)
+    {
+        trace_writer_allow(writer, 0, 0xffff);
+    }
+
+    for (unsigned int i = 0; i < filter->range_count; i++)
+    {
+        trace_writer_allow(writer, filter->range_starts[i], filter->range_ends[i]);
+    }
+
+    // The PRG bank of a PC is the one load_rom maps there: the first at $8000, the last at $C000
+    if (filter->bank >= 0)
+    {
+        int last_bank = writer->prg_size > 0x4000 ? (int)(writer->prg_size / 0x4000) - 1 : 0;
+
+        memset(writer->pcs, 0, 0x8000 / 8);
+
+        if (filter->bank != 0)
+        {
+            memset(writer->pcs + 0x8000 / 8, 0, 0x4000 / 8);
+        }
+
+        if (filter->bank != last_bank)
+        {
+            memset(writer->pcs + 0xc000 / 8, 0, 0x4000 / 8);
+        }
+    }
+
+    writer->frame_span = filter->last_frame - filter->first_frame;
+    writer->depth = 0;
+    writer->nmi_depth = 0;
+    trace_writer_update(writer);
+}
+
+// After the instructions that push or pull a return address. A return from further up than where the recording started stays at depth 0.
+void trace_writer_flow(TRACE_WRITER *writer, unsigned char opcode)
+{
+    switch (opcode)
+    {
+    case 0x00: // BRK
+    case 0x20: // JSR
+        writer->depth++;
+        break;
+    case 0x40: // RTI
+        writer->nmi_depth -= writer->nmi_depth != 0;
+        writer->depth -= writer->depth != 0;
+        break;
+    case 0x60: // RTS
+        writer->depth -= writer->depth != 0;
+        break;
+    }
+
+    trace_writer_update(writer);
+}
+
+void trace_writer_enter_nmi(TRACE_WRITER *writer)
+{
+    writer->depth++;
+    writer->nmi_depth++;
+    trace_writer_update(writer);
+}
+
+// The header is written at once and again with the index when closed. NULL when the file cannot be created.
+TRACE_WRITER *create_trace_writer(const char *filename, const TRACE_FILTER *filter, unsigned int prg_size)
+{
+    FILE *file = fopen(filename, "wb");
+
+    if (!file)
+    {
+        return NULL;
+    }
+
+    TRACE_WRITER *writer = malloc(sizeof(TRACE_WRITER));
+
+    memset(&writer->header, 0, sizeof(TRACE_HEADER));
+    memcpy(writer->header.magic, TRACE_MAGIC, sizeof(writer->header.magic));
+    writer->header.version = TRACE_VERSION;
+    writer->header.record_size = sizeof(TRACE_RECORD);
+    writer->header.block_records = TRACE_BLOCK_RECORDS;
+    writer->file = file;
+    writer->size = sizeof(TRACE_HEADER);
+    writer->count = 0;
+    writer->index = NULL;
+    writer->index_capacity = 0;
+    writer->error = fwrite(&writer->header, sizeof(TRACE_HEADER), 1, file) != 1;
+    writer->prg_size = prg_size;
+
+    if (filter)
+    {
+        writer->filter = *filter;
+    }
+    else
+    {
+        trace_filter_init(&writer->filter);
+    }
+
+    trace_writer_compile(writer);
+
+    return writer;
+}
+
+// Compresses and writes the records added since the last block
+void trace_writer_flush(TRACE_WRITER *writer)
+{
+    TRACE_HEADER *header = &writer->header;
+
+    if (!writer->count)
+    {
+        return;
+    }
+
+    if (header->block_count == writer->index_capacity)
+    {
+        writer->index_capacity = writer->index_capacity ? writer->index_capacity * 2 : 64;
+        writer->index = realloc(writer->index, writer->index_capacity * sizeof(TRACE_BLOCK_ENTRY));
+    }
+
+    TRACE_BLOCK_ENTRY *entry = &writer->index[header->block_count++];
+    unsigned int size = trace_encode_block(writer->records, writer->count, writer->encoded);
+
+    memset(entry, 0, sizeof(TRACE_BLOCK_ENTRY));
+    entry->offset = writer->size;
+    entry->size = size;
+    entry->record_count = writer->count;
+    entry->first_cycle = writer->records[0].cycle;
+    entry->first_frame = writer->records[0].frame;
+    entry->first_pc = writer->records[0].pc;
+
+    writer->error |= fwrite(writer->encoded, 1, size, writer->file) != size;
+    writer->size += size;
+    header->record_count += writer->count;
+    writer->count = 0;
+}
+
+// Returns -1 when something could not be written
+int close_trace_writer(TRACE_WRITER *writer)
+{
+    TRACE_HEADER *header = &writer->header;
+
+    trace_writer_flush(writer);
+
+    // The index is read in place from the mapping, it starts on a multiple of 8
+    static const unsigned char padding[8] = {0};
+    unsigned int padding_size = -writer->size & 7;
+
+    writer->error |= fwrite(padding, 1, padding_size, writer->file) != padding_size;
+    writer->size += padding_size;
+    header->index_offset = writer->size;
+    writer->error |= fwrite(writer->index, sizeof(TRACE_BLOCK_ENTRY), header->block_count, writer->file) != header->block_count;
+    writer->error |= fseek(writer->file, 0, SEEK_SET) != 0;
+    writer->error |= fwrite(header, sizeof(TRACE_HEADER), 1, writer->file) != 1;
+    writer->error |= fclose(writer->file) != 0;
+
+    int result = writer->error ? -1 : 0;
+
+    free(writer->index);
+    free(writer);
+
+    return result;
+}
+
+// Maps a closed trace, NULL when it cannot be read
+TRACE_READER *open_trace(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    struct stat status;
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if (fstat(fd, &status) < 0 || (unsigned long long)status.st_size < sizeof(TRACE_HEADER))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    // The mapping stays once the descriptor is closed
+    void *data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    const TRACE_HEADER *header = data;
+    unsigned long long size = status.st_size;
+
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) || header->version != TRACE_VERSION ||
+        header->record_size != sizeof(TRACE_RECORD) || header->block_records != TRACE_BLOCK_RECORDS ||
+        !header->index_offset || header->index_offset > size ||
+        (size - header->index_offset) / sizeof(TRACE_BLOCK_ENTRY) < header->block_count)
+    {
+        munmap(data, size);
+        return NULL;
+    }
+
+    const TRACE_BLOCK_ENTRY *index = (const TRACE_BLOCK_ENTRY *)((const unsigned char *)data + header->index_offset);
+    unsigned long long *first_records = malloc((header->block_count + 1) * sizeof(unsigned long long));
+
+    // Blocks are full but for the last one, unless the recording flushed on its way
+    first_records[0] = 0;
+
+    for (unsigned int i = 0; i < header->block_count; i++)
+    {
+        first_records[i + 1] = first_records[i] + (index[i].record_count <= TRACE_BLOCK_RECORDS ? index[i].record_count : 0);
+    }
+
+    if (first_records[header->block_count] != header->record_count)
+    {
+        free(first_records);
+        munmap(data, size);
+        return NULL;
+    }
+
+    TRACE_READER *reader = malloc(sizeof(TRACE_READER));
+
+    reader->data = data;
+    reader->size = size;
+    reader->header = header;
+    reader->index = index;
+    reader->first_records = first_records;
+    reader->block = -1;
+
+    return reader;
+}
+
+void close_trace(TRACE_READER *reader)
+{
+    munmap((void *)reader->data, reader->size);
+    free(reader->first_records);
+    free(reader);
+}
+
+// Block holding the record at an index below the record count, looked up when it is not the decoded one
+unsigned int trace_block_of(const TRACE_READER *reader, unsigned long long index)
+{
+    const unsigned long long *first_records = reader->first_records;
+
+    if (reader->block >= 0 && index >= first_records[reader->block] && index < first_records[reader->block + 1])
+    {
+        return reader->block;
+    }
+
+    unsigned int low = 0;
+    unsigned int high = reader->header->block_count - 1;
+
+    // The last block starting at the index or before it
+    while (low < high)
+    {
+        unsigned int middle = (low + high + 1) / 2;
+
+        if (first_records[middle] <= index)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    return low;
+}
+
+// The record at an index from 0, NULL past the end or in a damaged block. Valid until the next call.
+const TRACE_RECORD *trace_record(TRACE_READER *reader, unsigned long long index)
+{
+    if (index >= reader->header->record_count)
+    {
+        return NULL;
+    }
+
+    unsigned int block = trace_block_of(reader, index);
+
+    if ((long long)block != reader->block)
+    {
+        const TRACE_BLOCK_ENTRY *entry = &reader->index[block];
+
+        reader->block = -1;
+
+        if (entry->offset > reader->size || entry->size > reader->size - entry->offset ||
+            trace_decode_block(reader->data + entry->offset, entry->size, reader->records, entry->record_count) < 0)
+        {
+            return NULL;
+        }
+
+        reader->block = block;
+    }
+
+    return &reader->records[index - reader->first_records[block]];
+}
+
+/*
+ * Writes the record as a nestest-style line, like the one the NES prints while tracing, with
+ * the cycle at the end. Returns the length the whole line needs, like snprintf.
+ */
+unsigned int trace_record_to_str(const TRACE_RECORD *record, char *str, unsigned int size)
+{
+    const OPCODE_INFO *info = &OPCODES[record->bytes[0]];
+    const char *mnemonic = info->mnemonic ? MNEMONIC_NAMES[info->mnemonic] : "???";
+    unsigned char operand = record->bytes[1];
+    unsigned short address = record->address;
+    unsigned char value = record->value;
+    char instruction[64];
+    int length;
+
+    switch (info->length)
+    {
+    case 3:
+        length = snprintf(instruction, sizeof(instruction), "%04X  %02X %02X %02X  ", record->pc, record->bytes[0], operand, record->bytes[2]);
+        break;
+    case 2:
+        length = snprintf(instruction, sizeof(instruction), "%04X  %02X %02X     ", record->pc, record->bytes[0], operand);
+        break;
+    default:
+        length = snprintf(instruction, sizeof(instruction), "%04X  %02X        ", record->pc, record->bytes[0]);
+        break;
+    }
+
+    char *text = instruction + length;
+    size_t left = sizeof(instruction) - length;
+
+    switch (info->mode)
+    {
+    case ACCUMULATOR:
+        snprintf(text, left, "%s A", mnemonic);
+        break;
+    case IMMEDIATE:
+        snprintf(text, left, "%s #$%02X", mnemonic, operand);
+        break;
+    case ZERO_PAGE:
+        snprintf(text, left, "%s $%02X = %02X", mnemonic, operand, value);
+        break;
+    case ZERO_PAGE_X:
+        snprintf(text, left, "%s $%02X,X @ %02X = %02X", mnemonic, operand, address, value);
+        break;
+    case ZERO_PAGE_Y:
+        snprintf(text, left, "%s $%02X,Y @ %02X = %02X", mnemonic, operand, address, value);
+        break;
+    case RELATIVE:
+        snprintf(text, left, "%s $%04X", mnemonic, address);
+        break;
+    case ABSOLUTE:
+        snprintf(text, left, info->access & (ACCESS_JUMP | ACCESS_CALL) ? "%s $%04X" : "%s $%04X = %02X", mnemonic, address, value);
+        break;
+    case ABSOLUTE_X:
+        snprintf(text, left, "%s $%02X%02X,X @ %04X = %02X", mnemonic, record->bytes[2], operand, address, value);
+        break;
+    case ABSOLUTE_Y:
+        snprintf(text, left, "%s $%02X%02X,Y @ %04X = %02X", mnemonic, record->bytes[2], operand, address, value);
+        break;
+    case INDIRECT:
+        snprintf(text, left, "%s ($%02X%02X) = %04X", mnemonic, record->bytes[2], operand, address);
+        break;
+    case INDEXED_INDIRECT:
+        snprintf(text, left, "%s ($%02X,X) @ %02X = %04X = %02X", mnemonic, operand, (operand + record->x) & 0xff, address, value);
+        break;
+    case INDIRECT_INDEXED:
+        snprintf(text, left, "%s ($%02X),Y = %04X @ %04X = %02X", mnemonic, operand, (address - record->y) & 0xffff, address, value);
+        break;
+    default:
+        snprintf(text, left, "%s", mnemonic);
+        break;
+    }
+
+    return snprintf(str, size, "%-48sA:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu", instruction, record->a, record->x,
+                    record->y, record->p, record->sp, record->cycle);
+}
+
+// Index of the first record of the frame or of a later one, the record count when the trace ends before
+unsigned long long trace_find_frame(TRACE_READER *reader, unsigned long frame)
+{
+    const TRACE_HEADER *header = reader->header;
+    unsigned int low = 0;
+    unsigned int high = header->block_count;
+
+    // The first block starting at the frame or later, the frame can start in the one before it
+    while (low < high)
+    {
+        unsigned int middle = (low + high) / 2;
+
+        if (reader->index[middle].first_frame < frame)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    unsigned long long index = reader->first_records[low ? low - 1 : 0];
+    unsigned long long end = reader->first_records[low];
+
+    for (; index < end; index++)
+    {
+        const TRACE_RECORD *record = trace_record(reader, index);
+
+        if (record && record->frame >= frame)
+        {
+            return index;
+        }
+    }
+
+    return end;
+}
+
+/*
+ * Reads terms separated by spaces, like "pc=8000 a=3F address=0200", the values in hex. The
+ * fields are pc, a, x, y, p, sp and address. Returns -1 on error, the query is then left as it was.
+ */
+int trace_query_parse(TRACE_QUERY *query, const char *text)
+{
+    static const char *const names[TRACE_FIELDS] = {"pc=", "a=", "x=", "y=", "p=", "sp=", "address="};
+    TRACE_QUERY parsed = {0};
+
+    while (*text)
+    {
+        if (isspace((unsigned char)*text))
+        {
+            text++;
+            continue;
+        }
+
+        int field = 0;
+
+        while (field < TRACE_FIELDS && strncmp(text, names[field], strlen(names[field])))
+        {
+            field++;
+        }
+
+        if (field == TRACE_FIELDS)
+        {
+            return -1;
+        }
+
+        char *end;
+
+        text += strlen(names[field]);
+        text += *text == '$';
+        unsigned long value = strtoul(text, &end, 16);
+
+        if (end == text || value > (field == TRACE_FIELD_PC || field == TRACE_FIELD_ADDRESS ? 0xffff : 0xff) ||
+            (*end && !isspace((unsigned char)*end)))
+        {
+            return -1;
+        }
+
+        parsed.fields |= 1 << field;
+        parsed.values[field] = value;
+        text = end;
+    }
+
+    *query = parsed;
+
+    return 0;
+}
+
+int trace_query_matches(const TRACE_QUERY *query, const TRACE_RECORD *record)
+{
+    const unsigned short fields[TRACE_FIELDS] = {record->pc, record->a, record->x, record->y, record->p, record->sp, record->address};
+
+    if ((query->fields & (1 << TRACE_FIELD_ADDRESS)) && !(record->flags & TRACE_RECORD_ADDRESS))
+    {
+        return 0;
+    }
+
+    for (int field = 0; field < TRACE_FIELDS; field++)
+    {
+        if ((query->fields & (1 << field)) && fields[field] != query->values[field])
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Index of the first record from from up to before to that the query matches, -1 when none does. Damaged blocks are skipped.
+long long trace_search(TRACE_READER *reader, const TRACE_QUERY *query, unsigned long long from, unsigned long long to)
+{
+    unsigned long long index = from;
+
+    to = to < reader->header->record_count ? to : reader->header->record_count;
+
+    while (index < to)
+    {
+        const TRACE_RECORD *record = trace_record(reader, index);
+        unsigned long long block_end = reader->first_records[trace_block_of(reader, index) + 1];
+        unsigned long long end = block_end < to ? block_end : to;
+
+        // The rest of the block is decoded next to the record
+        for (; record && index < end; index++, record++)
+        {
+            if (trace_query_matches(query, record))
+            {
+                return index;
+            }
+        }
+
+        index = end;
+    }
+
+    return -1;
+}
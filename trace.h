@@ -0,0 +1,197 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdio.h>
+#include <string.h>
+
+#define TRACE_MAGIC "NESTRACE"
+#define TRACE_VERSION 1
+#define TRACE_BLOCK_RECORDS 4096 // records compressed together, each block is decoded on its own
+#define TRACE_ENCODED_SIZE 30    // at most per record: a mask of up to 4 bytes and the 26 bytes it covers
+#define TRACE_PREDICTIONS 1024   // instructions remembered by PC while a block is encoded
+
+#define TRACE_RECORD_ADDRESS 0x01 // the instruction uses the memory at address
+
+#define TRACE_FILTER_RANGES 8
+#define TRACE_CONTEXT_MAIN 0x01
+#define TRACE_CONTEXT_NMI 0x02
+#define TRACE_CONTEXT_ALL (TRACE_CONTEXT_MAIN | TRACE_CONTEXT_NMI)
+
+enum TRACE_FIELD
+{
+    TRACE_FIELD_PC,
+    TRACE_FIELD_A,
+    TRACE_FIELD_X,
+    TRACE_FIELD_Y,
+    TRACE_FIELD_P,
+    TRACE_FIELD_SP,
+    TRACE_FIELD_ADDRESS, // effective address, never matches the instructions without one
+    TRACE_FIELDS
+};
+
+// State of the CPU before an instruction, 32 bytes with nothing left to the padding of the compiler
+typedef struct
+{
+    unsigned long long cycle; // CPU cycle the instruction starts at
+    unsigned int frame;       // PPU frame number
+    unsigned short pc;
+    unsigned short address; // effective address, the target for a JMP through a pointer
+    unsigned char bytes[3]; // opcode and operands, 0 past the length of the instruction
+    unsigned char a;
+    unsigned char x;
+    unsigned char y;
+    unsigned char p;
+    unsigned char sp;
+    unsigned char value; // at address before the instruction
+    unsigned char flags; // TRACE_RECORD_
+    unsigned char reserved[6];
+} TRACE_RECORD;
+
+/*
+ * A trace file is this header, the compressed blocks, then their index. Everything is written in
+ * the byte order of the host. The header is rewritten when the trace is closed, a trace whose
+ * index_offset is still 0 was not closed and cannot be read.
+ */
+typedef struct
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int record_size;
+    unsigned int block_records;
+    unsigned int block_count;
+    unsigned long long record_count;
+    unsigned long long index_offset;
+} TRACE_HEADER;
+
+typedef struct
+{
+    unsigned long long offset; // of the compressed block in the file
+    unsigned long long first_cycle;
+    unsigned int size;
+    unsigned int record_count;
+    unsigned int first_frame;
+    unsigned short first_pc;
+    unsigned short reserved;
+} TRACE_BLOCK_ENTRY;
+
+// What the last instruction at a PC was and where it went, most instructions run again as they ran before
+typedef struct
+{
+    unsigned char bytes[3];
+    unsigned char seen;     // next and cycles are known
+    unsigned short address;
+    unsigned short next;    // PC of the instruction that came after
+    unsigned int cycles;    // it started after
+} TRACE_PREDICTION;
+
+/*
+ * Which instructions a recording keeps. The depth counts the return addresses pushed since the
+ * recording started, by JSR and by the NMI, less those pulled by RTS and RTI.
+ */
+typedef struct
+{
+    unsigned short range_starts[TRACE_FILTER_RANGES]; // PCs, the ends are included
+    unsigned short range_ends[TRACE_FILTER_RANGES];
+    unsigned int range_count; // 0 for every PC
+    int bank;                 // 16 KB PRG bank the PC runs from, -1 for any
+    unsigned int min_depth;
+    unsigned int max_depth;
+    unsigned char contexts; // TRACE_CONTEXT_
+    unsigned long first_frame;
+    unsigned long last_frame;
+} TRACE_FILTER;
+
+/*
+ * Records go to a block buffer that is compressed and written once full, so that adding one
+ * is a copy. Each record is encoded against what the previous one and the last one at the same
+ * PC predict, then only the bytes that differ are kept with a mask telling which ones they are.
+ */
+typedef struct
+{
+    FILE *file;
+    unsigned long long size; // written so far
+    TRACE_HEADER header;
+    TRACE_RECORD records[TRACE_BLOCK_RECORDS];
+    unsigned int count;
+    unsigned char encoded[TRACE_BLOCK_RECORDS * TRACE_ENCODED_SIZE];
+    TRACE_BLOCK_ENTRY *index;
+    unsigned int index_capacity;
+    int error;
+    TRACE_FILTER filter;
+    unsigned int prg_size;          // of the ROM recorded, tells the PRG bank of the PCs at $C000
+    unsigned char pcs[0x10000 / 8]; // bit set for the PCs the ranges and the bank let through
+    unsigned long frame_span;       // last_frame - first_frame
+    unsigned int depth;
+    unsigned int nmi_depth; // NMI handlers entered and not returned from
+    unsigned char open;     // depth and context are in the filter, updated only when they change
+} TRACE_WRITER;
+
+// Records whose fields all have the values asked for
+typedef struct
+{
+    unsigned char fields; // bit set for each TRACE_FIELD compared
+    unsigned short values[TRACE_FIELDS];
+} TRACE_QUERY;
+
+// A closed trace file mapped in memory, its blocks decoded one at a time when a record is asked for
+typedef struct
+{
+    const unsigned char *data;
+    unsigned long long size;
+    const TRACE_HEADER *header;
+    const TRACE_BLOCK_ENTRY *index;
+    unsigned long long *first_records; // of each block, then the record count. A flush can write a short block anywhere.
+    TRACE_RECORD records[TRACE_BLOCK_RECORDS];
+    long long block; // decoded in records, -1 when none is
+} TRACE_READER;
+
+void trace_filter_init(TRACE_FILTER *filter);
+int trace_filter_parse(TRACE_FILTER *filter, const char *text);
+int trace_filter_to_str(const TRACE_FILTER *filter, char *str, unsigned int size);
+
+TRACE_WRITER *create_trace_writer(const char *filename, const TRACE_FILTER *filter, unsigned int prg_size);
+void trace_writer_flush(TRACE_WRITER *writer);
+int close_trace_writer(TRACE_WRITER *writer);
+void trace_writer_flow(TRACE_WRITER *writer, unsigned char opcode);
+void trace_writer_enter_nmi(TRACE_WRITER *writer);
+
+// Follows the depth through every instruction run, recorded or not. Only BRK, JSR, RTI and RTS have bits 0-4 and 7 clear.
+static inline void trace_writer_follow(TRACE_WRITER *writer, unsigned char opcode)
+{
+    if (!(opcode & 0x9f))
+    {
+        trace_writer_flow(writer, opcode);
+    }
+}
+
+// Three tests, the depth and the context are only looked at when they change
+static inline int trace_writer_accepts(const TRACE_WRITER *writer, unsigned short pc, unsigned long frame)
+{
+    return writer->open && ((writer->pcs[pc >> 3] >> (pc & 7)) & 1) && frame - writer->filter.first_frame <= writer->frame_span;
+}
+
+static inline void trace_write(TRACE_WRITER *writer, const TRACE_RECORD *record)
+{
+    memcpy(&writer->records[writer->count], record, sizeof(TRACE_RECORD));
+
+    if (++writer->count == TRACE_BLOCK_RECORDS)
+    {
+        trace_writer_flush(writer);
+    }
+}
+
+unsigned int trace_encode_block(const TRACE_RECORD *records, unsigned int count, unsigned char *out);
+int trace_decode_block(const unsigned char *data, unsigned int size, TRACE_RECORD *records, unsigned int count);
+
+TRACE_READER *open_trace(const char *filename);
+void close_trace(TRACE_READER *reader);
+unsigned int trace_block_of(const TRACE_READER *reader, unsigned long long index);
+const TRACE_RECORD *trace_record(TRACE_READER *reader, unsigned long long index);
+unsigned int trace_record_to_str(const TRACE_RECORD *record, char *str, unsigned int size);
+unsigned long long trace_find_frame(TRACE_READER *reader, unsigned long frame);
+
+int trace_query_parse(TRACE_QUERY *query, const char *text);
+int trace_query_matches(const TRACE_QUERY *query, const TRACE_RECORD *record);
+long long trace_search(TRACE_READER *reader, const TRACE_QUERY *query, unsigned long long from, unsigned long long to);
+
+#endif
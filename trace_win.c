@@ -0,0 +1,557 @@
+#include <gtk/gtk.h>
+#include <stdlib.h>
+
+#include "trace_win.h"
+#include "trace.h"
+
+#define ROW_CACHE_SIZE 128                      // rows with a cached layout, more than a window ever shows
+#define SEARCH_CHUNK (TRACE_BLOCK_RECORDS * 16) // records searched between two looks at the cancel flag
+#define SEARCH_BATCH_SIZE 256                   // matches sent to the window together
+#define SEARCH_RESULTS_MAX 100000               // listed before a search gives up
+#define SEARCH_POLL_INTERVAL 100                // ms between two looks at the matches found
+
+enum
+{
+    RESULT_COLUMN_ROW,
+    RESULT_COLUMN_TEXT
+};
+
+typedef struct
+{
+    long long row; // -1 when the layout does not hold any row
+    PangoLayout *layout;
+} ROW_LAYOUT;
+
+// Matches found since the last batch and how far the search went
+typedef struct
+{
+    unsigned long long searched; // records looked at since the search started
+    unsigned int count;
+    gboolean done;
+    unsigned long long rows[SEARCH_BATCH_SIZE];
+    char lines[SEARCH_BATCH_SIZE][112];
+} SEARCH_BATCH;
+
+// A search on its own thread, with its own mapping of the trace since a reader decodes one block at a time
+typedef struct
+{
+    TRACE_READER *reader;
+    TRACE_QUERY query;
+    unsigned long long from;
+    gint cancelled;
+    GAsyncQueue *batches; // SEARCH_BATCH, the last one is done
+    GThread *thread;
+} TRACE_SEARCH;
+
+struct _TraceWindow
+{
+    GtkWindow parent;
+    GtkEntry *frame_entry;
+    GtkEntry *pc_entry;
+    GtkEntry *search_entry;
+    GtkLabel *search_label;
+    GtkDrawingArea *trace_area;
+    GtkScrollbar *trace_scrollbar;
+    GtkTreeView *result_tree_view;
+    char *filename;
+    TRACE_READER *reader;
+    ROW_LAYOUT layouts[ROW_CACHE_SIZE]; // indexed by row modulo the cache size
+    PangoFontDescription *font;
+    int char_width;
+    int line_height;
+    long long selected;    // row highlighted, -1 when none is
+    GtkListStore *results; // row and text of the matches of the last search
+    TRACE_SEARCH *search;  // NULL when none is running
+    unsigned int result_count;
+    gboolean jump;     // the first match of the search is selected
+    guint search_poll; // source listing the matches, 0 when no search is running
+};
+
+G_DEFINE_TYPE(TraceWindow, trace_window, GTK_TYPE_WINDOW);
+
+static void trace_window_init(TraceWindow *window)
+{
+    gtk_widget_init_template(GTK_WIDGET(window));
+
+    for (int i = 0; i < ROW_CACHE_SIZE; i++)
+    {
+        window->layouts[i].row = -1;
+        window->layouts[i].layout = NULL;
+    }
+}
+
+static void trace_window_class_init(TraceWindowClass *class)
+{
+    gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), "/org/c4z/debuggerapp/trace_window.xml");
+
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), TraceWindow, frame_entry);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), TraceWindow, pc_entry);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), TraceWindow, search_entry);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), TraceWindow, search_label);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), TraceWindow, trace_area);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), TraceWindow, trace_scrollbar);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), TraceWindow, result_tree_view);
+}
+
+static GtkAdjustment *trace_window_adjustment(TraceWindow *window)
+{
+    return gtk_range_get_adjustment(GTK_RANGE(window->trace_scrollbar));
+}
+
+static unsigned long long trace_window_row_count(TraceWindow *window)
+{
+    return window->reader->header->record_count;
+}
+
+// Looks for the matches from the first row on, the lines are written here where their block is decoded
+static gpointer trace_search_main(gpointer data)
+{
+    TRACE_SEARCH *search = data;
+    unsigned long long count = search->reader->header->record_count;
+    unsigned long long row = search->from;
+    unsigned int found = 0;
+
+    while (row < count && found < SEARCH_RESULTS_MAX && !g_atomic_int_get(&search->cancelled))
+    {
+        unsigned long long end = MIN(row + SEARCH_CHUNK, count);
+        SEARCH_BATCH *batch = g_malloc(sizeof(SEARCH_BATCH));
+        long long match;
+
+        batch->count = 0;
+        batch->done = FALSE;
+
+        while (batch->count < SEARCH_BATCH_SIZE && found < SEARCH_RESULTS_MAX &&
+               (match = trace_search(search->reader, &search->query, row, end)) >= 0)
+        {
+            trace_record_to_str(trace_record(search->reader, match), batch->lines[batch->count], sizeof(batch->lines[0]));
+            batch->rows[batch->count++] = match;
+            found++;
+            row = match + 1;
+        }
+
+        // A full batch leaves the rest of the chunk to the next one
+        if (batch->count < SEARCH_BATCH_SIZE)
+        {
+            row = end;
+        }
+
+        batch->searched = row - search->from;
+        g_async_queue_push(search->batches, batch);
+    }
+
+    SEARCH_BATCH *last = g_malloc(sizeof(SEARCH_BATCH));
+
+    last->searched = row - search->from;
+    last->count = 0;
+    last->done = TRUE;
+    g_async_queue_push(search->batches, last);
+
+    return NULL;
+}
+
+static void free_trace_search(TRACE_SEARCH *search)
+{
+    g_thread_join(search->thread);
+    g_async_queue_unref(search->batches);
+    close_trace(search->reader);
+    g_free(search);
+}
+
+static void trace_window_stop_search(TraceWindow *window)
+{
+    if (!window->search)
+    {
+        return;
+    }
+
+    g_atomic_int_set(&window->search->cancelled, 1);
+    g_source_remove(window->search_poll);
+    free_trace_search(window->search);
+
+    window->search = NULL;
+    window->search_poll = 0;
+}
+
+// Rows are only decoded and laid out when they are scrolled into view
+static PangoLayout *trace_window_row_layout(TraceWindow *window, unsigned long long row)
+{
+    ROW_LAYOUT *entry = &window->layouts[row % ROW_CACHE_SIZE];
+
+    if (entry->row == (long long)row)
+    {
+        return entry->layout;
+    }
+
+    if (!entry->layout)
+    {
+        entry->layout = gtk_widget_create_pango_layout(GTK_WIDGET(window->trace_area), NULL);
+        pango_layout_set_font_description(entry->layout, window->font);
+    }
+
+    const TRACE_RECORD *record = trace_record(window->reader, row);
+    char line[112];
+    char text[136];
+
+    if (record)
+    {
+        trace_record_to_str(record, line, sizeof(line));
+        g_snprintf(text, sizeof(text), "%10llu %7u  %s", row, record->frame, line);
+    }
+    else
+    {
+        g_snprintf(text, sizeof(text), "%10llu  (damaged block)", row);
+    }
+
+    pango_layout_set_text(entry->layout, text, -1);
+    entry->row = row;
+
+    return entry->layout;
+}
+
+static gboolean draw_trace(GtkWidget *widget, cairo_t *cr, TraceWindow *window)
+{
+    guint width = gtk_widget_get_allocated_width(widget);
+    guint height = gtk_widget_get_allocated_height(widget);
+    unsigned long long row_count = trace_window_row_count(window);
+
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_rectangle(cr, 0, 0, width, height);
+    cairo_fill(cr);
+
+    unsigned long long row = gtk_adjustment_get_value(trace_window_adjustment(window));
+
+    for (int y = 0; y < (int)height && row < row_count; y += window->line_height, row++)
+    {
+        if ((long long)row == window->selected)
+        {
+            cairo_set_source_rgb(cr, 1, 0.85, 0.4);
+            cairo_rectangle(cr, 0, y, width, window->line_height);
+            cairo_fill(cr);
+        }
+
+        cairo_set_source_rgb(cr, 0, 0, 0);
+        cairo_move_to(cr, window->char_width, y);
+        pango_cairo_show_layout(cr, trace_window_row_layout(window, row));
+    }
+
+    return FALSE;
+}
+
+// Selects the row and scrolls so that it is on screen, a third of the way down when it was not
+static void trace_window_show_row(TraceWindow *window, unsigned long long row)
+{
+    GtkAdjustment *adjustment = trace_window_adjustment(window);
+    double first_row = gtk_adjustment_get_value(adjustment);
+    double page = gtk_adjustment_get_page_size(adjustment);
+
+    if (row < first_row || row >= first_row + page)
+    {
+        gtk_adjustment_set_value(adjustment, MAX((double)row - (int)(page / 3), 0));
+    }
+
+    window->selected = row;
+    gtk_widget_queue_draw(GTK_WIDGET(window->trace_area));
+}
+
+static void trace_window_show_progress(TraceWindow *window, unsigned long long searched, gboolean done)
+{
+    unsigned long long total = trace_window_row_count(window) - window->search->from;
+    gchar *text;
+
+    if (!done)
+    {
+        text = g_strdup_printf("Searching... %u%%, %u found", (unsigned int)(total ? searched * 100 / total : 100),
+                               window->result_count);
+    }
+    else if (window->result_count >= SEARCH_RESULTS_MAX)
+    {
+        text = g_strdup_printf("First %u found", window->result_count);
+    }
+    else
+    {
+        text = window->result_count ? g_strdup_printf("%u found", window->result_count) : g_strdup("Not found");
+    }
+
+    gtk_label_set_text(window->search_label, text);
+    g_free(text);
+}
+
+// Lists the matches the search thread sent since the last time, until it is done
+static gboolean trace_window_poll_search(gpointer data)
+{
+    TraceWindow *window = data;
+    SEARCH_BATCH *batch;
+    unsigned long long searched = 0;
+    gboolean done = FALSE;
+
+    while (!done && (batch = g_async_queue_try_pop(window->search->batches)))
+    {
+        for (unsigned int i = 0; i < batch->count; i++)
+        {
+            GtkTreeIter iter;
+
+            gtk_list_store_append(window->results, &iter);
+            gtk_list_store_set(window->results, &iter, RESULT_COLUMN_ROW, (guint64)batch->rows[i], RESULT_COLUMN_TEXT, batch->lines[i], -1);
+            window->result_count++;
+        }
+
+        if (batch->count && window->jump)
+        {
+            window->jump = FALSE;
+            trace_window_show_row(window, batch->rows[0]);
+        }
+
+        searched = batch->searched;
+        done = batch->done;
+        g_free(batch);
+    }
+
+    if (searched || done)
+    {
+        trace_window_show_progress(window, searched, done);
+    }
+
+    if (!done)
+    {
+        return G_SOURCE_CONTINUE;
+    }
+
+    free_trace_search(window->search);
+    window->search = NULL;
+    window->search_poll = 0;
+
+    return G_SOURCE_REMOVE;
+}
+
+// Replaces the matches listed by those of the query from the row on
+static void trace_window_start_search(TraceWindow *window, const TRACE_QUERY *query, unsigned long long from, gboolean jump)
+{
+    TRACE_READER *reader = open_trace(window->filename);
+
+    trace_window_stop_search(window);
+    gtk_list_store_clear(window->results);
+    window->result_count = 0;
+
+    if (!reader)
+    {
+        gtk_label_set_text(window->search_label, "Cannot read the trace");
+        return;
+    }
+
+    TRACE_SEARCH *search = g_malloc(sizeof(TRACE_SEARCH));
+
+    search->reader = reader;
+    search->query = *query;
+    search->from = from;
+    search->cancelled = 0;
+    search->batches = g_async_queue_new_full(g_free);
+
+    window->search = search;
+    window->jump = jump;
+    trace_window_show_progress(window, 0, FALSE);
+
+    search->thread = g_thread_new("trace search", trace_search_main, search);
+    window->search_poll = g_timeout_add(SEARCH_POLL_INTERVAL, trace_window_poll_search, window);
+}
+
+static void trace_frame_changed(GtkEntry *entry, TraceWindow *window)
+{
+    const char *text = gtk_entry_get_text(entry);
+    char *end;
+    unsigned long frame = strtoul(text, &end, 10);
+    unsigned long long row = end != text && !*end ? trace_find_frame(window->reader, frame) : trace_window_row_count(window);
+
+    gtk_entry_set_icon_from_icon_name(entry, GTK_ENTRY_ICON_SECONDARY, row < trace_window_row_count(window) ? NULL : "dialog-error");
+
+    if (row < trace_window_row_count(window))
+    {
+        trace_window_show_row(window, row);
+    }
+}
+
+// The next instruction at the address is searched like any other, the view goes there once it is found
+static void trace_pc_changed(GtkEntry *entry, TraceWindow *window)
+{
+    const char *text = gtk_entry_get_text(entry);
+    char *end;
+    unsigned long pc = strtoul(text + (*text == '$'), &end, 16);
+    TRACE_QUERY query = {0};
+
+    if (end == text + (*text == '$') || *end || pc > 0xffff)
+    {
+        gtk_entry_set_icon_from_icon_name(entry, GTK_ENTRY_ICON_SECONDARY, "dialog-error");
+        return;
+    }
+
+    gtk_entry_set_icon_from_icon_name(entry, GTK_ENTRY_ICON_SECONDARY, NULL);
+
+    query.fields = 1 << TRACE_FIELD_PC;
+    query.values[TRACE_FIELD_PC] = pc;
+
+    unsigned long long from = window->selected >= 0 ? window->selected + 1 : gtk_adjustment_get_value(trace_window_adjustment(window));
+
+    trace_window_start_search(window, &query, from, TRUE);
+}
+
+static void trace_search_changed(GtkEntry *entry, TraceWindow *window)
+{
+    TRACE_QUERY query;
+
+    if (trace_query_parse(&query, gtk_entry_get_text(entry)) < 0 || !query.fields)
+    {
+        gtk_entry_set_icon_from_icon_name(entry, GTK_ENTRY_ICON_SECONDARY, "dialog-error");
+        return;
+    }
+
+    gtk_entry_set_icon_from_icon_name(entry, GTK_ENTRY_ICON_SECONDARY, NULL);
+    trace_window_start_search(window, &query, 0, FALSE);
+}
+
+static void trace_result_selected(GtkTreeSelection *selection, TraceWindow *window)
+{
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    guint64 row;
+
+    if (gtk_tree_selection_get_selected(selection, &model, &iter))
+    {
+        gtk_tree_model_get(model, &iter, RESULT_COLUMN_ROW, &row, -1);
+        trace_window_show_row(window, row);
+    }
+}
+
+static void trace_area_size_allocate(GtkWidget *widget, GdkRectangle *allocation, TraceWindow *window)
+{
+    GtkAdjustment *adjustment = trace_window_adjustment(window);
+    int page = allocation->height / window->line_height;
+
+    gtk_adjustment_configure(adjustment, gtk_adjustment_get_value(adjustment), 0, trace_window_row_count(window), 1, page, page);
+}
+
+static void trace_window_scrolled(GtkAdjustment *adjustment, TraceWindow *window)
+{
+    gtk_widget_queue_draw(GTK_WIDGET(window->trace_area));
+}
+
+static gboolean trace_area_scroll(GtkWidget *widget, GdkEventScroll *event, TraceWindow *window)
+{
+    GtkAdjustment *adjustment = trace_window_adjustment(window);
+    double delta = 0;
+
+    switch (event->direction)
+    {
+    case GDK_SCROLL_UP:
+        delta = -3;
+        break;
+    case GDK_SCROLL_DOWN:
+        delta = 3;
+        break;
+    case GDK_SCROLL_SMOOTH:
+        delta = event->delta_y * 3;
+        break;
+    default:
+        break;
+    }
+
+    gtk_adjustment_set_value(adjustment, gtk_adjustment_get_value(adjustment) + delta);
+
+    return TRUE;
+}
+
+// The PC search starts after the row clicked
+static gboolean trace_area_button_press(GtkWidget *widget, GdkEventButton *event, TraceWindow *window)
+{
+    unsigned long long row = gtk_adjustment_get_value(trace_window_adjustment(window)) + (int)event->y / window->line_height;
+
+    if (row < trace_window_row_count(window))
+    {
+        window->selected = row;
+        gtk_widget_queue_draw(widget);
+    }
+
+    return TRUE;
+}
+
+static void close_trace_window(GtkWindow *win, gpointer data)
+{
+    TraceWindow *window = TRACE_WINDOW(win);
+
+    trace_window_stop_search(window);
+
+    for (int i = 0; i < ROW_CACHE_SIZE; i++)
+    {
+        g_clear_object(&window->layouts[i].layout);
+    }
+
+    g_clear_pointer(&window->font, pango_font_description_free);
+    g_clear_pointer(&window->reader, close_trace);
+    g_clear_pointer(&window->filename, g_free);
+}
+
+/*
+ * Opens a trace written by a recording, NULL when it is not a complete one. Only the header and
+ * the index are read here, the blocks are decoded when their rows are shown or searched.
+ */
+TraceWindow *trace_window_new(const char *filename)
+{
+    TRACE_READER *reader = open_trace(filename);
+
+    if (!reader)
+    {
+        return NULL;
+    }
+
+    TraceWindow *window = g_object_new(TRACE_WINDOW_TYPE, NULL);
+    GtkWidget *area = GTK_WIDGET(window->trace_area);
+
+    window->filename = g_strdup(filename);
+    window->reader = reader;
+    window->selected = -1;
+    window->search = NULL;
+    window->result_count = 0;
+    window->jump = FALSE;
+    window->search_poll = 0;
+
+    gchar *basename = g_path_get_basename(filename);
+    gchar *title = g_strdup_printf("Trace - %s, %llu instructions", basename, trace_window_row_count(window));
+    gtk_window_set_title(GTK_WINDOW(window), title);
+    g_free(title);
+    g_free(basename);
+
+    window->font = pango_font_description_from_string("Monospace 10");
+    PangoLayout *layout = gtk_widget_create_pango_layout(area, "0");
+    pango_layout_set_font_description(layout, window->font);
+    pango_layout_get_pixel_size(layout, &window->char_width, &window->line_height);
+    g_object_unref(layout);
+
+    gtk_widget_set_size_request(area, 112 * window->char_width, 8 * window->line_height);
+    gtk_widget_add_events(area, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK | GDK_BUTTON_PRESS_MASK);
+
+    // The tree view keeps the only reference
+    window->results = gtk_list_store_new(2, G_TYPE_UINT64, G_TYPE_STRING);
+    gtk_tree_view_set_model(window->result_tree_view, GTK_TREE_MODEL(window->results));
+    g_object_unref(window->results);
+
+    GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+    GtkTreeViewColumn *column;
+    g_object_set(renderer, "family", "Monospace", NULL);
+    column = gtk_tree_view_column_new_with_attributes("Row", renderer, "text", RESULT_COLUMN_ROW, NULL);
+    gtk_tree_view_append_column(window->result_tree_view, column);
+    column = gtk_tree_view_column_new_with_attributes("Instruction", renderer, "text", RESULT_COLUMN_TEXT, NULL);
+    gtk_tree_view_append_column(window->result_tree_view, column);
+
+    g_signal_connect(window, "destroy", G_CALLBACK(close_trace_window), NULL);
+    g_signal_connect(window->frame_entry, "activate", G_CALLBACK(trace_frame_changed), window);
+    g_signal_connect(window->pc_entry, "activate", G_CALLBACK(trace_pc_changed), window);
+    g_signal_connect(window->search_entry, "activate", G_CALLBACK(trace_search_changed), window);
+    g_signal_connect(gtk_tree_view_get_selection(window->result_tree_view), "changed", G_CALLBACK(trace_result_selected), window);
+    g_signal_connect(area, "draw", G_CALLBACK(draw_trace), window);
+    g_signal_connect(area, "size-allocate", G_CALLBACK(trace_area_size_allocate), window);
+    g_signal_connect(area, "scroll-event", G_CALLBACK(trace_area_scroll), window);
+    g_signal_connect(area, "button-press-event", G_CALLBACK(trace_area_button_press), window);
+    g_signal_connect(trace_window_adjustment(window), "value-changed", G_CALLBACK(trace_window_scrolled), window);
+
+    gtk_adjustment_set_upper(trace_window_adjustment(window), trace_window_row_count(window));
+
+    return window;
+}
@@ -0,0 +1,11 @@
+#ifndef _TRACE_WIN_H_
+#define _TRACE_WIN_H_
+
+#include <gtk/gtk.h>
+
+#define TRACE_WINDOW_TYPE (trace_window_get_type())
+G_DECLARE_FINAL_TYPE(TraceWindow, trace_window, TRACE, WINDOW, GtkWindow);
+
+TraceWindow *trace_window_new(const char *filename);
+
+#endif
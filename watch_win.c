@@ -0,0 +1,140 @@
+#include <gtk/gtk.h>
+
+#include "watch_win.h"
+
+enum
+{
+    WATCH_COLUMN_SOURCE,
+    WATCH_COLUMN_VALUE,
+    WATCH_COLUMN_EXPRESSION
+};
+
+struct _WatchWindow
+{
+    GtkWindow parent;
+    GtkTreeView *watch_tree_view;
+    GtkEntry *expression_entry;
+    GtkButton *add_button;
+    GtkButton *remove_button;
+};
+
+G_DEFINE_TYPE(WatchWindow, watch_window, GTK_TYPE_WINDOW);
+
+static void watch_window_init(WatchWindow *window)
+{
+    gtk_widget_init_template(GTK_WIDGET(window));
+}
+
+static void watch_window_class_init(WatchWindowClass *class)
+{
+    gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), "/org/c4z/debuggerapp/watch_window.xml");
+
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), WatchWindow, watch_tree_view);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), WatchWindow, expression_entry);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), WatchWindow, add_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), WatchWindow, remove_button);
+}
+
+static void close_watch_window(GtkWindow *win, DebuggerApp *app)
+{
+    refresh_coordinator_unregister(app->refresh, win);
+    app->watch_window = NULL;
+}
+
+static void refresh_watch_window(gpointer view, gpointer data)
+{
+    update_watch_window(WATCH_WINDOW(view), data);
+}
+
+static void set_watch_value(GtkListStore *store, GtkTreeIter *iter, NES *nes)
+{
+    EXPRESSION *expression;
+    gtk_tree_model_get(GTK_TREE_MODEL(store), iter, WATCH_COLUMN_EXPRESSION, &expression, -1);
+
+    long value = nes_evaluate(nes, expression);
+    gchar *str = g_strdup_printf("$%02lX (%ld)", (unsigned long)value, value);
+    gtk_list_store_set(store, iter, WATCH_COLUMN_VALUE, str, -1);
+    g_free(str);
+}
+
+static void add_watch(GtkWidget *widget, DebuggerApp *app)
+{
+    WatchWindow *window = WATCH_WINDOW(app->watch_window);
+    EXPRESSION *expression = create_expression(gtk_entry_get_text(window->expression_entry));
+
+    if (!expression)
+    {
+        gtk_entry_set_icon_from_icon_name(window->expression_entry, GTK_ENTRY_ICON_SECONDARY, "dialog-error");
+        return;
+    }
+
+    gtk_entry_set_icon_from_icon_name(window->expression_entry, GTK_ENTRY_ICON_SECONDARY, NULL);
+    gtk_entry_set_text(window->expression_entry, "");
+
+    GtkTreeIter iter;
+    gtk_list_store_append(app->watches, &iter);
+    gtk_list_store_set(app->watches, &iter, WATCH_COLUMN_SOURCE, expression->source, WATCH_COLUMN_EXPRESSION, expression, -1);
+    set_watch_value(app->watches, &iter, app->nes);
+}
+
+static void remove_watch(GtkButton *button, DebuggerApp *app)
+{
+    WatchWindow *window = WATCH_WINDOW(app->watch_window);
+
+    GtkTreeIter iter;
+    GtkTreeModel *model;
+    GtkTreeSelection *selection = gtk_tree_view_get_selection(window->watch_tree_view);
+
+    if (gtk_tree_selection_get_selected(selection, &model, &iter))
+    {
+        EXPRESSION *expression;
+        gtk_tree_model_get(model, &iter, WATCH_COLUMN_EXPRESSION, &expression, -1);
+
+        gtk_list_store_remove(app->watches, &iter);
+        free_expression(expression);
+    }
+}
+
+WatchWindow *watch_window_new(DebuggerApp *app)
+{
+    WatchWindow *window = g_object_new(WATCH_WINDOW_TYPE, NULL);
+
+    g_signal_connect(window, "destroy", G_CALLBACK(close_watch_window), app);
+
+    gtk_tree_view_set_model(window->watch_tree_view, GTK_TREE_MODEL(app->watches));
+
+    GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+    GtkTreeViewColumn *column;
+    column = gtk_tree_view_column_new_with_attributes("Expression", renderer, "text", WATCH_COLUMN_SOURCE, NULL);
+    gtk_tree_view_column_set_expand(column, TRUE);
+    gtk_tree_view_append_column(window->watch_tree_view, column);
+    column = gtk_tree_view_column_new_with_attributes("Value", renderer, "text", WATCH_COLUMN_VALUE, NULL);
+    gtk_tree_view_append_column(window->watch_tree_view, column);
+
+    g_signal_connect(window->expression_entry, "activate", G_CALLBACK(add_watch), app);
+    g_signal_connect(window->add_button, "clicked", G_CALLBACK(add_watch), app);
+    g_signal_connect(window->remove_button, "clicked", G_CALLBACK(remove_watch), app);
+
+    // Expressions can read any part of the state
+    refresh_coordinator_register(app->refresh, window, STATE_ALL, refresh_watch_window);
+
+    return window;
+}
+
+// The expressions are compiled when added, a refresh only runs them
+void update_watch_window(WatchWindow *window, DebuggerApp *app)
+{
+    if (!window)
+    {
+        return;
+    }
+
+    GtkTreeIter iter;
+    gboolean valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(app->watches), &iter);
+
+    while (valid)
+    {
+        set_watch_value(app->watches, &iter, app->nes);
+        valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(app->watches), &iter);
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef _WATCH_WIN_H_
+#define _WATCH_WIN_H_
+
+#include <gtk/gtk.h>
+
+#include "debugger_app.h"
+
+#define WATCH_WINDOW_TYPE (watch_window_get_type())
+G_DECLARE_FINAL_TYPE(WatchWindow, watch_window, WATCH, WINDOW, GtkWindow);
+
+WatchWindow *watch_window_new(DebuggerApp *app);
+
+void update_watch_window(WatchWindow *window, DebuggerApp *app);
+
+#endif
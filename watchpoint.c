@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "watchpoint.h"
+
+void watchpoints_clear(WATCHPOINTS *watchpoints)
+{
+    for (int bus = 0; bus < NB_WATCH_BUSES; bus++)
+    {
+        watchpoints->buses[bus].count = 0;
+        memset(watchpoints->buses[bus].pages, 0, sizeof(watchpoints->buses[bus].pages));
+    }
+
+    watchpoints->match_count = 0;
+}
+
+void watchpoints_add(WATCHPOINTS *watchpoints, enum WATCH_BUS bus, unsigned short start, unsigned short end, unsigned char access, unsigned int tag)
+{
+    WATCH_LIST *list = &watchpoints->buses[bus];
+
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->ranges = realloc(list->ranges, list->capacity * sizeof(WATCH_RANGE));
+    }
+
+    unsigned int i = list->count;
+    while (i > 0 && list->ranges[i - 1].start > start)
+    {
+        i--;
+    }
+
+    memmove(list->ranges + i + 1, list->ranges + i, (list->count - i) * sizeof(WATCH_RANGE));
+    list->count++;
+
+    list->ranges[i].start = start;
+    list->ranges[i].end = end;
+    list->ranges[i].access = access;
+    list->ranges[i].tag = tag;
+
+    for (; i < list->count; i++)
+    {
+        unsigned short previous_max_end = i ? list->ranges[i - 1].max_end : 0;
+        list->ranges[i].max_end = list->ranges[i].end > previous_max_end ? list->ranges[i].end : previous_max_end;
+    }
+
+    for (unsigned int page = start >> 8; page <= (unsigned int)(end >> 8); page++)
+    {
+        list->pages[page] |= access;
+    }
+}
+
+static void watchpoints_record(WATCHPOINTS *watchpoints, enum WATCH_BUS bus, unsigned short address, unsigned char access, unsigned int tag)
+{
+    if (!watchpoints->match_count)
+    {
+        watchpoints->hit_bus = bus;
+        watchpoints->hit_address = address;
+        watchpoints->hit_access = access;
+    }
+
+    for (unsigned int i = 0; i < watchpoints->match_count; i++)
+    {
+        if (watchpoints->matches[i] == tag)
+        {
+            return;
+        }
+    }
+
+    if (watchpoints->match_count < WATCH_MAX_MATCHES)
+    {
+        watchpoints->matches[watchpoints->match_count++] = tag;
+    }
+}
+
+// Exact check once the page filter matched: walks back from the last range starting at or before the address
+void watchpoints_match(WATCHPOINTS *watchpoints, enum WATCH_BUS bus, unsigned short address, unsigned char access)
+{
+    WATCH_LIST *list = &watchpoints->buses[bus];
+    unsigned int low = 0;
+    unsigned int high = list->count;
+
+    while (low < high)
+    {
+        unsigned int middle = (low + high) / 2;
+
+        if (list->ranges[middle].start <= address)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    for (int i = (int)low - 1; i >= 0 && list->ranges[i].max_end >= address; i--)
+    {
+        if (list->ranges[i].end >= address && (list->ranges[i].access & access))
+        {
+            watchpoints_record(watchpoints, bus, address, list->ranges[i].access & access, list->ranges[i].tag);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef _WATCHPOINT_H_
+#define _WATCHPOINT_H_
+
+#define WATCH_READ 0x01
+#define WATCH_WRITE 0x02
+#define WATCH_CHANGE 0x04 // write of a different value
+
+#define WATCH_MAX_MATCHES 16
+
+enum WATCH_BUS
+{
+    WATCH_BUS_CPU,
+    WATCH_BUS_PPU,
+    WATCH_BUS_OAM,
+    NB_WATCH_BUSES
+};
+
+typedef struct
+{
+    unsigned short start;
+    unsigned short end; // inclusive
+    unsigned char access;
+    unsigned short max_end; // highest end of this range and the ones before it
+    unsigned int tag;       // index of the breakpoint the range comes from
+} WATCH_RANGE;
+
+/*
+ * Address ranges sorted by start, with the union of the access kinds watched in each 256-byte
+ * page so that accesses to pages without any watchpoint are rejected with a single test.
+ */
+typedef struct
+{
+    WATCH_RANGE *ranges;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned char pages[256];
+} WATCH_LIST;
+
+typedef struct
+{
+    WATCH_LIST buses[NB_WATCH_BUSES];
+    unsigned int matches[WATCH_MAX_MATCHES]; // tags of the ranges hit since the run loop cleared them
+    unsigned int match_count;
+    enum WATCH_BUS hit_bus;
+    unsigned short hit_address;
+    unsigned char hit_access;
+} WATCHPOINTS;
+
+void watchpoints_clear(WATCHPOINTS *watchpoints);
+void watchpoints_add(WATCHPOINTS *watchpoints, enum WATCH_BUS bus, unsigned short start, unsigned short end, unsigned char access, unsigned int tag);
+void watchpoints_match(WATCHPOINTS *watchpoints, enum WATCH_BUS bus, unsigned short address, unsigned char access);
+
+// Access kinds watched somewhere in the page of the address, to skip computing the old value of a write
+static inline unsigned char watchpoints_covered(WATCHPOINTS *watchpoints, enum WATCH_BUS bus, unsigned short address)
+{
+    return watchpoints->buses[bus].pages[address >> 8];
+}
+
+static inline void watchpoints_check(WATCHPOINTS *watchpoints, enum WATCH_BUS bus, unsigned short address, unsigned char access)
+{
+    if (watchpoints->buses[bus].pages[address >> 8] & access)
+    {
+        watchpoints_match(watchpoints, bus, address, access);
+    }
+}
+
+#endif
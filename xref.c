@@ -0,0 +1,434 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "xref.h"
+
+#define XREF_SET_INITIAL_CAPACITY 1024
+#define XREF_MAX_VARINT 5 // bytes of a 32-bit value
+
+// The location of an address seen from the bank, -1 when it depends on the switched bank
+int xref_location(const ANALYSIS *analysis, unsigned int bank, unsigned short address)
+{
+    if (address < XREF_ROM_LOCATION)
+    {
+        return address;
+    }
+
+    int offset = analysis_offset(analysis, bank, address);
+
+    return offset < 0 ? -1 : XREF_ROM_LOCATION + offset;
+}
+
+unsigned short xref_location_address(const ANALYSIS *analysis, unsigned int location)
+{
+    return location < XREF_ROM_LOCATION ? location : analysis_address(analysis, location - XREF_ROM_LOCATION);
+}
+
+// Short name of the main kind, for display
+const char *xref_kinds_name(unsigned char kinds)
+{
+    if (kinds & XREF_CALL)
+    {
+        return "call";
+    }
+
+    if (kinds & XREF_JUMP)
+    {
+        return "jump";
+    }
+
+    if ((kinds & (XREF_READ | XREF_WRITE)) == (XREF_READ | XREF_WRITE))
+    {
+        return "read/write";
+    }
+
+    return kinds & XREF_WRITE ? "write" : "read";
+}
+
+static void xref_set_init(XREF_SET *set)
+{
+    set->capacity = XREF_SET_INITIAL_CAPACITY;
+    set->count = 0;
+    set->keys = calloc(set->capacity, sizeof(unsigned long long));
+    set->kinds = malloc(set->capacity);
+}
+
+static unsigned int xref_set_slot(const XREF_SET *set, unsigned long long key)
+{
+    unsigned int mask = set->capacity - 1;
+    unsigned int slot = (key * 0x9e3779b97f4a7c15ULL) >> 40 & mask;
+
+    while (set->keys[slot] && set->keys[slot] != key)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void xref_set_grow(XREF_SET *set)
+{
+    XREF_SET old = *set;
+
+    set->capacity *= 2;
+    set->keys = calloc(set->capacity, sizeof(unsigned long long));
+    set->kinds = malloc(set->capacity);
+
+    for (unsigned int i = 0; i < old.capacity; i++)
+    {
+        if (old.keys[i])
+        {
+            unsigned int slot = xref_set_slot(set, old.keys[i]);
+
+            set->keys[slot] = old.keys[i];
+            set->kinds[slot] = old.kinds[i];
+        }
+    }
+
+    free(old.keys);
+    free(old.kinds);
+}
+
+// Adds the kinds to the pair, returns the ones it did not have yet
+static unsigned char xref_set_add(XREF_SET *set, unsigned int to, unsigned int from, unsigned char kinds)
+{
+    if (set->count * 2 >= set->capacity)
+    {
+        xref_set_grow(set);
+    }
+
+    unsigned long long key = ((unsigned long long)to << 32 | from) + 1;
+    unsigned int slot = xref_set_slot(set, key);
+
+    if (!set->keys[slot])
+    {
+        set->keys[slot] = key;
+        set->kinds[slot] = kinds;
+        set->count++;
+
+        return kinds;
+    }
+
+    unsigned char added = kinds & ~set->kinds[slot];
+    set->kinds[slot] |= kinds;
+
+    return added;
+}
+
+static void xref_set_clear(XREF_SET *set)
+{
+    memset(set->keys, 0, set->capacity * sizeof(unsigned long long));
+    set->count = 0;
+}
+
+static void xref_set_free(XREF_SET *set)
+{
+    free(set->keys);
+    free(set->kinds);
+}
+
+static void xref_append(XREF **xrefs, unsigned int *count, unsigned int *capacity, XREF *xref)
+{
+    if (*count == *capacity)
+    {
+        *capacity = *capacity ? *capacity * 2 : 256;
+        *xrefs = realloc(*xrefs, *capacity * sizeof(XREF));
+    }
+
+    (*xrefs)[(*count)++] = *xref;
+}
+
+XREF_INDEX *create_xref_index(unsigned int prg_size)
+{
+    XREF_INDEX *index = malloc(sizeof(XREF_INDEX));
+
+    index->location_count = XREF_ROM_LOCATION + prg_size;
+    index->starts = calloc(index->location_count + 1, sizeof(unsigned int));
+    index->counts = calloc(index->location_count, sizeof(unsigned int));
+    index->kinds = calloc(index->location_count, 1);
+    index->postings = malloc(1);
+    index->postings_size = 0;
+    index->pending = NULL;
+    index->pending_count = 0;
+    index->pending_capacity = 0;
+    xref_set_init(&index->known);
+
+    return index;
+}
+
+void free_xref_index(XREF_INDEX *index)
+{
+    free(index->starts);
+    free(index->counts);
+    free(index->kinds);
+    free(index->postings);
+    free(index->pending);
+    xref_set_free(&index->known);
+    free(index);
+}
+
+// Queued until the next commit, nothing is queued for a reference already known
+void xref_index_add(XREF_INDEX *index, unsigned int to, unsigned int from, unsigned char kinds)
+{
+    if (to >= index->location_count || from >= index->location_count)
+    {
+        return;
+    }
+
+    if (xref_set_add(&index->known, to, from, kinds))
+    {
+        XREF xref = {to, from, kinds};
+
+        xref_append(&index->pending, &index->pending_count, &index->pending_capacity, &xref);
+    }
+}
+
+// Operands of the code found by the analysis, and its control flow edges
+void xref_index_add_analysis(XREF_INDEX *index, const ANALYSIS *analysis)
+{
+    for (unsigned int offset = 0; offset < analysis->prg_size; offset++)
+    {
+        if (!(analysis->marks[offset] & BYTE_OPCODE))
+        {
+            continue;
+        }
+
+        unsigned char *prg = analysis->prg;
+        INSTRUCTION instruction;
+
+        dis_parse_instruction(prg[offset], offset + 1 < analysis->prg_size ? prg[offset + 1] : 0,
+                              offset + 2 < analysis->prg_size ? prg[offset + 2] : 0, &instruction);
+
+        unsigned char kinds = OPCODES[instruction.opcode].access;
+
+        // Targets of the control flow come from the edges, in every bank they may be in
+        if (!kinds || kinds & (XREF_JUMP | XREF_CALL))
+        {
+            continue;
+        }
+
+        int to = xref_location(analysis, offset / PRG_BANK_SIZE, instruction.address);
+
+        if (to >= 0)
+        {
+            xref_index_add(index, to, XREF_ROM_LOCATION + offset, kinds);
+        }
+    }
+
+    for (unsigned int i = 0; i < analysis->edge_count; i++)
+    {
+        CFG_EDGE *edge = &analysis->edges[i];
+
+        xref_index_add(index, XREF_ROM_LOCATION + edge->to, XREF_ROM_LOCATION + edge->from,
+                       edge->kind == EDGE_CALL ? XREF_CALL : XREF_JUMP);
+    }
+}
+
+static unsigned char *xref_encode(unsigned char *out, unsigned int value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = value | 0x80;
+        value >>= 7;
+    }
+
+    *out++ = value;
+
+    return out;
+}
+
+static const unsigned char *xref_decode(const unsigned char *in, unsigned int *value)
+{
+    unsigned int shift = 0;
+
+    *value = 0;
+
+    do
+    {
+        *value |= (*in & 0x7f) << shift;
+        shift += 7;
+    } while (*in++ & 0x80);
+
+    return in;
+}
+
+static int xref_compare(const void *a, const void *b)
+{
+    const XREF *xref_a = a;
+    const XREF *xref_b = b;
+
+    if (xref_a->to != xref_b->to)
+    {
+        return xref_a->to < xref_b->to ? -1 : 1;
+    }
+
+    return xref_a->from < xref_b->from ? -1 : xref_a->from > xref_b->from;
+}
+
+/*
+ * Merges the pending references into the lists. The lists without any are copied as they are,
+ * the others are decoded and merged with the pending ones. Returns 0 when nothing was pending.
+ */
+int xref_index_commit(XREF_INDEX *index)
+{
+    if (!index->pending_count)
+    {
+        return 0;
+    }
+
+    qsort(index->pending, index->pending_count, sizeof(XREF), xref_compare);
+
+    unsigned char *postings = malloc(index->postings_size + index->pending_count * XREF_MAX_VARINT);
+    unsigned char *out = postings;
+    unsigned int next = 0;
+
+    for (unsigned int location = 0; location < index->location_count; location++)
+    {
+        const unsigned char *in = index->postings + index->starts[location];
+        const unsigned char *end = index->postings + index->starts[location + 1];
+
+        index->starts[location] = out - postings;
+
+        if (next == index->pending_count || index->pending[next].to != location)
+        {
+            memcpy(out, in, end - in);
+            out += end - in;
+            continue;
+        }
+
+        unsigned int previous = 0;
+        unsigned int count = 0;
+        int have_old = in < end;
+        unsigned int old_from = 0;
+        unsigned int old_kinds = 0;
+
+        if (have_old)
+        {
+            unsigned int value;
+            in = xref_decode(in, &value);
+            old_from = value >> 4;
+            old_kinds = value & 0x0f;
+        }
+
+        // Both lists are sorted by source, the same source in both gets the union of the kinds
+        for (;;)
+        {
+            int have_new = next < index->pending_count && index->pending[next].to == location;
+
+            if (!have_old && !have_new)
+            {
+                break;
+            }
+
+            unsigned int from = !have_new || (have_old && old_from < index->pending[next].from) ? old_from : index->pending[next].from;
+            unsigned char kinds = 0;
+
+            if (have_old && old_from == from)
+            {
+                kinds = old_kinds;
+                have_old = in < end;
+
+                if (have_old)
+                {
+                    unsigned int value;
+                    in = xref_decode(in, &value);
+                    old_from += value >> 4;
+                    old_kinds = value & 0x0f;
+                }
+            }
+
+            while (next < index->pending_count && index->pending[next].to == location && index->pending[next].from == from)
+            {
+                kinds |= index->pending[next++].kinds;
+            }
+
+            out = xref_encode(out, (from - previous) << 4 | kinds);
+            previous = from;
+            index->kinds[location] |= kinds;
+            count++;
+        }
+
+        index->counts[location] = count;
+    }
+
+    index->starts[index->location_count] = out - postings;
+    index->postings_size = out - postings;
+
+    free(index->postings);
+    index->postings = postings;
+    index->pending_count = 0;
+
+    return 1;
+}
+
+// Copies up to max references of the location, returns how many were copied
+unsigned int xref_index_list(const XREF_INDEX *index, unsigned int location, XREF *xrefs, unsigned int max)
+{
+    if (location >= index->location_count)
+    {
+        return 0;
+    }
+
+    const unsigned char *in = index->postings + index->starts[location];
+    const unsigned char *end = index->postings + index->starts[location + 1];
+    unsigned int from = 0;
+    unsigned int count = 0;
+
+    while (in < end && count < max)
+    {
+        unsigned int value;
+
+        in = xref_decode(in, &value);
+        from += value >> 4;
+
+        xrefs[count].to = location;
+        xrefs[count].from = from;
+        xrefs[count++].kinds = value & 0x0f;
+    }
+
+    return count;
+}
+
+XREF_LOG *create_xref_log()
+{
+    XREF_LOG *log = malloc(sizeof(XREF_LOG));
+
+    xref_set_init(&log->seen);
+    log->pending = NULL;
+    log->count = 0;
+    log->capacity = 0;
+
+    xref_log_clear(log);
+
+    return log;
+}
+
+void xref_log_clear(XREF_LOG *log)
+{
+    xref_set_clear(&log->seen);
+    log->count = 0;
+
+    memset(log->recent, 0xff, sizeof(log->recent));
+    memset(log->recent_kinds, 0, sizeof(log->recent_kinds));
+}
+
+void xref_log_add(XREF_LOG *log, unsigned short to, unsigned short from, unsigned char kinds)
+{
+    unsigned int slot = from & (XREF_LOG_RECENT - 1);
+    unsigned int key = to << 16 | from;
+
+    if (log->recent[slot] == key && !(kinds & ~log->recent_kinds[slot]))
+    {
+        return;
+    }
+
+    log->recent[slot] = key;
+    log->recent_kinds[slot] = kinds;
+
+    if (xref_set_add(&log->seen, to, from, kinds))
+    {
+        XREF xref = {to, from, kinds};
+
+        xref_append(&log->pending, &log->count, &log->capacity, &xref);
+    }
+}
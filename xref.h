@@ -0,0 +1,90 @@
+#ifndef _XREF_H_
+#define _XREF_H_
+
+#include "analyzer.h"
+#include "disassembler.h"
+
+// The ACCESS_ bits of the opcode table
+#define XREF_READ ACCESS_READ
+#define XREF_WRITE ACCESS_WRITE
+#define XREF_JUMP ACCESS_JUMP // branches, jumps and jump tables
+#define XREF_CALL ACCESS_CALL
+
+// Locations below are CPU addresses, the ones above are PRG offsets, so that every bank has its own
+#define XREF_ROM_LOCATION 0x8000
+
+typedef struct
+{
+    unsigned int to;   // location referenced
+    unsigned int from; // location of the instruction
+    unsigned char kinds;
+} XREF;
+
+// Pairs already seen and their kinds, open addressing
+typedef struct
+{
+    unsigned long long *keys; // to << 32 | from, plus one so that 0 is a free slot
+    unsigned char *kinds;
+    unsigned int capacity; // power of 2
+    unsigned int count;
+} XREF_SET;
+
+/*
+ * References of each location, as one list per location sorted by source and packed in a shared
+ * buffer: varints of the source delta shifted left by 4 with the kinds in the low bits. New
+ * references are collected in pending and merged by a commit, which only re-encodes the lists
+ * they touch.
+ */
+typedef struct
+{
+    unsigned int location_count;
+    unsigned int *starts; // offset of the list of each location in postings, one more for the end
+    unsigned int *counts;
+    unsigned char *kinds; // union of the kinds of the references to each location
+    unsigned char *postings;
+    unsigned int postings_size;
+    XREF_SET known;
+    XREF *pending;
+    unsigned int pending_count;
+    unsigned int pending_capacity;
+} XREF_INDEX;
+
+#define XREF_LOG_RECENT 4096 // instructions whose last reference is remembered, by address
+
+// References seen by the running emulator, in CPU addresses, until the UI takes them
+typedef struct
+{
+    XREF_SET seen;
+    XREF *pending;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int recent[XREF_LOG_RECENT]; // to << 16 | from, most instructions reference the same address every time
+    unsigned char recent_kinds[XREF_LOG_RECENT];
+} XREF_LOG;
+
+int xref_location(const ANALYSIS *analysis, unsigned int bank, unsigned short address);
+unsigned short xref_location_address(const ANALYSIS *analysis, unsigned int location);
+const char *xref_kinds_name(unsigned char kinds);
+
+XREF_INDEX *create_xref_index(unsigned int prg_size);
+void free_xref_index(XREF_INDEX *index);
+void xref_index_add(XREF_INDEX *index, unsigned int to, unsigned int from, unsigned char kinds);
+void xref_index_add_analysis(XREF_INDEX *index, const ANALYSIS *analysis);
+int xref_index_commit(XREF_INDEX *index);
+unsigned int xref_index_list(const XREF_INDEX *index, unsigned int location, XREF *xrefs, unsigned int max);
+
+static inline unsigned int xref_index_count(const XREF_INDEX *index, unsigned int location)
+{
+    return location < index->location_count ? index->counts[location] : 0;
+}
+
+static inline unsigned char xref_index_kinds(const XREF_INDEX *index, unsigned int location)
+{
+    return location < index->location_count ? index->kinds[location] : 0;
+}
+
+XREF_LOG *create_xref_log();
+void xref_log_clear(XREF_LOG *log);
+void xref_log_add(XREF_LOG *log, unsigned short to, unsigned short from, unsigned char kinds);
+
+#endif